@@ -0,0 +1,722 @@
+/* ----------------------------------------------------------- */
+/*                                                             */
+/*               _ ___       _   _   _                         */
+/*              /_\ | |_/ _ /_\ |_| |_|                        */
+/*              | | | | \   | | |   |                          */
+/*              =========   =========                          */
+/*                                                             */
+/*      Application Example using the ATK Real-Time API        */
+/*                                                             */
+/*       Machine Intelligence Laboratory (Speech Group)        */
+/*        Cambridge University Engineering Department          */
+/*                  http://mi.eng.cam.ac.uk/                   */
+/*                                                             */
+/*               Copyright CUED 2000-2007                      */
+/*                                                             */
+/*   Use of this software is governed by a License Agreement   */
+/*    ** See the file License for the Conditions of Use  **    */
+/*    **     This banner notice must not be removed      **    */
+/*                                                             */
+/* ----------------------------------------------------------- */
+/*        File: ABench.cpp -    Offline decoder benchmark      */
+/* ----------------------------------------------------------- */
+
+char * abench_version="!HVER!ABench: 1.6.0 [CUED 19/10/26]";
+
+// ABench decodes a fixed set of utterances directly through HRec
+// (no ASource/ACode/ARec threads) for every combination of network,
+// nToks and beam width given on the command line and reports the
+// decoding speed, heap usage and word accuracy of each combination.
+// Features are computed once up front so that only the decoder is timed.
+
+#include "ARec.h"
+#include <vector>
+
+#define T_TOP 00001      /* Basic progress reporting */
+#define T_UTT 00002      /* Per utterance results */
+#define T_HYP 00004      /* Print recognised word strings */
+static int trace = 0;
+
+#define SYNSEED 1234     /* random seed for synthetic utterances */
+
+// ---------------------- Benchmark Data --------------------------
+
+typedef vector<string> WordSeq;
+
+struct BenchUtt {
+   string name;          // file name or "syn<n>"
+   int nFrames;          // number of observations
+   Observation *obs;     // array[0..nFrames-1] of observations
+   Boolean hasRef;       // TRUE if ref holds a reference transcription
+   WordSeq ref;          // reference word sequence
+};
+
+struct BenchNet {
+   string name;          // network file name or "loop<n>"
+   Network *net;         // compiled recognition network
+};
+
+struct BenchResult {
+   int utts,frames;      // utterances and frames decoded
+   double decodeTime;    // secs in ProcessObservation
+   double traceTime;     // secs in traceback
+   long nactSum;         // summed active instances
+   int nactMax;          // max active instances
+   size_t heapPeak;      // max bytes allocated by all heaps
+   int nRef;             // scoring totals over utts with references
+   int hits,dels,subs,ins;
+};
+
+// Global resources
+ARMan *rman;             // resource manager for dict, grammars and HMMSet
+AHmms *ahmms;            // HMM set
+ADict *dict;             // dictionary
+HMMSet *hset;            // HTK HMM set used by the decoder
+PSetInfo *psi;           // decoder model information
+MemHeap dataHeap;        // observations and references
+HTime sampPeriod = 100000.0;  // frame period
+
+vector<BenchUtt> utts;   // utterances to decode
+vector<BenchNet> nets;   // networks to decode with
+
+// Command line arguments
+
+string hmmlist;          // file containing hmmlist
+string mmffile0;         // main hmm mmf file
+string mmffile1;         // aux mmf file
+string dctfile;          // dictionary file
+string scpfile;          // list of wave files to decode
+string outfile;          // optional results table
+char * mlffile = NULL;   // reference mlf
+list<string> netFiles;   // networks given by -w
+list<int> loopSizes;     // word loop networks given by -l
+list<int> synLengths;    // synthetic utterances given by -f
+list<string> ignWords;   // words ignored when scoring
+vector<float> genBeams;  // general beams to sweep
+vector<int> nToksList;   // nToks values to sweep
+
+float wordBeam = 200.0;  // fixed rec control constants
+float nBeam = 225.0;
+float wordPen = 0.0;
+float lmScale = 1.0;
+float prScale = 1.0;
+int maxActive = 0;
+int repeats = 1;         // decode each utterance repeats times
+Boolean heapStats = FALSE;  // PrintAllHeapStats after each run
+FILE *outf = NULL;
+
+// ---------------------- Initialisation Code ---------------------------
+
+void ReportUsage(void)
+{
+   printf("\nUSAGE: ABench [options] VocabFile HMMList\n\n");
+   printf(" Option                                   Default\n\n");
+   printf(" -e s    ignore word s when scoring          none\n");
+   printf(" -f i    add synthetic utterance of i frames none\n");
+   printf(" -i s    write results table to s            off\n");
+   printf(" -l i    add word loop of first i dict words none\n");
+   printf(" -m      print heap stats after each run     off\n");
+   printf(" -n s    list of nToks values eg 0,3,5       0\n");
+   printf(" -p f    inter model trans penalty (log)     0.0\n");
+   printf(" -r f    pronunciation scale factor          1.0\n");
+   printf(" -s f    link lm scale factor                1.0\n");
+   printf(" -t s    list of general beams eg 150,225    225.0\n");
+   printf(" -u i    set pruning max active              0\n");
+   printf(" -v f    set word beam threshold             200.0\n");
+   printf(" -w s    add recognition network s           none\n");
+   printf(" -x i    decode each utterance i times       1\n");
+   PrintStdOpts("HIST");
+   printf("\n\n");
+}
+
+// ParseList: split comma separated list s into numbers
+static void ParseFltList(char *s, vector<float>& v)
+{
+   char *p;
+
+   v.clear();
+   for (p=strtok(s,","); p!=NULL; p=strtok(NULL,",")) {
+      float f = float(atof(p));
+      v.push_back(f==0.0?float(-LZERO):f);
+   }
+}
+
+static void ParseIntList(char *s, vector<int>& v)
+{
+   char *p;
+
+   v.clear();
+   for (p=strtok(s,","); p!=NULL; p=strtok(NULL,",")) {
+      int i = atoi(p);
+      if (i<0 || i>MAX_TOKS) {
+         HRError(3219,"ABench: nToks %d out of range",i); throw ATK_Error(3219);
+      }
+      v.push_back(i);
+   }
+}
+
+void Initialise(int argc, char *argv[])
+{
+   char *s;
+
+   DisableSCPHandling();
+   if (InitHTK(argc,argv,abench_version,TRUE)<SUCCESS){
+      HRError(9999,"ABench: cannot initialise HTK\n");
+      throw HTK_Error(9999);
+   }
+   if (!InfoPrinted() && NumArgs() == 0)
+      ReportUsage();
+   if (NumArgs() == 0) Exit(0);
+   EnableBTrees();   /* allows unseen triphones to be synthesised */
+   while (NextArg() == SWITCHARG) {
+      s = GetSwtArg();
+      if (strlen(s)!=1) {
+         HRError(3219,"ABench: Bad switch %s; must be single letter",s); throw ATK_Error(3219);
+      }
+      switch(s[0]){
+      case 'e':
+         ignWords.push_back(string(GetStrArg())); break;
+      case 'f':
+         synLengths.push_back(GetChkedInt(1,1000000,s)); break;
+      case 'i':
+         outfile = GetStrArg(); break;
+      case 'l':
+         loopSizes.push_back(GetChkedInt(1,1000000,s)); break;
+      case 'm':
+         heapStats = TRUE; break;
+      case 'n':
+         ParseIntList(GetStrArg(),nToksList); break;
+      case 'p':
+         wordPen = GetChkedFlt(-1000.0,1000.0,s); break;
+      case 'r':
+         prScale = GetChkedFlt(0.0,1000.0,s); break;
+      case 's':
+         lmScale = GetChkedFlt(0.0,1000.0,s); break;
+      case 't':
+         ParseFltList(GetStrArg(),genBeams); break;
+      case 'u':
+         maxActive = GetChkedInt(0,100000,s); break;
+      case 'v':
+         wordBeam = GetChkedFlt(0.0,1.0E20F,s);
+         if (wordBeam == 0.0) wordBeam = -LZERO;
+         break;
+      case 'w':
+         netFiles.push_back(string(GetStrArg())); break;
+      case 'x':
+         repeats = GetChkedInt(1,1000,s); break;
+      case 'H':
+         if (mmffile1 != ""){
+            HRError(3219,"ABench: max of two MMF files allowed"); throw ATK_Error(3219);
+         }
+         if (mmffile0 == "")
+            mmffile0 = string(GetStrArg());
+         else
+            mmffile1 = string(GetStrArg());
+         break;
+      case 'I':
+         mlffile = GetStrArg();
+         LoadMasterFile(mlffile);
+         break;
+      case 'S':
+         scpfile = GetStrArg();     break;
+      case 'T':
+         trace = GetChkedInt(0,511,s); break;
+      default:
+         HRError(3219,"ABench: Unknown switch %s",s); throw ATK_Error(3219);
+      }
+   }
+   if (NextArg()!=STRINGARG) {
+      HRError(3219,"ABench: Dictionary file name expected"); throw ATK_Error(3219);
+   }
+   dctfile = string(GetStrArg());
+   if (NextArg()!=STRINGARG) {
+      HRError(3219,"ABench: HMM list file name expected"); throw ATK_Error(3219);
+   }
+   hmmlist = string(GetStrArg());
+   if (mmffile0 == "") {
+      HRError(3219,"ABench: Model File needed [use switch -H]"); throw ATK_Error(3219);
+   }
+   if (netFiles.size()==0 && loopSizes.size()==0) {
+      HRError(3219,"ABench: at least one network needed [use switch -w or -l]");
+      throw ATK_Error(3219);
+   }
+   if (scpfile == "" && synLengths.size()==0) {
+      HRError(3219,"ABench: no data to decode [use switch -S or -f]");
+      throw ATK_Error(3219);
+   }
+   if (genBeams.size()==0) genBeams.push_back(225.0);
+   if (nToksList.size()==0) nToksList.push_back(0);
+   if (outfile != "") {
+      outf = fopen(outfile.c_str(),"w");
+      if (outf==NULL) {
+         HRError(3219,"ABench: cant create results file %s",outfile.c_str());
+         throw ATK_Error(3219);
+      }
+   }
+   CreateHeap(&dataHeap,"ABenchData",MSTAK,1,1.0,100000,1000000);
+}
+
+// ---------------------- Network Construction ---------------------------
+
+// LoopWords: return the first n distinct words in the dictionary file
+static WordSeq LoopWords(int n)
+{
+   Source src;
+   char buf[MAXSTRLEN],word[MAXSTRLEN];
+   WordSeq ws;
+
+   strcpy(buf,dctfile.c_str());
+   if (InitSource(buf, &src, DictFilter) != SUCCESS) {
+      HRError(3220,"ABench: cannot open dictionary %s",buf);
+      throw ATK_Error(3220);
+   }
+   while (int(ws.size())<n && ReadLine(&src,buf)) {
+      if (sscanf(buf,"%s",word)!=1) continue;
+      if (word[0]=='!' || word[0]=='<') continue;
+      if (ws.size()>0 && ws.back()==word) continue;
+      ws.push_back(string(word));
+   }
+   CloseSource(&src);
+   if (int(ws.size())<n)
+      printf("ABench: only %d words available for loop%d\n",int(ws.size()),n);
+   return ws;
+}
+
+// MakeLoopGram: word loop  NULL[0] -> words -> NULL[1] -> NULL[2]
+//                            ^__________________|
+static AGram *MakeLoopGram(const string& name, int n)
+{
+   WordSeq ws = LoopWords(n);
+   AGram *gram = new AGram(name,"");
+
+   gram->OpenEdit();
+   GramSubN *loop = gram->NewSubN("loop");
+   GramNode *snode = loop->NewNullNode(0);
+   GramNode *lnode = loop->NewNullNode(1);
+   GramNode *enode = loop->NewNullNode(2);
+   for (WordSeq::iterator w = ws.begin(); w != ws.end(); w++) {
+      GramNode *wnode = loop->NewWordNode(*w);
+      loop->AddLink(snode,wnode);
+      loop->AddLink(wnode,lnode);
+   }
+   loop->AddLink(lnode,snode);
+   loop->AddLink(lnode,enode);
+   loop->SetEnds(snode,enode);
+   gram->main = loop;
+   gram->CloseEdit();
+   return gram;
+}
+
+// AddNet: compile gram in its own resource group and add to nets
+static void AddNet(const string& name, AGram *gram)
+{
+   BenchNet bn;
+
+   rman->StoreGram(gram);
+   ResourceGroup *rg = rman->NewGroup(name);
+   rg->AddHMMs(ahmms);
+   rg->AddDict(dict);
+   rg->AddGram(gram);
+   bn.name = name;
+   bn.net = rg->MakeNetwork();
+   nets.push_back(bn);
+   if (trace&T_TOP)
+      printf("Network %s: %d nodes, %d links\n",name.c_str(),
+             bn.net->numNode,bn.net->numLink);
+}
+
+// LoadResources: load HMMs and dictionary and build every network
+void LoadResources()
+{
+   char buf[20];
+
+   rman = new ARMan;
+   ahmms = new AHmms("HmmSet",hmmlist,mmffile0,mmffile1);
+   rman->StoreHMMs(ahmms);
+   dict = new ADict("ADict",dctfile);
+   rman->StoreDict(dict);
+   ResourceGroup *main = rman->NewGroup("main");
+   main->AddHMMs(ahmms);
+   main->AddDict(dict);
+   hset = main->MakeHMMSet();
+   psi = InitPSetInfo(hset);
+
+   for (list<string>::iterator f = netFiles.begin(); f != netFiles.end(); f++)
+      AddNet(*f, new AGram(*f,*f));
+   for (list<int>::iterator n = loopSizes.begin(); n != loopSizes.end(); n++) {
+      sprintf(buf,"loop%d",*n);
+      AddNet(string(buf), MakeLoopGram(string(buf),*n));
+   }
+}
+
+// ---------------------- Utterance Data ---------------------------
+
+// Wave source for HParm: the whole file followed by silence
+struct WaveSrc {
+   short *data;          // samples
+   long nSamples;        // number of samples
+   long next;            // index of next sample
+};
+
+static Ptr xOpen(Ptr xInfo, char *fn, BufferInfo *info) { return xInfo; }
+static void xClose(Ptr xInfo, Ptr bInfo) {}
+static void xStart(Ptr xInfo, Ptr bInfo) {}
+static void xStop(Ptr xInfo, Ptr bInfo) {}
+static int xNumSamp(Ptr xInfo, Ptr bInfo) { return 1<<20; }
+
+static int xGetData(Ptr xInfo, Ptr bInfo, int n, Ptr data)
+{
+   WaveSrc *ws = (WaveSrc *) xInfo;
+   short *t = (short *) data;
+
+   for (int i=0; i<n; i++,ws->next++)
+      *t++ = (ws->next<ws->nSamples)?ws->data[ws->next]:FakeSilenceSample();
+   return n;
+}
+
+// LoadReference: find reference word sequence for fn in the mlf
+static void LoadReference(BenchUtt& u, const string& fn)
+{
+   char buf[MAXSTRLEN];
+   MemHeap tmp;
+   Transcription *t;
+   LabList *ll;
+
+   if (mlffile == NULL) return;
+   string lab = fn;
+   string::size_type i = lab.find_last_of('.');
+   if (i != string::npos && lab.find_first_of("/\\",i) == string::npos)
+      lab = lab.substr(0,i);
+   lab += ".lab";
+   strcpy(buf,lab.c_str());
+   CreateHeap(&tmp,"ABenchLab",MSTAK,1,1.0,5000,50000);
+   if ((t = LOpen(&tmp,buf,UNDEFF)) == NULL) {
+      HRError(3220,"ABench: no reference for %s",buf);
+      throw ATK_Error(3220);
+   }
+   ll = GetLabelList(t,1);
+   for (int k=1; k<=CountLabs(ll); k++)
+      u.ref.push_back(string(GetLabN(ll,k)->labid->name));
+   u.hasRef = TRUE;
+   DeleteHeap(&tmp);
+}
+
+// LoadWaveUtt: code wave file fn into observations
+static void LoadWaveUtt(const string& fn)
+{
+   MemHeap mem;
+   BufferInfo info;
+   HParmSrcDef ext;
+   ParmBuf pbuf;
+   Wave w;
+   WaveSrc ws;
+   BenchUtt u;
+   HTime sp = 0.0;
+   char buf[MAXSTRLEN];
+   short swidth[SMAX];
+   Boolean eSep;
+
+   CreateHeap(&mem,"ABenchWave",MSTAK,1,1.0,100000,1000000);
+   ws.next = 0;
+   ext = CreateSrcExt(&ws, WAVEFORM, 2, 0.0, xOpen, xClose,
+                      xStart, xStop, xNumSamp, xGetData);
+   if ((pbuf = OpenBuffer(&mem,"",ext))==NULL){
+      HRError(10200,"ABench: OpenBuffer failed - check config");
+      throw HTK_Error(10200);
+   }
+   GetBufferInfo(pbuf,&info);
+   strcpy(buf,fn.c_str());
+   w = OpenWaveInput(&mem,buf,UNDEFF,info.frSize*info.srcSampRate,
+                     info.frRate*info.srcSampRate,&sp);
+   if (w==NULL) {
+      HRError(3220,"ABench: cannot open wave file %s",buf);
+      throw HTK_Error(3220);
+   }
+   ws.data = GetWaveDirect(w,&ws.nSamples);
+   sampPeriod = info.tgtSampRate;
+
+   u.name = fn; u.hasRef = FALSE;
+   u.nFrames = (ws.nSamples<info.frSize)?0:
+      (ws.nSamples - info.frSize)/info.frRate + 1;
+   u.obs = (Observation *)New(&dataHeap,(u.nFrames+1)*sizeof(Observation));
+   ZeroStreamWidths(hset->swidth[0],swidth);
+   SetStreamWidths(info.tgtPK,info.tgtVecSize,swidth,&eSep);
+   StartBuffer(pbuf);
+   for (int i=0; i<u.nFrames; i++) {
+      u.obs[i] = MakeObservation(&dataHeap,swidth,info.tgtPK,FALSE,eSep);
+      ReadBuffer(pbuf,&u.obs[i]);
+   }
+   StopBuffer(pbuf);
+   if (u.nFrames>0 && (u.obs[0].pk != hset->pkind ||
+                       u.obs[0].swidth[1] != hset->swidth[1])) {
+      HRError(3221,"ABench: HMM set is not compatible with coded %s",buf);
+      throw ATK_Error(3221);
+   }
+   CloseBuffer(pbuf);
+   CloseWaveInput(w);
+   DeleteHeap(&mem);
+   LoadReference(u,fn);
+   utts.push_back(u);
+}
+
+// PhysHMMs: return all physical HMMs in hset
+static vector<HLink> PhysHMMs()
+{
+   vector<HLink> v;
+   MLink m;
+
+   for (int h=0; h<MACHASHSIZE; h++)
+      for (m=hset->mtab[h]; m!=NULL; m=m->next)
+         if (m->type == 'h') v.push_back((HLink) m->structure);
+   return v;
+}
+
+// LoadSynUtt: make an utterance of n frames by sampling the first
+// mixture component of each state of randomly chosen HMMs
+static void LoadSynUtt(int n, vector<HLink>& hmms)
+{
+   BenchUtt u;
+   char buf[20];
+   int i,j,k,s,d;
+
+   sprintf(buf,"syn%d",n);
+   u.name = buf; u.hasRef = FALSE; u.nFrames = n;
+   u.obs = (Observation *)New(&dataHeap,(n+1)*sizeof(Observation));
+   for (i=0; i<n;) {
+      HLink hmm = hmms[int(RandomValue()*hmms.size())%hmms.size()];
+      for (j=2; j<hmm->numStates && i<n; j++) {
+         StateInfo *si = hmm->svec[j].info;
+         for (d = 1+int(RandomValue()*3); d>0 && i<n; d--,i++) {
+            u.obs[i] = MakeObservation(&dataHeap,hset->swidth,hset->pkind,FALSE,FALSE);
+            for (s=1; s<=hset->swidth[0]; s++) {
+               MixPDF *mp = si->pdf[s].spdf.cpdf[1].mpdf;
+               for (k=1; k<=hset->swidth[s]; k++) {
+                  float sd = 0.0;
+                  if (mp->ckind == DIAGC) sd = sqrt(mp->cov.var[k]);
+                  else if (mp->ckind == INVDIAGC) sd = sqrt(1.0/mp->cov.var[k]);
+                  u.obs[i].fv[s][k] = GaussDeviate(mp->mean[k],sd);
+               }
+            }
+         }
+      }
+   }
+   utts.push_back(u);
+}
+
+// LoadUtterances: code every file in scpfile and make synthetic utts
+void LoadUtterances()
+{
+   Source src;
+   char buf[MAXSTRLEN];
+   int i;
+
+   if (scpfile != "") {
+      strcpy(buf,scpfile.c_str());
+      if (InitSource(buf, &src, NoFilter) != SUCCESS) {
+         HRError(3220,"ABench: cannot open scp file %s",buf);
+         throw ATK_Error(3220);
+      }
+      while (ReadLine(&src,buf)){
+         i = strlen(buf)-1;
+         while (i>=0 && isspace(buf[i])) i--;
+         buf[i+1] = '\0';
+         if (i>=0) LoadWaveUtt(string(buf));
+      }
+      CloseSource(&src);
+   }
+   if (synLengths.size()>0) {
+      if (hset->hsKind != PLAINHS && hset->hsKind != SHAREDHS) {
+         HRError(3221,"ABench: synthetic data needs continuous density HMMs");
+         throw ATK_Error(3221);
+      }
+      vector<HLink> hmms = PhysHMMs();
+      RandInit(SYNSEED);
+      for (list<int>::iterator n = synLengths.begin(); n != synLengths.end(); n++)
+         LoadSynUtt(*n,hmms);
+   }
+   if (trace&T_TOP) {
+      int nf = 0;
+      for (i=0; i<int(utts.size()); i++) nf += utts[i].nFrames;
+      printf("Loaded %d utterances, %d frames\n",int(utts.size()),nf);
+   }
+}
+
+// ---------------------- Scoring ---------------------------
+
+static Boolean Ignored(const string& w)
+{
+   for (list<string>::iterator i = ignWords.begin(); i != ignWords.end(); i++)
+      if (*i == w) return TRUE;
+   return FALSE;
+}
+
+// PathWords: extract the word sequence from a partial path
+static WordSeq PathWords(PartialPath pp)
+{
+   WordSeq ws;
+   Path *p = pp.path;
+
+   for (int i=pp.n; i>0 && p!=NULL; i--, p=p->prev) {
+      NetNode *node = p->owner->node;
+      if (node->info.pron == NULL || node->info.pron->word == NULL) continue;
+      string w = node->info.pron->word->wordName->name;
+      if (w == "!NULL") continue;
+      ws.insert(ws.begin(),w);
+   }
+   return ws;
+}
+
+// ScoreUtt: dynamic programming alignment of hyp against ref using the
+// HResults penalties, accumulating hits, deletions, subs and insertions
+static void ScoreUtt(WordSeq ref, WordSeq hyp, BenchResult& r)
+{
+   const int subPen = 10, delPen = 7, insPen = 7;
+   WordSeq R,H;
+   int i,j,nr,nh;
+
+   for (i=0; i<int(ref.size()); i++) if (!Ignored(ref[i])) R.push_back(ref[i]);
+   for (i=0; i<int(hyp.size()); i++) if (!Ignored(hyp[i])) H.push_back(hyp[i]);
+   nr = R.size(); nh = H.size();
+   vector< vector<int> > sc(nr+1, vector<int>(nh+1));
+   vector< vector<char> > dir(nr+1, vector<char>(nh+1));
+   for (i=0; i<=nr; i++) { sc[i][0] = i*delPen; dir[i][0] = 'd'; }
+   for (j=0; j<=nh; j++) { sc[0][j] = j*insPen; dir[0][j] = 'i'; }
+   for (i=1; i<=nr; i++)
+      for (j=1; j<=nh; j++) {
+         int d = sc[i-1][j] + delPen;
+         int n = sc[i][j-1] + insPen;
+         int h = sc[i-1][j-1] + ((R[i-1]==H[j-1])?0:subPen);
+         sc[i][j] = h; dir[i][j] = 'h';
+         if (d < sc[i][j]) { sc[i][j] = d; dir[i][j] = 'd'; }
+         if (n < sc[i][j]) { sc[i][j] = n; dir[i][j] = 'i'; }
+      }
+   for (i=nr,j=nh; i>0 || j>0;) {
+      switch (dir[i][j]) {
+      case 'h':
+         if (R[i-1]==H[j-1]) ++r.hits; else ++r.subs;
+         --i; --j; break;
+      case 'd': ++r.dels; --i; break;
+      case 'i': ++r.ins; --j; break;
+      }
+   }
+   r.nRef += nr;
+}
+
+// ---------------------- Decoding ---------------------------
+
+// RunBench: decode all utterances with the given net, nToks and beam
+static BenchResult RunBench(BenchNet& bn, PRecInfo *pri, float genBeam)
+{
+   BenchResult r;
+   PartialPath pp;
+   double t0,t1;
+   size_t hp;
+
+   memset(&r,0,sizeof(r));
+   for (int rep=0; rep<repeats; rep++)
+      for (int u=0; u<int(utts.size()); u++) {
+         BenchUtt& utt = utts[u];
+         StartRecognition(pri,bn.net,lmScale,wordPen,prScale,0.0,NULL);
+         SetPruningLevels(pri,maxActive,genBeam,wordBeam,
+                          (nBeam<genBeam)?genBeam:nBeam,10.0);
+         ResetRecStats(pri,FALSE);
+         t0 = GetClockNow();
+         for (int i=0; i<utt.nFrames; i++)
+            ProcessObservation(pri,&utt.obs[i],-1,hset->curXForm);
+         t1 = GetClockNow();
+         pp = FinalBestPath(pri);
+         if (pp.n==0) pp = CurrentBestPath(pri);
+         WordSeq hyp = PathWords(pp);
+         r.traceTime += GetClockNow() - t1;
+         r.decodeTime += t1 - t0;
+         ++r.utts; r.frames += utt.nFrames;
+         r.nactSum += pri->stats.nactSum;
+         if (pri->stats.nactMax > r.nactMax) r.nactMax = pri->stats.nactMax;
+         // heaps only grow during an utterance so this is the peak
+         hp = TotalHeapAlloc();
+         if (hp > r.heapPeak) r.heapPeak = hp;
+         if (rep==0 && utt.hasRef) ScoreUtt(utt.ref,hyp,r);
+         if (rep==0 && (trace&(T_UTT|T_HYP))) {
+            printf("  %-14s %5d frames %7.3fs",utt.name.c_str(),utt.nFrames,t1-t0);
+            if (trace&T_HYP)
+               for (int k=0; k<int(hyp.size()); k++) printf(" %s",hyp[k].c_str());
+            printf("\n");
+         }
+         CompleteRecognition(pri);
+      }
+   return r;
+}
+
+static void PrintHeader(FILE *f)
+{
+   fprintf(f,"%-16s %5s %8s %6s %7s %8s %7s %9s %7s %6s %6s %7s\n",
+           "network","ntoks","beam","utts","frames","decode","xRT",
+           "frames/s","nact","maxact","heapMB","acc");
+}
+
+static void PrintResult(FILE *f, BenchNet& bn, int nToks, float beam, BenchResult& r)
+{
+   double audio = r.frames*sampPeriod/1e7;
+   double fr = (r.frames>0)?r.frames:1;
+   char acc[20];
+
+   if (r.nRef>0)
+      sprintf(acc,"%7.2f",100.0*(r.hits-r.ins)/r.nRef);
+   else
+      strcpy(acc,"      -");
+   fprintf(f,"%-16s %5d %8.1f %6d %7d %8.3f %7.4f %9.1f %7.1f %6d %6.1f %s\n",
+           bn.name.c_str(),nToks,beam,r.utts,r.frames,r.decodeTime,
+           (audio>0.0)?(r.decodeTime+r.traceTime)/audio:0.0,
+           (r.decodeTime>0.0)?r.frames/r.decodeTime:0.0,
+           r.nactSum/fr,r.nactMax,r.heapPeak/1048576.0,acc);
+   fflush(f);
+}
+
+// RunAll: sweep networks x nToks x beams
+void RunAll()
+{
+   PrintHeader(stdout);
+   if (outf != NULL) PrintHeader(outf);
+   for (int t=0; t<int(nToksList.size()); t++) {
+      PRecInfo *pri = InitPRecInfo(psi,nToksList[t]);
+      for (int n=0; n<int(nets.size()); n++)
+         for (int b=0; b<int(genBeams.size()); b++) {
+            BenchResult r = RunBench(nets[n],pri,genBeams[b]);
+            PrintResult(stdout,nets[n],nToksList[t],genBeams[b],r);
+            if (outf != NULL) PrintResult(outf,nets[n],nToksList[t],genBeams[b],r);
+            if (heapStats) PrintAllHeapStats();
+         }
+      DeletePRecInfo(pri);
+   }
+}
+
+// ---------------------------- Main Program ---------------------------
+
+int main(int argc, char *argv[])
+{
+   try {
+      Initialise(argc,argv);
+      LoadResources();
+      LoadUtterances();
+      RunAll();
+      if (outf != NULL) fclose(outf);
+      return 0;
+   }
+   catch (ATK_Error e){
+      int n = HRErrorCount();
+      printf("ATK Error %d\n",e.i);
+      for (int i=1; i<=n; i++)
+         printf("  %d. %s\n",i,HRErrorGetMess(i));
+      fflush(stdout);
+   }
+   catch (HTK_Error e){
+      int n = HRErrorCount();
+      printf("HTK Error %d\n",e.i);
+      for (int i=1; i<=n; i++)
+         printf("  %d. %s\n",i,HRErrorGetMess(i));
+      fflush(stdout);
+   }
+   return 0;
+}
+
+// ------------------------- End ABench.cpp -----------------------------
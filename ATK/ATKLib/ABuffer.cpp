@@ -25,6 +25,9 @@ char * abuffer_version="!HVER!ABuffer: 1.6.0 [SJY 01/06/07]";
 
 // 24/07/05 - sync locks added to buffer status checks though
 //       its not clear if they are an unecessary overhead
+// 19/10/26 - packet counts, depths and queueing times kept for AMonitor
+// 19/10/26 - overflow policies
+// 19/10/26 - queueing times only kept when timed, in a ring
 
 #include "ABuffer.h"
 
@@ -33,8 +36,35 @@ char * abuffer_version="!HVER!ABuffer: 1.6.0 [SJY 01/06/07]";
 ABuffer::ABuffer(const string& name, int maxPkts)
 {
   string s;
+  ConfParam *cParm[MAXGLOBS];
+  int i,numParm;
+  char buf[MAXSTRLEN];
 
   bname = name;  bsize = maxPkts;
+  policy = BlockOnFull;
+  // the size and policy may be set in the config under the name
+  strcpy(buf,name.c_str());
+  for (i=0; i<int(strlen(buf)); i++) buf[i] = toupper(buf[i]);
+  numParm = GetConfig(buf, FALSE, cParm, MAXGLOBS);
+  if (numParm>0){
+    if (GetConfInt(cParm,numParm,"MAXPKTS",&i)) bsize = i;
+    if (GetConfStr(cParm,numParm,"OVERFLOW",buf)){
+      for (i=0; i<int(strlen(buf)); i++) buf[i] = toupper(buf[i]);
+      if (strcmp(buf,"BLOCK")==0) policy = BlockOnFull;
+      else if (strcmp(buf,"DROPOLDEST")==0) policy = DropOldest;
+      else if (strcmp(buf,"DROPNEWEST")==0) policy = DropNewest;
+      else if (strcmp(buf,"COALESCE")==0) policy = CoalesceWave;
+      else if (strcmp(buf,"OVERLOAD")==0) policy = SignalOverload;
+      else {
+        HRError(10001,"ABuffer: %s has unknown OVERFLOW %s",name.c_str(),buf);
+        throw ATK_Error(10001);
+      }
+    }
+  }
+  if (bsize<0){
+    HRError(10001,"ABuffer: %s has MAXPKTS < 0",name.c_str());
+    throw ATK_Error(10001);
+  }
   // create lock and two signals for thread synchronisation
   s = name+":lock";
   lock = HCreateLock(s.c_str());
@@ -44,6 +74,9 @@ ABuffer::ABuffer(const string& name, int maxPkts)
   notEmpty = HCreateSignal(s.c_str());
   filter = AnyPacket;   // default is no filtering
   evCount = 0;
+  memset(&stats,0,sizeof(ABufferStats));
+  overloaded = peeked = FALSE;
+  timed = FALSE; tHead = 0;
 }
 
 // Set filter kind
@@ -52,8 +85,70 @@ void ABuffer::SetFilter(PacketKind kind)
   filter = kind;
 }
 
-// Push packet p onto the end of the pktList.  Wait for nonFull
-// if the buffer is full
+// Set overflow policy and size
+void ABuffer::SetOverflow(OverflowPolicy pol, int maxPkts)
+{
+  HEnterSection(lock);
+  policy = pol;
+  if (maxPkts>=0) bsize = maxPkts;
+  HLeaveSection(lock);
+  HSendSignal(notFull);
+}
+
+// Return and clear the overloaded flag
+Boolean ABuffer::Overloaded()
+{
+  HEnterSection(lock);
+  Boolean ans = overloaded;
+  overloaded = FALSE;
+  HLeaveSection(lock);
+  return ans;
+}
+
+// Drop the oldest wave packet other than a peeked one, which will be
+// popped.  Other packets such as the markers of a source are never
+// dropped.  Returns FALSE if there is no such packet, lock held
+Boolean ABuffer::DropOne()
+{
+  list<APacket>::iterator p = pktList.begin();
+  int i = 0, n = putTimes.size();
+
+  if (peeked && p != pktList.end()) { ++p; ++i; }
+  while (p != pktList.end() && p->GetKind() != WavePacket) { ++p; ++i; }
+  if (p == pktList.end()) return FALSE;
+  pktList.erase(p);
+  if (timed){
+    // the times of the packets in front move up over the dropped one's
+    for (; i>0; i--) putTimes[(tHead+i)%n] = putTimes[(tHead+i-1)%n];
+    tHead = (tHead+1)%n;
+  }
+  ++stats.dropped; overloaded = TRUE;
+  return TRUE;
+}
+
+// Merge wave packet p into the newest packet if that is a wave packet
+// which has not been peeked and the samples of both fit in one packet.
+// The merged packet is new (queued packets may be shared) and spans
+// the time of both.  Returns FALSE if p cannot be merged, lock held
+Boolean ABuffer::Coalesce(APacket& p)
+{
+  if (p.GetKind() != WavePacket || pktList.size()==0) return FALSE;
+  APacket& q = pktList.back();
+  if (q.GetKind() != WavePacket || (peeked && pktList.size()==1)) return FALSE;
+  AWaveData *qw = (AWaveData *)q.GetData();
+  AWaveData *pw = (AWaveData *)p.GetData();
+  if (qw->wused + pw->wused > WAVEPACKETSIZE) return FALSE;
+  AWaveData *w = new AWaveData(qw->wused,qw->data);
+  for (int i=0; i<pw->wused; i++) w->data[w->wused++] = pw->data[i];
+  APacket m(w);
+  m.SetStartTime(q.GetStartTime()); m.SetEndTime(p.GetEndTime());
+  q = m;
+  ++stats.coalesced; overloaded = TRUE;
+  return TRUE;
+}
+
+// Push packet p onto the end of the pktList.  If the buffer is full
+// apply its overflow policy, by default wait for notFull
 void ABuffer::PutPacket(APacket p)
 {
   assert(filter == AnyPacket || p.GetKind() == filter);
@@ -64,10 +159,46 @@ void ABuffer::PutPacket(APacket p)
   }
   
   HEnterSection(lock);
-  while (bsize!=0 && int(pktList.size())>= bsize) {
-    HWaitSignal(notFull, lock);
+  if (bsize!=0 && int(pktList.size())>= bsize) {
+    // only wave packets are dropped or merged, others are queued
+    // beyond maxPkts unless the buffer blocks
+    Boolean wave = (p.GetKind() == WavePacket)?TRUE:FALSE;
+    switch (policy) {
+    case DropOldest:
+      if (!wave || DropOne()) break;
+      // else drop p
+    case DropNewest:
+      if (!wave) break;
+      ++stats.dropped; overloaded = TRUE;
+      HLeaveSection(lock);
+      return;
+    case SignalOverload:
+      ++stats.overloads; overloaded = TRUE;
+      if (int(pktList.size()) >= 2*bsize) DropOne();
+      break;
+    case CoalesceWave:
+      if (!wave) break;
+      if (Coalesce(p)){
+        HLeaveSection(lock);
+        return;
+      }
+      // wave which does not fit is dropped as for DropOldest
+      if (DropOne()) break;
+      ++stats.dropped; overloaded = TRUE;
+      HLeaveSection(lock);
+      return;
+    case BlockOnFull:
+      ++stats.blocked;
+      while (bsize!=0 && int(pktList.size())>= bsize) {
+        HWaitSignal(notFull, lock);
+      }
+      break;
+    }
   }
+  PutTime();
   pktList.push_back(p);
+  ++stats.puts; stats.writer = HFindThreadSelf();
+  if (int(pktList.size()) > stats.hiwater) stats.hiwater = pktList.size();
   HLeaveSection(lock);
   HSendSignal(notEmpty);
   SendBufferEvents();
@@ -83,6 +214,7 @@ APacket ABuffer::GetPacket()
   }
   APacket p = pktList.front();
   pktList.pop_front();
+  Taken(p); peeked = FALSE;
   HLeaveSection(lock);
   HSendSignal(notFull);
   return p;
@@ -97,6 +229,7 @@ APacket ABuffer::PeekPacket()
     HWaitSignal(notEmpty, lock);
   }
   APacket p = pktList.front();
+  peeked = TRUE;
   HLeaveSection(lock);
   return p;
 }
@@ -107,7 +240,8 @@ void ABuffer::PopPacket()
   while (pktList.size()==0) {
     HWaitSignal(notEmpty, lock);
   }
-  pktList.pop_front();
+  Taken(pktList.front());
+  pktList.pop_front(); peeked = FALSE;
   HLeaveSection(lock);
   HSendSignal(notFull);
   SendBufferEvents();
@@ -116,8 +250,7 @@ void ABuffer::PopPacket()
 Boolean ABuffer::IsFull()
 {
   HEnterSection(lock);
-  if (bsize==0) return FALSE;
-  Boolean ans = (int(pktList.size())>=bsize)?TRUE:FALSE;
+  Boolean ans = (bsize>0 && int(pktList.size())>=bsize)?TRUE:FALSE;
   HLeaveSection(lock);
   return ans;
 }
@@ -189,6 +322,76 @@ string ABuffer::GetName()
   return bname;
 }
 
+// Count packet p taken from the front of the buffer, lock held
+void ABuffer::Taken(APacket& p)
+{
+  HTime dur = p.GetEndTime() - p.GetStartTime();
+
+  ++stats.gets; stats.reader = HFindThreadSelf();
+  if (timed){
+    double wait = GetClockNow() - TakeTime();
+    stats.waitSum += wait;
+    if (wait > stats.waitMax) stats.waitMax = wait;
+  }
+  if (dur > 0) stats.streamOut += dur;
+}
+
+// Record the time a packet is put, before it is queued.  The ring
+// holds one time per queued packet and is only grown, so rarely
+// allocates once it reaches the buffer size, lock held
+void ABuffer::PutTime()
+{
+  int i, n = pktList.size(), size = putTimes.size();
+
+  if (!timed) return;
+  if (n == size){
+    vector<double> t(2*size);
+    for (i=0; i<n; i++) t[i] = putTimes[(tHead+i)%size];
+    putTimes.swap(t); tHead = 0; size *= 2;
+  }
+  putTimes[(tHead+n)%size] = GetClockNow();
+}
+
+// Return the time the oldest packet was put and remove it, lock held
+double ABuffer::TakeTime()
+{
+  double t = putTimes[tHead];
+
+  tHead = (tHead+1)%putTimes.size();
+  return t;
+}
+
+// Start or stop timing.  The ring starts at the size of the buffer
+// and packets already queued are timed from now
+void ABuffer::SetTiming(Boolean on)
+{
+  int i, n, size;
+
+  HEnterSection(lock);
+  if (on && !timed){
+    n = pktList.size();
+    size = (policy==SignalOverload)?2*bsize:bsize;
+    if (size < n+1) size = n+1;
+    if (size < 16) size = 16;
+    putTimes.assign(size,GetClockNow()); tHead = 0;
+  } else if (!on)
+    putTimes.clear();
+  timed = on;
+  HLeaveSection(lock);
+}
+
+// Copy the counts to st, restarting the maxima if reset
+void ABuffer::GetStats(ABufferStats& st, Boolean reset)
+{
+  HEnterSection(lock);
+  stats.depth = pktList.size();
+  st = stats;
+  if (reset){
+    stats.hiwater = stats.depth; stats.waitMax = 0.0;
+  }
+  HLeaveSection(lock);
+}
+
 // ------------------------ End ABuffer.cpp ---------------------
 
 
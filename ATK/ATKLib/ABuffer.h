@@ -42,11 +42,53 @@ struct ABufferEventMsg {
   unsigned char id;
 };
 
+// What PutPacket does when the buffer holds maxPkts packets.  Only
+// wave packets are dropped, other packets such as the markers of a
+// source are queued beyond maxPkts by all but BlockOnFull
+enum OverflowPolicy {
+  BlockOnFull,      // wait until a packet is taken (the default)
+  DropOldest,       // discard the oldest packet
+  DropNewest,       // discard the packet being put
+  CoalesceWave,     // merge a wave packet into the newest one if the
+                    // samples fit, else drop the oldest
+  SignalOverload    // keep it and mark the buffer overloaded, up to
+                    // twice maxPkts after which the oldest is dropped
+};
+
+// Counts kept by every buffer, see GetStats
+struct ABufferStats {
+  long puts, gets;         // packets put and taken so far
+  int depth;               // packets queued now
+  int hiwater;             // max packets queued
+  double waitSum;          // total secs taken packets spent queued
+  double waitMax;          // max secs a packet spent queued (both timed only)
+  HTime streamOut;         // total duration (end-start) of taken packets
+  HThread writer, reader;  // threads which last put and took a packet
+  long blocked;            // puts which waited for room
+  long dropped;            // packets discarded by a drop policy
+  long coalesced;          // wave packets merged into the newest
+  long overloads;          // packets put beyond maxPkts by SignalOverload
+};
+
+// Configuration variables, for a buffer called name (Defaults as shown)
+// NAME: MAXPKTS  = maxPkts  -- packets held before overflow, 0 is no limit
+// NAME: OVERFLOW = BLOCK    -- or DROPOLDEST, DROPNEWEST, COALESCE, OVERLOAD
+
 class ABuffer {
 public:
   ABuffer (const string& name, int maxPkts = 0);
   // Construct an empty buffer.  The buffer will block after maxPkts
-  // inserted. If maxPkts is zero, buffer never blocks.
+  // inserted. If maxPkts is zero, buffer never blocks.  The size and
+  // overflow policy can be set in the config under the buffer name.
+
+  void SetOverflow(OverflowPolicy policy, int maxPkts = -1);
+  // Set the overflow policy and, if maxPkts >= 0, the size.  A live
+  // source should not block, eg its output buffer can drop the oldest
+  // audio when the consumer falls behind.
+
+  Boolean Overloaded();
+  // Returns TRUE if packets have been dropped, coalesced or put beyond
+  // maxPkts since the last call, so a consumer can shed work.
 
   void SetFilter(PacketKind kind);
   // Restrict buffer to only accept packets of given kind.
@@ -82,6 +124,15 @@ public:
   void RemoveListener(ABufferListener *listener);
   
   string GetName();
+
+  void GetStats(ABufferStats& stats, Boolean reset = FALSE);
+  // Copy the counts of the buffer to stats.  If reset, the hiwater
+  // and waitMax are restarted from the current depth and zero.
+
+  void SetTiming(Boolean on);
+  // Time how long packets spend queued, for waitSum and waitMax.  Off
+  // by default since it reads the clock on every put and take, AMonitor
+  // turns it on for the buffers it samples.
   
 private:
   string bname;                 // name of buffer
@@ -95,6 +146,18 @@ private:
   int evCount;                  // num events sent so far
   void SendBufferEvents();      // send requested buffer events
   ABufferListenerList listenerList;
+  Boolean timed;                // keep putTimes, see SetTiming
+  vector<double> putTimes;      // ring of clock times packets were queued
+  int tHead;                    // index in putTimes of the oldest packet
+  void PutTime();               // record time of packet put, lock held
+  double TakeTime();            // and of the oldest, lock held
+  ABufferStats stats;           // counts, guarded by lock
+  OverflowPolicy policy;        // what to do when full
+  Boolean overloaded;           // overflowed since Overloaded last called
+  Boolean peeked;               // front packet has been peeked
+  void Taken(APacket& p);       // count p taken, lock held
+  Boolean DropOne();            // drop oldest unpeeked wave packet, lock held
+  Boolean Coalesce(APacket& p); // merge p into the newest packet, lock held
 };
 
 #endif
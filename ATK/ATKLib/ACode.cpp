@@ -28,6 +28,8 @@ char * acode_version="!HVER!ACode: 1.6.0 [SJY 01/06/07]";
 //   5/08/03 - standardised display config var names
 //  11/08/04 - static variables removed
 //  21/06/05 - added multiple parameterisation support - MNS
+//  19/10/26 - task split into TaskInit/Event/Exit for AScheduler
+//  19/10/26 - no featuregram when headless
 
 #include "ACode.h"
 #define INBUFID 1
@@ -130,6 +132,7 @@ ACode::ACode(const string & name, ABuffer *inb, ABuffer *outb, char *confName)
       if (GetConfInt(cParm,numParm,"NUMSTREAMS",&i)) numStreams = i;
       if (GetConfInt(cParm,numParm,"TRACE",&i)) trace = i;
    }
+   if (!HGrafActive()) showFG = FALSE;
    CreateHeap(&mem, buf, MSTAK, 1, 1.0, 10000, 50000);
    ext = CreateSrcExt(this, WAVEFORM, 2, 0.0, xOpen, xClose,
       xStart, xStop, xNumSamp, xGetData);
@@ -157,10 +160,9 @@ HTime ACode::GetSampPeriod()
 }
 
 // Start the task
-TASKTYPE TASKMOD ACode_Task(void * p);
 void ACode::Start(HPriority priority)
 {
-   AComponent::Start(priority,ACode_Task);
+   AComponent::Start(priority,AComponent_Task);
 }
 
 void ACode::SetCodeHMMSet(AHmms *ahmms)
@@ -522,7 +524,7 @@ void ACode::ForwardMkr()
 {
    APacket mkr = holdList.front();
    holdList.pop_front();
-   if (showFG) AddMkr2FG(mkr);
+   if (HGrafActive() && showFG) AddMkr2FG(mkr);
    out->PutPacket(mkr);
    if (trace&T_OUT)mkr.Show();
 }
@@ -576,89 +578,88 @@ void ACode::HoldPacket(APacket p)
    }
 }
 
-// ACode task
-TASKTYPE TASKMOD ACode_Task(void * p)
+// ACode task: set up and request input and message events
+void ACode::TaskInit()
 {
-   ACode *acp = (ACode *)p;
-   APacket pkt,mkr;
-   char buf[100],cname[100];
-   HEventRec e;
+   char cname[100];
+
+   strcpy(cname,this->cname.c_str());
+   if (showFG){
+      win = MakeHWin(cname,fgx0,fgy0,width,height,1);
+      HSetGrey(win,50);
+      HFillRectangle(win,0,0,width,height);
+   }
+   StartBuffer(pbuf);
+   in->RequestBufferEvents(INBUFID);
+   RequestMessageEvents();
+}
+
+// ACode task: handle an event
+void ACode::TaskEvent(HEventRec &e)
+{
+   APacket pkt;
+   char buf[100];
    HTime tnow;
    PacketKind inpk;
 
-   try{
-      strcpy(cname,acp->cname.c_str());
-      if (acp->showFG){
-         acp->win = MakeHWin(cname,acp->fgx0,acp->fgy0,acp->width,acp->height,1);
-         HSetGrey(acp->win,50);
-         HFillRectangle(acp->win,0,0,acp->width,acp->height);
-      }
-      StartBuffer(acp->pbuf);
-      acp->in->RequestBufferEvents(INBUFID);
-      acp->RequestMessageEvents();
-      while (!acp->IsTerminated()){
-         e = HGetEvent(0,0);
-         switch(e.event){
-            case HTBUFFER:
-               switch(e.c){
-                  case MSGEVENTID:
-                     acp->ChkMessage();
-                     while (acp->IsSuspended()) acp->ChkMessage(TRUE);
-                     break;
-                  case INBUFID:
-                     // code a packet if HParm already has observations
-                     // or next input packet is a wavepacket so we know that HParm
-                     // wont block if we go ahead and get an obs anyway
-                     inpk=(FramesNeeded(acp->pbuf)<=0)?WavePacket:acp->in->GetFirstKind();
-                     while (inpk == WavePacket || inpk == StringPacket){
-                        switch (inpk){
-                           case WavePacket:
-                              pkt = acp->CodePacket();
-                              if (acp->showFG) acp->DrawFG(pkt);
-                              tnow = pkt.GetStartTime();
-                              // forward any pending marker packets
-                              acp->ForwardOldMkrs(tnow);
-                              acp->out->PutPacket(pkt);
-                              if (acp->trace&T_OUT) pkt.Show();
-                              break;
-                           case StringPacket:
-                              pkt = acp->in->GetPacket();
-                              acp->HoldPacket(pkt);
-                              AStringData * sd = (AStringData *)pkt.GetData();
-                              if (sd->GetMarker() == "TERMINATED") {
-                                 sprintf(buf, "terminated via input");
-                                 HPostMessage(HThreadSelf(),buf);
-                                 acp->terminated = TRUE;
-                              }
-                              break;
-                        }
-                        inpk=(FramesNeeded(acp->pbuf)<=0)?WavePacket:acp->in->GetFirstKind();
-                     }
-                     // input audio now processed so forward any remaining held packets
-                     acp->ForwardAllMkrs();
-               } /* switch(e.c) */
-               break;
-
-            case HWINCLOSE:
-               sprintf(buf, "terminating");
-               HPostMessage(HThreadSelf(),buf);
-               acp->terminated = TRUE;
+   switch(e.event){
+      case HTBUFFER:
+         switch(e.c){
+            case MSGEVENTID:
+               DoMessage();
                break;
-            case HMOUSEDOWN:
-               if (acp->FGinit && TrackButtons(&(acp->calb),e)>0)
-                  acp->ButtonPressed();
-         }
-      }
-      // forward a terminated message to output buffer
-      AStringData *sd = new AStringData(acp->cname+"::TERMINATED");
-      APacket mkrpkt(sd);
-      acp->out->PutPacket(mkrpkt);
-      if (acp->trace&T_TOP) printf("%s coder exiting\n",acp->cname.c_str());
-      HExitThread(0);
-      return 0;
+            case INBUFID:
+               // code a packet if HParm already has observations
+               // or next input packet is a wavepacket so we know that HParm
+               // wont block if we go ahead and get an obs anyway
+               inpk=(FramesNeeded(pbuf)<=0)?WavePacket:in->GetFirstKind();
+               while (inpk == WavePacket || inpk == StringPacket){
+                  switch (inpk){
+                     case WavePacket:
+                        pkt = CodePacket();
+                        if (HGrafActive() && showFG) DrawFG(pkt);
+                        tnow = pkt.GetStartTime();
+                        // forward any pending marker packets
+                        ForwardOldMkrs(tnow);
+                        out->PutPacket(pkt);
+                        if (trace&T_OUT) pkt.Show();
+                        break;
+                     case StringPacket:
+                        pkt = in->GetPacket();
+                        HoldPacket(pkt);
+                        AStringData * sd = (AStringData *)pkt.GetData();
+                        if (sd->GetMarker() == "TERMINATED") {
+                           sprintf(buf, "terminated via input");
+                           HPostMessage(HThreadSelf(),buf);
+                           terminated = TRUE;
+                        }
+                        break;
+                  }
+                  inpk=(FramesNeeded(pbuf)<=0)?WavePacket:in->GetFirstKind();
+               }
+               // input audio now processed so forward any remaining held packets
+               ForwardAllMkrs();
+         } /* switch(e.c) */
+         break;
+
+      case HWINCLOSE:
+         sprintf(buf, "terminating");
+         HPostMessage(HThreadSelf(),buf);
+         terminated = TRUE;
+         break;
+      case HMOUSEDOWN:
+         if (FGinit && TrackButtons(&calb,e)>0)
+            ButtonPressed();
    }
-   catch (ATK_Error e){ ReportErrors("ATK",e.i); return 0;}
-   catch (HTK_Error e){ ReportErrors("HTK",e.i); return 0;}
+}
+
+// ACode task: forward a terminated message to output buffer
+void ACode::TaskExit()
+{
+   AStringData *sd = new AStringData(cname+"::TERMINATED");
+   APacket mkrpkt(sd);
+   out->PutPacket(mkrpkt);
+   if (trace&T_TOP) printf("%s coder exiting\n",cname.c_str());
 }
 
 // ----------------------End of ACode.cpp ---------------------
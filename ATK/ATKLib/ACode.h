@@ -65,8 +65,12 @@ public:
   AObsData * GetSpecimen();
   HTime GetSampPeriod();
   void SetCodeHMMSet(AHmms *ahmm);
+  // stepped execution, not possible with a display
+  Boolean CanSchedule(){return showFG?FALSE:TRUE;}
+  void TaskInit();
+  void TaskEvent(HEventRec &e);
+  void TaskExit();
 private:
-  friend TASKTYPE TASKMOD ACode_Task(void *p);
   friend Ptr xOpen(Ptr xInfo, char *fn, BufferInfo *info);
   friend int xNumSamp(Ptr xInfo, Ptr bInfo);
   friend int xGetData(Ptr xInfo, Ptr bInfo, int n, Ptr data);
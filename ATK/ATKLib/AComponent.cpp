@@ -23,7 +23,12 @@
 
 char * acomponent_version="!HVER!AComponent: 1.6.0 [SJY 01/06/07]";
 
+// Modification history:
+//  19/10/26 - components can run as tasks of an AScheduler
+//  19/10/26 - component threads may be given cpus in the config
+
 #include "AComponent.h"
+#include "AScheduler.h"
 
 AComponent::AComponent(const string & name, const int numPrBufLines)
 {
@@ -31,6 +36,7 @@ AComponent::AComponent(const string & name, const int numPrBufLines)
    terminated = FALSE;
    suspended = FALSE;
    started = FALSE;
+   sched = NULL; stask = NULL;
    mbuf = new ABuffer(name+":mbuf");
    mbuf->SetFilter(CommandPacket);
    prBufLines = numPrBufLines;
@@ -121,6 +127,16 @@ void AComponent::ChkMessage(Boolean wait)
    }
 }
 
+// Exec message of a message event, a component with a thread of its
+// own waits here while suspended, a scheduled one is held by the
+// scheduler instead
+void AComponent::DoMessage()
+{
+   ChkMessage();
+   if (stask==NULL)
+      while (IsSuspended()) ChkMessage(TRUE);
+}
+
 // Functions to retrieve args from current command
 Boolean AComponent::GetStrArg(string & arg)
 {
@@ -158,18 +174,43 @@ Boolean AComponent::GetFltArg(float & arg, float lo, float hi)
 }
 
 // Start the component in its own thread with priority pr.  Pass this
-// to the thread so that it can still access its members
+// to the thread so that it can still access its members.  The thread
+// runs on the cpus given by CPUS in the component's config, if any
 void AComponent::Start(HPriority pr, TASKTYPE (TASKMOD *task)(void *))
 {
-   if(!started)
-      thread = HCreateThread(cname.c_str(),prBufLines,pr,task,(void *)this);
+   ConfParam *cParm[MAXGLOBS];
+   int numParm;
+   char buf[MAXSTRLEN];
+
+   if(!started){
+      if (sched!=NULL && CanSchedule())
+         sched->Add(this);
+      else {
+         thread = HCreateThread(cname.c_str(),prBufLines,pr,task,(void *)this);
+         numParm = GetConfig(UCase(cname.c_str(),buf), FALSE, cParm, MAXGLOBS);
+         if (numParm>0 && GetConfCpus(cParm,numParm,"CPUS",buf))
+            HSetThreadAffinity(thread,buf);
+      }
+   }
    started=TRUE;
 }
 
-// Wait to join with the components thread
+// Set the scheduler to run on when started
+void AComponent::SetScheduler(AScheduler *s)
+{
+   if (started){
+      HRError(10902,"AComponent: %s already started\n",cname.c_str());
+      throw ATK_Error(10902);
+   }
+   sched = s;
+}
+
+// Wait to join with the components thread or task
 int AComponent::Join()
 {
    int status;
+   if (stask!=NULL)
+      return sched->Join(this);
    HJoinThread(thread,&status);
    return status;
 }
@@ -182,4 +223,24 @@ void AComponent::Terminate()
 }
 
 
+// Thread task of a component which supports stepped execution
+TASKTYPE TASKMOD AComponent_Task(void *p)
+{
+   AComponent *comp = (AComponent *)p;
+   HEventRec e;
+
+   try{
+      comp->TaskInit();
+      while (!comp->IsTerminated()){
+         e = HGetEvent(0,0);
+         comp->TaskEvent(e);
+      }
+      comp->TaskExit();
+      HExitThread(0);
+      return 0;
+   }
+   catch (ATK_Error e){ ReportErrors("ATK",e.i); return 0;}
+   catch (HTK_Error e){ ReportErrors("HTK",e.i); return 0;}
+}
+
 // --------------------End of AComponent.cpp -------------------------
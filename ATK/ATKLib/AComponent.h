@@ -30,14 +30,33 @@
 
 #define MSGEVENTID 255
 
+class AScheduler;
+struct ASchedTask;
+
 class AComponent {
 public:
-  AComponent(){}
+  AComponent(){sched = NULL; stask = NULL;}
   AComponent(const string & name, const int numPrBufLines=1);
 
-  // Start the component executing
+  // Start the component executing, in its own thread running task
+  // or as a task of its scheduler (see SetScheduler)
   void Start(HPriority pr, TASKTYPE (TASKMOD *task)(void *));
 
+  // Run the component as a task of s rather than in its own thread
+  // when it is started, if it can be (see CanSchedule).  Must be
+  // called before Start.
+  virtual void SetScheduler(AScheduler *s);
+  Boolean IsScheduled(){return (stask!=NULL)?TRUE:FALSE;}
+
+  // Stepped execution.  A component which can run as a task provides
+  // these and returns TRUE from CanSchedule, its task is then TaskInit,
+  // TaskEvent for each event until terminated, and TaskExit.  The
+  // same code is run by AComponent_Task in a thread of its own.
+  virtual Boolean CanSchedule(){return FALSE;}
+  virtual void TaskInit(){}
+  virtual void TaskEvent(HEventRec &e){}
+  virtual void TaskExit(){}
+
   // Send message to component.  A message is a text string of form
   //            command(arg1,arg2,...)
   // every component supports the following commands
@@ -61,6 +80,10 @@ public:
   // then wait until there is a message
   void ChkMessage(Boolean wait = FALSE);
 
+  // Exec the message which caused a message event, in a thread of
+  // its own then wait for resume if the message suspended it
+  void DoMessage();
+
   // Terminate the component
   void Terminate ();
 
@@ -82,6 +105,8 @@ public:
   HThread thread;            // the task itself
   int prBufLines;            // number of lines in thread printf buffer
 protected:
+  friend class AScheduler;
+  friend class AMonitor;
   // Task control flags
   Boolean terminated;        // set to request a soft kill
   Boolean suspended;         // set to indicate process is suspended
@@ -91,9 +116,16 @@ protected:
   APacket cmd;               // the command packet itself
   int     carg;              // index of next arg in cmd
   ABuffer *mbuf;             // buffer used by SendMessage
+
+  // Scheduling
+  AScheduler *sched;         // scheduler to run on, else NULL
+  ASchedTask *stask;         // task record once started on sched
 };
 
 typedef AComponent * AComponentPtr;
 
+// Thread task of a component which supports stepped execution
+TASKTYPE TASKMOD AComponent_Task(void *p);
+
 #endif
 // ---------------------- End of AComponent.h -----------------------------
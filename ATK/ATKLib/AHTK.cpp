@@ -26,6 +26,8 @@ static const char * ahtk_version="!HVER!AHTK: 1.6.0 [SJY 01/06/07]";
 
 // Modification history:
 //   9/12/02 - added NCInitHTK and ReportErrors
+//  19/10/26 - added AHistogram
+//  19/10/26 - thread priorities configured from HTHREADS
 
 #include "AHTK.h"
 
@@ -47,6 +49,25 @@ extern char * arman_version;
 extern char * asource_version;
 
 
+// Set how thread priorities are applied
+static void ConfigThreads()
+{
+   ConfParam *cParm[MAXGLOBS];
+   int i,numParm;
+   int rtPrio = 0, rr = FALSE, highNice = -10, lowNice = 10;
+   char buf[MAXSTRLEN];
+
+   numParm = GetConfig("HTHREADS", TRUE, cParm, MAXGLOBS);
+   if (numParm>0){
+      if (GetConfInt(cParm,numParm,"RTPRIO",&i)) rtPrio = i;
+      if (GetConfStr(cParm,numParm,"RTPOLICY",buf))
+         rr = (strcmp(UCase(buf,buf),"RR")==0)?TRUE:FALSE;
+      if (GetConfInt(cParm,numParm,"HIGHNICE",&i)) highNice = i;
+      if (GetConfInt(cParm,numParm,"LOWNICE",&i)) lowNice = i;
+   }
+   HSetPriorityMap(rtPrio,rr,highNice,lowNice);
+}
+
 ReturnStatus CommonInit(Boolean noGraphics) {
    InitMem();   InitLabel();
    InitMath();  InitSigP(); InitUtil();
@@ -56,6 +77,7 @@ ReturnStatus CommonInit(Boolean noGraphics) {
    InitDict();  InitNet();   InitLM();
    InitRec();  InitLat();  /*InitAdapt();*/
    EnableBTrees();   /* allows unseen triphones to be synthesised */
+   ConfigThreads();
    Register(abuffer_version);
    Register(acode_version);
    Register(acomponent_version);
@@ -117,3 +139,81 @@ char * UCase(const char *s, char *buf)
    return buf;
 }
 
+// Get a cpu list, a single cpu is read by the config parser as an int
+Boolean GetConfCpus(ConfParam **list, int size, char *name, char *buf)
+{
+   for (int i=0; i<size; i++){
+      if (strcmp(list[i]->name,name)!=0) continue;
+      list[i]->seen = TRUE;
+      if (list[i]->kind == IntCKind){
+         sprintf(buf,"%d",list[i]->val.i); return TRUE;
+      }
+      if (list[i]->kind == StrCKind){
+         strcpy(buf,list[i]->val.s); return TRUE;
+      }
+      HRError(10099,"GetConfCpus: %s is not a cpu list\n",name);
+      throw ATK_Error(10099);
+   }
+   return FALSE;
+}
+
+// --------------------- Histogram -------------------------
+
+AHistogram::AHistogram(float binWidth, int numBins)
+{
+   assert(binWidth>0.0 && numBins>0);
+   width = binWidth;
+   bins.resize(numBins);
+   Reset();
+}
+
+void AHistogram::Reset()
+{
+   for (size_t i=0; i<bins.size(); i++) bins[i] = 0;
+   count = 0; sum = 0.0; maxval = 0.0;
+}
+
+void AHistogram::Add(float x)
+{
+   int i = (x<0.0)?0:int(x/width);
+   if (i >= int(bins.size())) i = bins.size()-1;
+   ++bins[i]; ++count; sum += x;
+   if (count==1 || x>maxval) maxval = x;
+}
+
+float AHistogram::Mean()
+{
+   return (count>0)?float(sum/count):0.0f;
+}
+
+float AHistogram::Percentile(float p)
+{
+   long n = 0, target = long(p*count/100.0 + 0.5);
+   size_t i;
+
+   if (count==0) return 0.0;
+   for (i=0; i<bins.size()-1; i++){
+      n += bins[i];
+      if (n >= target) break;
+   }
+   return (i==bins.size()-1)?maxval:(i+1)*width;
+}
+
+void AHistogram::Print(FILE *f, const string& name)
+{
+   const char *s = name.c_str();
+
+   fprintf(f,"%s.count %ld\n",s,count);
+   fprintf(f,"%s.mean %g\n",s,Mean());
+   fprintf(f,"%s.max %g\n",s,maxval);
+   fprintf(f,"%s.p50 %g\n",s,Percentile(50));
+   fprintf(f,"%s.p90 %g\n",s,Percentile(90));
+   fprintf(f,"%s.p99 %g\n",s,Percentile(99));
+   for (size_t i=0; i<bins.size(); i++){
+      if (bins[i]==0) continue;
+      if (i==bins.size()-1)
+         fprintf(f,"%s.bin[%g+] %ld\n",s,i*width,bins[i]);
+      else
+         fprintf(f,"%s.bin[%g] %ld\n",s,(i+1)*width,bins[i]);
+   }
+}
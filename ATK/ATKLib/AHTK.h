@@ -26,6 +26,20 @@
 // Modification history:
 //   9/12/02 - added NCInitHTK and ReportErrors
 //  29/07/04 - noGraphics switch added for linux version
+//  19/10/26 - AHistogram added for component metrics
+//  19/10/26 - thread priorities configured by InitHTK
+
+// Configuration variables (Defaults as shown)
+// HTHREADS: RTPRIO   = 0     -- real-time priority of HPRIO_HIGH threads, 0 for none
+// HTHREADS: RTPOLICY = FIFO  -- or RR
+// HTHREADS: HIGHNICE = -10   -- nice of HPRIO_HIGH threads if not real-time
+// HTHREADS: LOWNICE  = 10    -- nice of HPRIO_LOW threads
+//
+// Real-time priority and negative nice values need privilege (eg
+// CAP_SYS_NICE or RLIMIT_RTPRIO on Linux) and are dropped with a
+// warning without it.  Each component may also be given the cpus its thread
+// runs on, eg
+// ASOURCE: CPUS = 0          -- see AComponent::Start and ASCHED: CPUS
 
 
 #ifndef _ATK_HTK
@@ -84,4 +98,25 @@ void ReportErrors(char *library, int errnum);
 // Make an upper case copy of s in buf
 char * UCase(const char *s, char *buf);
 
+// Get a cpu list config param, eg CPUS = 1 or CPUS = "0-1,3", into buf
+Boolean GetConfCpus(ConfParam **list, int size, char *name, char *buf);
+
+// Fixed bin width histogram used for latency and load metrics.
+// Samples beyond the last bin are counted in the last bin.
+class AHistogram {
+public:
+  AHistogram(float binWidth=1.0, int numBins=20);
+  void Add(float x);             // record a sample
+  void Reset();                  // forget all samples
+  float Mean();                  // mean of samples so far
+  float Percentile(float p);     // upper edge of bin holding p'th percentile
+  // print as "name.key value" counter lines
+  void Print(FILE *f, const string& name);
+  float width;                   // bin width
+  vector<long> bins;             // sample counts per bin
+  long count;                    // total num samples
+  double sum;                    // sum of samples
+  float maxval;                  // largest sample
+};
+
 #endif  /* _ATK_HTK */
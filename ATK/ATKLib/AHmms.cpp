@@ -23,6 +23,10 @@
 
 char * ahmms_version="!HVER!AHmms: 1.6.0 [SJY 01/06/07]";
 
+// Modification history:
+//  19/10/26 - HMMSet held as reference counted snapshots, Reload added
+//  19/10/26 - snapshots acquired without locking
+
 #include "AHmms.h"
 
 #define T_LOAD 001     /* HMM Set Loading */
@@ -34,13 +38,10 @@ AHmms::AHmms(const string& name):AResource(name)
    ConfParam *cParm[MAXGLOBS];       /* config parameters */
    int numParm;
    int i;
-   Boolean hasMMF = FALSE;
-   XFormAdded = FALSE;
    char buf[100],buf1[100],buf2[256];
-   string xformfn;
 
    hmmList="hmmlist"; hmmExt=hmmDir="";
-   trace = 0;
+   trace = 0; XFormAdded = FALSE; readers = 0;
 
    // Read configuration file
    strcpy(buf,name.c_str());
@@ -59,48 +60,11 @@ AHmms::AHmms(const string& name):AResource(name)
                HRError(10500,"AHmms:  mmf0, mmf1, .... must be used sequentially");
                throw ATK_Error(10500);
             }
-            mmfn[i]= buf2; hasMMF = TRUE;
+            mmfn[i]= buf2;
          }
       }
    }
-
-   // Create Empty HMM Set
-   hset = new HMMSet;
-   CreateHeap(&hmem, buf,  MSTAK, 1, 0.0, 100000, 800000 );
-   CreateHMMSet(hset,&hmem,TRUE);
-
-   // Add any mmf files
-   if (hasMMF){
-      for (i=0; i<10; i++) {
-         if (mmfn[i]=="") break;
-         strcpy(buf,mmfn[i].c_str());
-         if (trace&T_LOAD)
-            printf("AHmms: adding mmf%d=%s\n",i,buf);
-         AddMMF(hset,buf);
-      }
-   }
-
-   // Load the model data
-   if (trace&T_LOAD)
-      printf("Loading models ...."); fflush(stdout);
-   strcpy(buf,hmmList.c_str());
-   if(MakeHMMSet(hset,buf)<SUCCESS) {
-      HRError(10500,"AHmms: MakeHMMSet failed [hmmlist=%s]",buf);
-      throw HTK_Error(10500);
-   }
-   strcpy(buf1,hmmDir.c_str()); strcpy(buf2,hmmExt.c_str());
-   if(LoadHMMSet(hset,buf1,buf2)<SUCCESS) {
-      HRError(9999,"AHmms: LoadHMMSet failed [Dir=%s, Ext=%s",buf1,buf2);
-      throw HTK_Error(10500);
-   }
-   ConvDiagC(hset,TRUE);
-
-   InitAdapt(&xfinfo);
-   if (xformfn!="" && !XFormAdded)
-     AddXForm((char *)xformfn.c_str());
-
-   if (trace&T_LOAD)  printf("done\n");
-   if (trace&T_INFO) PrintHSetProfile(stdout,hset);
+   cur = Load();
 }
 
 AHmms::AHmms(const string& name, const string& hmmlist, const string& mmf0,
@@ -111,83 +75,165 @@ AHmms::AHmms(const string& name, const string& hmmlist, const string& mmf0,
    int i;
    char buf[100];
 
-   trace=0;
+   this->trace = trace; XFormAdded = FALSE; readers = 0;
 
    // Read configuration file
    strcpy(buf,name.c_str());
    for (i=0; i<int(strlen(buf)); i++) buf[i] = toupper(buf[i]);
    numParm = GetConfig(buf, TRUE, cParm, MAXGLOBS);
    if (numParm>0){
-      if (GetConfInt(cParm,numParm,"TRACE",&i)) trace = i;
+      if (GetConfInt(cParm,numParm,"TRACE",&i)) this->trace = i;
    }
+   hmmList = hmmlist; hmmExt=hmmDir="";
+   mmfn[0] = mmf0;    // main MMF (mandatory)
+   mmfn[1] = mmf1;    // aux MMF (optional)
+   cur = Load();
+}
+
+// Load: load the model files into a new snapshot
+HMMSnap *AHmms::Load()
+{
+   HMMSnap *s = new HMMSnap;
+   int i;
+   char buf[256],buf1[256],buf2[256];
 
    // Create Empty HMM Set
-   hset = new HMMSet;
-   CreateHeap(&hmem, buf,  MSTAK, 1, 0.0, 100000, 800000 );
-   CreateHMMSet(hset,&hmem,TRUE);
-
-   // Add mmf file
-   strcpy(buf,mmf0.c_str());   // load main MMF (mandatory)
-   AddMMF(hset,buf);
-   strcpy(buf,mmf1.c_str());   // load aux MMF (optional)
-   if (strlen(buf)>0) AddMMF(hset,buf);
-
-   // Load the model data
-   if (trace&T_LOAD)
-      printf("Loading models ...."); fflush(stdout);
-   hmmList = hmmlist;
-   strcpy(buf,hmmList.c_str());
-   if(MakeHMMSet(hset,buf)<SUCCESS) {
-      HRError(10500,"AHmms: MakeHMMSet failed [hmmlist=%s]",buf);
-      throw HTK_Error(10500);
+   strcpy(buf,rname.c_str());
+   for (i=0; i<int(strlen(buf)); i++) buf[i] = toupper(buf[i]);
+   s->hset = new HMMSet;
+   CreateHeap(&s->hmem, buf,  MSTAK, 1, 0.0, 100000, 800000 );
+   CreateHMMSet(s->hset,&s->hmem,TRUE);
+   s->refs = 1; s->version = version;
+   try {
+      // Add any mmf files
+      for (i=0; i<10; i++) {
+         if (mmfn[i]=="") break;
+         strcpy(buf,mmfn[i].c_str());
+         if (trace&T_LOAD)
+            printf("AHmms: adding mmf%d=%s\n",i,buf);
+         AddMMF(s->hset,buf);
+      }
+
+      // Load the model data
+      if (trace&T_LOAD)
+         printf("Loading models ...."); fflush(stdout);
+      strcpy(buf,hmmList.c_str());
+      if(MakeHMMSet(s->hset,buf)<SUCCESS) {
+         HRError(10500,"AHmms: MakeHMMSet failed [hmmlist=%s]",buf);
+         throw HTK_Error(10500);
+      }
+      strcpy(buf1,hmmDir.c_str()); strcpy(buf2,hmmExt.c_str());
+      if(LoadHMMSet(s->hset,buf1,buf2)<SUCCESS) {
+         HRError(9999,"AHmms: LoadHMMSet failed [Dir=%s, Ext=%s",buf1,buf2);
+         throw HTK_Error(10500);
+      }
    }
-   if(LoadHMMSet(hset,"","")<SUCCESS) {
-      HRError(9999,"AHmms: LoadHMMSet failed");
-      throw HTK_Error(10500);
+   catch (...) {
+      DeleteHeap(&s->hmem); delete s->hset; delete s;
+      throw;
    }
-   ConvDiagC(hset,TRUE);
-   InitAdapt(&xfinfo);
+   ConvDiagC(s->hset,TRUE);
+
+   InitAdapt(&s->xfinfo);
+   if (xformfn!=""){
+      s->xfinfo.useInXForm = TRUE;
+      s->xfinfo.inXFormFN = (char *)xformfn.c_str();
+      XFormAdded = ALoadXForm(s->hset, &s->xfinfo);
+   }
+
    if (trace&T_LOAD)  printf("done\n");
-   if (trace&T_INFO) PrintHSetProfile(stdout,hset);
+   if (trace&T_INFO) PrintHSetProfile(stdout,s->hset);
+   return s;
 }
 
-
 AHmms::~AHmms()
 {
-   DeleteHeap(&hmem);
-   delete hset;
+   Release(cur);
 }
 
-// Get properties
-ParmKind AHmms::GetParmKind() { return hset->pkind; }
-HSetKind AHmms::GetKind(){ return hset->hsKind; }
-HMMSet *AHmms::GetHMMSet(){ return hset; }
-int AHmms::GetNumLogHMM(){ return hset->numLogHMM; }
-int AHmms::GetNumPhyHMM(){ return hset->numPhyHMM; }
-int AHmms::GetNumStates(){ return hset->numStates; }
-int AHmms::GetNumSharedStates(){ return hset->numSharedStates; }
-int AHmms::GetNumMix(){  return hset->numMix; }
-int AHmms::GetNumSharedMix(){ return hset->numSharedMix; }
-int AHmms::GetNumTransP(){ return hset->numTransP; }
+// Get properties of the current set
+ParmKind AHmms::GetParmKind() { return cur->hset->pkind; }
+HSetKind AHmms::GetKind(){ return cur->hset->hsKind; }
+HMMSet *AHmms::GetHMMSet(){ return cur->hset; }
+int AHmms::GetNumLogHMM(){ return cur->hset->numLogHMM; }
+int AHmms::GetNumPhyHMM(){ return cur->hset->numPhyHMM; }
+int AHmms::GetNumStates(){ return cur->hset->numStates; }
+int AHmms::GetNumSharedStates(){ return cur->hset->numSharedStates; }
+int AHmms::GetNumMix(){  return cur->hset->numMix; }
+int AHmms::GetNumSharedMix(){ return cur->hset->numSharedMix; }
+int AHmms::GetNumTransP(){ return cur->hset->numTransP; }
 
 // Check compatibility with given coder
 Boolean AHmms::CheckCompatible(Observation *o)
 {
-  if (o->pk != hset->pkind) return FALSE;
+   HMMSet *hset = cur->hset;
+
+   if (o->pk != hset->pkind) return FALSE;
    if (o->swidth[0] != hset->swidth[0]) return FALSE;
    for (int i = 1; i<=hset->swidth[0]; i++)
       if (o->swidth[i] != hset->swidth[i]) return FALSE;
-      return TRUE;
+   return TRUE;
 }
 
-
+// Load a model transform into the current set, it is also loaded
+// into sets made by Reload
 Boolean AHmms::AddXForm(char *name)
 {
-  xfinfo.useInXForm = TRUE;
-  xfinfo.inXFormFN = name;
-  XFormAdded = ALoadXForm(hset, &xfinfo);
+  xformfn = name;
+  cur->xfinfo.useInXForm = TRUE;
+  cur->xfinfo.inXFormFN = (char *)xformfn.c_str();
+  XFormAdded = ALoadXForm(cur->hset, &cur->xfinfo);
   return XFormAdded;
 }
+
+// Acquire: return the current snapshot with a reference added.  No
+// lock is taken, readers is raised while cur is read and referenced
+// so that Reload can tell when no reader can still see the old one.
+HMMSnap *AHmms::Acquire()
+{
+   HMMSnap *s;
+
+   HAtomicAdd(&readers,1);
+   s = cur; HAtomicAdd(&s->refs,1);
+   HAtomicAdd(&readers,-1);
+   return s;
+}
+
+// Retain: add a reference to a snapshot already held
+void AHmms::Retain(HMMSnap *s)
+{
+   HAtomicAdd(&s->refs,1);
+}
+
+// Release: drop a reference to s, deleting it if it was the last
+void AHmms::Release(HMMSnap *s)
+{
+   if (HAtomicAdd(&s->refs,-1) == 0){
+      DeleteHeap(&s->hmem);
+      delete s->hset;
+      delete s;
+   }
+}
+
+// Reload: load the model files into a new snapshot and publish it.
+// Loading is done without the lock so users of the old snapshot are
+// not held up, and groups see the new version number and rebuild
+// their networks with it.  The old snapshot is only released once
+// every Acquire which might have read it has taken its reference.
+void AHmms::Reload()
+{
+   HMMSnap *s,*old;
+
+   s = Load();
+   HEnterSection(lock);
+   s->version = version+1;
+   old = (HMMSnap *)HAtomicSwap((void * volatile *)&cur,s);
+   version = s->version;
+   HLeaveSection(lock);
+   while (readers > 0) HDeschedule();
+   if (trace&T_LOAD) printf("AHmms: %s reloaded as version %d\n",rname.c_str(),s->version);
+   Release(old);
+}
 // ------------------------ End AHmms.cpp ---------------------
 
 
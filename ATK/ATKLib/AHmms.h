@@ -29,6 +29,13 @@
 // AHMMS: MMF[0-9]   = specify upto 10 MMF files to load
 // AHMMS: XFORMNAME  = name of the model transform
 
+// The HMMSet is held as a snapshot.  Reload loads the model files
+// again into a new snapshot and makes it current, so that updated
+// models can be deployed without stopping the recognisers using the
+// old ones.  Each user of a snapshot holds a reference (see Acquire
+// and Release) and the snapshot is deleted when the last is dropped.
+// Acquire and Release take no lock.
+
 #include <stdio.h>
 #ifndef _ATK_AHmms
 #define _ATK_AHmms
@@ -36,6 +43,15 @@
 #include "AHTK.h"
 #include "AResource.h"
 
+// One loaded version of an HMMSet
+struct HMMSnap {
+  HMMSet *hset;          // the HTK data structure
+  MemHeap hmem;          // heap for use by HTK
+  XFInfo xfinfo;         // model transform
+  int version;           // AHmms version when it was current
+  volatile int refs;     // references, including AHmms while current
+};
+
 class AHmms : public AResource {
 public:
   // Construct HMMSet from name:info in config file
@@ -43,7 +59,8 @@ public:
   // Construct HMMSet from explicitly supplied hmmlist and MMF (only one MMF)
   AHmms(const string& name, const string& hmmlist, const string& mmf0,
 	     const string& mmf1, int trace=0);
-  // Destroy HMMSet including disposal of MemHeap
+  // Destroy HMMSet including disposal of MemHeap, snapshots still
+  // referenced are deleted when released
   ~AHmms();
   // Get Properties of HMMSet
   HSetKind GetKind();
@@ -55,22 +72,33 @@ public:
   int GetNumMix();
   int GetNumSharedMix();
   int GetNumTransP();
-  HMMSet *GetHMMSet();
+  HMMSet *GetHMMSet();   // current HMMSet, valid only while it is current
   // Check for compatibility with given observation
   Boolean CheckCompatible(Observation *o);
   // Load XForms
   Boolean XFormAdded;
   Boolean AddXForm(char *name);
+  // Get a reference to the current snapshot
+  HMMSnap *Acquire();
+  // Add a reference to a snapshot which is already held
+  static void Retain(HMMSnap *s);
+  // Drop a reference, deleting the snapshot if it was the last.  This
+  // may be called after the AHmms itself has been deleted.
+  static void Release(HMMSnap *s);
+  // Load the model files again and make the new set current.  If
+  // the load fails the current set is kept and an error thrown.
+  void Reload();
   friend class ResourceGroup;
 private:
+  HMMSnap *Load();       // load a new snapshot from the model files
   int trace;             // trace flags
-  HMMSet *hset;          // the HTK data structure
-  XFInfo xfinfo;         // model transform
-  MemHeap hmem;          // heap for use by HTK
+  HMMSnap * volatile cur;  // current snapshot
+  volatile int readers;  // Acquires in progress
   string hmmList;        // name of list file
   string hmmDir;         // name of hmm dir
   string hmmExt;         // name of hmm ext
   string mmfn[10];       // mmf file names mmf0, mmf1, mmf2, ... , mmf9
+  string xformfn;        // model transform, if any
 };
 
 #endif
@@ -23,6 +23,13 @@
 
 char * AIO_version="!HVER!AIO: 1.6.0 [SJY 01/06/07]";
 
+// Modification history:
+//  19/10/26 - task split into TaskInit/Event/Exit for AScheduler
+//  19/10/26 - timeouts run by a shared ATimerWheel, no timer thread
+//  19/10/26 - no display when headless, so AIO can be scheduled
+//  19/10/26 - last AIO to exit stops the shared synthesiser pool
+//  19/10/26 - and the shared timer wheel
+
 #include "AIO.h"
 
 #define TIMEOUTPERIOD 3000
@@ -39,16 +46,66 @@ char * AIO_version="!HVER!AIO: 1.6.0 [SJY 01/06/07]";
 #define T_HAN 0040    // trace unhandled cmds/events
 
 // predeclare the internal threads
-TASKTYPE TASKMOD TimerTask(void *p);
 TASKTYPE TASKMOD DisplayTask(void *p);
 
+// The synthesiser pool is created by the first AIO configured to
+// use one and then shared by every AIO in the process.  AIOs are
+// constructed by the application's main thread so no lock is needed
+// there, but they exit on their own threads.
+static ASynPool *sharedSynPool = NULL;
+static volatile int synPoolUsers = 0;   // AIOs using sharedSynPool
+
+// GetSynPool: return the shared pool, creating it with n workers
+static ASynPool *GetSynPool(int n)
+{
+   if (sharedSynPool == NULL){
+      vector<ASynthesiser *> syns;
+      for (int i=0; i<n; i++) syns.push_back(new FSynthesiser());
+      sharedSynPool = new ASynPool("asynpool",syns);
+   }
+   HAtomicAdd(&synPoolUsers,1);
+   return sharedSynPool;
+}
+
+// ReleaseSynPool: the last AIO using pool to exit stops its workers.
+// The pool is not deleted since ASyn components may still refer to it.
+static void ReleaseSynPool(ASynPool *pool)
+{
+   if (HAtomicAdd(&synPoolUsers,-1) == 0){
+      if (sharedSynPool == pool) sharedSynPool = NULL;
+      pool->Terminate();
+   }
+}
+
+// The timer wheel is likewise created by the first AIO and shared
+static ATimerWheel *sharedTimers = NULL;
+static volatile int timerUsers = 0;     // AIOs using sharedTimers
+
+// GetTimers: return the shared timer wheel, creating it if need be
+static ATimerWheel *GetTimers()
+{
+   if (sharedTimers == NULL) sharedTimers = new ATimerWheel("ATIMER");
+   HAtomicAdd(&timerUsers,1);
+   return sharedTimers;
+}
+
+// ReleaseTimers: the last AIO using timers to exit stops its thread.
+// The wheel is not deleted since the AIOs still refer to it.
+static void ReleaseTimers(ATimerWheel *timers)
+{
+   if (HAtomicAdd(&timerUsers,-1) == 0){
+      if (sharedTimers == timers) sharedTimers = NULL;
+      timers->Terminate();
+   }
+}
+
 // Constructor
 AIO::AIO(const string & name, ABuffer *outChannel, ARMan *appRman, Boolean useLogging)
 : AComponent(name,(HasRealConsole()?2:AIOPRBUFSIZE))
 {
    outChan = outChannel;
    ConfParam *cParm[MAXGLOBS];       /* config parameters */
-   int numParm,i;
+   int numParm,i,synWorkers = 0;
    Boolean b;
    char ngramFN[100],buf[100];
    ngramFN[0] = '\0';
@@ -63,7 +120,7 @@ AIO::AIO(const string & name, ABuffer *outChannel, ARMan *appRman, Boolean useLo
    numParm = GetConfig(buf, TRUE, cParm, MAXGLOBS);
    timeOutPeriod = TIMEOUTPERIOD;  // set default timeout
    width = 400; height=220; showDisp = FALSE;
-   toutFlag = FALSE;   timeOut = 0; timing = FALSE; logData=useLogging;
+   toutFlag = FALSE;   timerId = timeLeft = 0; timing = FALSE; logData=useLogging;
    dx0 = 420;   dy0 = 80; trace = 0; xstep = 5;disableBargeIn=FALSE;
    if (numParm>0){
       if (GetConfBool(cParm,numParm,"DISPSHOW",&b)) showDisp = b;
@@ -76,7 +133,9 @@ AIO::AIO(const string & name, ABuffer *outChannel, ARMan *appRman, Boolean useLo
       if (GetConfInt(cParm,numParm,"DISPSTEP",&i)) xstep = i;
       if (GetConfInt(cParm,numParm,"TIMEOUTPERIOD",&i))timeOutPeriod = i;
       if (GetConfInt(cParm,numParm,"TRACE",&i)) trace = i;
+      if (GetConfInt(cParm,numParm,"SYNWORKERS",&i)) synWorkers = i;
    }
+   if (!HGrafActive()) showDisp = FALSE;
 
    // Create the buffers
    waveOut = new ABuffer("waveOut");  // syn -> aud for synth playing
@@ -115,9 +174,15 @@ AIO::AIO(const string & name, ABuffer *outChannel, ARMan *appRman, Boolean useLo
       code= new ACode("code",waveIn,featIn);                // coder
    }
    aud = new ASource("aud",waveIn);                      // audio
-   synDevice = new FSynthesiser();
-   syn = new ASyn("syn", synRep, waveOut, synAck, aud, synDevice);  // tts
+   if (synWorkers>0){
+      synDevice = NULL; synPool = GetSynPool(synWorkers);
+      syn = new ASyn("syn", synRep, waveOut, synAck, aud, synPool);
+   } else {
+      synPool = NULL; synDevice = new FSynthesiser();
+      syn = new ASyn("syn", synRep, waveOut, synAck, aud, synDevice);  // tts
+   }
    rec = new ARec("rec",featIn,asrIn,rman);         // recogniser
+   timers = GetTimers();
    // Initialise the state machines
    astate = asr_idle; sstate = syn_idle; smode=syn_telling;
 
@@ -335,19 +400,34 @@ Boolean AIO::IsFiller(const string& word)
 }
 
 
+// SetScheduler: run the subsidiary components on s as well
+void AIO::SetScheduler(AScheduler *s)
+{
+   AComponent::SetScheduler(s);
+   aud->SetScheduler(s);
+   code->SetScheduler(s);
+   syn->SetScheduler(s);
+   rec->SetScheduler(s);
+   if(logData) {
+      log->SetScheduler(s);
+      tee->SetScheduler(s);
+   }
+}
+
 // Start:  start subsidiary threads, then aio thread
-TASKTYPE TASKMOD AIO_Task(void *p);
 void AIO::Start(HPriority priority)
 {
+   timers->Start(priority);
    aud->Start(priority);
    code->Start(priority);
+   if (synPool != NULL) synPool->Start(priority);
    syn->Start(priority);
    rec->Start(priority);
    if(logData) {
       log->Start(priority);
       tee->Start(priority);
    }
-   AComponent::Start(priority,AIO_Task);
+   AComponent::Start(priority,AComponent_Task);
 }
 
 // UnhandledCmds
@@ -465,6 +545,10 @@ ASREvent AIO::MapAsrEvent(APacket p)
             HRError(13003,"MapAsrEvent: %s cmd unexpected",cmd.c_str());
             throw ATK_Error(13003);
          }
+         // ignore a timer which expired as it was cleared
+         if (!timing || cd->GetInt(0) != timerId) return AsrOtherEv;
+         if (trace&T_TIM) printf(">>> TimeOut!!!\n");
+         toutFlag = TRUE; timing = FALSE; timerId = 0;
          return AsrTimerEv;
          break;
       case PhrasePacket:
@@ -486,8 +570,8 @@ ASREvent AIO::MapAsrEvent(APacket p)
 		 cmd=ad->GetSource();
 		 if(cmd=="aud"){
 			 cmd=ad->GetMarker();
-			 if(cmd=="PAUSE") PauseTimeOut=TRUE;
-			 if(cmd=="START" && PauseTimeOut) PauseTimeOut=FALSE;
+			 if(cmd=="PAUSE" && !PauseTimeOut) PauseTimer();
+			 if(cmd=="START" && PauseTimeOut) ResumeTimer();
 		 }
          return AsrMarkerEv;
          break;
@@ -615,55 +699,42 @@ void AIO::StepAsrState(APacket p)
    }
 }
 
-// ----------------------------- Timer Thread -----------------------
+// ----------------------------- Timer -----------------------------
 
+// SetTimer: start the response timeout, it only runs when not paused
 void AIO::SetTimer()
 {
-   HEnterSection(tlock);
-   timeOut = timeOutPeriod; timing = TRUE;
-   HLeaveSection(tlock);
-   HSendSignal(tsig);
+   if (timerId>0) timers->ClearTimer(timerId);
+   timerId = 0; timing = TRUE; timeLeft = timeOutPeriod;
+   if (!PauseTimeOut)
+      timerId = timers->SetTimer(timeOutPeriod,asrIn,"timeout");
+   if (trace&T_TIM) printf(">>> Timer Primed\n");
 }
 
+// ClearTimer: cancel the response timeout
 void AIO::ClearTimer()
 {
-   HEnterSection(tlock);
-   timeOut = 0; timing = FALSE;
-   HLeaveSection(tlock);
+   if (timerId>0) timers->ClearTimer(timerId);
+   timerId = 0; timing = FALSE;
 }
 
-// TimerTask:  timer thread
-TASKTYPE TASKMOD TimerTask(void *p)
+// PauseTimer: stop the timeout counting down while audio is paused
+void AIO::PauseTimer()
 {
-   AIO *aio = (AIO *)p;
-   int t;
-
-   while (!aio->IsTerminated()){
-      // idle until timeout set by signalling tsig
-      if (aio->trace&T_TIM) printf(">>> Timer Primed\n");
-
-      HEnterSection(aio->tlock);
-      while (!aio->timing) HWaitSignal(aio->tsig,aio->tlock);
-      HLeaveSection(aio->tlock);
-
-      while (aio->timing) {
-         HPauseThread(10);
-
-         HEnterSection(aio->tlock);
-		 aio->timeOut -= 10*(!aio->PauseTimeOut);
-         if (aio->timeOut<=0) {
-            aio->timeOut = 0;
-            if (aio->timing) { // check cos it might have been cancelled
-               if (aio->trace&T_TIM) printf(">>> TimeOut!!!\n");
-               aio->SendCommand("timeout",aio->asrIn,FALSE);
-               aio->toutFlag = TRUE;  aio->timing = FALSE;
-            }
-         }
-         HLeaveSection(aio->tlock);
-      }
+   PauseTimeOut = TRUE;
+   if (timing && timerId>0){
+      timeLeft = timers->TimeLeft(timerId);
+      // if it has just expired its timeout is already in asrIn
+      if (timeLeft>=0 && timers->ClearTimer(timerId)) timerId = 0;
    }
-   HExitThread(0);
-   return 0;
+}
+
+// ResumeTimer: restart the timeout with the time it had left
+void AIO::ResumeTimer()
+{
+   PauseTimeOut = FALSE;
+   if (timing && timerId==0)
+      timerId = timers->SetTimer(timeLeft,asrIn,"timeout");
 }
 
 // ----------------------- Main AIO Thread ------------------------------
@@ -678,78 +749,78 @@ static char *smodes[] = {
   "syn_telling","syn_asking", "syn_yelling", "syn_self"
 };
 
-// AIO_Task:  the main interface control thread
-TASKTYPE TASKMOD AIO_Task(void *p)
+// AIO task: create the display, request events and start
+// the recogniser and audio input
+void AIO::TaskInit()
+{
+   char cname[100];
+
+   if (showDisp){
+      strcpy(cname,this->cname.c_str());
+      win = MakeHWin(cname,dx0,dy0,width,height,1);
+      HSetGrey(win,50);
+      HFillRectangle(win,0,0,width,height);
+      // Create the display thread
+      display = HCreateThread("display",1,HPRIO_NORM,DisplayTask,this);
+      ticker = 0;
+   }
+   synRep->RequestBufferEvents(synRepID);
+   asrIn->RequestBufferEvents(asrInID);
+   RequestMessageEvents();
+   rec->SendMessage("usegrp(main)");
+   rec->SendMessage("start()");
+   aud->SendMessage("start()");
+   if(disableBargeIn)
+     aud->SendMessage("stop()");
+}
+
+// AIO task: the main interface control, handle an event
+void AIO::TaskEvent(HEventRec &e)
 {
-   HEventRec e;
-   char buf[100],cname[100];
+   char buf[100];
    ASRState as;   // only used for tracing
    SYNState ss;   //
    SYNMode  sm;   //
 
-   AIO *aio = (AIO *)p;
-   try{
-   // Create the Timer
-   aio->tsig = HCreateSignal("tsig");
-   aio->tlock = HCreateLock("tlock");
-   aio->timer = HCreateThread("timer",1,HPRIO_NORM,TimerTask,p);
-   if (aio->showDisp){
-      strcpy(cname,aio->cname.c_str());
-      aio->win = MakeHWin(cname,aio->dx0,aio->dy0,aio->width,aio->height,1);
-      HSetGrey(aio->win,50);
-      HFillRectangle(aio->win,0,0,aio->width,aio->height);
-      // Create the display thread
-      aio->display = HCreateThread("display",1,HPRIO_NORM,DisplayTask,p);
-      aio->ticker = 0;
-   }
-   aio->synRep->RequestBufferEvents(synRepID);
-   aio->asrIn->RequestBufferEvents(asrInID);
-   aio->RequestMessageEvents();
-   aio->rec->SendMessage("usegrp(main)");
-   aio->rec->SendMessage("start()");
-   aio->aud->SendMessage("start()");
-   if(aio->disableBargeIn)
-     aio->aud->SendMessage("stop()");
-   while (!aio->IsTerminated()) {
-      e = HGetEvent(0,0);
-      if (e.event == HTBUFFER) {
-         if (aio->trace&T_STC){
-            as = aio->astate; ss = aio->sstate; sm = aio->smode;
-         }
-         switch(e.c){
-            case synRepID:
-               if (!aio->synRep->IsEmpty()){
-                  aio->StepSynState(aio->synRep->GetPacket());
-               }
-               break;
-            case asrInID:
-               if (!aio->asrIn->IsEmpty()){
-                  aio->StepAsrState(aio->asrIn->GetPacket());
-               }
-               break;
-            case MSGEVENTID:
-               aio->ChkMessage();
-               while (aio->IsSuspended()) aio->ChkMessage(TRUE);
-               break;
-         }
-         if ( aio->trace&T_STC &&
-              (as!=aio->astate || ss!=aio->sstate || sm!=aio->smode)){
-            printf(" aio_state: %s : %s[%s]\n",
-               astates[aio->astate], sstates[aio->sstate], smodes[aio->smode]);
-         }
-      }else if (e.event == HWINCLOSE){
-         sprintf(buf, "terminating");
-         HPostMessage(HThreadSelf(),buf);
-         aio->terminated = TRUE;
+   if (e.event == HTBUFFER) {
+      if (trace&T_STC){
+         as = astate; ss = sstate; sm = smode;
       }
+      switch(e.c){
+         case synRepID:
+            if (!synRep->IsEmpty()){
+               StepSynState(synRep->GetPacket());
+            }
+            break;
+         case asrInID:
+            if (!asrIn->IsEmpty()){
+               StepAsrState(asrIn->GetPacket());
+            }
+            break;
+         case MSGEVENTID:
+            DoMessage();
+            break;
+      }
+      if ( trace&T_STC &&
+           (as!=astate || ss!=sstate || sm!=smode)){
+         printf(" aio_state: %s : %s[%s]\n",
+            astates[astate], sstates[sstate], smodes[smode]);
+      }
+   }else if (e.event == HWINCLOSE){
+      sprintf(buf, "terminating");
+      HPostMessage(HThreadSelf(),buf);
+      terminated = TRUE;
    }
-   if (aio->trace&T_TOP) printf("AIO main task exiting\n");
-   aio->SendCommand("terminated",aio->outChan,FALSE);
-   HExitThread(0);
-   return 0;
-   }
-   catch (ATK_Error e){ ReportErrors("ATK",e.i); return 0;}
-   catch (HTK_Error e){ ReportErrors("HTK",e.i); return 0;}
+}
+
+// AIO task: tell the host
+void AIO::TaskExit()
+{
+   if (trace&T_TOP) printf("AIO main task exiting\n");
+   if (synPool != NULL) ReleaseSynPool(synPool);
+   if (timerId>0) timers->ClearTimer(timerId);
+   ReleaseTimers(timers);
+   SendCommand("terminated",outChan,FALSE);
 }
 
 // ------------------------ End AIO.cpp ---------------------
@@ -25,7 +25,8 @@
 
 // Configuration variables (Defaults as shown)
 //
-// AIO:
+// AIO: SYNWORKERS = 0   -- size of synthesiser pool shared by all AIOs
+//                          (0 = each AIO synthesises in its own ASyn)
 
 #ifndef _ATK_AIO
 #define _ATK_AIO
@@ -38,6 +39,7 @@
 #include "AMonitor.h"
 #include "ATee.h"
 #include "ALog.h"
+#include "ATimer.h"
 #include "FliteSynthesiser.h"
 
 // This componenet provides a high level interface to the main ATK
@@ -108,7 +110,8 @@ public:
    // Create an IO subsystem using the resource manager appRman
    // if supplied, else using an internally created default.
    // AIO will invoke the following subsidiary threads:
-   //   aud, code, rec, syn plus a local timer thread.
+   //   aud, code, rec, syn.  Response timeouts are run by a timer
+   //   wheel shared by all AIOs.
    AIO(const string & name, ABuffer *outChannel, ARMan *appRman=NULL, Boolean useLogging=FALSE);
    // Attach a monitor if required.  This methods simply calls
    // AddComponent for each of the components embedded in AIO.
@@ -116,11 +119,16 @@ public:
    // Define a filler word, call once for each filler
    void DefineFiller(const string& word);
    // Start the interface thread ( this will also start all of the
-   // subcomponents: aud, code, syn, rec, timer )
+   // subcomponents: aud, code, syn, rec, and the shared timers )
    void Start(HPriority priority=HPRIO_NORM);
+   // Run AIO and those of its subcomponents which can be on s
+   void SetScheduler(AScheduler *s);
+   // stepped execution, not possible with a display
+   Boolean CanSchedule(){return showDisp?FALSE:TRUE;}
+   void TaskInit();
+   void TaskEvent(HEventRec &e);
+   void TaskExit();
 private:
-   friend TASKTYPE TASKMOD AIO_Task(void *p);
-   friend TASKTYPE TASKMOD TimerTask(void *p);
    friend TASKTYPE TASKMOD DisplayTask(void *p);
    void ExecCommand(const string & cmdname);
    void SendString(const string& s, ABuffer *b);
@@ -131,13 +139,16 @@ private:
    void StepAsrState(APacket p);
    void SetTimer();
    void ClearTimer();
+   void PauseTimer();
+   void ResumeTimer();
    void UnhandledSynCmd(string cmd);
    void UnhandledAsrCmd(ASREvent e);
    ASREvent MapAsrEvent(APacket p);
    Boolean IsFiller(const string& word);
    void CheckTQ();
    ASource *aud;      // audio input/output
-   FSynthesiser *synDevice; // use Flite Synthesiser
+   FSynthesiser *synDevice; // use Flite Synthesiser (NULL if pool)
+   ASynPool *synPool; // shared Flite synthesiser pool (NULL if none)
    ASyn    *syn;      // tts
    ACode   *code;     // front-end feature encoder
    ARec    *rec;      // recogniser
@@ -150,11 +161,10 @@ private:
    ABuffer *synRep;   // syn -> aio for synthesiser replies
    ABuffer *asrIn;    // asr -> aio for recognition results
    ABuffer *outChan;  // aio -> application
-   HThread timer;     // Timer for asr timeouts
+   ATimerWheel *timers; // shared timers for asr timeouts
+   int timerId;       // current timer, 0 if none or paused
    int timeOutPeriod; // Allowed time before user response
-   int timeOut;       // current timeout in msecs
-   HSignal tsig;
-   HLock   tlock;
+   int timeLeft;      // msecs left when the timer was paused
    Boolean timing;    // current status of timer
    Boolean toutFlag;  // set after timeout for display use
    ARMan   *rman;     // Resource manager
@@ -23,6 +23,10 @@
 
 char * alog_version="!HVER!ALog: 1.6.0 [SJY 01/06/07]";
 
+// Modification history:
+//  19/10/26 - task split into TaskInit/Event for AScheduler
+//  19/10/26 - not scheduled since WriteWav blocks
+
 #include "ALog.h"
 
 #ifdef WIN32
@@ -112,10 +116,9 @@ void ALog::SetWavFileName()
    wavFileName = logDirName+"/"+sessionDirName+"/"+fname;
 }
 
-TASKTYPE TASKMOD ALog_Task(void * p);
 void ALog::Start(HPriority priority)
 {
-   AComponent::Start(priority,ALog_Task);
+   AComponent::Start(priority,AComponent_Task);
 }
 
 void ALog::CheckWrite(void *data, int size, int n, FILE *fp)
@@ -283,38 +286,23 @@ void ALog::ExecCommand(const string & cmdname)
    }
 }
 
-TASKTYPE TASKMOD ALog_Task(void * p)
+// ALog task: request input and message events
+void ALog::TaskInit()
 {
-   ALog *alog = (ALog *)p;
-   char buf[100];
-   HEventRec e;
-   PacketKind inpk;
-   APacket pkt;
-   AWaveData *w;
-   HTime pst;
-   AStringData *sd;
-
-   try{
-      alog->in->RequestBufferEvents(INBUFID);
-      alog->RequestMessageEvents();
+   in->RequestBufferEvents(INBUFID);
+   RequestMessageEvents();
+}
 
-      while (!alog->IsTerminated()){
-         e = HGetEvent(0,0);
-         if (e.event==HTBUFFER){
-            switch(e.c) {
-              case MSGEVENTID:
-                   alog->ChkMessage();
-                   while (alog->IsSuspended()) alog->ChkMessage(TRUE);
-                   break;
-              case INBUFID:
-                   break;
-            }
-         }
+// ALog task: handle an event
+void ALog::TaskEvent(HEventRec &e)
+{
+   if (e.event==HTBUFFER){
+      switch(e.c) {
+        case MSGEVENTID:
+             DoMessage();
+             break;
+        case INBUFID:
+             break;
       }
-
-      HExitThread(0);
-      return 0;
    }
-   catch (ATK_Error e){ ReportErrors("ATK",e.i); return 0;}
-   catch (HTK_Error e){ ReportErrors("HTK",e.i); return 0;}
 }
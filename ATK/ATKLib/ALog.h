@@ -35,9 +35,13 @@ class ALog: public AComponent {
   ALog(const string &name, ABuffer *inb, const string & logDirInit,
        const string &userIdInit, const string &hostIdInit );
   void Start(HPriority priority=HPRIO_NORM);
+  // stepped execution, but WriteWav waits on the input buffer for the
+  // end of the utterance so ALog always runs on its own thread
+  Boolean CanSchedule(){return FALSE;}
+  void TaskInit();
+  void TaskEvent(HEventRec &e);
 
  private:
-  friend TASKTYPE TASKMOD ALog_Task(void *p);
   void ExecCommand(const string &cmdname);
   void MakeSessionDirectory();
   void SetSessionDirName();
@@ -29,8 +29,16 @@ char * amonitor_version="!HVER!AMonitor: 1.6.0 [SJY 01/06/07]";
 //   7/01/03 - removed main print panel when it has a real console
 //   5/08/03 - standardised display config var names
 //   8/05/05 - termination cleaned up - SJY
+//  19/10/26 - headless mode and component statistics
+//  19/10/26 - buffers sampled are timed
 
 #include "AMonitor.h"
+#ifdef UNIX
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 // --------------------- CompMonitor ------------------------
 
@@ -247,6 +255,8 @@ AMonitor::AMonitor()
    ConfParam *cParm[MAXGLOBS];       /* config parameters */
    int numParm = GetConfig("AMONITOR", TRUE, cParm, MAXGLOBS);
    int i;
+   Boolean b;
+   char buf[MAXSTRLEN];
    // set basic dimensions of monitor
    margin = 5;  spacing = 5;
    dlwidth = 300;
@@ -258,6 +268,22 @@ AMonitor::AMonitor()
       if (GetConfInt(cParm,numParm,"DISPYORIGIN",&i)) winy0 = i;
       if (GetConfInt(cParm,numParm,"DISPWIDTH",&i)) dlwidth = i;
    }
+   // and statistics settings
+   headless = FALSE; period = 1000;
+   if (numParm>0){
+      if (GetConfBool(cParm,numParm,"HEADLESS",&b)) headless = b;
+      if (GetConfStr(cParm,numParm,"STATSFILE",buf)) statsFN = buf;
+      if (GetConfStr(cParm,numParm,"STATSSOCKET",buf)) statsSock = buf;
+      if (GetConfInt(cParm,numParm,"STATSPERIOD",&i)) period = i;
+   }
+   // no window can be made without graphics
+   if (!HGrafActive()) headless = TRUE;
+   if (period<1){
+      HRError(10401,"AMonitor: STATSPERIOD must be > 0");
+      throw ATK_Error(10401);
+   }
+   statsFile = NULL; listenFd = -1; numSamples = 0;
+   statsLock = HCreateLock("AMonitor:stats");
    terminated = FALSE;
 }
 
@@ -267,6 +293,210 @@ void AMonitor::AddComponent(AComponentPtr comp)
    compList.push_back(comp);
 }
 
+// Add buffer to monitor
+void AMonitor::AddBuffer(ABuffer *buf)
+{
+   BufferMonitor bm;
+
+   bm.buf = buf;
+   memset(&bm.last,0,sizeof(ABufferStats));
+   bufList.push_back(bm);
+}
+
+// Open the stats file and socket if configured, and record the
+// counts so far so that the first sample covers only the first period
+void AMonitor::OpenStats()
+{
+   typedef list<AComponentPtr>::const_iterator LI;
+   ABufferStats st;
+
+   if (statsFN != ""){
+      statsFile = (statsFN=="-")?stdout:fopen(statsFN.c_str(),"w");
+      if (statsFile==NULL){
+         HRError(10402,"AMonitor: cannot open stats file %s",statsFN.c_str());
+         throw ATK_Error(10402);
+      }
+   }
+   if (statsSock != ""){
+#ifdef UNIX
+      struct sockaddr_un addr;
+
+      memset(&addr,0,sizeof(addr));
+      addr.sun_family = AF_UNIX;
+      if (statsSock.size() >= sizeof(addr.sun_path)){
+         HRError(10403,"AMonitor: stats socket name %s too long",statsSock.c_str());
+         throw ATK_Error(10403);
+      }
+      strcpy(addr.sun_path,statsSock.c_str());
+      unlink(addr.sun_path);
+      if ((listenFd = socket(AF_UNIX,SOCK_STREAM,0)) < 0 ||
+          bind(listenFd,(struct sockaddr *)&addr,sizeof(addr)) < 0 ||
+          listen(listenFd,8) < 0){
+         HRError(10403,"AMonitor: cannot listen on stats socket %s",statsSock.c_str());
+         throw ATK_Error(10403);
+      }
+      fcntl(listenFd,F_SETFL,fcntl(listenFd,F_GETFL)|O_NONBLOCK);
+#else
+      HRError(10403,"AMonitor: stats sockets not supported");
+      throw ATK_Error(10403);
+#endif
+   }
+   for (size_t j=0; j<bufList.size(); j++){
+      bufList[j].buf->SetTiming(TRUE);
+      bufList[j].buf->GetStats(bufList[j].last,TRUE);
+   }
+   for (LI i = compList.begin(); i != compList.end(); ++i) {
+      (*i)->mbuf->SetTiming(TRUE);
+      (*i)->mbuf->GetStats(st,TRUE);
+      lastCmd.push_back(st);
+      lastCpu.push_back(((*i)->thread!=0)?HThreadCPUTime((*i)->thread):0.0);
+   }
+   startTime = lastTime = nextTime = GetClockNow();
+   nextTime += period/1000.0;
+}
+
+// Take a sample of every component and buffer and append it to out.
+// Rates are over the time since the last sample.
+void AMonitor::Sample(string& out)
+{
+   typedef list<AComponentPtr>::const_iterator LI;
+   char buf[4*MAXSTRLEN];
+   const char *s;
+   vector<ABufferStats> cur(bufList.size());
+   ABufferStats st,*last;
+   double now,dt,cpu,wait;
+   long nin,nout,n;
+   size_t j;
+   int k;
+
+   now = GetClockNow(); dt = now - lastTime;
+   if (dt <= 0.0) dt = 1e-6;
+   sprintf(buf,"monitor.sample %d\nmonitor.time %.3f\n",++numSamples,now-startTime);
+   out += buf;
+   for (j=0; j<bufList.size(); j++)
+      bufList[j].buf->GetStats(cur[j],TRUE);
+   k = 0;
+   for (LI i = compList.begin(); i != compList.end(); ++i,++k) {
+      AComponentPtr comp = *i;
+      s = comp->cname.c_str();
+      cpu = (comp->thread!=0)?HThreadCPUTime(comp->thread):0.0;
+      nin = nout = 0;
+      for (j=0; j<bufList.size(); j++){
+         if (comp->thread == 0) break;
+         if (cur[j].reader == comp->thread) nin += cur[j].gets - bufList[j].last.gets;
+         if (cur[j].writer == comp->thread) nout += cur[j].puts - bufList[j].last.puts;
+      }
+      comp->mbuf->GetStats(st,TRUE);
+      last = &lastCmd[k];
+      n = st.gets - last->gets;
+      wait = (n>0)?(st.waitSum - last->waitSum)/n:0.0;
+      sprintf(buf,"%s.cpu %.3f\n%s.load %.3f\n",s,cpu,s,(cpu-lastCpu[k])/dt);
+      out += buf;
+      sprintf(buf,"%s.in %.1f\n%s.out %.1f\n",s,nin/dt,s,nout/dt);
+      out += buf;
+      sprintf(buf,"%s.cmds %ld\n%s.cmdwait %.3f\n%s.cmdwaitmax %.3f\n",
+              s,n,s,wait*1000,s,st.waitMax*1000);
+      out += buf;
+      lastCmd[k] = st; lastCpu[k] = cpu;
+   }
+   for (j=0; j<bufList.size(); j++){
+      ABufferStats *c = &cur[j];
+      last = &bufList[j].last;
+      string name = bufList[j].buf->GetName();
+      s = name.c_str();
+      n = c->gets - last->gets;
+      wait = (n>0)?(c->waitSum - last->waitSum)/n:0.0;
+      sprintf(buf,"%s.depth %d\n%s.hiwater %d\n",s,c->depth,s,c->hiwater);
+      out += buf;
+      sprintf(buf,"%s.in %.1f\n%s.out %.1f\n",s,(c->puts-last->puts)/dt,s,n/dt);
+      out += buf;
+      sprintf(buf,"%s.wait %.3f\n%s.waitmax %.3f\n%s.stream %.3f\n",
+              s,wait*1000,s,c->waitMax*1000,s,(c->streamOut-last->streamOut)/1e7/dt);
+      out += buf;
+      sprintf(buf,"%s.blocked %ld\n%s.dropped %ld\n%s.coalesced %ld\n%s.overloads %ld\n",
+              s,c->blocked-last->blocked,s,c->dropped-last->dropped,
+              s,c->coalesced-last->coalesced,s,c->overloads-last->overloads);
+      out += buf;
+      *last = *c;
+   }
+   lastTime = now;
+}
+
+// Send a sample to the stats file and socket clients.  Clients which
+// cannot take it at once are dropped so the monitor never blocks.
+static void SendStats(FILE *f, int listenFd, list<int>& clients, const string& out)
+{
+   if (f != NULL){
+      fputs(out.c_str(),f); fflush(f);
+   }
+#ifdef UNIX
+   int fd;
+   if (listenFd >= 0){
+      while ((fd = accept(listenFd,NULL,NULL)) >= 0){
+         fcntl(fd,F_SETFL,fcntl(fd,F_GETFL)|O_NONBLOCK);
+         clients.push_back(fd);
+      }
+   }
+   for (list<int>::iterator i = clients.begin(); i != clients.end(); ){
+      if (send(*i,out.c_str(),out.size(),MSG_NOSIGNAL) != int(out.size())){
+         close(*i); i = clients.erase(i);
+      } else
+         ++i;
+   }
+#endif
+}
+
+// Output a sample if one is due
+void AMonitor::ChkStats()
+{
+   string out;
+   double now;
+
+   if (statsFile==NULL && listenFd<0) return;
+   now = GetClockNow();
+   if (now < nextTime) return;
+   HEnterSection(statsLock);
+   Sample(out);
+   HLeaveSection(statsLock);
+   nextTime += period/1000.0;
+   if (nextTime < now) nextTime = now + period/1000.0;
+   SendStats(statsFile,listenFd,clients,out);
+}
+
+// Output a last sample and close the stats file and socket
+void AMonitor::CloseStats()
+{
+   if (statsFile==NULL && listenFd<0) return;
+   nextTime = 0.0; ChkStats();
+   if (statsFile != NULL && statsFile != stdout) fclose(statsFile);
+   statsFile = NULL;
+#ifdef UNIX
+   for (list<int>::iterator i = clients.begin(); i != clients.end(); ++i)
+      close(*i);
+   clients.clear();
+   if (listenFd >= 0){
+      close(listenFd); unlink(statsSock.c_str());
+   }
+#endif
+   listenFd = -1;
+}
+
+// Take a sample and print it to f
+void AMonitor::PrintStats(FILE *f)
+{
+   string out;
+
+   HEnterSection(statsLock);
+   if (lastCpu.size() < compList.size()){
+      HRError(10404,"AMonitor: PrintStats called before Start");
+      HLeaveSection(statsLock);
+      throw ATK_Error(10404);
+   }
+   Sample(out);
+   HLeaveSection(statsLock);
+   fputs(out.c_str(),f); fflush(f);
+}
+
 // Redraw entire monitor display
 void AMonitor::Redraw(int lev)
 {
@@ -342,6 +572,7 @@ TASKTYPE TASKMOD Monitor_Task(void * monp)
          while (HEventsPending(NULL)==0) {
             HPauseThread(100);
             mon->Redraw(0);
+            mon->ChkStats();
          }
          e = HGetEvent(NULL,NULL);
          // service window messages
@@ -354,6 +585,7 @@ TASKTYPE TASKMOD Monitor_Task(void * monp)
                break;
             case HWINCLOSE:
                printf("Exiting monitor\n");
+               mon->CloseStats();
                HExitThread(0);
                break;
             default:
@@ -363,6 +595,28 @@ TASKTYPE TASKMOD Monitor_Task(void * monp)
                break;
          }
       } while (!mon->terminated);
+      mon->CloseStats();
+      HExitThread(0);
+      return 0;
+   }
+   catch (ATK_Error e){ ReportErrors("ATK",e.i); return 0;}
+   catch (HTK_Error e){ ReportErrors("HTK",e.i); return 0;}
+}
+
+// The headless monitor task, statistics only
+TASKTYPE TASKMOD Stats_Task(void * monp)
+{
+   AMonitor *mon = (AMonitor *)monp;
+   int pause = (mon->period<100)?mon->period:100;
+
+   try{
+      while (!mon->terminated) {
+         // monitor updates are of no use without a display
+         while (HEventsPending(NULL)>0) HGetEvent(NULL,NULL);
+         HPauseThread(pause);
+         mon->ChkStats();
+      }
+      mon->CloseStats();
       HExitThread(0);
       return 0;
    }
@@ -373,7 +627,8 @@ TASKTYPE TASKMOD Monitor_Task(void * monp)
 // Start the monitor task running
 void AMonitor::Start()
 {
-   HCreateMonitor(Monitor_Task,(void *)this);
+   OpenStats();
+   HCreateMonitor(headless?Stats_Task:Monitor_Task,(void *)this);
 }
 
 // Start the monitor task running
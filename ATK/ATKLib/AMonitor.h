@@ -26,6 +26,7 @@
 // Modification history:
 //   9/12/02 - added display of thread print buffers
 //   8/05/05 - termination cleaned up - SJY
+//  19/10/26 - headless mode and component statistics
 
 #ifndef _ATK_Monitor
 #define _ATK_Monitor
@@ -37,6 +38,10 @@
 // AMONITOR: DISPXORIGIN = 30
 // AMONITOR: DISPYORIGIN = 20
 // AMONITOR: DISPWIDTH   = 300
+// AMONITOR: HEADLESS    = F     -- no window, statistics only
+// AMONITOR: STATSFILE   = ""    -- file for statistics, "-" is stdout
+// AMONITOR: STATSSOCKET = ""    -- unix socket serving statistics
+// AMONITOR: STATSPERIOD = 1000  -- msecs between samples
 
 // ---------------- Component Monitor Class -----------------
 
@@ -75,18 +80,62 @@ typedef CompMonitor *CompMonPtr;
 
 // ------------------- Main Monitor Class ------------------
 
+// If STATSFILE or STATSSOCKET is set, the monitor takes a sample of
+// every registered component and buffer each STATSPERIOD msecs and
+// writes it as lines of the form "name.stat value", starting with a
+// "monitor.sample n" line.  A component's stats are its cpu time,
+// its cpu load over the period, the packets per sec it takes from
+// and puts in registered buffers (attributed by the threads which
+// last did so) and the time its commands waited to be executed.  A
+// buffer's stats are its depth and high water mark, the time packets
+// spent queued, the packet duration taken per sec (under 1 for a
+// stream is falling behind real time) and the puts which overflowed
+// it (see ABuffer::SetOverflow).  Clients may connect to the
+// socket at any time and are sent every later sample.  The counts
+// are kept by the buffers and threads as they run, so sampling
+// costs nothing between samples.
+
+struct BufferMonitor {   // a registered buffer and its last sample
+  ABuffer *buf;
+  ABufferStats last;
+};
+
 class AMonitor {       // a system wide task monitor
 public:
   AMonitor();
   void AddComponent(AComponentPtr comp);
+  void AddBuffer(ABuffer *buf);
+  // Register buf for statistics
   AComponentPtr FindComponent(const string& name);
   void Start();
   void Terminate();
+  void PrintStats(FILE *f);
+  // Take a sample and print it to f
 private:
   friend TASKTYPE TASKMOD Monitor_Task(void * monp);
+  friend TASKTYPE TASKMOD Stats_Task(void * monp);
   void Redraw(int lev);
   void PassEvent(HEventRec e);
+  void Sample(string& out);     // take a sample, append it to out
+  void ChkStats();              // output a sample if one is due
+  void OpenStats();             // open the stats file and socket
+  void CloseStats();
   list<AComponentPtr> compList;   // list of components
+  vector<BufferMonitor> bufList;  // registered buffers
+  vector<ABufferStats> lastCmd;   // last sample of each comp's mbuf
+  vector<double> lastCpu;         // and its cpu time
+  Boolean headless;    // no window
+  string statsFN;      // stats file name
+  string statsSock;    // stats socket path
+  int period;          // msecs between samples
+  FILE *statsFile;     // open stats file, else NULL
+  int listenFd;        // listening stats socket, else -1
+  list<int> clients;   // connected stats clients
+  int numSamples;      // samples taken
+  HLock statsLock;     // guards sampling
+  double startTime;    // clock time of Start
+  double lastTime;     // clock time of last sample
+  double nextTime;     // clock time of next sample
   HWin  theWin;        // the window
   int winx0,winy0;     // window origin
   int dlwidth;         // width of displaylet rectangle
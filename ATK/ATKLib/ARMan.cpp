@@ -29,12 +29,16 @@ char * arman_version="!HVER!ARMan: 1.6.0 [SJY 01/06/07]";
 // 31/10/03   NGram support added
 // 08/05/05   Termination cleaned up
 // 29/07/05   Bug in MakeNetwork fixed, and NULL nodes minimised
+// 19/10/26   Background precompilation of group networks added
+// 19/10/26   Networks held as snapshots so HMMs can be reloaded
+// 19/10/26   Lock free Acquire of group snapshots
 
 #include "ARMan.h"
 #define T_TOP 001     /* Top level tracing */
 #define T_LAT 002     /* Lattice building */
 #define T_WLT 004     /* Print generated HTK lattice */
 #define T_GUP 010     /* trace grammar update and combination */
+#define T_PRE 020     /* Trace network precompilation */
 #define T_DEL 040     /* Trace destructors */
 
 static int trace = 0;
@@ -64,9 +68,8 @@ ResourceGroup::ResourceGroup(const string& name)
    gname = name;
    hmms = dicts = grams = ngrams = NULL;
    xhmms = NULL;  xdict = NULL; xgram = NULL;  xngram = NULL;
-   next = NULL; net=NULL;
-   strcpy(buf,name.c_str()); strcat(buf,":net");
-   CreateHeap(&hmem, buf,  MSTAK, 1, 0.2F, 5000, 20000 );
+   next = NULL; cur=NULL; readers = 0; rebuilding = FALSE; owner = NULL;
+   failed = FALSE;
    strcpy(buf,name.c_str()); strcat(buf,":grp");
    lock = HCreateLock(buf);
 }
@@ -75,7 +78,7 @@ ResourceGroup::ResourceGroup(const string& name)
 ResourceGroup::~ResourceGroup()
 {
    if (trace&T_DEL) printf("  deleting resgroup %s\n",gname.c_str());
-   DeleteHeap(&hmem);
+   if (cur!=NULL) Release(cur);
    ResourceRef *p,*pnxt;
    for (p=hmms; p!=NULL; p=pnxt){pnxt=p->next; delete p;}
    for (p=dicts; p!=NULL; p=pnxt){pnxt=p->next; delete p;}
@@ -91,6 +94,7 @@ void ResourceGroup::AddHMMs(AHmms *p)
    ResourceRef *r = new ResourceRef(p);
    r->next = hmms; hmms = r;
    HLeaveSection(lock);
+   if (owner!=NULL) owner->KickPrecompiler();
 }
 void ResourceGroup::AddDict(ADict *p)
 {
@@ -98,6 +102,7 @@ void ResourceGroup::AddDict(ADict *p)
    ResourceRef *r = new ResourceRef(p);
    r->next = dicts; dicts = r;
    HLeaveSection(lock);
+   if (owner!=NULL) owner->KickPrecompiler();
 }
 void ResourceGroup::AddGram(AGram *p)
 {
@@ -105,6 +110,7 @@ void ResourceGroup::AddGram(AGram *p)
    ResourceRef *r = new ResourceRef(p);
    r->next = grams; grams = r;
    HLeaveSection(lock);
+   if (owner!=NULL) owner->KickPrecompiler();
 }
 void ResourceGroup::AddNGram(ANGram *p)
 {
@@ -112,6 +118,7 @@ void ResourceGroup::AddNGram(ANGram *p)
    ResourceRef *r = new ResourceRef(p);
    r->next = ngrams; ngrams = r;
    HLeaveSection(lock);
+   if (owner!=NULL) owner->KickPrecompiler();
 }
 
 // lock/unlock the entire resource group
@@ -134,6 +141,36 @@ void  ResourceGroup::UnLockAllResources()
    HLeaveSection(lock);
 }
 
+// return TRUE if any resource has changed since the network was built.
+// Versions are read without locking, a change which is missed here
+// will be picked up by the next call.
+Boolean ResourceGroup::IsStale()
+{
+   ResourceRef *p;
+
+   if (cur==NULL || xgram==NULL || failed) return TRUE;
+   for (p=hmms;  p!=NULL; p=p->next) if (p->version != p->ref->version) return TRUE;
+   for (p=dicts; p!=NULL; p=p->next) if (p->version != p->ref->version) return TRUE;
+   for (p=grams; p!=NULL; p=p->next) if (p->version != p->ref->version) return TRUE;
+   for (p=ngrams; p!=NULL; p=p->next) if (p->version != p->ref->version) return TRUE;
+   return FALSE;
+}
+
+// a network can only be built once the group has an HMMSet and a dict
+Boolean ResourceGroup::IsComplete()
+{
+   return (hmms!=NULL && dicts!=NULL)?TRUE:FALSE;
+}
+
+// return TRUE if MakeNetwork can return without rebuilding
+Boolean ResourceGroup::IsReady()
+{
+   HEnterSection(lock);
+   Boolean ready = IsStale()?FALSE:TRUE;
+   HLeaveSection(lock);
+   return ready;
+}
+
 // resource builder routines
 Boolean ResourceGroup::UpdateHMMs()
 {
@@ -238,11 +275,19 @@ Boolean ResourceGroup::UpdateNGram()
    return update;
 }
 
-// make a HMMset from group resources
+// make a HMMset from group resources.  The versions are left alone
+// so that a stale network is still rebuilt.
 HMMSet *ResourceGroup::MakeHMMSet()
 {
-   UpdateHMMs();
-   return xhmms->hset;
+   assert(hmms!=NULL);
+   return ((AHmms *)hmms->ref)->GetHMMSet();
+}
+
+// get a reference to the current HMMSet snapshot
+HMMSnap *ResourceGroup::AcquireHMMSet()
+{
+   assert(hmms!=NULL);
+   return ((AHmms *)hmms->ref)->Acquire();
 }
 
 // make an NGram, if possible, from group resources
@@ -472,68 +517,176 @@ Network *ResourceGroup::MakeNetwork()
    LArc *la;
    char netName[512];
    Boolean ok;
+   GroupSnap *s = NULL, *old = NULL;
+   Network *net;
+
+   // a precompiled network whose resources are unchanged can be
+   // handed straight back without locking the resources
+   GroupSnap *c = cur;
+   if (c!=NULL && !IsStale()) return c->net;
 
    LockAllResources();
-   Boolean b0 = (net==NULL)?TRUE:FALSE;
-   Boolean b1 = UpdateHMMs();
-   Boolean b2 = UpdateDict();
-   Boolean b3 = UpdateGram();
-   Boolean b4 = UpdateNGram();
-
-   if (b0||b1||b2||b3|b4){
-      strcpy(netName,gname.c_str());
-      if (trace&T_TOP) printf("Making new net for group %s\n",netName);
-      // delete existing net
-      if (net != NULL) { ResetHeap(&hmem); net=NULL;}
-      // create HTK lattice corresponding to xgram
-      CreateHeap(&heap,"Lattice heap",MSTAK,1,0.2F,4000,10000);
-      lat = (Lattice *) New(&heap,sizeof(Lattice));
-      lat->heap=&heap; lat->subLatId=NULL; lat->chain=NULL;
-      lat->voc=xdict->vocab; lat->refList=NULL; lat->subList=NULL;
-      lat->vocab=NULL; lat->hmms=NULL;
-      lat->lmscale=1.0; lat->wdpenalty=0.0;
-      lat->utterance = NULL; lat->net = netName;
-      lat->format=HLAT_SHARC|HLAT_ALABS;
-      // calculate number of nodes nn and arcs na required
-      nn = 0;    // init counters
-      na = -1;   // top level doesnt have return link
-      xgram->ExpandCount(nn,na,xgram->main);
-      if (trace&T_TOP) printf("  -- %d nodes, %d links\n",nn,na);
-      // allocate node and link space
-      lat->lnodes=(LNode *) New(&heap, sizeof(LNode)*nn);
-      lat->larcs=(LArc *) New(&heap, sizeof(LArc_S)*na);
-      for(i=0, ln=lat->lnodes; i<nn; i++, ln++) {
-         ln->hook=NULL; ln->pred=NULL; ln->foll=NULL;
-         ln->n = i; ln->v = 0;
-      }
-      for(i=0, la=lat->larcs; i<na; i++, la=NextLArc(lat,la)) {
-         la->lmlike=0.0;
-         la->start=la->end=NNODE;
-         la->farc=la->parc=NARC;
-      }
-      // scan grammar and create lat nodes
-      lat->nn=0;
-      ok = TRUE;    // set false if soft error occurs
-      CreateNodes(&heap,xgram->main,lat,nn,FALSE,&ok);
-      if (!ok) throw ATK_Error(10822);   // usually one or more missing dict entries
-      assert(nn == lat->nn);
-      // scan again and add links
-      lat->na=0; nn=0;
-      CreateLinks(xgram->main,lat,nn,na);
-      assert(na == lat->na);
-      RemoveNulls(lat);
+   try {
+      // the versions are taken before the build, so a build which
+      // failed must be retried even though none has changed since
+      Boolean b0 = (cur==NULL || failed)?TRUE:FALSE;
+      Boolean b1 = UpdateHMMs();
+      Boolean b2 = UpdateDict();
+      Boolean b3 = UpdateGram();
+      Boolean b4 = UpdateNGram();
+
+      if (b0||b1||b2||b3|b4){
+         rebuilding = TRUE;
+         strcpy(netName,gname.c_str());
+         if (trace&T_TOP) printf("Making new net for group %s\n",netName);
+         // the new net goes in a snapshot of its own, the existing one
+         // is freed when its last user releases it
+         s = new GroupSnap;
+         strcat(netName,":net");
+         CreateHeap(&s->heap,netName,MSTAK,1,0.2F,5000,20000);
+         strcpy(netName,gname.c_str());
+         s->hmms = xhmms->Acquire(); s->refs = 1; s->net = NULL;
+         s->lm = (xngram==NULL)?NULL:xngram->lm;
+         hmms->version = s->hmms->version;
+         // create HTK lattice corresponding to xgram
+         CreateHeap(&heap,"Lattice heap",MSTAK,1,0.2F,4000,10000);
+         lat = (Lattice *) New(&heap,sizeof(Lattice));
+         lat->heap=&heap; lat->subLatId=NULL; lat->chain=NULL;
+         lat->voc=xdict->vocab; lat->refList=NULL; lat->subList=NULL;
+         lat->vocab=NULL; lat->hmms=NULL;
+         lat->lmscale=1.0; lat->wdpenalty=0.0;
+         lat->utterance = NULL; lat->net = netName;
+         lat->format=HLAT_SHARC|HLAT_ALABS;
+         // calculate number of nodes nn and arcs na required
+         nn = 0;    // init counters
+         na = -1;   // top level doesnt have return link
+         xgram->ExpandCount(nn,na,xgram->main);
+         if (trace&T_TOP) printf("  -- %d nodes, %d links\n",nn,na);
+         // allocate node and link space
+         lat->lnodes=(LNode *) New(&heap, sizeof(LNode)*nn);
+         lat->larcs=(LArc *) New(&heap, sizeof(LArc_S)*na);
+         for(i=0, ln=lat->lnodes; i<nn; i++, ln++) {
+            ln->hook=NULL; ln->pred=NULL; ln->foll=NULL;
+            ln->n = i; ln->v = 0;
+         }
+         for(i=0, la=lat->larcs; i<na; i++, la=NextLArc(lat,la)) {
+            la->lmlike=0.0;
+            la->start=la->end=NNODE;
+            la->farc=la->parc=NARC;
+         }
+         // scan grammar and create lat nodes
+         lat->nn=0;
+         ok = TRUE;    // set false if soft error occurs
+         CreateNodes(&heap,xgram->main,lat,nn,FALSE,&ok);
+         if (!ok) throw ATK_Error(10822);   // usually one or more missing dict entries
+         assert(nn == lat->nn);
+         // scan again and add links
+         lat->na=0; nn=0;
+         CreateLinks(xgram->main,lat,nn,na);
+         assert(na == lat->na);
+         RemoveNulls(lat);
 #ifdef sanity
-	  CheckNetwork(lat);
+         CheckNetwork(lat);
 #endif
-      if (trace&T_WLT) WriteLattice(lat, stdout, HLAT_DEFAULT);
-      if (trace&T_TOP) printf("Expanding lattice\n");
-      net=ExpandWordNet(&hmem,lat,xdict->vocab,xhmms->hset);
-      DeleteHeap(&heap);
+         if (trace&T_WLT) WriteLattice(lat, stdout, HLAT_DEFAULT);
+         if (trace&T_TOP) printf("Expanding lattice\n");
+         s->net=ExpandWordNet(&s->heap,lat,xdict->vocab,s->hmms->hset);
+         DeleteHeap(&heap);
+         old = (GroupSnap *)HAtomicSwap((void * volatile *)&cur,s);
+         failed = FALSE; rebuilding = FALSE;
+      }
    }
+   catch (...) {  // dont leave the resources locked
+      failed = TRUE; rebuilding = FALSE;
+      if (s!=NULL && s!=cur){
+         DeleteHeap(&s->heap); AHmms::Release(s->hmms); delete s;
+      }
+      UnLockAllResources();
+      throw;
+   }
+   net = cur->net;
    UnLockAllResources();
+   if (old!=NULL){
+      // wait until no Acquire can still be reading old
+      while (readers > 0) HDeschedule();
+      Release(old);
+   }
    return net;
 }
 
+// make the network if needed and return a reference to it.  When the
+// group is up to date no lock is taken: readers is raised while cur is
+// read and referenced so that MakeNetwork knows when it can drop a
+// snapshot it has replaced.  While another thread is rebuilding the
+// group the snapshot it will replace is returned rather than waiting.
+GroupSnap *ResourceGroup::Acquire()
+{
+   GroupSnap *s;
+
+   if (cur==NULL || !rebuilding) MakeNetwork();
+   HAtomicAdd(&readers,1);
+   s = cur; HAtomicAdd(&s->refs,1);
+   HAtomicAdd(&readers,-1);
+   return s;
+}
+
+// drop a reference, deleting the snapshot if it was the last
+void ResourceGroup::Release(GroupSnap *s)
+{
+   if (HAtomicAdd(&s->refs,-1) == 0){
+      if (trace&T_DEL) printf("  deleting network snapshot\n");
+      DeleteHeap(&s->heap);
+      AHmms::Release(s->hmms);
+      delete s;
+   }
+}
+
+// --------------------- Precompiler Thread -------------------
+
+// Rebuild the network of every complete group which is stale, then
+// wait to be kicked again
+TASKTYPE TASKMOD ARMan_Precompile(void *p)
+{
+   ARMan *rm = (ARMan *)p;
+   ResourceGroup *g;
+   int req;
+
+   HEnterSection(rm->pclock);
+   while (!rm->pcstop){
+      while (rm->pcserved == rm->pcrequest && !rm->pcstop)
+         HWaitSignal(rm->pcwake,rm->pclock);
+      if (rm->pcstop) break;
+      req = rm->pcrequest;
+      HLeaveSection(rm->pclock);
+      // groups are only ever added at the head so the list can
+      // be scanned without holding the lock
+      for (g=rm->groups; g!=NULL; g=g->next){
+         if (!g->IsComplete() || !g->IsStale()) continue;
+         if (trace&T_PRE) printf("Precompiling net for group %s\n",g->gname.c_str());
+         try {
+            g->MakeNetwork(); g->MakeNGram();
+         }
+         // leave the group stale so that the error is reported
+         // to the recogniser if it ever tries to use it
+         catch (ATK_Error e){
+            HRError(10829,"ARMan: cannot precompile group %s [ATK %d]",g->gname.c_str(),e.i);
+            printf("%s\n",HRErrorGetMess(HRErrorCount()));
+         }
+         catch (HTK_Error e){
+            HRError(10829,"ARMan: cannot precompile group %s [HTK %d]",g->gname.c_str(),e.i);
+            printf("%s\n",HRErrorGetMess(HRErrorCount()));
+         }
+      }
+      HEnterSection(rm->pclock);
+      rm->pcserved = req;
+      HSendSignal(rm->pcdone);
+   }
+   HLeaveSection(rm->pclock);
+   if (trace&T_PRE) printf("Precompiler exiting\n");
+   HExitThread(0);
+   return 0;
+}
+
 // --------------------- Resource Manager -------------------
 
 // Construct empty resource manager object
@@ -546,8 +699,10 @@ ARMan::ARMan()
 
    autoSil = FALSE;
    numParm = GetConfig("ARMAN", TRUE, cParm, MAXGLOBS);
+   precompile = FALSE;
    if (numParm>0){
       if (GetConfBool(cParm,numParm,"AUTOSIL",&b)) autoSil = b;
+      if (GetConfBool(cParm,numParm,"PRECOMPILE",&b)) precompile = b;
       if (GetConfInt(cParm,numParm,"TRACE",&i)) trace = i;
    }
    // Initialise the structure
@@ -556,6 +711,11 @@ ARMan::ARMan()
    poolGram = NULL;
    poolNGram = NULL;
    groups = NULL; main = NULL;
+   precomp = NULL; pcstop = FALSE;
+   pcrequest = pcserved = 0;
+   pclock = HCreateLock("ARMan:pclock");
+   pcwake = HCreateSignal("ARMan:pcwake");
+   pcdone = HCreateSignal("ARMan:pcdone");
 }
 
 // Delete the resource manager and all enclosed resource objects
@@ -563,6 +723,15 @@ ARMan::~ARMan()
 {
    // delete resource groups
    if (trace&T_DEL) printf(" deleting ARMan\n");
+   // stop the precompiler before the groups go away
+   if (precomp!=NULL){
+      int status;
+      HEnterSection(pclock);
+      pcstop = TRUE;
+      HSendSignal(pcwake);
+      HLeaveSection(pclock);
+      HJoinThread(precomp,&status);
+   }
    ResourceGroup *g,*gnxt;
    for (g=groups; g!=NULL; g=gnxt){gnxt = g->next; delete g;}
    // note that the actual resources are passed into ARMan by the
@@ -612,11 +781,38 @@ ResourceGroup *ARMan::NewGroup(string name)
 {
    ResourceGroup *g = new ResourceGroup(name);
    g->autoSil = autoSil;
+   g->owner = this;
    g->next = groups;  groups = g;
    if (main==NULL) main = g;
    return g;
 }
 
+// Start the precompiler if necessary and ask it to rescan the groups
+void ARMan::PrecompileNetworks(Boolean wait)
+{
+   int req;
+
+   HEnterSection(pclock);
+   if (precomp==NULL){
+      pcstop = FALSE;
+      precomp = HCreateThread("ARMan:precomp",1,HPRIO_LOW,
+                              ARMan_Precompile,(void *)this);
+   }
+   req = ++pcrequest;
+   HSendSignal(pcwake);
+   while (wait && pcserved < req)
+      HWaitSignal(pcdone,pclock);
+   HLeaveSection(pclock);
+   if (wait) HSendSignal(pcdone);  // pass wakeup on to any other waiter
+}
+
+// Called when a group changes, rescan only if precompiling
+void ARMan::KickPrecompiler()
+{
+   if (precomp==NULL && !precompile) return;
+   PrecompileNetworks(FALSE);
+}
+
 // Find a group by name
 ResourceGroup *ARMan::FindGroup(string name)
 {
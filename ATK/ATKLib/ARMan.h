@@ -25,6 +25,7 @@
 
 // Configuration variables (Defaults as shown)
 // ARMAN: AUTOSIL = T   -- auto add sil models around utterance
+// ARMAN: PRECOMPILE = F -- build group networks in a background thread
 
 #include <stdio.h>
 #ifndef _ATK_ARMan
@@ -46,6 +47,24 @@ class ResourceRef {
   friend class ResourceGroup;
 };
 
+class ARMan;
+
+// A compiled network of a group, together with the HMMSet snapshot it
+// was expanded against and the ngram if any.  The group holds a
+// reference to its current snapshot and a recogniser holds one for
+// as long as it uses it, so rebuilding a group (eg after its models
+// are reloaded) never frees a network which is still being decoded.
+// A snapshot is never changed once published, so recognisers sharing
+// a group acquire it without locking; only a rebuild after one of the
+// group's resources has changed locks them.
+struct GroupSnap {
+  Network *net;        // the network ...
+  HMMSnap *hmms;       //  ... its models
+  LModel *lm;          //  ... and ngram, if any
+  MemHeap heap;        // HTK memory for the network
+  volatile int refs;   // references held
+};
+
 class ResourceGroup {
 public:
   string gname;        // name of this group
@@ -58,12 +77,27 @@ public:
   void AddNGram(ANGram *p);
   // Get HMMSet from group
   HMMSet *MakeHMMSet();
-  // Make a network from group
+  // Get a reference to the current HMMSet snapshot of the group,
+  // to be dropped by AHmms::Release
+  HMMSnap *AcquireHMMSet();
+  // Make a network from group, valid until the group is next rebuilt
   Network *MakeNetwork();
+  // Make the network if needed and return a reference to the current
+  // snapshot, which must be dropped by Release
+  GroupSnap *Acquire();
+  static void Release(GroupSnap *s);
   // Get Ngram (if any) from group
   LModel *MakeNGram();
+  // TRUE if the group has a compiled network which is up to date
+  Boolean IsReady();
   friend class ARMan;
+  friend TASKTYPE TASKMOD ARMan_Precompile(void *p);
 private:
+  // TRUE if any constituent resource has changed since the
+  // network was last built
+  Boolean IsStale();
+  // TRUE if the group has enough resources to build a network
+  Boolean IsComplete();
   // resource update routines, return true if the corresponding
   // resource has been updated.
   Boolean UpdateHMMs();   // update HMMs
@@ -86,13 +120,16 @@ private:
   ADict *xdict;        //  ... dict and
   AGram *xgram;        //  ... grammar
   ANGram *xngram;       //  ... ngram lm, if any
-  MemHeap hmem;        // HTK memory for the network
-  Network *net;        // current network if any
+  GroupSnap * volatile cur;  // current network if any
+  volatile int readers;      // Acquires in progress
+  volatile Boolean rebuilding;  // MakeNetwork is building a new snapshot
+  volatile Boolean failed;      // the last rebuild failed, so retry it
   ResourceRef *hmms;   // constitutent resources
   ResourceRef *dicts;
   ResourceRef *grams;
   ResourceRef *ngrams;
   Boolean autoSil;       // auto add initial/final silence
+  ARMan *owner;        // manager to notify when group changes
   ResourceGroup *next;
   HLock lock;          // protected access
 };
@@ -116,9 +153,26 @@ public:
   ResourceGroup *MainGroup();
   ResourceGroup *NewGroup(string name);
   ResourceGroup *FindGroup(string name);
+  // Precompile the networks of all complete groups.  The first call
+  // starts a background thread which thereafter rebuilds any group
+  // whose resources have changed each time it is kicked by a call
+  // to this routine or by adding resources to a group.  If wait is
+  // TRUE, returns only once every complete group is ready.
+  void PrecompileNetworks(Boolean wait = FALSE);
 
 private:
+  friend class ResourceGroup;
+  friend TASKTYPE TASKMOD ARMan_Precompile(void *p);
+  void KickPrecompiler();  // wake precompiler if running
   Boolean autoSil;       // auto add initial/final silence
+  Boolean precompile;    // precompile networks when groups change
+  HThread precomp;       // precompiler thread, if started
+  HLock pclock;          // precompiler state lock
+  HSignal pcwake;        // signals precompiler to rescan groups
+  HSignal pcdone;        // signals that a rescan has completed
+  int pcrequest;         // number of rescans requested ...
+  int pcserved;          // ... and completed
+  Boolean pcstop;        // set to terminate precompiler
   AHmms *poolHMMs;       // resource pools
   ADict *poolDict;
   AGram *poolGram;
@@ -34,6 +34,10 @@ char * arec_version="!HVER!ARec: 1.6.0 [SJY 01/06/07]";
 //  17/05/05 - added nbest output options, added a ansheap
 //             for lattices, added a destructor - MNS
 //  11/08/05 - support for class-based LMs added
+//  19/10/26 - decoder metrics added
+//  19/10/26 - task split into TaskInit/Event/Exit for AScheduler
+//  19/10/26 - no display or display traceback when headless
+//  19/10/26 - networks and HMMs held as snapshots, models switched at prime
 
 #include "ARec.h"
 
@@ -57,6 +61,24 @@ char * arec_version="!HVER!ARec: 1.6.0 [SJY 01/06/07]";
 #define PANELGREY1 50
 #define PANELGREY2 60
 
+// ------------------- Decoder Metrics ----------------------------
+
+// rtf bins are 0.05 wide up to 2.0, latency bins 20ms up to 2s
+ARecMetrics::ARecMetrics() : rtf(0.05F,40), latency(20.0F,100)
+{
+   Reset();
+}
+
+void ARecMetrics::Reset()
+{
+   utts = frames = 0;
+   decodeTime = outpTime = step1Time = step2Time = 0.0;
+   collTime = traceTime = 0.0;
+   sPreHits = sPreMiss = mPreHits = mPreMiss = 0;
+   nactSum = tokSum = 0; nactMax = pathsMax = 0;
+   rtf.Reset(); latency.Reset();
+}
+
 // ------------------- ARec Class --------------------------------
 
 // ARec constructor
@@ -84,7 +106,8 @@ ARec::ARec(const string & name, ABuffer *inb, ABuffer *outb,
    genBeam = nBeam = 225.0; wordBeam = 200.0; maxActive = 0;
    grpName = "";  trbakFreq = 5; outseqnum = 0; inlevel = -1;
    trbakFrame = 0; trbakAc = 0.0; trbakCount = 0; trbakLastWidth=0;
-   nBest=0;
+   nBest=0; metrics = FALSE; metricsFile = "";
+   uttDecodeTime = uttTraceTime = 0.0; lastObsTime = 0.0;
    if (numParm>0){
       if (GetConfBool(cParm,numParm,"DISPSHOW",&b)) showRD = b;
       if (GetConfInt(cParm,numParm,"DISPXORIGIN",&i)) rdx0 = i;
@@ -106,7 +129,10 @@ ARec::ARec(const string & name, ABuffer *inb, ABuffer *outb,
       if (GetConfFlt(cParm,numParm,"TARGETRATE",&f)) sampPeriod = float(f);
       if (GetConfInt(cParm,numParm,"TRACE",&i)) trace = i;
       if (GetConfInt(cParm,numParm,"NBEST",&i)) nBest = i;
+      if (GetConfBool(cParm,numParm,"METRICS",&b)) metrics = b;
+      if (GetConfStr(cParm,numParm,"METRICSFILE",buf)) metricsFile=string(buf);
    }
+   if (!HGrafActive()) showRD = FALSE;
    if (nBeam < genBeam) nBeam = genBeam;
    if ((runmode&RESULT_ASAP) || (runmode&RESULT_IMMED))
       runmode = RunMode(runmode|RESULT_ATEND);
@@ -114,6 +140,7 @@ ARec::ARec(const string & name, ABuffer *inb, ABuffer *outb,
       CreateHeap(&ansHeap,"Lattice heap",MSTAK,1,0.0,4000,4000);
       CreateHeap(&altHeap,"Lattice heap",MSTAK,1,0.0,4000,4000);
    }
+   mlock = HCreateLock((name+":metrics").c_str());
 }
 
 // Destructor
@@ -126,10 +153,9 @@ ARec::~ARec()
 }
 
 // Start the task
-TASKTYPE TASKMOD ARec_Task(void * p);
 void ARec::Start(HPriority priority)
 {
-   AComponent::Start(priority,ARec_Task);
+   AComponent::Start(priority,AComponent_Task);
 }
 
 // Draw current status
@@ -322,6 +348,22 @@ void ARec::UseGrpCmd()
       printf("Rec switching to resource group %s\n",grpName.c_str());
 }
 
+// Append metrics to metricsFile or print them if none
+void ARec::DumpMetricsCmd()
+{
+   FILE *f;
+
+   if (metricsFile == "") {
+      PrintMetrics(stdout); return;
+   }
+   if ((f = fopen(metricsFile.c_str(),"a")) == NULL){
+      HPostMessage(HThreadSelf(),"DumpMetrics: cannot open metrics file\n");
+      return;
+   }
+   PrintMetrics(f);
+   fclose(f);
+}
+
 // Send a marker packet to output
 void ARec::SendMarkerPkt(string marker)
 {
@@ -358,6 +400,10 @@ void ARec::ExecCommand(const string & cmdname)
 		   HPostMessage(HThreadSelf(),"Setnbest, n-best num expected\n");
 	   nBest=nb;
    }
+   else if (cmdname == "dumpmetrics")
+	   DumpMetricsCmd();
+   else if (cmdname == "resetmetrics")
+	   ResetMetrics();
    else {
 	   sprintf(buf,"Unknown command %s\n", cmdname.c_str());
 	   HPostMessage(HThreadSelf(),buf);
@@ -368,7 +414,8 @@ void ARec::ExecCommand(const string & cmdname)
 void ARec::InitRecogniser()
 {
    ResourceGroup *main = rmgr->MainGroup();
-   hset = main->MakeHMMSet();
+   hsnap = main->AcquireHMMSet(); snap = NULL;
+   hset = hsnap->hset;
    psi=InitPSetInfo(hset);
    pri=InitPRecInfo(psi,nToks);
 }
@@ -384,12 +431,29 @@ void ARec::PrimeRecogniser()
       else HRError(0,"ARec: cant find resource group %s\n",grpName.c_str());
       throw ATK_Error(11001);
    }
-   Network *net = g->MakeNetwork();
-   LModel *lm = g->MakeNGram();
+   // the last utterance is complete so its network can be dropped
+   GroupSnap *s = g->Acquire();
+   if (snap!=NULL) ResourceGroup::Release(snap);
+   snap = s;
+   if (snap->hmms != hsnap){
+      // the models have been reloaded, rebuild the model data on them
+      if (trace&T_TOP) printf("%s switching to HMMs version %d\n",
+                              cname.c_str(),snap->hmms->version);
+      DeletePRecInfo(pri); FreePSetInfo(psi);
+      AHmms::Release(hsnap);
+      hsnap = snap->hmms; AHmms::Retain(hsnap);
+      hset = hsnap->hset;
+      psi=InitPSetInfo(hset);
+      pri=InitPRecInfo(psi,nToks);
+   }
    opMap.clear();   // forget all previously output packets
-   StartRecognition(pri,net,lmScale,wordPen,prScale,ngScale,lm);
+   StartRecognition(pri,snap->net,lmScale,wordPen,prScale,ngScale,snap->lm);
    SetPruningLevels(pri,maxActive,genBeam,wordBeam,nBeam,10.0);
    frameCount = 0; tact = 0;
+   if (metrics) {
+      ResetRecStats(pri,TRUE);
+      uttDecodeTime = uttTraceTime = 0.0; lastObsTime = 0.0;
+   }
    if (showRD){
       string gn = (grpName=="")?"main":grpName;
       string s = "Primed with "+  gn + "\n";
@@ -486,7 +550,13 @@ Boolean ARec::RecObservation()
                return TRUE;
             if (trace&T_OBS) PrintObservation(frameCount,&(od->data),13);
             // recognise observation
-            ProcessObservation(pri,&(od->data),-1,hset->curXForm);
+            if (metrics) {
+               double t0 = GetClockNow();
+               ProcessObservation(pri,&(od->data),-1,hset->curXForm);
+               uttDecodeTime += GetClockNow() - t0;
+               lastObsTime = pkt.GetEndTime();
+            } else
+               ProcessObservation(pri,&(od->data),-1,hset->curXForm);
 
             if (trace & T_FRS) {
                char *p;  MLink m;
@@ -504,9 +574,11 @@ Boolean ARec::RecObservation()
             }
             ++frameCount; tact+=pri->nact;
             enTime += sampPeriod;
-            if ((showRD || (runmode&(RESULT_IMMED|RESULT_ASAP)))
+            if (((HGrafActive() && showRD) || (runmode&(RESULT_IMMED|RESULT_ASAP)))
                && (++trbakCount == trbakFreq)) {
+                  double t0 = metrics?GetClockNow():0.0;
                   TraceBackRecogniser(); trbakCount = 0;
+                  if (metrics) uttTraceTime += GetClockNow() - t0;
                }
          }
       }
@@ -653,7 +725,7 @@ void ARec::OutPacket(PhraseType k, string wrd, string tag,
    APacket p(pd);
    p.SetStartTime(start); p.SetEndTime(end);
    out->PutPacket(p);
-   if (showRD) DrawOutLine(k,start,wrd,tag);
+   if (HGrafActive() && showRD) DrawOutLine(k,start,wrd,tag);
    if (trace&T_OUT) p.Show();
 	
 #ifdef __APPLE__
@@ -851,6 +923,7 @@ void ARec::ComputeAnswer()
    float score;
    Lattice *lat, *prunedlat;
    Transcription *trans;
+   double t0 = metrics?GetClockNow():0.0;
 
    pp = FinalBestPath(pri);
    // PrintLatStuff(pp);
@@ -889,86 +962,168 @@ void ARec::ComputeAnswer()
       OutPacket(End_PT, "", "",outseqnum,0,0.0,0.0,score,-1,
                        (float)tact/frameCount,enTime,enTime);
    }
+   if (metrics) {
+      uttTraceTime += GetClockNow() - t0;
+      UpdateMetrics();
+   }
 
    CompleteRecognition(pri);
    OutMarkers(-1);
 }
 
-// ARec task
-TASKTYPE TASKMOD ARec_Task(void * p)
+// Add the decoder statistics of the utterance just completed
+void ARec::UpdateMetrics()
 {
-   ARec *avp = (ARec *)p;
-   char buf[100],cname[100];
-   HEventRec e;
+   RecStats *rs = &pri->stats;
+   HTime now = GetTimeNow();
+
+   if (rs->frames==0) return;
+   HEnterSection(mlock);
+   ++mtr.utts; mtr.frames += rs->frames;
+   mtr.decodeTime += uttDecodeTime;  mtr.traceTime += uttTraceTime;
+   mtr.outpTime += rs->outpTime;
+   mtr.step1Time += rs->step1Time; mtr.step2Time += rs->step2Time;
+   mtr.collTime += rs->collTime;
+   mtr.sPreHits += rs->sPreHits; mtr.sPreMiss += rs->sPreMiss;
+   mtr.mPreHits += rs->mPreHits; mtr.mPreMiss += rs->mPreMiss;
+   mtr.nactSum += rs->nactSum; mtr.tokSum += rs->tokSum;
+   if (rs->nactMax > mtr.nactMax) mtr.nactMax = rs->nactMax;
+   if (rs->pathsMax > mtr.pathsMax) mtr.pathsMax = rs->pathsMax;
+   // time spent decoding vs duration of the audio in secs
+   mtr.rtf.Add(float((uttDecodeTime+uttTraceTime)/(rs->frames*sampPeriod/1e7)));
+   // packet times are on the GetTimeNow clock when input is live
+   if (lastObsTime>0.0 && now>=lastObsTime)
+      mtr.latency.Add(float((now-lastObsTime)/1e4));
+   HLeaveSection(mlock);
+}
 
-   try{
-      strcpy(cname,avp->cname.c_str());
-      if (avp->showRD){
-         avp->win = MakeHWin(cname,avp->rdx0,avp->rdy0,avp->width,avp->height,1);
-         avp->InitDrawRD();
-      }
-      // Initialise Recogniser
-      avp->InitRecogniser();
-      avp->in->RequestBufferEvents(INBUFID);
-      avp->RequestMessageEvents();
-      while (!avp->IsTerminated()){
-         e = HGetEvent(0,0);
-         if (avp->trace&T_RST)
-            printf(" ARec event=%d ev.c=%d state=%d mode=%o\n",
-            e.event,e.c,(int)avp->runstate,(int)avp->runmode);
-         switch(e.event){
-         case HTBUFFER:
-            switch(e.c){
-            case MSGEVENTID:
-               avp->ChkMessage();
-               while (avp->IsSuspended()) avp->ChkMessage(TRUE);
-               if (avp->runstate==ANS_STATE){
-                  avp->ComputeAnswer();
-                  avp->runstate = (avp->runmode&CONTINUOUS_MODE)?PRIME_STATE:WAIT_STATE;
-               }
+// Return a copy of the accumulated metrics
+ARecMetrics ARec::GetMetrics()
+{
+   HEnterSection(mlock);
+   ARecMetrics m = mtr;
+   HLeaveSection(mlock);
+   return m;
+}
+
+void ARec::ResetMetrics()
+{
+   HEnterSection(mlock);
+   mtr.Reset();
+   HLeaveSection(mlock);
+}
+
+// Print metrics as counter lines prefixed by the component name
+void ARec::PrintMetrics(FILE *f)
+{
+   ARecMetrics m = GetMetrics();
+   const char *s = cname.c_str();
+   double fr = (m.frames>0)?double(m.frames):1.0;
+   long sp = m.sPreHits+m.sPreMiss, mp = m.mPreHits+m.mPreMiss;
+
+   fprintf(f,"%s.utts %ld\n",s,m.utts);
+   fprintf(f,"%s.frames %ld\n",s,m.frames);
+   fprintf(f,"%s.decode_secs %.4f\n",s,m.decodeTime);
+   fprintf(f,"%s.trace_secs %.4f\n",s,m.traceTime);
+   fprintf(f,"%s.usec_per_frame.decode %.1f\n",s,1e6*m.decodeTime/fr);
+   fprintf(f,"%s.usec_per_frame.outp %.1f\n",s,1e6*m.outpTime/fr);
+   fprintf(f,"%s.usec_per_frame.step1 %.1f\n",s,1e6*m.step1Time/fr);
+   fprintf(f,"%s.usec_per_frame.step2 %.1f\n",s,1e6*m.step2Time/fr);
+   fprintf(f,"%s.usec_per_frame.collect %.1f\n",s,1e6*m.collTime/fr);
+   fprintf(f,"%s.usec_per_frame.trace %.1f\n",s,1e6*m.traceTime/fr);
+   fprintf(f,"%s.nact.mean %.1f\n",s,m.nactSum/fr);
+   fprintf(f,"%s.nact.max %d\n",s,m.nactMax);
+   fprintf(f,"%s.toks.mean %.1f\n",s,m.tokSum/fr);
+   fprintf(f,"%s.paths.max %d\n",s,m.pathsMax);
+   fprintf(f,"%s.spre.hits %ld\n",s,m.sPreHits);
+   fprintf(f,"%s.spre.misses %ld\n",s,m.sPreMiss);
+   fprintf(f,"%s.spre.hitrate %.3f\n",s,(sp>0)?double(m.sPreHits)/sp:0.0);
+   fprintf(f,"%s.mpre.hits %ld\n",s,m.mPreHits);
+   fprintf(f,"%s.mpre.misses %ld\n",s,m.mPreMiss);
+   fprintf(f,"%s.mpre.hitrate %.3f\n",s,(mp>0)?double(m.mPreHits)/mp:0.0);
+   m.rtf.Print(f,cname+".rtf");
+   m.latency.Print(f,cname+".latency_ms");
+   fflush(f);
+}
+
+// ARec task: set up and request input and message events
+void ARec::TaskInit()
+{
+   char cname[100];
+
+   strcpy(cname,this->cname.c_str());
+   if (showRD){
+      win = MakeHWin(cname,rdx0,rdy0,width,height,1);
+      InitDrawRD();
+   }
+   // Initialise Recogniser
+   InitRecogniser();
+   in->RequestBufferEvents(INBUFID);
+   RequestMessageEvents();
+}
+
+// ARec task: handle an event
+void ARec::TaskEvent(HEventRec &e)
+{
+   char buf[100];
+
+   if (trace&T_RST)
+      printf(" ARec event=%d ev.c=%d state=%d mode=%o\n",
+      e.event,e.c,(int)runstate,(int)runmode);
+   switch(e.event){
+   case HTBUFFER:
+      switch(e.c){
+      case MSGEVENTID:
+         DoMessage();
+         if (runstate==ANS_STATE){
+            ComputeAnswer();
+            runstate = (runmode&CONTINUOUS_MODE)?PRIME_STATE:WAIT_STATE;
+         }
+         break;
+      case INBUFID:
+         switch (runstate) {
+         case PRIME_STATE:
+            PrimeRecogniser();
+            runstate = FLUSH_STATE;
+         case FLUSH_STATE:
+            if (FlushObservation()) {
+               if (terminated) break;   // only possible if file input
+               runstate = RUN_STATE;
+            } else
                break;
-            case INBUFID:
-               switch (avp->runstate) {
-               case PRIME_STATE:
-                  avp->PrimeRecogniser();
-                  avp->runstate = FLUSH_STATE;
-               case FLUSH_STATE:
-                  if (avp->FlushObservation()) {
-                     if (avp->terminated) break;   // only possible if file input
-                     avp->runstate = RUN_STATE;
-                  } else
-                     break;
-               case RUN_STATE:
-                  if (avp->RecObservation())
-                     avp->runstate = ANS_STATE;
-                  else
-                     break;
-               case ANS_STATE:
-                  avp->ComputeAnswer();
-                  avp->runstate = (avp->runmode&CONTINUOUS_MODE)?PRIME_STATE:WAIT_STATE;
-                  break;
-               }
-               // update display
-               if (avp->showRD) avp->DrawStatus();
+         case RUN_STATE:
+            if (RecObservation())
+               runstate = ANS_STATE;
+            else
                break;
-            }
+         case ANS_STATE:
+            ComputeAnswer();
+            runstate = (runmode&CONTINUOUS_MODE)?PRIME_STATE:WAIT_STATE;
             break;
-            case HWINCLOSE:
-               sprintf(buf, "Terminating\n");
-               HPostMessage(HThreadSelf(),buf);
-               avp->terminated = TRUE;
-               break;
          }
+         // update display
+         if (HGrafActive() && showRD) DrawStatus();
+         break;
       }
-      // forward a terminated message to output buffer
-      if (avp->trace&T_TOP) printf("%s recogniser exiting\n",avp->cname.c_str());
-      avp->SendMarkerPkt("TERMINATED");
-      HExitThread(0);
-      return 0;
+      break;
+      case HWINCLOSE:
+         sprintf(buf, "Terminating\n");
+         HPostMessage(HThreadSelf(),buf);
+         terminated = TRUE;
+         break;
    }
-   catch (ATK_Error e){ ReportErrors("ATK",e.i); return 0;}
-   catch (HTK_Error e){ ReportErrors("HTK",e.i); return 0;}
+}
 
+// ARec task: forward a terminated message to output buffer
+void ARec::TaskExit()
+{
+   if (trace&T_TOP) printf("%s recogniser exiting\n",cname.c_str());
+   if (snap!=NULL) { ResourceGroup::Release(snap); snap = NULL; }
+   // the model data is built on hsnap so goes before it
+   DeletePRecInfo(pri); FreePSetInfo(psi);
+   pri = NULL; psi = NULL;
+   AHmms::Release(hsnap); hsnap = NULL; hset = NULL;
+   SendMarkerPkt("TERMINATED");
 }
 
 // ----------------------End of ARec.cpp ---------------------
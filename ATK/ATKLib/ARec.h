@@ -43,6 +43,8 @@
 // AREC: GRPNAME       = ""        -- default resource group name
 // AREC: TRBAKFREQ     = 5         -- default traceback freq for RD
 // AREC: NBEST         = 0         -- number N-Best hyps to compute
+// AREC: METRICS       = F         -- collect decoder metrics
+// AREC: METRICSFILE   = ""        -- file dumpmetrics() appends to (stdout if "")
 //       TARGETRATE    = 10000.0   -- target sample rate
 // HREC: FORCEOUT      = F         -- force output
 
@@ -82,6 +84,30 @@ enum RunState {
 typedef map<Path*, int, less<Path*> > PathMap;
 typedef list<APacket> PacketList;
 
+// Decoder metrics accumulated over utterances when AREC: METRICS = T
+struct ARecMetrics {
+  ARecMetrics();
+  void Reset();
+  long utts;            // utterances completed
+  long frames;          // frames decoded
+  double decodeTime;    // secs in ProcessObservation
+  double outpTime;      // secs computing uncached output probs
+  double step1Time;     // secs in StepInst1 pass (includes outpTime)
+  double step2Time;     // secs in StepInst2 pass
+  double collTime;      // secs in path collection
+  double traceTime;     // secs in traceback and answer output
+  long sPreHits;        // state output prob cache hits and misses
+  long sPreMiss;
+  long mPreHits;        // mixture output prob cache hits and misses
+  long mPreMiss;
+  long nactSum;         // sum over frames of active instances
+  int nactMax;          // max active instances in any frame
+  long tokSum;          // sum over frames of live state tokens
+  int pathsMax;         // max path records in use
+  AHistogram rtf;       // real time factor per utterance
+  AHistogram latency;   // end of speech to result in msecs
+};
+
 class ARec: public AComponent {
 public:
   ARec(const string & name, ABuffer *inb, ABuffer *outb, ARMan *armgr, int nnToks=0);
@@ -98,8 +124,18 @@ public:
   int nToks;           // number of tokens
   int nBest;           //n-best decoding
 
+  // Decoder metrics, these may be called from any thread
+  ARecMetrics GetMetrics();        // snapshot of current metrics
+  void PrintMetrics(FILE *f);      // print as "name.key value" lines
+  void ResetMetrics();
+
+  // stepped execution, not possible with a display
+  Boolean CanSchedule(){return showRD?FALSE:TRUE;}
+  void TaskInit();
+  void TaskEvent(HEventRec &e);
+  void TaskExit();
+
 private:
-  friend TASKTYPE TASKMOD ARec_Task(void *p);
   void InitDrawRD();
   void DrawStatus();
   void DrawOutLine(PhraseType k, HTime t, string wrd, string tag);
@@ -110,6 +146,7 @@ private:
   void StartCmd();
   void StopCmd();
   void UseGrpCmd();
+  void DumpMetricsCmd();
   // State Machine operations
   void InitRecogniser();
   void PrimeRecogniser();
@@ -125,6 +162,7 @@ private:
   void StoreMarker(APacket p);    // Store unrecognised markers for onward transmission
   void OutMarkers(HTime t);       // Forward stored markers stamped < t, all if t -ve
   void ComputeAnswer();
+  void UpdateMetrics();           // add current utterance to metrics
   // Recogniser global data
 
   int trace;           // trace control
@@ -136,6 +174,8 @@ private:
   RunMode runmode;     // current mode
   string grpName;      // current resource group
   HMMSet *hset;        // Current HMMSet
+  HMMSnap *hsnap;      // snapshot holding hset, psi is built on it
+  GroupSnap *snap;     // network in use, if any
   HTime sampPeriod;    // Sample period
   HTime stTime;        // Abs time of first frame
   HTime enTime;        // Abs time of last frame
@@ -167,6 +207,14 @@ private:
 
   MemHeap ansHeap;     //for lattice generation
   MemHeap altHeap;
+
+  Boolean metrics;     // collect decoder metrics
+  string metricsFile;  // file to dump metrics to
+  ARecMetrics mtr;     // accumulated metrics
+  HLock mlock;         // guards mtr
+  double uttDecodeTime; // secs in ProcessObservation this utterance
+  double uttTraceTime; // secs in traceback this utterance
+  HTime lastObsTime;   // end time of last observation decoded
 };
 
 
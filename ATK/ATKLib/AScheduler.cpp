@@ -0,0 +1,347 @@
+/* ----------------------------------------------------------- */
+/*                                                             */
+/*                        _ ___                                */
+/*                       /_\ | |_/                             */
+/*                       | | | | \                             */
+/*                       =========                             */
+/*                                                             */
+/*        Real-time API for HTK-base Speech Recognition        */
+/*                                                             */
+/*       Machine Intelligence Laboratory (Speech Group)        */
+/*        Cambridge University Engineering Department          */
+/*                  http://mi.eng.cam.ac.uk/                   */
+/*                                                             */
+/*               Copyright CUED 2000-2007                      */
+/*                                                             */
+/*   Use of this software is governed by a License Agreement   */
+/*    ** See the file License for the Conditions of Use  **    */
+/*    **     This banner notice must not be removed      **    */
+/*                                                             */
+/* ----------------------------------------------------------- */
+/*  File: AScheduler.cpp - Task scheduler for components       */
+/* ----------------------------------------------------------- */
+
+char * ascheduler_version="!HVER!AScheduler: 1.6.0 [SJY 01/06/07]";
+
+#include "AScheduler.h"
+
+#define T_TOP 0001    // top level tracing
+#define T_RUN 0002    // trace each turn
+
+// task states
+#define TASK_IDLE     0   // no events
+#define TASK_READY    1   // queued on a worker
+#define TASK_RUNNING  2   // having a turn
+#define TASK_STOPPED  3   // terminated
+
+// PostToTask: post function of the task records
+static void PostToTask(HThread t, int event, int c)
+{
+   ASchedTask *task = (ASchedTask *)t->arg;
+   task->sched->Post(task,event,c);
+}
+
+// AScheduler constructor
+AScheduler::AScheduler(const string& schedname, int nWorkers)
+{
+   ConfParam *cParm[MAXGLOBS];
+   int i,numParm;
+   char buf[MAXSTRLEN];
+
+   name = schedname;
+   strcpy(buf,name.c_str());
+   for (i=0; i<int(strlen(buf)); i++) buf[i] = toupper(buf[i]);
+   numParm = GetConfig(buf, TRUE, cParm, MAXGLOBS);
+   numWorkers = 4; batch = 16; trace = 0;
+   if (numParm>0){
+      if (GetConfInt(cParm,numParm,"NUMWORKERS",&i)) numWorkers = i;
+      if (GetConfInt(cParm,numParm,"BATCH",&i)) batch = i;
+      if (GetConfInt(cParm,numParm,"TRACE",&i)) trace = i;
+      if (GetConfCpus(cParm,numParm,"CPUS",buf)) cpus = buf;
+   }
+   if (nWorkers>0) numWorkers = nWorkers;
+   if (numWorkers<1 || batch<1){
+      HRError(10901,"AScheduler: %s needs workers and batch > 0\n",name.c_str());
+      throw ATK_Error(10901);
+   }
+   workers.resize(numWorkers);
+   for (i=0; i<numWorkers; i++){
+      Worker *w = &workers[i];
+      w->sched = this; w->index = i; w->thread = NULL;
+      sprintf(buf,"%s:%d:ready",name.c_str(),i);
+      w->lock = HCreateLock(buf);
+      w->turns = w->events = w->steals = 0;
+   }
+   strcpy(buf,name.c_str());
+   lock = HCreateLock(buf);
+   strcat(buf,":work");
+   work = HCreateSignal(buf);
+   next = idle = wakeups = live = 0;
+   started = terminated = FALSE;
+}
+
+// Start the worker threads
+TASKTYPE TASKMOD AScheduler_Task(void * p);
+void AScheduler::Start(HPriority priority)
+{
+   char buf[MAXSTRLEN];
+
+   HEnterSection(lock);
+   if (started) { HLeaveSection(lock); return; }
+   started = TRUE;
+   HLeaveSection(lock);
+   for (int i=0; i<numWorkers; i++){
+      sprintf(buf,"%s:%d",name.c_str(),i);
+      workers[i].thread = HCreateThread(buf,1,priority,AScheduler_Task,&workers[i]);
+      if (cpus != "") HSetThreadAffinity(workers[i].thread,cpus.c_str());
+   }
+   if (trace&T_TOP)
+      printf("%s: %d workers started\n",name.c_str(),numWorkers);
+}
+
+// Add: run comp as a task, its first turn calls TaskInit
+void AScheduler::Add(AComponent *comp)
+{
+   ASchedTask *task = new ASchedTask;
+   string s;
+
+   task->comp = comp; task->sched = this;
+   task->self = HCreateTaskRecord(comp->cname.c_str(),comp->prBufLines,
+                                  PostToTask,task);
+   s = comp->cname+":task";
+   task->lock = HCreateLock(s.c_str());
+   s = comp->cname+":done";
+   task->done = HCreateSignal(s.c_str());
+   task->state = TASK_READY; task->worker = 0;
+   task->inited = FALSE;
+   comp->stask = task; comp->thread = task->self;
+   HEnterSection(lock);
+   tasks.push_back(task); ++live;
+   HLeaveSection(lock);
+   Start();
+   Ready(task);
+}
+
+// Post: give task an event, making it ready if it was idle
+void AScheduler::Post(ASchedTask *task, int event, int c)
+{
+   HEventRec e;
+   Boolean wake;
+
+   memset(&e,0,sizeof(HEventRec));
+   e.event = (HEvent)event; e.c = (unsigned char)c;
+   HEnterSection(task->lock);
+   if (task->state == TASK_STOPPED) { HLeaveSection(task->lock); return; }
+   task->events.push_back(e);
+   wake = (task->state == TASK_IDLE)?TRUE:FALSE;
+   if (wake) task->state = TASK_READY;
+   HLeaveSection(task->lock);
+   if (wake) Ready(task);
+}
+
+// Ready: queue task on the worker running the caller, so that a
+// pipeline tends to stay on one worker, else on the next worker in turn
+void AScheduler::Ready(ASchedTask *task)
+{
+   HThread self = HFindThreadSelf();
+   ASchedTask *caller;
+   Worker *w;
+
+   caller = (self!=NULL && self->post==PostToTask)?(ASchedTask *)self->arg:NULL;
+   if (caller!=NULL && caller->sched==this)
+      w = &workers[caller->worker];
+   else {
+      HEnterSection(lock);
+      w = &workers[next]; next = (next+1)%numWorkers;
+      HLeaveSection(lock);
+   }
+   HEnterSection(w->lock);
+   w->ready.push_back(task);
+   HLeaveSection(w->lock);
+   // a worker raises idle before it looks for work again, so it
+   // either finds this task or is given a wakeup
+   if (idle>0){
+      HEnterSection(lock);
+      if (idle>0) { ++wakeups; HSendSignal(work); }
+      HLeaveSection(lock);
+   }
+}
+
+// Take: next task of w, most recently readied first, else steal the
+// oldest task of another worker
+ASchedTask *AScheduler::Take(Worker *w)
+{
+   ASchedTask *task = NULL;
+   Worker *v;
+
+   HEnterSection(w->lock);
+   if (!w->ready.empty()){
+      task = w->ready.back(); w->ready.pop_back();
+   }
+   HLeaveSection(w->lock);
+   for (int i=1; task==NULL && i<numWorkers; i++){
+      v = &workers[(w->index+i)%numWorkers];
+      HEnterSection(v->lock);
+      if (!v->ready.empty()){
+         task = v->ready.front(); v->ready.pop_front();
+         ++w->steals;
+      }
+      HLeaveSection(v->lock);
+   }
+   return task;
+}
+
+// Run: give task a turn of up to batch events on worker w.  Events
+// other than messages are held while the component is suspended.
+void AScheduler::Run(Worker *w, ASchedTask *task)
+{
+   AComponent *comp = task->comp;
+   HEventRec ev;
+   HThread prev;
+   Boolean stop = FALSE, requeue = FALSE;
+   int n;
+
+   HEnterSection(task->lock);
+   task->state = TASK_RUNNING; task->worker = w->index;
+   HLeaveSection(task->lock);
+   ++w->turns;
+   if (trace&T_RUN)
+      printf("%s:%d: turn of %s\n",name.c_str(),w->index,comp->cname.c_str());
+   prev = HSetThreadSelf(task->self);
+   try{
+      if (!task->inited){
+         task->inited = TRUE; comp->TaskInit();
+      }
+      for (n=0; n<batch && !comp->IsTerminated(); ){
+         HEnterSection(task->lock);
+         if (!comp->IsSuspended() && !task->held.empty()){
+            task->events.insert(task->events.begin(),task->held.begin(),task->held.end());
+            task->held.clear();
+         }
+         if (task->events.empty()) { HLeaveSection(task->lock); break; }
+         ev = task->events.front(); task->events.pop_front();
+         if (comp->IsSuspended() && !(ev.event==HTBUFFER && ev.c==MSGEVENTID)){
+            task->held.push_back(ev);
+            HLeaveSection(task->lock);
+            continue;
+         }
+         HLeaveSection(task->lock);
+         ++n; ++w->events;
+         comp->TaskEvent(ev);
+      }
+      if (comp->IsTerminated()){
+         comp->TaskExit(); stop = TRUE;
+      }
+   }
+   catch (ATK_Error e){ ReportErrors("ATK",e.i); stop = TRUE; }
+   catch (HTK_Error e){ ReportErrors("HTK",e.i); stop = TRUE; }
+   HSetThreadSelf(prev);
+   HEnterSection(task->lock);
+   if (stop){
+      task->state = TASK_STOPPED;
+      task->events.clear(); task->held.clear();
+      HSendSignal(task->done);
+   } else if (!task->events.empty()){
+      task->state = TASK_READY; requeue = TRUE;
+   } else
+      task->state = TASK_IDLE;
+   HLeaveSection(task->lock);
+   if (stop){
+      HStopTaskRecord(task->self,0);
+      HEnterSection(lock);
+      --live;
+      HLeaveSection(lock);
+      if (trace&T_TOP) printf("%s: %s stopped\n",name.c_str(),comp->cname.c_str());
+   }
+   if (requeue){
+      // the turn is over so let w's other tasks go first
+      HEnterSection(w->lock);
+      w->ready.push_front(task);
+      HLeaveSection(w->lock);
+   }
+}
+
+// Join: wait for comp's task to stop
+int AScheduler::Join(AComponent *comp)
+{
+   ASchedTask *task = comp->stask;
+
+   HEnterSection(task->lock);
+   while (task->state != TASK_STOPPED)
+      HWaitSignal(task->done,task->lock);
+   HLeaveSection(task->lock);
+   return 0;
+}
+
+// Terminate: stop the workers after their current turns
+void AScheduler::Terminate()
+{
+   HEnterSection(lock);
+   terminated = TRUE;
+   for (int i=0; i<numWorkers; i++) HSendSignal(work);
+   HLeaveSection(lock);
+}
+
+// NumTasks: number of tasks not yet stopped
+int AScheduler::NumTasks()
+{
+   int n;
+
+   HEnterSection(lock);
+   n = live;
+   HLeaveSection(lock);
+   return n;
+}
+
+// PrintStats: print turns, events and steals of each worker
+void AScheduler::PrintStats(FILE *f)
+{
+   const char *s = name.c_str();
+
+   for (int i=0; i<numWorkers; i++){
+      fprintf(f,"%s.worker%d.turns %ld\n",s,i,workers[i].turns);
+      fprintf(f,"%s.worker%d.events %ld\n",s,i,workers[i].events);
+      fprintf(f,"%s.worker%d.steals %ld\n",s,i,workers[i].steals);
+   }
+   fprintf(f,"%s.tasks %d\n",s,NumTasks());
+   fflush(f);
+}
+
+// AScheduler worker task
+TASKTYPE TASKMOD AScheduler_Task(void * p)
+{
+   AScheduler::Worker *w = (AScheduler::Worker *)p;
+   AScheduler *sched = w->sched;
+   ASchedTask *task;
+
+   try{
+      while (!sched->terminated){
+         if ((task = sched->Take(w)) == NULL){
+            // the worker queues are not looked at under the scheduler
+            // lock, a wakeup is counted for each task made ready while
+            // workers are idle
+            HEnterSection(sched->lock);
+            ++sched->idle;
+            HLeaveSection(sched->lock);
+            while (!sched->terminated && (task = sched->Take(w)) == NULL){
+               HEnterSection(sched->lock);
+               while (!sched->terminated && sched->wakeups==0)
+                  HWaitSignal(sched->work,sched->lock);
+               if (sched->wakeups>0) --sched->wakeups;
+               HLeaveSection(sched->lock);
+            }
+            HEnterSection(sched->lock);
+            --sched->idle;
+            HLeaveSection(sched->lock);
+            if (task == NULL) break;
+         }
+         sched->Run(w,task);
+      }
+      HExitThread(0);
+      return 0;
+   }
+   catch (ATK_Error e){ ReportErrors("ATK",e.i); return 0;}
+   catch (HTK_Error e){ ReportErrors("HTK",e.i); return 0;}
+}
+
+// ------------------------ End AScheduler.cpp ---------------------
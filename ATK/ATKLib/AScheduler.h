@@ -0,0 +1,117 @@
+/* ----------------------------------------------------------- */
+/*                                                             */
+/*                        _ ___                                */
+/*                       /_\ | |_/                             */
+/*                       | | | | \                             */
+/*                       =========                             */
+/*                                                             */
+/*        Real-time API for HTK-base Speech Recognition        */
+/*                                                             */
+/*       Machine Intelligence Laboratory (Speech Group)        */
+/*        Cambridge University Engineering Department          */
+/*                  http://mi.eng.cam.ac.uk/                   */
+/*                                                             */
+/*               Copyright CUED 2000-2007                      */
+/*                                                             */
+/*   Use of this software is governed by a License Agreement   */
+/*    ** See the file License for the Conditions of Use  **    */
+/*    **     This banner notice must not be removed      **    */
+/*                                                             */
+/* ----------------------------------------------------------- */
+/*    File: AScheduler.h - Task scheduler for components       */
+/* ----------------------------------------------------------- */
+
+/* !HVER!AScheduler: 1.6.0 [SJY 01/06/07] */
+
+// Configuration variables (Defaults as shown)
+
+// ASCHED: NUMWORKERS    = 4             -- worker threads
+// ASCHED: BATCH         = 16            -- max events per turn of a task
+// ASCHED: TRACE         = 0             -- trace flag
+// ASCHED: CPUS          = ""            -- cpus the workers run on, eg 1-3
+
+// An AScheduler runs components as tasks on a fixed set of worker
+// threads instead of giving each its own thread.  A component is
+// scheduled by calling SetScheduler before Start.  Its task then has
+// a turn whenever it has events: buffer events, command messages and
+// audio events all go to the task, and the worker takes on its
+// identity (HThreadSelf) for the turn, so the component code is the
+// same as when it has a thread.  Each worker keeps its own queue of
+// ready tasks; tasks made ready by a worker go on its queue and an
+// idle worker takes from the others.
+//
+// Task code must not block: buffers read by scheduled components
+// should only be read when they have packets and buffers written by
+// them should be unbounded.  Components which cannot run this way
+// (CanSchedule() false, eg with a display window or audio input)
+// still get their own thread.
+
+#ifndef _ATK_SCHEDULER
+#define _ATK_SCHEDULER
+
+#include "AComponent.h"
+#include <deque>
+
+// Per task record, one per scheduled component
+struct ASchedTask {
+   AComponent *comp;     // the component
+   AScheduler *sched;    // scheduler running it
+   HThread self;         // task record used as its thread
+   HLock lock;           // guards events, state
+   HSignal done;         // sent when the task stops
+   deque<HEventRec> events;  // events waiting for its turn
+   deque<HEventRec> held;    // events held while suspended
+   int state;            // idle, ready, running or stopped
+   int worker;           // worker running it (valid when running)
+   Boolean inited;       // TaskInit has been called
+};
+
+class AScheduler {
+public:
+   AScheduler(const string& name, int numWorkers=0);
+   // numWorkers==0 takes NUMWORKERS from the config
+   void Start(HPriority priority=HPRIO_NORM);
+   // start the workers, later calls do nothing
+   void Add(AComponent *comp);
+   // run comp as a task, called by AComponent::Start
+   int Join(AComponent *comp);
+   // wait until comp's task has stopped, returns 0
+   void Terminate();
+   // stop the workers after their current turns
+   int NumWorkers() { return numWorkers; }
+   int NumTasks();
+   void Post(ASchedTask *task, int event, int c);
+   // give task an event, making it ready if idle
+   void PrintStats(FILE *f);
+   // print turns, events and steals of each worker
+private:
+   friend TASKTYPE TASKMOD AScheduler_Task(void *p);
+   struct Worker {
+      AScheduler *sched; int index;
+      HThread thread;
+      HLock lock;                // guards ready
+      deque<ASchedTask *> ready; // own tasks at the back, stolen from front
+      long turns, events, steals;
+   };
+   void Ready(ASchedTask *task);      // queue task on a worker
+   ASchedTask *Take(Worker *w);       // own task else steal one
+   void Run(Worker *w, ASchedTask *task);  // give task a turn
+   string name;          // name of scheduler, used for config and threads
+   int numWorkers;
+   vector<Worker> workers;
+   vector<ASchedTask *> tasks;
+   HLock lock;           // guards tasks, next, idle, wakeups, live, terminated
+   HSignal work;         // sent when a task is made ready
+   int next;             // next worker for tasks made ready elsewhere
+   volatile int idle;    // workers looking for or waiting for work
+   int wakeups;          // tasks made ready while workers were idle
+   int live;             // tasks not yet stopped
+   int batch;            // max events per turn
+   Boolean started;      // workers have been started
+   Boolean terminated;   // workers must exit
+   int trace;            // trace flag
+   string cpus;          // cpus of the workers, if not empty
+};
+
+#endif
+/*  -------------------- End of AScheduler.h --------------------- */
@@ -30,6 +30,10 @@ char * asource_version="!HVER!ASource: 1.6.0 [SJY 01/06/07]";
 //  11/08/04 - static variables removed
 //  19/08/05 - speech output added
 //  18/03/06 - speech output flushing modified
+//  19/10/26 - input rate conversion added
+//  19/10/26 - startout can start muted
+//  19/10/26 - task split into TaskInit/Event/Exit for AScheduler
+//  19/10/26 - no volume meter when headless
 
 #include "ASource.h"
 
@@ -38,6 +42,7 @@ char * asource_version="!HVER!ASource: 1.6.0 [SJY 01/06/07]";
 #define T_SPO 0004    // trace speech output
 
 #define ASOURCEPRBUFSIZE 4
+#define SRCSTEPID 1   // step event of a scheduled source
 
 void ASource::CommonInit(const string & name, ABuffer *outb)
 {
@@ -55,6 +60,7 @@ void ASource::CommonInit(const string & name, ABuffer *outb)
    width = 120; height=30; showVM = FALSE; sampSent = 0;
    timeNow = 0.0; flushmargin = 0.0; oldLevel = -1;
    sampPeriod = 0.0;  // ie default is to use device setting
+   audioRate = 0.0; rconv = NULL; rconvRate = 0.0;
    outSeqNum = 0; isPlaying = FALSE; trace=0;
    ain = NULL; ao = NULL;
    for (i=0; i<int(strlen(buf)); i++) buf[i] = toupper(buf[i]);
@@ -82,7 +88,9 @@ void ASource::CommonInit(const string & name, ABuffer *outb)
       if (GetConfStr(cParm,numParm,"SOURCEFORMAT",buf))
          fmt = Str2Format(buf);
       if (GetConfInt(cParm,numParm,"TRACE",&i)) trace = i;
+      if (GetConfFlt(cParm,numParm,"AUDIORATE",&f)) audioRate = f;
    }
+   if (!HGrafActive()) showVM = FALSE;
 }
 
 // ASource constructor, if cntlWin is supplied, then the volume control
@@ -248,11 +256,34 @@ void ASource::StartCmd()
 {
    string wfn;
    char buf[512];
+   Boolean wasStopped = stopped;
 
    if (fmt == HAUDIO){
       timeNow = GetTimeNow();
       SendMarkerPkt("START");
-      ain = OpenAudioInput(&sampPeriod);
+      if (audioRate > 0.0) {
+         // sample at audioRate and convert to SOURCERATE
+         HTime devPeriod = audioRate;
+         if (sampPeriod <= 0.0) {
+            ConfParam *hParm[MAXGLOBS];
+            double f;
+            int n = GetConfig("HAUDIO", TRUE, hParm, MAXGLOBS);
+            sampPeriod = (n>0 && GetConfFlt(hParm,n,"SOURCERATE",&f))?f:625.0;
+         }
+         ain = OpenAudioInput(&devPeriod);
+         if (ain != NULL && devPeriod != rconvRate){
+            if (rconv == NULL)
+               CreateHeap(&rcHeap,"ASourceRateConv",MSTAK,1,0.0,1000,10000);
+            else
+               ResetHeap(&rcHeap);
+            rconv = CreateRateConv(&rcHeap,int(1.0E7/devPeriod+0.5),
+                                   int(1.0E7/sampPeriod+0.5),1);
+            rconvRate = devPeriod;
+         }
+         if (rconv != NULL) ResetRateConv(rconv);
+         rcpend.clear();
+      } else
+         ain = OpenAudioInput(&sampPeriod);
       if (ain == NULL){
          HRError(10106,"ASource::StartCmd: Cannot open audio device");
          throw HTK_Error(10106);
@@ -278,6 +309,7 @@ void ASource::StartCmd()
    stopped = FALSE; stopping = FALSE;
    flushsamps = (long int) (flushmargin/sampPeriod);
    if (showVM) DrawButton();
+   if (IsScheduled() && wasStopped) HBufferEvent(thread,SRCSTEPID);
 }
 
 // Stop the audio sampling
@@ -302,8 +334,8 @@ APacket ASource::MakePacket(Boolean &isEmpty)
    if (fmt == HAUDIO){
       //  The normal source for ATK ie raw audio input
       if (stopping) {
-         if (PacketsInAudio(ain) > 0) {
-            GetAudio(ain,wd->data); isEmpty = FALSE;
+         if (AudioAvail()) {
+            GetSourceAudio(wd->data); isEmpty = FALSE;
          }else if (flushsamps>0) {
             for (int i=0; i<WAVEPACKETSIZE; i++){
                wd->data[i] = (short int) FakeSilenceSample();
@@ -311,12 +343,12 @@ APacket ASource::MakePacket(Boolean &isEmpty)
             }
             isEmpty = FALSE;
          }
-         if (stopping && (PacketsInAudio(ain)==0) && (flushsamps<=0)){
+         if (stopping && !AudioAvail() && (flushsamps<=0)){
             stopped = TRUE;
             CloseAudioInput(ain);  ain=NULL;
          }
       } else {
-         GetAudio(ain,wd->data); isEmpty = FALSE;
+         GetSourceAudio(wd->data); isEmpty = FALSE;
       }
    } else {
       // The alternate source for testing - ain file
@@ -343,6 +375,39 @@ APacket ASource::MakePacket(Boolean &isEmpty)
    return newpkt;
 }
 
+// AudioAvail: TRUE if an audio packet is ready without waiting
+Boolean ASource::AudioAvail()
+{
+   if (PacketsInAudio(ain) > 0) return TRUE;
+   return (audioRate>0.0 && rcpend.size()>0) ? TRUE : FALSE;
+}
+
+// GetSourceAudio: get next audio packet at the source rate, converting
+// from the device rate when AUDIORATE is set
+void ASource::GetSourceAudio(short *data)
+{
+   short dbuf[WAVEPACKETSIZE];
+   int i,n;
+
+   if (audioRate <= 0.0) {
+      GetAudio(ain,data); return;
+   }
+   while (int(rcpend.size()) < WAVEPACKETSIZE) {
+      if (stopping && PacketsInAudio(ain) == 0) {
+         // input has stopped, pad out the last packet
+         while (int(rcpend.size()) < WAVEPACKETSIZE)
+            rcpend.push_back((short) FakeSilenceSample());
+         break;
+      }
+      GetAudio(ain,dbuf);
+      n = rcpend.size();
+      rcpend.resize(n+RateConvSize(rconv,WAVEPACKETSIZE));
+      rcpend.resize(n+RunRateConv(rconv,dbuf,WAVEPACKETSIZE,&rcpend[n]));
+   }
+   for (i=0; i<WAVEPACKETSIZE; i++) data[i] = rcpend[i];
+   rcpend.erase(rcpend.begin(),rcpend.begin()+WAVEPACKETSIZE);
+}
+
 // Send ain marker packet to output
 void ASource::SendMarkerPkt(string marker)
 {
@@ -393,6 +458,8 @@ void ASource::ExecCommand(const string & cmdname)
 //                  If next wave has seq num > ss, then reply
 //                  "error()" else start output and reply
 //                  "started()".
+//   startout(ss,1) - as above but start muted, used to continue
+//                  a muted prompt in its next segment.
 //   muteout()   -  If output is active reduce volume & reply
 //                  "muted()" else reply "idle()".
 //   unmuteout()  - If output is active restore volume & reply
@@ -494,16 +561,17 @@ void ASource::OpenOutput(ABuffer *spoutb, ABuffer *ackchanb, HTime sampPeriod)
 // StartOutCmd: message interface startout command
 void ASource::StartOutCmd()
 {
-   int ss;
+   int ss,muted = 0;
 
    if (! GetIntArg(ss, 0, -1)) {
       HRError(10201,"ASource::StartOutCmd - invalid seq number");
       throw ATK_Error(10201);
    }
+   GetIntArg(muted, 0, 1);
    if (trace&T_SPO)
-      printf("SpOut: startout(%d) rxed\n",ss);
-   // ensure volume is normal
-   SetOutVolume(ao,normvolume);
+      printf("SpOut: startout(%d%s) rxed\n",ss,muted?",1":"");
+   // ensure volume is normal unless asked to start muted
+   SetOutVolume(ao,muted?mutevolume:normvolume);
    // first get header packet ss
    do {
       if (! GetOutPktHdr()) {
@@ -583,70 +651,96 @@ void  ASource::StatusOutCmd()
 }
 
 // -------------------- ASource task ----------------------------
+// ASource task: set up and request message events
+void ASource::TaskInit()
+{
+   char cname[100];
+
+   CreateHeap(&mem, "ASourceStack", MSTAK, 1, 1.0, 10000, 50000);
+   strcpy(cname,this->cname.c_str());
+   if (showVM && win == NULL){
+      win = MakeHWin(cname,vmx0,vmy0,width,height,1);
+      if (win==NULL) HError(999,"ASource cannot create volume window\n");
+   }
+   if (win != NULL) DrawVM(0);
+   RequestMessageEvents();
+   if (trace&T_TOP)
+      printf("ASource: starting main loop\n");
+}
+
+// ASource task: make the next packet and send it
+void ASource::SourceStep()
+{
+   APacket pkt;
+   Boolean isEmpty;
+
+   pkt = MakePacket(isEmpty);
+   if (!isEmpty){
+      if (HGrafActive() && win != NULL){
+         DrawVM((int)GetCurrentVol(ain));
+      }
+      out->PutPacket(pkt);
+      if (trace&T_OUT)pkt.Show();
+   }
+   if (stopped)SendMarkerPkt("STOP");
+}
+
+// ASource task: handle an event.  A scheduled source sends itself
+// a step event for each packet in place of the polling loop.
+void ASource::TaskEvent(HEventRec &e)
+{
+   char buf[100];
+
+   switch(e.event){
+   case HAUDOUT:
+      isPlaying = FALSE;
+      AckOutCmd("finished");
+      SendMarkerPkt("SYNTHSTOP");
+      break;
+   case HTBUFFER:
+      if (e.c == MSGEVENTID) {
+         DoMessage();
+      } else if (e.c == SRCSTEPID && !stopped) {
+         SourceStep();
+         if (!stopped) HBufferEvent(thread,SRCSTEPID);
+      }
+      break;
+   case HWINCLOSE:
+      sprintf(buf, "terminating");
+      HPostMessage(HThreadSelf(),buf);
+      terminated = TRUE;
+      break;
+   case HMOUSEDOWN:
+      if (TrackButtons(&ssb,e)>0)
+         ButtonPressed(ssb.id);
+      if (hasXbt && TrackButtons(&xtb,e)>0)
+         ButtonPressed(xtb.id);
+   }
+}
+
+// ASource task: mark the end of input and stop
+void ASource::TaskExit()
+{
+   SendMarkerPkt("TERMINATED");
+   if (!stopped) StopCmd();
+   if (trace&T_TOP) printf("%s source exiting\n",cname.c_str());
+}
+
 TASKTYPE TASKMOD ASource_Task(void * p)
 {
    ASource *asp = (ASource *)p;
-   APacket pkt;
-   int i;
-   char buf[100],cname[100];
    HEventRec e;
-   AWaveData *wd;
-   Boolean isEmpty;
 
    try{
-      CreateHeap(&(asp->mem), "ASourceStack", MSTAK, 1, 1.0, 10000, 50000);
-      strcpy(cname,asp->cname.c_str());
-      if (asp->showVM && asp->win == NULL){
-         asp->win = MakeHWin(cname,asp->vmx0,asp->vmy0,asp->width,asp->height,1);
-         if (asp->win==NULL) HError(999,"ASource cannot create volume window\n");
-      }
-      if (asp->win != NULL) asp->DrawVM(0);
-      asp->RequestMessageEvents();
-      if (asp->trace&T_TOP)
-         printf("ASource: starting main loop\n");
+      asp->TaskInit();
       while (!asp->IsTerminated()){
-         if (!asp->stopped){
-            pkt = asp->MakePacket(isEmpty);
-            if (!isEmpty){
-               wd = (AWaveData *)pkt.GetData();
-               if (asp->win != NULL){
-                  asp->DrawVM((int)GetCurrentVol(asp->ain));
-               }
-               asp->out->PutPacket(pkt);
-               if (asp->trace&T_OUT)pkt.Show();
-            }
-            if (asp->stopped)asp->SendMarkerPkt("STOP");
-         }
+         if (!asp->stopped) asp->SourceStep();
          if (asp->stopped || HEventsPending(0)){
             e = HGetEvent(0,0);
-            switch(e.event){
-            case HAUDOUT:
-               asp->isPlaying = FALSE;
-               asp->AckOutCmd("finished");
-               asp->SendMarkerPkt("SYNTHSTOP");
-               break;
-            case HTBUFFER:
-               if (e.c == MSGEVENTID) {
-                  asp->ChkMessage();
-                  while (asp->IsSuspended()) asp->ChkMessage(TRUE);
-               }
-               break;
-            case HWINCLOSE:
-               sprintf(buf, "terminating");
-               HPostMessage(HThreadSelf(),buf);
-               asp->terminated = TRUE;
-               break;
-            case HMOUSEDOWN:
-               if (TrackButtons(&(asp->ssb),e)>0)
-                  asp->ButtonPressed(asp->ssb.id);
-               if (asp->hasXbt && TrackButtons(&(asp->xtb),e)>0)
-                  asp->ButtonPressed(asp->xtb.id);
-            }
+            asp->TaskEvent(e);
          }
       }
-      asp->SendMarkerPkt("TERMINATED");
-      if (!asp->stopped) asp->StopCmd();
-      if (asp->trace&T_TOP) printf("%s source exiting\n",asp->cname.c_str());
+      asp->TaskExit();
       HExitThread(0);
       return 0;
    }
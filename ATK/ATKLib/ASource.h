@@ -25,7 +25,7 @@
 
 // Configuration variables (Defaults as shown)
 //         SOURCEFORMAT = HAUDIO  -- source is direct audio
-// ASOURCE: DISPSHOW    = T       -- create a volume meter
+// ASOURCE: DISPSHOW    = T       -- create a volume meter, unless headless
 // ASOURCE: DISPXORIGIN = 30      -- top-left X coord of VM Window
 // ASOURCE: DISPYORIGIN = 10      -- top-left Y coord of VM Window
 // ASOURCE: DISPHEIGHT  = 30      -- height of volume meter
@@ -36,6 +36,13 @@
 // ASOURCE: NORMALVOLUME = 100    -- default volume for output
 // ASOURCE: MUTEDVOLUME = 50      -- muted volume
 // ASOURCE: EXTRABUTTON = ''      -- define to create extra control button
+// ASOURCE: AUDIORATE   = 0       -- audio device sample period if not SOURCERATE
+//
+// Putting a packet in a full output buffer stalls audio capture, so
+// the output buffer of a live source should be bounded with a policy
+// which does not block, eg for a buffer called auChan
+//    AUCHAN: MAXPKTS  = 50
+//    AUCHAN: OVERFLOW = DROPOLDEST
 
 #ifndef _ATK_ASource
 #define _ATK_ASource
@@ -60,8 +67,15 @@ public:
   HTime GetSampPeriod();
   AudioOut ao;         // output device
   AudioIn ain;         // HTK audio input object
+  // stepped execution, only for file input without a display since
+  // audio input blocks
+  Boolean CanSchedule(){return (fmt!=HAUDIO && !showVM)?TRUE:FALSE;}
+  void TaskInit();
+  void TaskEvent(HEventRec &e);
+  void TaskExit();
 private:
   friend TASKTYPE TASKMOD ASource_Task(void *p);
+  void SourceStep();
   void CommonInit(const string & name, ABuffer *outb);
   void ReadWaveList(char *fn);
   void DrawVM(int level);
@@ -71,6 +85,8 @@ private:
   void StopCmd();
   void SendMarkerPkt(string marker);
   APacket MakePacket(Boolean &isEmpty);
+  Boolean AudioAvail();           // TRUE if audio packet ready
+  void GetSourceAudio(short *data); // get audio packet at source rate
   void ExecCommand(const string & cmdname);
   MemHeap mem;         // heap for HWave input
   FileFormat fmt;      // source format (default HAUDIO)
@@ -84,6 +100,11 @@ private:
   long flushsamps;     // number of flush samples left
   HTime timeNow;       // used to track time
   HTime sampPeriod;    // Sample period
+  HTime audioRate;     // audio device sample period (0 = sampPeriod)
+  MemHeap rcHeap;      // holds rconv
+  RateConv rconv;      // audio device to source rate converter
+  HTime rconvRate;     // device sample period rconv was made for
+  vector<short> rcpend; // converted samples not yet sent
   Boolean stopping;    // TRUE when stopping sampling
   Boolean stopped;     // TRUE when sampling is temporarily stopped
   int mutevolume;      // muted volume level
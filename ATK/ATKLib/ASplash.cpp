@@ -83,6 +83,8 @@ Boolean SplashScreen(string& userid, string& hostid, string& mictype)
    int id;
    HWin win;
 
+   // without graphics there is no screen, so start with the ids given
+   if (!HGrafActive()) return TRUE;
    win = MakeHWin("tHIS",200,100,400,200,1);
    if (win==NULL) HError(999,"SplashScreen cannot create splash window\n");
    HSetColour(win,WHITE);
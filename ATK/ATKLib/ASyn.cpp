@@ -24,14 +24,26 @@
 char * asyn_version="!HVER!ASyn: 1.6.0 [SJY 01/06/07]";
 
 // Modification history:
+//  19/10/26 - prompt cache added
+//  19/10/26 - output rate conversion added
+//  19/10/26 - synthesiser pool added
+//  19/10/26 - talks split and played by sentence
+//  19/10/26 - task split into TaskInit/Event/Exit for AScheduler
+//  19/10/26 - pool survives HTK errors in a job and joins on Terminate
+//  19/10/26 - started always replied before a talk is interrupted
 
 #include "ASyn.h"
 
 #define ACKBUFID 1
+#define POOLBUFID 2
 #define ASynPRBUFSIZE 5
 
 #define T_TOP 0001    // top level tracing
 #define T_ABT 0002    // abort tracing
+#define T_CCH 0004    // prompt cache tracing
+#define T_POL 0010    // pool job tracing
+
+#define PROMPTMAGIC "ASYNPRM1"
 
 // This component is driven by command messages, status is returned
 // via the reply buffer (repbuf).
@@ -48,6 +60,327 @@ char * asyn_version="!HVER!ASyn: 1.6.0 [SJY 01/06/07]";
 //       idx = index of last whole word output
 //       word = last whole word output
 //
+// Unless SPLITTEXT is false, talk text is split into sentences which
+// are synthesised and sent to the sink one by one, so output starts
+// once the first is ready.  Replies still refer to the talk as a
+// whole, idx counting words from its start.
+//
+
+// ------------------- Prompt Cache ------------------------------
+
+// Copy: copy the synthesiser's current utterance
+void ASynPrompt::Copy(ASynthesiser *syn, Boolean withWave)
+{
+   int i,n = syn->GetNumWords();
+
+   nSamps = syn->GetNumSamples();
+   wave.clear(); words.clear(); ends.clear();
+   if (withWave && nSamps>0)
+      wave.assign(syn->GetWave(),syn->GetWave()+nSamps);
+   for (i=1; i<=n; i++){
+      words.push_back(syn->GetWord(i));
+      ends.push_back(syn->GetBoundary(i));
+   }
+}
+
+// return i'th word in prompt (first is i=1)
+string ASynPrompt::GetWord(int i)
+{
+   if (i<1 || i>GetNumWords()) return "";
+   return words[i-1];
+}
+
+// get sample number of end of i'th word
+int ASynPrompt::GetBoundary(int i)
+{
+   if (i<1) return 0;
+   if (i>GetNumWords()) return nSamps;
+   return ends[i-1];
+}
+
+// Load: read prompt from file fn, fails if missing or key differs
+Boolean ASynPrompt::Load(const string& fn, const string& key)
+{
+   FILE *f;
+   char magic[8];
+   int i,n,nw,len;
+   bool ok = false;
+
+   if ((f=fopen(fn.c_str(),"rb")) == NULL) return FALSE;
+   if (fread(magic,1,8,f)==8 && strncmp(magic,PROMPTMAGIC,8)==0 &&
+       fread(&len,sizeof(int),1,f)==1 && len==int(key.size())) {
+      string k(len,' ');
+      if (len==0 || fread(&k[0],1,len,f)==size_t(len)) ok = (k==key);
+   }
+   if (ok) ok = fread(&n,sizeof(int),1,f)==1 && fread(&nw,sizeof(int),1,f)==1
+               && n>0 && nw>=0;
+   if (ok) {
+      nSamps = n; words.clear();
+      for (i=0; ok && i<nw; i++){
+         ok = fread(&len,sizeof(int),1,f)==1 && len>=0;
+         if (ok) {
+            string w(len,' ');
+            if (len>0) ok = fread(&w[0],1,len,f)==size_t(len);
+            words.push_back(w);
+         }
+      }
+   }
+   if (ok) {
+      ends.resize(nw); wave.resize(n);
+      ok = (nw==0 || fread(&ends[0],sizeof(int),nw,f)==size_t(nw)) &&
+           fread(&wave[0],sizeof(short),n,f)==size_t(n);
+   }
+   fclose(f);
+   if (!ok) { nSamps = 0; wave.clear(); words.clear(); ends.clear(); }
+   return ok?TRUE:FALSE;
+}
+
+// Save: write prompt to file fn
+void ASynPrompt::Save(const string& fn, const string& key)
+{
+   FILE *f;
+   int i,n,len;
+
+   if ((f=fopen(fn.c_str(),"wb")) == NULL){
+      HRError(12010,"ASynPrompt::Save: cannot create %s\n",fn.c_str());
+      return;
+   }
+   fwrite(PROMPTMAGIC,1,8,f);
+   len = key.size(); fwrite(&len,sizeof(int),1,f);
+   fwrite(key.c_str(),1,len,f);
+   n = GetNumWords();
+   fwrite(&nSamps,sizeof(int),1,f); fwrite(&n,sizeof(int),1,f);
+   for (i=0; i<n; i++){
+      len = words[i].size(); fwrite(&len,sizeof(int),1,f);
+      fwrite(words[i].c_str(),1,len,f);
+   }
+   if (n>0) fwrite(&ends[0],sizeof(int),n,f);
+   fwrite(&wave[0],sizeof(short),nSamps,f);
+   if (fclose(f)!=0)
+      HRError(12010,"ASynPrompt::Save: error writing %s\n",fn.c_str());
+}
+
+// ASynCache constructor
+ASynCache::ASynCache(int maxp, int maxs, const string& d)
+{
+   maxPrompts = maxp; maxSamps = maxs; dir = d;
+   totSamps = 0; hits = misses = 0;
+}
+
+ASynCache::~ASynCache()
+{
+   for (PromptList::iterator i=lru.begin(); i!=lru.end(); i++)
+      delete i->second;
+}
+
+// FileName: name of persisted file for key, a hash of the key
+string ASynCache::FileName(const string& key)
+{
+   unsigned int h = 2166136261u;
+   char base[20],fn[1024];
+
+   for (size_t i=0; i<key.size(); i++){
+      h ^= (unsigned char)key[i]; h *= 16777619u;
+   }
+   sprintf(base,"%08x",h);
+   strcpy(fn,dir.c_str());
+   return string(MakeFN(base,fn,"syn",fn));
+}
+
+// Insert: put p at front of lru and evict to stay within limits
+void ASynCache::Insert(const string& key, ASynPrompt *p)
+{
+   lru.push_front(make_pair(key,p));
+   index[key] = lru.begin();
+   totSamps += p->nSamps;
+   while (int(lru.size()) > maxPrompts ||
+          (maxSamps>0 && totSamps>maxSamps && lru.size()>1)) {
+      totSamps -= lru.back().second->nSamps;
+      index.erase(lru.back().first);
+      delete lru.back().second;
+      lru.pop_back();
+   }
+}
+
+// Find: return prompt for key or NULL
+ASynPrompt *ASynCache::Find(const string& key)
+{
+   PromptMap::iterator i = index.find(key);
+
+   if (i != index.end()) {
+      lru.splice(lru.begin(),lru,i->second);
+      ++hits;
+      return lru.front().second;
+   }
+   if (dir != "") {
+      ASynPrompt *p = new ASynPrompt;
+      if (p->Load(FileName(key),key)) {
+         Insert(key,p); ++hits;
+         return p;
+      }
+      delete p;
+   }
+   ++misses;
+   return NULL;
+}
+
+// Add: add p to cache, persisting it if dir set
+void ASynCache::Add(const string& key, ASynPrompt *p)
+{
+   if (index.find(key) != index.end() ||
+       (maxSamps>0 && p->nSamps>maxSamps)) {
+      delete p; return;
+   }
+   if (dir != "") p->Save(FileName(key),key);
+   Insert(key,p);
+}
+
+// ------------------- Synthesis Pool ----------------------------
+
+// ASynPool constructor
+ASynPool::ASynPool(const string& poolname, const vector<ASynthesiser *>& s)
+{
+   ConfParam *cParm[MAXGLOBS];
+   int i,numParm;
+   char buf[MAXSTRLEN];
+
+   if (s.size()==0){
+      HRError(12001,"ASynPool: %s has no synthesisers\n",poolname.c_str());
+      throw ATK_Error(12001);
+   }
+   name = poolname; syns = s;
+   strcpy(buf,name.c_str());
+   for (i=0; i<int(strlen(buf)); i++) buf[i] = toupper(buf[i]);
+   numParm = GetConfig(buf, TRUE, cParm, MAXGLOBS);
+   trace = 0;
+   if (numParm>0){
+      if (GetConfInt(cParm,numParm,"TRACE",&i)) trace = i;
+   }
+   workers.resize(syns.size());
+   for (i=0; i<NumWorkers(); i++){
+      workers[i].pool = this; workers[i].syn = syns[i];
+   }
+   strcpy(buf,name.c_str());
+   lock = HCreateLock(buf);
+   strcat(buf,":work");
+   work = HCreateSignal(buf);
+   started = terminated = FALSE;
+}
+
+// Start the worker threads
+TASKTYPE TASKMOD ASynPool_Task(void * p);
+void ASynPool::Start(HPriority priority)
+{
+   char buf[MAXSTRLEN];
+
+   HEnterSection(lock);
+   if (started) { HLeaveSection(lock); return; }
+   started = TRUE;
+   HLeaveSection(lock);
+   for (int i=0; i<NumWorkers(); i++){
+      sprintf(buf,"%s:%d",name.c_str(),i);
+      workers[i].thread = HCreateThread(buf,1,priority,ASynPool_Task,&workers[i]);
+   }
+}
+
+// Submit: queue job for the next free worker, or if terminated mark
+// it done at once
+void ASynPool::Submit(ASynJob *job)
+{
+   HEnterSection(lock);
+   if (terminated){
+      // no worker will take it, so it is done with no prompt
+      job->prompt = ASynPrompt(); job->done = TRUE;
+      HLeaveSection(lock);
+      if (job->client != NULL) HBufferEvent(job->client,job->eventId);
+      return;
+   }
+   job->done = FALSE;
+   queue.push_back(job);
+   HSendSignal(work);
+   HLeaveSection(lock);
+}
+
+// IsDone: true once job's prompt is complete
+Boolean ASynPool::IsDone(ASynJob *job)
+{
+   Boolean done;
+
+   HEnterSection(lock);
+   done = job->done;
+   HLeaveSection(lock);
+   return done;
+}
+
+// Terminate: stop the workers once their current jobs are done and
+// wait for them to exit.  Jobs still queued are done with no prompt
+void ASynPool::Terminate()
+{
+   vector<HThread> clients;
+   vector<int> eventIds;
+   int i,status;
+
+   HEnterSection(lock);
+   if (terminated) { HLeaveSection(lock); return; }
+   terminated = TRUE;
+   for (i=0; i<NumWorkers(); i++) HSendSignal(work);
+   for (list<ASynJob *>::iterator j=queue.begin(); j!=queue.end(); j++){
+      // job may be deleted by its client as soon as it is done
+      clients.push_back((*j)->client); eventIds.push_back((*j)->eventId);
+      (*j)->done = TRUE;
+   }
+   queue.clear();
+   HLeaveSection(lock);
+   for (i=0; i<int(clients.size()); i++)
+      if (clients[i] != NULL) HBufferEvent(clients[i],eventIds[i]);
+   if (started)
+      for (i=0; i<NumWorkers(); i++) HJoinThread(workers[i].thread,&status);
+}
+
+// ASynPool worker task
+TASKTYPE TASKMOD ASynPool_Task(void * p)
+{
+   ASynPool::Worker *w = (ASynPool::Worker *)p;
+   ASynPool *pool = w->pool;
+   ASynJob *job;
+   HThread client;
+   int eventId;
+
+   try{
+      while (TRUE){
+         HEnterSection(pool->lock);
+         while (pool->queue.empty() && !pool->terminated)
+            HWaitSignal(pool->work,pool->lock);
+         if (pool->terminated) { HLeaveSection(pool->lock); break; }
+         job = pool->queue.front(); pool->queue.pop_front();
+         HLeaveSection(pool->lock);
+         try{
+            w->syn->StartUtterance(job->text);
+            job->prompt.Copy(w->syn,TRUE);
+         }
+         catch (ATK_Error e){
+            job->prompt = ASynPrompt();
+         }
+         catch (HTK_Error e){
+            job->prompt = ASynPrompt();
+         }
+         w->syn->EndUtterance();
+         if (pool->trace&T_POL)
+            printf("%s: %d samples for %s\n",pool->name.c_str(),
+                   job->prompt.nSamps,job->text.c_str());
+         // job may be deleted by its client as soon as it is done
+         client = job->client; eventId = job->eventId;
+         HEnterSection(pool->lock);
+         job->done = TRUE;
+         HLeaveSection(pool->lock);
+         if (client != NULL) HBufferEvent(client,eventId);
+      }
+      HExitThread(0);
+      return 0;
+   }
+   catch (ATK_Error e){ ReportErrors("ATK",e.i); return 0;}
+   catch (HTK_Error e){ ReportErrors("HTK",e.i); return 0;}
+}
 
 // ------------------- ASyn Class --------------------------------
 
@@ -55,36 +388,88 @@ char * asyn_version="!HVER!ASyn: 1.6.0 [SJY 01/06/07]";
 ASyn::ASyn(const string & name, ABuffer *repb, ABuffer *audb,
            ABuffer *ackb, ASource *asink, ASynthesiser *theSyn)
 : AComponent(name,(HasRealConsole()?2:ASynPRBUFSIZE))
+{
+   syn = theSyn; pool = NULL;
+   Init(name,repb,audb,ackb,asink);
+}
+
+// ASyn constructor for synthesis in a shared pool
+ASyn::ASyn(const string & name, ABuffer *repb, ABuffer *audb,
+           ABuffer *ackb, ASource *asink, ASynPool *thePool)
+: AComponent(name,(HasRealConsole()?2:ASynPRBUFSIZE))
+{
+   syn = NULL; pool = thePool;
+   Init(name,repb,audb,ackb,asink);
+}
+
+// Init: configure the component, common to both constructors
+void ASyn::Init(const string & name, ABuffer *repb, ABuffer *audb,
+                ABuffer *ackb, ASource *asink)
 {
    ConfParam *cParm[MAXGLOBS];       /* config parameters */
    int numParm;
-   int i;
+   int i,maxp,maxs;
+   double f;
+   HTime outP;
    Boolean b;
-   char buf[100];
+   char buf[MAXSTRLEN];
+   string dir;
 
    // create the module
    strcpy(buf,name.c_str());
    for (i=0; i<int(strlen(buf)); i++) buf[i] = toupper(buf[i]);
    numParm = GetConfig(buf, TRUE, cParm, MAXGLOBS);
    audbuf = audb; ackbuf = ackb; repbuf = repb;
-   sink = asink; state = synth_idle; syn=theSyn;
-   trace = 0; seqnum = 0;
+   sink = asink; state = synth_idle;
+   trace = 0; seqnum = 0; splitText = TRUE;
+   talking = playing = aborted = startSent = FALSE;
+   segNext = segWords = segSamps = talkSeq = 0;
+   maxp = maxs = 0; cache = NULL;
+   synRate = (pool!=NULL)?pool->GetSampRate():syn->GetSampRate();
+   outP = 1.0E7/synRate;
    if (numParm>0){
       if (GetConfInt(cParm,numParm,"TRACE",&i)) trace = i;
+      if (GetConfInt(cParm,numParm,"CACHESIZE",&i)) maxp = i;
+      if (GetConfInt(cParm,numParm,"CACHESAMPS",&i)) maxs = i;
+      if (GetConfStr(cParm,numParm,"CACHEDIR",buf)) dir = buf;
+      if (GetConfStr(cParm,numParm,"CACHEPRELOAD",buf)) preload = buf;
+      if (GetConfFlt(cParm,numParm,"AUDIORATE",&f) && f>0.0) outP = f;
+      if (GetConfBool(cParm,numParm,"SPLITTEXT",&b)) splitText = b;
+   }
+   if (maxp>0) cache = new ASynCache(maxp,maxs,dir);
+   // convert to the output rate if it differs from the synthesiser
+   outRate = int(1.0E7/outP+0.5); rconv = NULL;
+   if (outRate != synRate){
+      CreateHeap(&rcHeap,"ASynRateConv",MSTAK,1,0.0,1000,10000);
+      rconv = CreateRateConv(&rcHeap,synRate,outRate,1);
    }
    // create the output channel to the sink
-   asink->OpenOutput(audb,ackb,625.0);
+   asink->OpenOutput(audb,ackb,outP);
 }
 
 
 // Start the task
-TASKTYPE TASKMOD ASyn_Task(void * p);
 void ASyn::Start(HPriority priority)
 {
-   AComponent::Start(priority,ASyn_Task);
+   AComponent::Start(priority,AComponent_Task);
+}
+
+// Reply: send cd to the host
+void ASyn::Reply(ACommandData *cd)
+{
+   APacket reppkt(cd);
+   reppkt.SetStartTime(GetTimeNow());
+   reppkt.SetEndTime(GetTimeNow());
+   repbuf->PutPacket(reppkt);
+   if (trace&T_TOP){
+      printf("ASyn: reply sent - "); cd->Show(); printf("\n");
+   }
 }
 
-// ChkAckBuf: check acks coming from sink and update host on status
+// ChkAckBuf: check acks coming from sink and update host on status.
+// The sink plays a talk one segment at a time, its acks are mapped
+// onto the talk as a whole so the host sees one started(), one
+// finished() and word positions counted from the start of the talk.
 void ASyn::ChkAckBuf()
 {
    if (!ackbuf->IsEmpty()){
@@ -100,6 +485,32 @@ void ASyn::ChkAckBuf()
       int ss = cd->GetInt(0);
       int played = cd->GetInt(1);
       int total = cd->GetInt(2);
+      // cur if ack is for the segment of the current talk in the sink,
+      // an error means the sink could not find that segment
+      Boolean cur = (talking && segNext>0 &&
+                     (ss==seqnum || ack=="error"))?TRUE:FALSE;
+      Pending sent;
+      if (ack != "finished" && ack != "playing" && !inflight.empty()){
+         sent = inflight.front(); inflight.pop_front();
+      }
+      if (cur){
+         if (ack == "finished"){
+            // end of a segment, start the next or end the talk
+            EndSeg(); Pump();
+            return;
+         }
+         if (ack == "started") {
+            // the first segment to start starts the talk
+            if (!startSent) ReplyStarted();
+            return;
+         }
+      }
+      if (talking && ack == "idle" && sent.ack != "" && ss>=talkSeq){
+         // segment ended before the command arrived, so apply it to
+         // the next segment or between segments
+         pending.push_front(sent); Pump();
+         return;
+      }
       // next construct reply command
       cd = new ACommandData(ack);
       // if intermediate state, then figure out what has been played
@@ -107,58 +518,287 @@ void ASyn::ChkAckBuf()
       if (ack=="aborted" || ack=="muted" || ack=="unmuted"){
          int idx;
          float percent;
-         if (ss==seqnum) {  // still current output utterance
-               //printf("********* p=%d,t=%d,nw=%d,b1=%d,b2=%d\n",
-               //played,total,syn->GetNumWords(),
-               //syn->GetBoundary(1),syn->GetBoundary(2));
-            idx = syn->GetNumWords();
-            while (idx>0 && syn->GetBoundary(idx)>played) --idx;
-            word = "";
-            if (idx>0) word = syn->GetWord(idx);
-            percent = 100.0*played/total;
+         if (cur) {  // still current output utterance
+            Position(played,idx,word,percent);
+            if (ack=="aborted") aborted = TRUE;
+            ss = talkSeq;
          }else{
             idx=0; percent=100.0; word=".";
          }
          cd->AddArg(ss); cd->AddArg(idx);
          cd->AddArg(word); cd->AddArg(percent);
-         if (ack=="aborted") syn->EndUtterance();
          if (trace&T_ABT)
             printf("ASyn: syn interrupted: ss=%d,played=%d,total=%d,idx=%d[%s]\n",
                     ss,played,total,idx,word.c_str());
       }else if (ack == "started") {
          cd->AddArg(ss); cd->AddArg(total);
       }else if (ack == "error" || ack == "finished") {
-         cd->AddArg(ss); syn->EndUtterance();
+         if (cur) ss = talkSeq;
+         cd->AddArg(ss);
       }
-      APacket reppkt(cd);
-      reppkt.SetStartTime(GetTimeNow());
-      reppkt.SetEndTime(GetTimeNow());
-      repbuf->PutPacket(reppkt);
-      if (trace&T_TOP){
-         printf("ASyn: reply sent - "); cd->Show(); printf("\n");
+      Reply(cd);
+      if (cur && ack == "error") { EndTalk(FALSE); Pump(); }
+   }
+}
+
+// Position: word index, word and percent of talk played, given the
+// samples played of the current segment
+void ASyn::Position(int played, int& idx, string& word, float& percent)
+{
+   ASynPrompt& cur = segs[segNext-1].prompt;
+
+   // boundaries are at the synthesiser rate
+   if (rconv != NULL)
+      played = int((double)played*synRate/outRate);
+   idx = cur.GetNumWords();
+   while (idx>0 && cur.GetBoundary(idx)>played) --idx;
+   word = (idx>0)?cur.GetWord(idx):lastWord;
+   idx += segWords;
+   percent = 100.0*(segSamps+played)/EstSamps();
+   if (percent>100.0) percent = 100.0;
+}
+
+// EstSamps: samples in current talk, segments not yet synthesised
+// are estimated from the samples per character of the others
+int ASyn::EstSamps()
+{
+   int n = 0, known = 0, unknown = 0;
+
+   for (size_t i=0; i<segs.size(); i++){
+      if (Ready(segs[i])) {
+         n += segs[i].prompt.nSamps; known += segs[i].text.size();
+      } else
+         unknown += segs[i].text.size();
+   }
+   if (unknown>0 && known>0) n += int((double)n*unknown/known);
+   return (n>0)?n:1;
+}
+
+// CacheKey: key for text, voice settings plus normalised text
+string ASyn::CacheKey(const string& text)
+{
+   string key = ((pool!=NULL)?pool->GetVoiceKey():syn->GetVoiceKey()) + "|";
+   Boolean space = FALSE;
+
+   for (size_t i=0; i<text.size(); i++){
+      if (isspace((unsigned char)text[i])) { space = TRUE; continue; }
+      if (space && key[key.size()-1] != '|') key += ' ';
+      key += text[i]; space = FALSE;
+   }
+   return key;
+}
+
+// Ready: true if s has been synthesised, collecting it from the pool
+Boolean ASyn::Ready(Segment& s)
+{
+   if (!s.ready && s.job != NULL && pool->IsDone(s.job)) {
+      s.prompt = s.job->prompt; s.ready = TRUE;
+      delete s.job; s.job = NULL;
+      if (trace&T_POL)
+         printf("ASyn: pool synthesised %d samples for %s\n",
+                s.prompt.nSamps,s.text.c_str());
+      if (cache != NULL && s.key != "" && s.prompt.nSamps>0)
+         cache->Add(s.key,new ASynPrompt(s.prompt));
+   }
+   return s.ready;
+}
+
+// Synthesise: synthesise s in this thread
+void ASyn::Synthesise(Segment& s)
+{
+   syn->StartUtterance(s.text);
+   s.prompt.Copy(syn,TRUE);
+   syn->EndUtterance();
+   s.ready = TRUE;
+   if (cache != NULL && s.key != "" && s.prompt.nSamps>0)
+      cache->Add(s.key,new ASynPrompt(s.prompt));
+}
+
+// Preload: synthesise each line of the preload file into the cache
+void ASyn::Preload()
+{
+   FILE *f;
+   char buf[MAXSTRLEN];
+   vector<string> texts;
+   Segment s;
+   int n = 0;
+
+   if (cache==NULL || preload=="") return;
+   if ((f=fopen(preload.c_str(),"r")) == NULL){
+      HRError(12010,"ASyn: cannot open preload file %s\n",preload.c_str());
+      return;
+   }
+   while (fgets(buf,MAXSTRLEN,f) != NULL){
+      // cached as they would be split when spoken
+      texts.clear();
+      if (!splitText) texts.push_back(buf);
+      else if (pool != NULL) pool->Split(buf,texts);
+      else syn->Split(buf,texts);
+      for (size_t i=0; i<texts.size(); i++){
+         s.text = texts[i]; s.key = CacheKey(s.text);
+         s.job = NULL; s.ready = FALSE;
+         if (s.key[s.key.size()-1]=='|' || cache->Find(s.key) != NULL) continue;
+         if (pool != NULL) {
+            // cached by ChkPool as the jobs complete
+            s.job = new ASynJob(s.text,HThreadSelf(),POOLBUFID);
+            detached.push_back(s); pool->Submit(s.job);
+         } else
+            Synthesise(s);
+         ++n;
       }
    }
+   fclose(f);
+   if (trace&T_CCH)
+      printf("ASyn: %d prompts %s from %s\n",n,
+             pool?"queued":"synthesised",preload.c_str());
 }
 
-// TalkCmd: synthesise the string and start playing it
+// TalkCmd: split the string into segments, start synthesising them
+// and queue the talk to be played
 void ASyn::TalkCmd()
 {
-   AWaveData *wd;
-   char cbuf[100];
-   short *wave,*p;
-   int size,n;
    string text;
+   vector<string> texts;
+   ASynPrompt *cp;
+   Pending pd;
 
    if (!GetStrArg(text))
       HPostMessage(HThreadSelf(),"TalkCmd: synthesis string expected\n");
    if (trace&T_TOP)
       printf("ASyn: talk request = %s\n",text.c_str());   // convert text to waveform
-   syn->StartUtterance(text);
-   n = syn->GetNumSamples();
+   if (!splitText) texts.push_back(text);
+   else if (pool != NULL) pool->Split(text,texts);
+   else syn->Split(text,texts);
+   pd.segs.resize(texts.size());
+   for (size_t i=0; i<texts.size(); i++){
+      Segment& s = pd.segs[i];
+      s.text = texts[i]; s.job = NULL; s.ready = FALSE;
+      if (cache != NULL) {
+         cp = cache->Find(CacheKey(s.text));
+         if (trace&T_CCH)
+            printf("ASyn: cache %s (%d hits, %d misses) for %s\n",
+                   cp?"hit":"miss",cache->hits,cache->misses,s.text.c_str());
+         if (cp != NULL) {
+            s.prompt = *cp; s.ready = TRUE;
+         } else
+            s.key = CacheKey(s.text);
+      }
+      if (!s.ready && pool != NULL) {
+         s.job = new ASynJob(s.text,HThreadSelf(),POOLBUFID);
+         pool->Submit(s.job);
+      }
+   }
+   if (trace&T_TOP && texts.size()>1)
+      printf("ASyn: talk split into %d segments\n",int(texts.size()));
+   pending.push_back(pd);
+   Pump();
+}
+
+// Pump: start the next segment of the current talk when the sink has
+// finished the last one, end the talk after its last segment, make
+// the next waiting talk current, and pass on sink commands which
+// follow the current talk.  In this thread's synthesiser the next
+// segment is synthesised while the current one plays.
+void ASyn::Pump()
+{
+   Boolean wait;
+
+   while (TRUE) {
+      if (talking && !playing){
+         if (aborted || segNext==int(segs.size())) {
+            EndTalk(TRUE); continue;
+         }
+         Segment& s = segs[segNext];
+         wait = Ready(s)?FALSE:TRUE;
+         if (wait && syn != NULL) { Synthesise(s); wait = FALSE; }
+         if (!wait) {
+            if (s.prompt.nSamps==0 && segs.size()>1) {
+               // nothing to play, skip it unless it is the whole talk
+               string err="TalkCmd: cannot synthesise "+s.text+"\n";
+               HPostMessage(HThreadSelf(),err.c_str());
+               ++segNext;
+            } else
+               StartSeg();
+            continue;
+         }
+      }
+      if (pending.empty()) break;
+      Pending& pd = pending.front();
+      if (pd.segs.size()==0) {
+         if (talking && !playing) LocalCmd(pd); else ToSink(pd);
+         pending.pop_front();
+         continue;
+      }
+      if (talking) break;
+      // the next talk becomes current
+      segs.swap(pd.segs); pending.pop_front();
+      talking = TRUE; playing = aborted = startSent = FALSE;
+      segNext = segWords = segSamps = 0; lastWord = "";
+      talkSeq = seqnum+1;
+   }
+   if (syn != NULL && talking && segNext<int(segs.size()))
+      if (!segs[segNext].ready) Synthesise(segs[segNext]);
+}
+
+// StartSeg: send the next segment of the current talk to the sink
+void ASyn::StartSeg()
+{
+   Segment& s = segs[segNext++];
+
+   if (segNext==1) {
+      talkSeq = seqnum+1; state = synth_talking;
+   }
+   SendWave(s.prompt,s.text,(state==synth_muted)?TRUE:FALSE);
+   playing = TRUE;
+}
+
+// EndSeg: the sink has finished the current segment
+void ASyn::EndSeg()
+{
+   ASynPrompt& p = segs[segNext-1].prompt;
+   int n = p.GetNumWords();
+
+   segWords += n; segSamps += p.nSamps;
+   if (n>0) lastWord = p.GetWord(n);
+   p.wave.clear();
+   playing = FALSE;
+}
+
+// EndTalk: finish with the current talk, and reply finished if reply
+void ASyn::EndTalk(Boolean reply)
+{
+   if (reply) {
+      ACommandData *cd = new ACommandData("finished");
+      cd->AddArg(talkSeq);
+      Reply(cd);
+   }
+   // pool jobs still running are collected and cached by ChkPool
+   for (size_t i=0; i<segs.size(); i++)
+      if (segs[i].job != NULL) detached.push_back(segs[i]);
+   segs.clear();
+   talking = playing = FALSE;
+}
+
+// SendWave: rate convert prompt p and send it to the sink
+void ASyn::SendWave(ASynPrompt& wp, const string& text, Boolean muted)
+{
+   AWaveData *wd;
+   char cbuf[100];
+   int size,n = wp.nSamps;
+   short *p = (n>0)?&wp.wave[0]:NULL;
+   Pending pd;
+
    if (n==0){
       string err="TalkCmd: cannot synthesise "+text+"\n";
       HPostMessage(HThreadSelf(),err.c_str());
    }
+   if (rconv != NULL && n>0){
+      ResetRateConv(rconv);
+      rcbuf.resize(RateConvSize(rconv,n)+RateConvSize(rconv,0));
+      size = RunRateConv(rconv,p,n,&rcbuf[0]);
+      n = size + FlushRateConv(rconv,&rcbuf[size]);
+      p = &rcbuf[0];
+   }
    // packet up the wave and send it to ASource
    // - first create header
    ++seqnum;
@@ -169,7 +809,6 @@ void ASyn::TalkCmd()
    hdrpkt.SetEndTime(GetTimeNow());
    audbuf->PutPacket(hdrpkt);
    // - then chop wave into packets
-   p = syn->GetWave();
    while (n>0){
       size = n;
       if (size>WAVEPACKETSIZE) size = WAVEPACKETSIZE;
@@ -179,31 +818,89 @@ void ASyn::TalkCmd()
       audbuf->PutPacket(wavpkt);
    }
    // - finally send command to start playback
-   sprintf(cbuf,"startout(%d)",seqnum);
-   sink->SendMessage(string(cbuf));
-   state = synth_talking;
+   sprintf(cbuf,muted?"startout(%d,1)":"startout(%d)",seqnum);
+   pd.msg = cbuf; pd.next = state;
+   ToSink(pd);
 }
 
+// ChkPool: collect completed pool jobs
+void ASyn::ChkPool()
+{
+   list<Segment>::iterator i;
+
+   Pump();
+   for (i=detached.begin(); i!=detached.end(); ){
+      if (Ready(*i)) i = detached.erase(i); else ++i;
+   }
+}
+
+// ToSink: send command to the sink
+void ASyn::ToSink(const Pending& pd)
+{
+   sink->SendMessage(pd.msg);
+   inflight.push_back(pd);
+   state = pd.next;
+}
+
+// ReplyStarted: tell the host the current talk has started, giving
+// its estimated length at the output rate
+void ASyn::ReplyStarted()
+{
+   ACommandData *cd = new ACommandData("started");
+
+   cd->AddArg(talkSeq);
+   cd->AddArg(int((double)EstSamps()*outRate/synRate));
+   Reply(cd);
+   startSent = TRUE;
+}
+
+// LocalCmd: apply a sink command which falls between two segments of
+// the current talk, replying as the sink would at the boundary
+void ASyn::LocalCmd(const Pending& pd)
+{
+   ACommandData *cd;
+   float percent = 100.0*segSamps/EstSamps();
+
+   // before any segment has started the host must still see the talk
+   // start before it is interrupted and finishes
+   if (!startSent) ReplyStarted();
+   cd = new ACommandData(pd.ack);
+   cd->AddArg(talkSeq); cd->AddArg(segWords);
+   cd->AddArg(lastWord); cd->AddArg(percent);
+   if (trace&T_ABT)
+      printf("ASyn: syn interrupted between segments: idx=%d[%s]\n",
+             segWords,lastWord.c_str());
+   Reply(cd);
+   state = pd.next;
+   if (pd.ack == "aborted") aborted = TRUE;
+}
+
+// SinkCmd: send msg to sink once talks queued before it have started
+void ASyn::SinkCmd(const string& msg, const string& ack, Synth_State next)
+{
+   Pending pd;
+
+   pd.msg = msg; pd.ack = ack; pd.next = next;
+   pending.push_back(pd);
+   Pump();
+}
 
 // MuteCmd: quiet the output dont kill it
 void ASyn::MuteCmd()
 {
-   sink->SendMessage("muteout()");
-   state = synth_muted;
+   SinkCmd("muteout()","muted",synth_muted);
 }
 
 // ResumeCmd: resume the output to full volume
 void ASyn::UnmuteCmd()
 {
-   sink->SendMessage("unmuteout()");
-   state = synth_unmuted;
+   SinkCmd("unmuteout()","unmuted",synth_unmuted);
 }
 
 // AbortCmd: terminate output
 void ASyn::AbortCmd()
 {
-   sink->SendMessage("abortout()");
-   state = synth_aborted;
+   SinkCmd("abortout()","aborted",synth_aborted);
 }
 
 // Implement the command interface
@@ -225,45 +922,45 @@ void ASyn::ExecCommand(const string & cmdname)
    }
 }
 
-// ASyn task
-TASKTYPE TASKMOD ASyn_Task(void * p)
+// ASyn task: preload the cache and request ack and message events
+void ASyn::TaskInit()
 {
-   ASyn *asp = (ASyn *)p;
-   APacket pkt,mkr;
-   char buf[100],cname[100];
-   HEventRec e;
+   Preload();
+   ackbuf->RequestBufferEvents(ACKBUFID);
+   RequestMessageEvents();
+}
 
-   try{
-      strcpy(cname,asp->cname.c_str());
-      asp->ackbuf->RequestBufferEvents(ACKBUFID);
-      asp->RequestMessageEvents();
-      while (!asp->IsTerminated()){
-         e = HGetEvent(0,0);
-         switch(e.event){
-            case HTBUFFER:
-               switch(e.c){
-                  case MSGEVENTID:
-                     asp->ChkMessage();
-                     while (asp->IsSuspended()) asp->ChkMessage(TRUE);
-                     break;
-                  case ACKBUFID:
-                     asp->ChkAckBuf();
-		               break;
-               } /* switch(e.c) */
+// ASyn task: handle an event
+void ASyn::TaskEvent(HEventRec &e)
+{
+   char buf[100];
+
+   switch(e.event){
+      case HTBUFFER:
+         switch(e.c){
+            case MSGEVENTID:
+               DoMessage();
                break;
-            case HWINCLOSE:
-               sprintf(buf, "terminating");
-               HPostMessage(HThreadSelf(),buf);
-               asp->terminated = TRUE;
+            case ACKBUFID:
+               ChkAckBuf();
                break;
-         }
-      }
-      if (asp->trace&T_TOP) printf("%s synthesiser exiting\n",asp->cname.c_str());
-      HExitThread(0);
-      return 0;
+            case POOLBUFID:
+               ChkPool();
+               break;
+         } /* switch(e.c) */
+         break;
+      case HWINCLOSE:
+         sprintf(buf, "terminating");
+         HPostMessage(HThreadSelf(),buf);
+         terminated = TRUE;
+         break;
    }
-   catch (ATK_Error e){ ReportErrors("ATK",e.i); return 0;}
-   catch (HTK_Error e){ ReportErrors("HTK",e.i); return 0;}
+}
+
+// ASyn task: all done
+void ASyn::TaskExit()
+{
+   if (trace&T_TOP) printf("%s synthesiser exiting\n",cname.c_str());
 }
 
 // ----------------------End of ASyn.cpp ---------------------
@@ -26,6 +26,14 @@
 // Configuration variables (Defaults as shown)
 
 // ASYN: TRACE         = 0             -- trace flag
+// ASYN: CACHESIZE     = 0             -- max prompts cached (0 = no cache)
+// ASYN: CACHESAMPS    = 0             -- max samples cached (0 = no limit)
+// ASYN: CACHEDIR      = ""            -- directory to persist cached prompts
+// ASYN: CACHEPRELOAD  = ""            -- file of prompts to cache at start
+// ASYN: AUDIORATE     = 0             -- output sample period if not synth's
+// ASYN: SPLITTEXT     = T             -- synthesise and play by sentence
+//
+// ASYNPOOL: TRACE     = 0             -- trace flag for pool of that name
 
 #ifndef _ATK_ASyn
 #define _ATK_ASyn
@@ -52,9 +60,112 @@ public:
    // get sample number of end of i'th word
    virtual void EndUtterance()=0;
    // release any storage allocated for current utterance
+   virtual string GetVoiceKey() { return ""; }
+   // settings which change the synthesised output, used in cache keys
+   virtual int GetSampRate() { return 16000; }
+   // sample rate of synthesised waveforms in Hz
+   virtual void Split(const string& text, vector<string>& segs)
+   { segs.push_back(text); }
+   // split text into sentences or phrases to synthesise separately,
+   // must not use the current utterance
    friend class ASyn;
 };
 
+// -------------------------- Prompt Cache ---------------------------
+
+// A synthesised prompt: its waveform and word boundaries
+class ASynPrompt {
+public:
+   ASynPrompt() { nSamps = 0; }
+   void Copy(ASynthesiser *syn, Boolean withWave);
+   // copy the synthesiser's current utterance
+   int GetNumWords() { return int(words.size()); }
+   string GetWord(int i);
+   int GetBoundary(int i);
+   // as the corresponding ASynthesiser functions
+   Boolean Load(const string& fn, const string& key);
+   void Save(const string& fn, const string& key);
+   // read/write binary prompt file, Load fails unless key matches
+   int nSamps;           // number of samples
+   vector<short> wave;   // samples, may be empty if not needed
+   vector<string> words; // words 1..n
+   vector<int> ends;     // sample number of end of each word
+};
+
+// Bounded LRU cache of prompts keyed by voice settings and text
+class ASynCache {
+public:
+   ASynCache(int maxPrompts, int maxSamps, const string& dir);
+   ~ASynCache();
+   ASynPrompt *Find(const string& key);
+   // return prompt for key or NULL, hits become most recent
+   void Add(const string& key, ASynPrompt *p);
+   // add a prompt, the cache takes ownership of p
+   int hits;             // number of Finds satisfied
+   int misses;           // number of Finds not satisfied
+private:
+   typedef list<pair<string,ASynPrompt*> > PromptList;
+   typedef map<string,PromptList::iterator> PromptMap;
+   string FileName(const string& key);
+   void Insert(const string& key, ASynPrompt *p);
+   int maxPrompts;       // max prompts held
+   int maxSamps;         // max total samples held (0 = no limit)
+   int totSamps;         // total samples held
+   string dir;           // directory for persisted prompts ("" = none)
+   PromptList lru;       // most recently used first
+   PromptMap index;      // key -> position in lru
+};
+
+// ------------------------ Synthesis Pool ---------------------------
+
+// A unit of work for an ASynPool: text in, prompt out
+class ASynJob {
+public:
+   ASynJob(const string& t, HThread c, int id)
+   { text = t; client = c; eventId = id; done = FALSE; }
+   string text;          // text to synthesise
+   ASynPrompt prompt;    // result, nSamps==0 if synthesis failed
+   HThread client;       // thread sent a buffer event when done (or NULL)
+   int eventId;          // buffer event id sent to client
+   Boolean done;         // set by the pool once prompt is complete
+};
+
+// A set of worker threads each driving its own synthesiser.  Jobs
+// submitted by any number of ASyn components are taken in order by
+// whichever worker is free.  The synthesisers must be usable from
+// different threads at once, eg FSynthesisers each have their own
+// voice but share the static voice data.
+class ASynPool {
+public:
+   ASynPool(const string& name, const vector<ASynthesiser *>& syns);
+   void Start(HPriority priority=HPRIO_NORM);
+   // start the workers, later calls do nothing
+   void Submit(ASynJob *job);
+   // queue job, the caller owns job but must not delete it until done
+   Boolean IsDone(ASynJob *job);
+   // TRUE once job's prompt is complete
+   void Terminate();
+   // stop the workers after their current jobs and wait for them
+   int NumWorkers() { return int(syns.size()); }
+   string GetVoiceKey() { return syns[0]->GetVoiceKey(); }
+   int GetSampRate() { return syns[0]->GetSampRate(); }
+   void Split(const string& text, vector<string>& segs)
+   { syns[0]->Split(text,segs); }
+   // settings of the synthesisers, which must all be the same
+private:
+   friend TASKTYPE TASKMOD ASynPool_Task(void *p);
+   struct Worker { ASynPool *pool; ASynthesiser *syn; HThread thread; };
+   string name;          // name of pool, used for config and threads
+   vector<ASynthesiser *> syns;  // one synthesiser per worker
+   vector<Worker> workers;
+   list<ASynJob *> queue;        // jobs waiting for a worker
+   HLock lock;           // guards queue, job done flags and terminated
+   HSignal work;         // signalled when a job is queued
+   Boolean started;      // workers have been started
+   Boolean terminated;   // workers must exit
+   int trace;            // trace flag
+};
+
 // ---------------------- ASyn Application Interface -----------------
 
 enum Synth_State {
@@ -70,16 +181,79 @@ public:
   ASyn(){}
   ASyn(const string & name, ABuffer *repb, ABuffer *audb, ABuffer *ackb,
        ASource *asink, ASynthesiser *theSyn);
+  ASyn(const string & name, ABuffer *repb, ABuffer *audb, ABuffer *ackb,
+       ASource *asink, ASynPool *thePool);
+  // synthesise in this component's thread or hand talks to a pool
   void Start(HPriority priority=HPRIO_NORM);
+  // stepped execution
+  Boolean CanSchedule(){return TRUE;}
+  void TaskInit();
+  void TaskEvent(HEventRec &e);
+  void TaskExit();
 private:
-  friend TASKTYPE TASKMOD ASyn_Task(void *p);
+  // a sentence or phrase of a talk, synthesised separately
+  struct Segment {
+     string text;        // segment text
+     string key;         // cache key, "" if not to be cached
+     ASynJob *job;       // pool job until collected (else NULL)
+     ASynPrompt prompt;  // synthesised segment
+     Boolean ready;      // prompt is complete
+  };
+  // a talk waiting its turn, or a command for the sink
+  struct Pending {
+     vector<Segment> segs;  // talk segments (empty for sink command)
+     string msg;         // sink command
+     string ack;         // reply if command falls between segments
+     Synth_State next;   // state after sending msg
+  };
+  void Init(const string & name, ABuffer *repb, ABuffer *audb,
+            ABuffer *ackb, ASource *asink);
   void ExecCommand(const string & cmdname);
   void ChkAckBuf();
   void TalkCmd();       // Interface command messages
   void MuteCmd();
   void UnmuteCmd();
   void AbortCmd();
-  ASynthesiser *syn;    // the actual synthesiser to use
+  void SinkCmd(const string& msg, const string& ack, Synth_State next);
+  void ToSink(const Pending& pd);
+  void Pump();          // start talks, segments and sink commands
+  void StartSeg();      // send next segment of current talk to sink
+  void EndSeg();        // account for a segment the sink has finished
+  void EndTalk(Boolean reply);
+  void LocalCmd(const Pending& pd);
+  void Position(int played, int& idx, string& word, float& percent);
+  int EstSamps();       // estimated samples in current talk
+  Boolean Ready(Segment& s);
+  void Synthesise(Segment& s);
+  void SendWave(ASynPrompt& p, const string& text, Boolean muted);
+  void Reply(ACommandData *cd);
+  void ReplyStarted();  // reply started for the current talk
+  void ChkPool();       // collect completed pool jobs
+  void Preload();       // cache prompts listed in preload file
+  string CacheKey(const string& text);
+  ASynthesiser *syn;    // the actual synthesiser to use (NULL if pool)
+  ASynPool *pool;       // shared synthesiser pool (NULL if syn)
+  Boolean splitText;    // synthesise and play by sentence
+  list<Pending> pending;  // talks and sink commands in issue order
+  list<Pending> inflight; // commands sent to sink awaiting ack
+  list<Segment> detached; // preloads and abandoned pool jobs
+  vector<Segment> segs; // segments of current talk
+  Boolean talking;      // segs is the current talk
+  Boolean playing;      // segment segNext-1 is in the sink
+  Boolean aborted;      // current talk has been aborted
+  Boolean startSent;    // started has been replied for current talk
+  int segNext;          // next segment to send
+  int segWords;         // words in segments already played
+  int segSamps;         // samples in segments already played
+  string lastWord;      // last word of segments already played
+  int talkSeq;          // seqnum of the current talk for the host
+  ASynCache *cache;     // prompt cache (NULL if disabled)
+  string preload;       // file of prompts to cache at start
+  int synRate;          // synthesiser sample rate
+  int outRate;          // audio output sample rate
+  MemHeap rcHeap;       // holds rconv
+  RateConv rconv;       // synth to output rate converter (NULL if same)
+  vector<short> rcbuf;  // converted waveform
   ABuffer *audbuf;      // output wavs to ASource
   ABuffer *ackbuf;      // acks from ASource
   ABuffer *repbuf;      // reply to host
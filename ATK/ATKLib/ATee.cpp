@@ -24,6 +24,7 @@
 char * atee_version="!HVER!ATee: 1.6.0 [SJY 01/06/07]";
 
 //Tee component 1-2 plumbing
+//  19/10/26 - task split into TaskInit/Event for AScheduler
 
 #include "ATee.h"
 #define INBUFID 1
@@ -36,47 +37,39 @@ ATee::ATee(const string &name, ABuffer *inb, ABuffer *outb1, ABuffer *outb2)
   out2=outb2;
 }
 
-TASKTYPE TASKMOD CopyFe(void *p)
+// ATee task: request input and message events
+void ATee::TaskInit()
+{
+  in->RequestBufferEvents(INBUFID);
+  RequestMessageEvents();
+}
+
+// ATee task: copy input packets to both outputs
+void ATee::TaskEvent(HEventRec &e)
 {
-  ATee *acp = (ATee *)p;
   APacket pkt;
-  HEventRec e;
-  try{
-    acp->in->RequestBufferEvents(INBUFID);
-    acp->RequestMessageEvents();
 
-    while(!acp->IsTerminated()){
-      e = HGetEvent(0,0);
-      switch(e.event){
-      case HTBUFFER:
-      	switch(e.c) {
-	case MSGEVENTID:
-	  acp->ChkMessage();
-	  while (acp->IsSuspended()) acp->ChkMessage(TRUE);
-	  break;
-	case INBUFID:
-	  if (! acp->in->IsEmpty()) {
-	    while (! acp->in->IsEmpty()) {
-	      pkt=acp->in->GetPacket();
-	      acp->out1->PutPacket(pkt);
-	      acp->out2->PutPacket(pkt);
-	    }
-	  }
-	  break;
-	}
+  switch(e.event){
+  case HTBUFFER:
+    switch(e.c) {
+    case MSGEVENTID:
+      DoMessage();
+      break;
+    case INBUFID:
+      while (! in->IsEmpty()) {
+	pkt=in->GetPacket();
+	out1->PutPacket(pkt);
+	out2->PutPacket(pkt);
       }
+      break;
     }
-    HExitThread(0);
-    return 0;
   }
-  catch (ATK_Error e){ReportErrors("ATK",e.i); return 0;}
-  catch (HTK_Error e){ReportErrors("HTK",e.i); return 0;}
 }
 
 // Start the task
 void ATee::Start(HPriority priority)
 {
-   AComponent::Start(priority,CopyFe);
+   AComponent::Start(priority,AComponent_Task);
 }
 
 // Implement the command interface
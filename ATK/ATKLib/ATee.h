@@ -31,8 +31,11 @@ class ATee: public AComponent {
  public:
   ATee(const string &name, ABuffer *inb, ABuffer *outb1, ABuffer *outb2);
   void Start(HPriority priority=HPRIO_NORM);
+  // stepped execution
+  Boolean CanSchedule(){return TRUE;}
+  void TaskInit();
+  void TaskEvent(HEventRec &e);
  private:
-  friend TASKTYPE TASKMOD CopyFe(void *p);
   void ExecCommand(const string &cmdname);
   ABuffer *in, *out1, *out2;
 };
@@ -0,0 +1,307 @@
+/* ----------------------------------------------------------- */
+/*                                                             */
+/*                        _ ___                                */
+/*                       /_\ | |_/                             */
+/*                       | | | | \                             */
+/*                       =========                             */
+/*                                                             */
+/*        Real-time API for HTK-base Speech Recognition        */
+/*                                                             */
+/*       Machine Intelligence Laboratory (Speech Group)        */
+/*        Cambridge University Engineering Department          */
+/*                  http://mi.eng.cam.ac.uk/                   */
+/*                                                             */
+/*               Copyright CUED 2000-2007                      */
+/*                                                             */
+/*   Use of this software is governed by a License Agreement   */
+/*    ** See the file License for the Conditions of Use  **    */
+/*    **     This banner notice must not be removed      **    */
+/*                                                             */
+/* ----------------------------------------------------------- */
+/*    File: ATimer.cpp - Shared timers for components          */
+/* ----------------------------------------------------------- */
+
+char * atimer_version="!HVER!ATimer: 1.6.0 [SJY 01/06/07]";
+
+#include "ATimer.h"
+
+#define T_TOP 0001    // top level tracing
+#define T_FIR 0002    // trace timers set, cleared and fired
+
+// wheel geometry: level 0 has 256 slots of 1 tick, levels 1..3 have
+// 64 slots each of 256, 256*64 and 256*64*64 ticks
+#define L0BITS 8
+#define LNBITS 6
+#define L0SIZE (1<<L0BITS)
+#define LNSIZE (1<<LNBITS)
+#define MAXDELTA ((1L<<(L0BITS+3*LNBITS))-1)
+
+// SlotOf: index in slots of slot i of level l
+static inline int SlotOf(int l, int i)
+{
+   return (l==0)?i:L0SIZE+(l-1)*LNSIZE+i;
+}
+
+// ATimerWheel constructor
+ATimerWheel::ATimerWheel(const string& wname)
+{
+   ConfParam *cParm[MAXGLOBS];
+   int i,numParm;
+   char buf[MAXSTRLEN];
+
+   name = wname;
+   strcpy(buf,name.c_str());
+   for (i=0; i<int(strlen(buf)); i++) buf[i] = toupper(buf[i]);
+   numParm = GetConfig(buf, TRUE, cParm, MAXGLOBS);
+   tick = 10; trace = 0;
+   if (numParm>0){
+      if (GetConfInt(cParm,numParm,"TICK",&i)) tick = i;
+      if (GetConfInt(cParm,numParm,"TRACE",&i)) trace = i;
+   }
+   if (tick<1){
+      HRError(10911,"ATimerWheel: %s needs TICK > 0\n",name.c_str());
+      throw ATK_Error(10911);
+   }
+   for (i=0; i<L0SIZE+3*LNSIZE; i++) slots[i] = NULL;
+   strcpy(buf,name.c_str());
+   lock = HCreateLock(buf);
+   strcat(buf,":work");
+   work = HCreateSignal(buf);
+   now = 0; t0 = GetClockNow(); nextId = 1;
+   thread = NULL; started = terminated = FALSE;
+}
+
+// Start the timer thread
+TASKTYPE TASKMOD ATimerWheel_Task(void * p);
+void ATimerWheel::Start(HPriority priority)
+{
+   HEnterSection(lock);
+   if (started) { HLeaveSection(lock); return; }
+   started = TRUE;
+   HLeaveSection(lock);
+   thread = HCreateThread(name.c_str(),1,priority,ATimerWheel_Task,this);
+}
+
+// TickNow: the current tick by the clock
+long ATimerWheel::TickNow()
+{
+   return long((GetClockNow()-t0)*1000.0/tick);
+}
+
+// Insert: put t in the slot for its expiry tick relative to now
+void ATimerWheel::Insert(TimerRec *t)
+{
+   long e = t->expires, d = e - now;
+   int s;
+
+   if (d < 0)
+      s = SlotOf(0,now&(L0SIZE-1));     // overdue, run at next tick
+   else if (d < L0SIZE)
+      s = SlotOf(0,e&(L0SIZE-1));
+   else if (d < 1L<<(L0BITS+LNBITS))
+      s = SlotOf(1,(e>>L0BITS)&(LNSIZE-1));
+   else if (d < 1L<<(L0BITS+2*LNBITS))
+      s = SlotOf(2,(e>>(L0BITS+LNBITS))&(LNSIZE-1));
+   else {
+      if (d > MAXDELTA) t->expires = e = now + MAXDELTA;
+      s = SlotOf(3,(e>>(L0BITS+2*LNBITS))&(LNSIZE-1));
+   }
+   t->slot = s; t->prev = NULL; t->next = slots[s];
+   if (slots[s]!=NULL) slots[s]->prev = t;
+   slots[s] = t;
+}
+
+// Unlink: take t out of its slot
+void ATimerWheel::Unlink(TimerRec *t)
+{
+   if (t->prev!=NULL)
+      t->prev->next = t->next;
+   else
+      slots[t->slot] = t->next;
+   if (t->next!=NULL) t->next->prev = t->prev;
+   t->prev = t->next = NULL;
+}
+
+// Cascade: reinsert the timers of slot index of level, which now
+// fall within the levels below, returns index
+int ATimerWheel::Cascade(int level, int index)
+{
+   int s = SlotOf(level,index);
+   TimerRec *t = slots[s], *next;
+
+   slots[s] = NULL;
+   for (; t!=NULL; t=next){
+      next = t->next;
+      Insert(t);
+   }
+   return index;
+}
+
+// RunTick: run tick now, moving its timers to fired
+void ATimerWheel::RunTick(vector<TimerRec *>& fired)
+{
+   int index = now&(L0SIZE-1), s;
+   TimerRec *t, *next;
+
+   if (index==0 &&
+       Cascade(1,(now>>L0BITS)&(LNSIZE-1))==0 &&
+       Cascade(2,(now>>(L0BITS+LNBITS))&(LNSIZE-1))==0)
+      Cascade(3,(now>>(L0BITS+2*LNBITS))&(LNSIZE-1));
+   s = SlotOf(0,index);
+   t = slots[s]; slots[s] = NULL;
+   for (; t!=NULL; t=next){
+      next = t->next;
+      timers.erase(t->id);
+      fired.push_back(t);
+   }
+   ++now;
+}
+
+// SetTimer: send cmd(id) to buf in msecs
+int ATimerWheel::SetTimer(int msecs, ABuffer *buf, const string& cmd)
+{
+   TimerRec *t = new TimerRec;
+   Boolean wake;
+   int id;
+
+   t->buf = buf; t->cmd = cmd;
+   HEnterSection(lock);
+   id = t->id = nextId++;
+   if (nextId<=0) nextId = 1;
+   // the clock may be ahead of now if the thread was idle
+   if (timers.empty()) now = TickNow();
+   // the first tick at or after the expiry time, so that it is never early
+   t->expires = long(ceil(((GetClockNow()-t0)*1000.0+msecs)/tick));
+   if (t->expires <= now) t->expires = now;
+   Insert(t);
+   wake = timers.empty()?TRUE:FALSE;
+   timers[id] = t;
+   if (wake) HSendSignal(work);
+   HLeaveSection(lock);
+   if (trace&T_FIR) printf("%s: timer %d set for %dms\n",name.c_str(),id,msecs);
+   return id;
+}
+
+// ClearTimer: cancel timer id if pending
+Boolean ATimerWheel::ClearTimer(int id)
+{
+   map<int,TimerRec *>::iterator i;
+   TimerRec *t = NULL;
+
+   HEnterSection(lock);
+   i = timers.find(id);
+   if (i != timers.end()){
+      t = i->second; timers.erase(i);
+      Unlink(t);
+   }
+   HLeaveSection(lock);
+   if (t==NULL) return FALSE;
+   if (trace&T_FIR) printf("%s: timer %d cleared\n",name.c_str(),id);
+   delete t;
+   return TRUE;
+}
+
+// TimeLeft: msecs before timer id expires
+int ATimerWheel::TimeLeft(int id)
+{
+   map<int,TimerRec *>::iterator i;
+   int left = -1;
+
+   HEnterSection(lock);
+   i = timers.find(id);
+   if (i != timers.end()){
+      left = int(i->second->expires - TickNow())*tick;
+      if (left<0) left = 0;
+   }
+   HLeaveSection(lock);
+   return left;
+}
+
+// NumPending: number of timers set and not yet expired
+int ATimerWheel::NumPending()
+{
+   int n;
+
+   HEnterSection(lock);
+   n = timers.size();
+   HLeaveSection(lock);
+   return n;
+}
+
+// Terminate: stop the timer thread and wait for it to exit, so that
+// once this returns no timer can be delivered
+void ATimerWheel::Terminate()
+{
+   HThread t;
+   int status;
+
+   HEnterSection(lock);
+   t = thread; thread = NULL;
+   terminated = TRUE;
+   HSendSignal(work);
+   HLeaveSection(lock);
+   if (t != NULL) HJoinThread(t,&status);
+}
+
+// ATimerWheel destructor: stop the thread and drop pending timers
+ATimerWheel::~ATimerWheel()
+{
+   Terminate();
+   for (map<int,TimerRec *>::iterator i=timers.begin(); i!=timers.end(); i++)
+      delete i->second;
+}
+
+// ATimerWheel task: while timers are pending, wake at each tick and
+// run the ticks due by the clock, else wait for a timer to be set.
+// Commands are sent outside the lock since buffers may block.
+TASKTYPE TASKMOD ATimerWheel_Task(void * p)
+{
+   ATimerWheel *tw = (ATimerWheel *)p;
+   vector<ATimerWheel::TimerRec *> fired;
+   ATimerWheel::TimerRec *t;
+   long due;
+   int i,wait;
+
+   try{
+      if (tw->trace&T_TOP) printf("%s: timer thread started\n",tw->name.c_str());
+      HEnterSection(tw->lock);
+      while (!tw->terminated){
+         if (tw->timers.empty()){
+            HWaitSignal(tw->work,tw->lock);
+            continue;
+         }
+         // sleep until tick now is due
+         wait = int(ceil(tw->now*tw->tick - (GetClockNow()-tw->t0)*1000.0));
+         HLeaveSection(tw->lock);
+         if (wait>0) HPauseThread(wait);
+         HEnterSection(tw->lock);
+         due = tw->TickNow();
+         while (tw->now <= due && !tw->timers.empty())
+            tw->RunTick(fired);
+         if (fired.empty()) continue;
+         HLeaveSection(tw->lock);
+         for (i=0; i<int(fired.size()); i++){
+            t = fired[i];
+            if (tw->trace&T_FIR)
+               printf("%s: timer %d fired\n",tw->name.c_str(),t->id);
+            ACommandData *cd = new ACommandData(t->cmd);
+            cd->AddArg(t->id);
+            APacket pkt(cd);
+            pkt.SetStartTime(GetTimeNow());
+            pkt.SetEndTime(GetTimeNow());
+            t->buf->PutPacket(pkt);
+            delete t;
+         }
+         fired.clear();
+         HEnterSection(tw->lock);
+      }
+      HLeaveSection(tw->lock);
+      if (tw->trace&T_TOP) printf("%s: timer thread exiting\n",tw->name.c_str());
+      HExitThread(0);
+      return 0;
+   }
+   catch (ATK_Error e){ ReportErrors("ATK",e.i); return 0;}
+   catch (HTK_Error e){ ReportErrors("HTK",e.i); return 0;}
+}
+
+// ------------------------ End ATimer.cpp ---------------------
@@ -0,0 +1,104 @@
+/* ----------------------------------------------------------- */
+/*                                                             */
+/*                        _ ___                                */
+/*                       /_\ | |_/                             */
+/*                       | | | | \                             */
+/*                       =========                             */
+/*                                                             */
+/*        Real-time API for HTK-base Speech Recognition        */
+/*                                                             */
+/*       Machine Intelligence Laboratory (Speech Group)        */
+/*        Cambridge University Engineering Department          */
+/*                  http://mi.eng.cam.ac.uk/                   */
+/*                                                             */
+/*               Copyright CUED 2000-2007                      */
+/*                                                             */
+/*   Use of this software is governed by a License Agreement   */
+/*    ** See the file License for the Conditions of Use  **    */
+/*    **     This banner notice must not be removed      **    */
+/*                                                             */
+/* ----------------------------------------------------------- */
+/*    File: ATimer.h - Shared timers for components            */
+/* ----------------------------------------------------------- */
+
+/* !HVER!ATimer: 1.6.0 [SJY 01/06/07] */
+
+// Configuration variables (Defaults as shown)
+
+// ATIMER: TICK          = 10            -- resolution in msecs
+// ATIMER: TRACE         = 0             -- trace flag
+
+// An ATimerWheel holds the timers of any number of components and
+// runs them from a single thread.  A timer is set with a period, a
+// buffer and a command name; when it expires a command packet with
+// that name and the timer id as its one argument is put in the
+// buffer, so a component handles its timeouts along with the rest
+// of its input.  A timer which is cleared before it expires sends
+// nothing, but one which has just expired may already be in the
+// buffer, so components should check the id.
+//
+// Fired timers are delivered by the thread after it has released the
+// wheel's lock, so a timer may still be put in its buffer after
+// ClearTimer has returned FALSE.  A buffer must therefore outlive the
+// wheel's thread, ie stay valid until Terminate has returned (which
+// waits for the thread to exit) or the wheel has been deleted.
+//
+// The timers are kept in a hierarchical wheel: 256 slots of one
+// tick then 3 levels of 64 slots each covering 64 times the one
+// before, so setting and clearing a timer cost the same however
+// many are pending.  Periods beyond the last level (about 7.7 days
+// with 10ms ticks) are cut to fit.  The thread only wakes each tick
+// while timers are pending.
+
+#ifndef _ATK_TIMER
+#define _ATK_TIMER
+
+#include "ABuffer.h"
+
+class ATimerWheel {
+public:
+   ATimerWheel(const string& name);
+   ~ATimerWheel();
+   // terminates the thread and drops pending timers
+   void Start(HPriority priority=HPRIO_NORM);
+   // start the timer thread, later calls do nothing
+   int SetTimer(int msecs, ABuffer *buf, const string& cmd);
+   // send cmd(id) to buf in msecs, returns the timer id (>0)
+   Boolean ClearTimer(int id);
+   // cancel timer id, FALSE if it has expired or is unknown
+   int TimeLeft(int id);
+   // msecs before timer id expires, -1 if it is not pending
+   int NumPending();
+   void Terminate();
+   // stop the timer thread and wait for it, pending timers are dropped
+private:
+   friend TASKTYPE TASKMOD ATimerWheel_Task(void *p);
+   struct TimerRec {
+      int id;
+      long expires;              // tick at which it expires
+      ABuffer *buf;              // where to send cmd
+      string cmd;
+      int slot;                  // index in slots
+      TimerRec *prev, *next;     // slot list
+   };
+   void Insert(TimerRec *t);     // put t in its slot
+   void Unlink(TimerRec *t);     // take t out of its slot
+   int Cascade(int level, int index);   // move slot down a level
+   void RunTick(vector<TimerRec *>& fired);  // expire timers of tick now
+   long TickNow();               // current tick by the clock
+   string name;
+   TimerRec *slots[256+3*64];    // level 0 then levels 1..3
+   map<int,TimerRec *> timers;   // pending timers by id
+   long now;                     // next tick to run
+   double t0;                    // clock time of tick 0
+   int tick;                     // msecs per tick
+   int nextId;
+   HLock lock;                   // guards all of the above
+   HSignal work;                 // sent when the first timer is set
+   HThread thread;
+   Boolean started, terminated;
+   int trace;
+};
+
+#endif
+/*  -------------------- End of ATimer.h --------------------- */
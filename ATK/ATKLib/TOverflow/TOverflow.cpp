@@ -0,0 +1,129 @@
+/* ----------------------------------------------------------- */
+/*                                                             */
+/*                        _ ___                                */
+/*                       /_\ | |_/                             */
+/*                       | | | | \                             */
+/*                       =========                             */
+/*                                                             */
+/*        Real-time API for HTK-base Speech Recognition        */
+/*                                                             */
+/*       Machine Intelligence Laboratory (Speech Group)        */
+/*        Cambridge University Engineering Department          */
+/*                  http://mi.eng.cam.ac.uk/                   */
+/*                                                             */
+/*               Copyright CUED 2000-2007                      */
+/*                                                             */
+/*   Use of this software is governed by a License Agreement   */
+/*    ** See the file License for the Conditions of Use  **    */
+/*    **     This banner notice must not be removed      **    */
+/*                                                             */
+/* ----------------------------------------------------------- */
+/*   File: TOverflow.cpp - Test buffer overflow policies       */
+/* ----------------------------------------------------------- */
+
+
+static const char * version="!HVER!TOverflow: 1.6.0 [SJY 01/06/07]";
+
+#include "ABuffer.h"
+
+// A live source puts a wave packet into the buffer every prodMs
+// msecs, and a marker after every markGap of them, and must not
+// stall, while the consumer takes consMs msecs over each packet
+
+static ABuffer *live;              // the buffer under test
+static int consMs;                 // consumer msecs per packet
+static volatile Boolean done;      // the source has finished
+static int got, overloads;         // packets taken, overloads seen
+static int marks;                  // markers taken
+static const int markGap = 10;     // wave packets between markers
+static HTime streamIn;             // duration of packets taken
+
+TASKTYPE TASKMOD Consumer_Task(void *p)
+{
+   APacket pkt;
+
+   for (;;){
+      if (live->IsEmpty()){
+         if (done) break;
+         HPauseThread(1); continue;
+      }
+      pkt = live->GetPacket();
+      if (pkt.GetKind() == StringPacket) ++marks;
+      else {
+         ++got; streamIn += pkt.GetEndTime() - pkt.GetStartTime();
+      }
+      if (live->Overloaded()) ++overloads;
+      HPauseThread(consMs);
+   }
+   HExitThread(0);
+   return 0;
+}
+
+void ReportUsage(void)
+{
+   printf("\nUSAGE: TOverflow [-C cfg] nPkts prodMs consMs\n");
+   exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+   const char *names[] = {"block","dropoldest","dropnewest","coalesce","overload"};
+   int nPkts,prodMs,k,status,lost = 0;
+   double t,put,maxPut;
+   ABufferStats st;
+   HThread consumer;
+
+   if (InitHTK(argc,argv,version,TRUE)<SUCCESS){
+      ReportErrors("Main",0); exit(-1);
+   }
+   if (NumArgs() != 3) ReportUsage();
+   nPkts = GetChkedInt(1,100000,"nPkts");
+   prodMs = GetChkedInt(1,1000,"prodMs");
+   consMs = GetChkedInt(0,1000,"consMs");
+
+   try {
+      // the size of the buffer is LIVE: MAXPKTS
+      live = new ABuffer("live");
+      printf("TOverflow: %d packets every %dms, consumer takes %dms each\n",
+             nPkts,prodMs,consMs);
+      printf("%-10s %8s %6s %6s %6s %6s %6s %7s %8s %6s\n","policy","maxput",
+             "got","drop","merge","over","hiwat","signals","stream","marks");
+      for (int pol=BlockOnFull; pol<=SignalOverload; pol++){
+         live->SetOverflow((OverflowPolicy)pol);
+         live->GetStats(st,TRUE);
+         long drop0 = st.dropped, merge0 = st.coalesced, over0 = st.overloads;
+         done = FALSE; got = overloads = marks = 0; streamIn = 0;
+         consumer = HCreateThread("consumer",1,HPRIO_NORM,Consumer_Task,0);
+         maxPut = 0.0;
+         for (k=0; k<nPkts; k++){
+            AWaveData *w = new AWaveData();
+            w->wused = WAVEPACKETSIZE/2;  // two fit in a merged packet
+            APacket pkt(w);
+            pkt.SetStartTime(k*prodMs*1e4); pkt.SetEndTime((k+1)*prodMs*1e4);
+            t = GetClockNow();
+            live->PutPacket(pkt);
+            put = GetClockNow() - t;
+            if (put > maxPut) maxPut = put;
+            if ((k+1)%markGap == 0){
+               // markers are never dropped
+               APacket mark(new AStringData("mark"));
+               live->PutPacket(mark);
+            }
+            HPauseThread(prodMs);
+         }
+         done = TRUE;
+         HJoinThread(consumer,&status);
+         live->GetStats(st,TRUE);
+         printf("%-10s %6.1fms %6d %6ld %6ld %6ld %6d %7d %7.2fs %6d\n",names[pol],
+                maxPut*1000,got,st.dropped-drop0,st.coalesced-merge0,
+                st.overloads-over0,st.hiwater,overloads,streamIn/1e7,marks);
+         lost += nPkts/markGap - marks;
+      }
+      printf("TOverflow: %.2fs of audio and %d markers put by each\n",
+             nPkts*prodMs/1000.0,nPkts/markGap);
+      if (lost>0) printf("TOverflow: %d markers lost\n",lost);
+   }
+   catch (ATK_Error e){ ReportErrors("ATK",e.i); }
+   catch (HTK_Error e){ ReportErrors("HTK",e.i); }
+   return 0;
+}
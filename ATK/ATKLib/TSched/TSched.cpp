@@ -0,0 +1,200 @@
+/* ----------------------------------------------------------- */
+/*                                                             */
+/*                        _ ___                                */
+/*                       /_\ | |_/                             */
+/*                       | | | | \                             */
+/*                       =========                             */
+/*                                                             */
+/*        Real-time API for HTK-base Speech Recognition        */
+/*                                                             */
+/*       Machine Intelligence Laboratory (Speech Group)        */
+/*        Cambridge University Engineering Department          */
+/*                  http://mi.eng.cam.ac.uk/                   */
+/*                                                             */
+/*               Copyright CUED 2000-2007                      */
+/*                                                             */
+/*   Use of this software is governed by a License Agreement   */
+/*    ** See the file License for the Conditions of Use  **    */
+/*    **     This banner notice must not be removed      **    */
+/*                                                             */
+/* ----------------------------------------------------------- */
+/*     File: TSched.cpp -     Test the component scheduler     */
+/* ----------------------------------------------------------- */
+
+
+static const char * version="!HVER!TSched: 1.6.0 [SJY 01/06/07]";
+
+#include "AComponent.h"
+#include "AScheduler.h"
+#include "ATee.h"
+#include "AMonitor.h"
+
+//=============================================================
+//  A relay component: copies packets from its input buffer to
+//  its output buffer.  It supports stepped execution so it can
+//  run in a thread of its own or as a task of a scheduler.
+//=============================================================
+
+#define INBUFID 1
+
+class ARelay: public AComponent {
+public:
+   ARelay(const string & name, ABuffer *inb, ABuffer *outb);
+   void Start(HPriority priority=HPRIO_NORM);
+   Boolean CanSchedule(){return TRUE;}
+   void TaskInit();
+   void TaskEvent(HEventRec &e);
+   int count;           // packets relayed
+private:
+   void ExecCommand(const string & cmdname){}
+   ABuffer *in;
+   ABuffer *out;
+};
+
+ARelay::ARelay(const string & name, ABuffer *inb, ABuffer *outb)
+: AComponent(name,1)
+{
+   in = inb; out = outb; count = 0;
+}
+
+void ARelay::Start(HPriority priority)
+{
+   AComponent::Start(priority,AComponent_Task);
+}
+
+void ARelay::TaskInit()
+{
+   in->RequestBufferEvents(INBUFID);
+   RequestMessageEvents();
+}
+
+void ARelay::TaskEvent(HEventRec &e)
+{
+   APacket pkt;
+
+   if (e.event != HTBUFFER) return;
+   if (e.c == MSGEVENTID)
+      DoMessage();
+   else if (e.c == INBUFID){
+      while (!in->IsEmpty()){
+         pkt = in->GetPacket(); ++count;
+         out->PutPacket(pkt);
+      }
+   }
+}
+
+//---------- Main: build pipelines and pass packets ------------
+
+// Each pipeline is nStages relays followed by a tee into two sinks
+void ReportUsage(void)
+{
+   printf("\nUSAGE: TSched [-C cfg] [-m] mode nPipes nStages nPkts\n");
+   printf("   mode 0 gives each component a thread\n");
+   printf("   mode 1 runs them on a scheduler (see ASCHED: NUMWORKERS)\n");
+   printf("   -m monitors the components (see AMONITOR: STATSFILE)\n");
+   exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+   int mode,nPipes,nStages,nPkts,nComps,nThreads;
+   int i,j,k,lost;
+   double t0,t;
+   char buf[100],*s;
+   Boolean monitor = FALSE;
+
+   if (InitHTK(argc,argv,version,TRUE)<SUCCESS){
+      ReportErrors("Main",0); exit(-1);
+   }
+   while (NextArg() == SWITCHARG) {
+      s = GetSwtArg();
+      if (strcmp(s,"m")==0) monitor = TRUE;
+      else ReportUsage();
+   }
+   if (NumArgs() != 4) ReportUsage();
+   mode = GetChkedInt(0,1,"mode");
+   nPipes = GetChkedInt(1,1000,"nPipes");
+   nStages = GetChkedInt(1,100,"nStages");
+   nPkts = GetChkedInt(1,1000000,"nPkts");
+
+   try {
+      AScheduler sched("ASCHED");
+      AMonitor *amon = NULL;
+      vector<ABuffer *> bufs;
+      vector<AComponent *> comps;
+      vector<ABuffer *> srcs, sinks;
+      vector<ARelay *> relays;
+      vector<ATee *> tees;
+      ABuffer *in,*out,*out2;
+
+      // Create pipelines, buffers are unbounded since scheduled
+      // components must not block
+      for (i=0; i<nPipes; i++){
+         sprintf(buf,"src%d",i);
+         in = new ABuffer(buf); srcs.push_back(in);
+         for (j=0; j<nStages; j++){
+            sprintf(buf,"p%d.%d",i,j);
+            out = new ABuffer(buf); bufs.push_back(out);
+            sprintf(buf,"relay%d.%d",i,j);
+            ARelay *r = new ARelay(buf,in,out);
+            relays.push_back(r); comps.push_back(r);
+            in = out;
+         }
+         sprintf(buf,"sink%d.a",i);
+         out = new ABuffer(buf); sinks.push_back(out);
+         sprintf(buf,"sink%d.b",i);
+         out2 = new ABuffer(buf); sinks.push_back(out2);
+         sprintf(buf,"tee%d",i);
+         ATee *tee = new ATee(buf,in,out,out2);
+         tees.push_back(tee); comps.push_back(tee);
+      }
+      nComps = comps.size();
+      if (mode==1)
+         for (k=0; k<nComps; k++) comps[k]->SetScheduler(&sched);
+      for (k=0; k<int(relays.size()); k++) relays[k]->Start();
+      for (k=0; k<int(tees.size()); k++) tees[k]->Start();
+      if (monitor){
+         amon = new AMonitor;
+         for (k=0; k<nComps; k++) amon->AddComponent(comps[k]);
+         for (i=0; i<nPipes; i++) amon->AddBuffer(srcs[i]);
+         for (k=0; k<int(bufs.size()); k++) amon->AddBuffer(bufs[k]);
+         for (k=0; k<int(sinks.size()); k++) amon->AddBuffer(sinks[k]);
+         amon->Start();
+      }
+      nThreads = (mode==1)?sched.NumWorkers():nComps;
+      printf("TSched: %d pipelines of %d stages, %d components on %d threads\n",
+             nPipes,nStages,nComps,nThreads);
+      fflush(stdout);
+
+      // Pass nPkts packets down each pipeline and wait for them
+      t0 = GetClockNow();
+      for (k=0; k<nPkts; k++)
+         for (i=0; i<nPipes; i++){
+            APacket p(new AStringData("x"));
+            srcs[i]->PutPacket(p);
+         }
+      for (i=0; i<int(sinks.size()); i++)
+         for (k=0; k<nPkts; k++) sinks[i]->GetPacket();
+      t = GetClockNow() - t0;
+
+      // Shut down
+      for (k=0; k<nComps; k++) comps[k]->SendMessage("terminate()");
+      for (k=0; k<nComps; k++) comps[k]->Join();
+      lost = 0;
+      for (k=0; k<int(relays.size()); k++)
+         if (relays[k]->count != nPkts) ++lost;
+      printf("TSched: %d packets in %.3f secs, %.2f usecs per packet per stage\n",
+             nPipes*nPkts,t,t*1e6/(nPipes*nPkts*(nStages+1)));
+      printf("TSched: %d relays with missing packets\n",lost);
+      if (mode==1){
+         sched.PrintStats(stdout);
+         sched.Terminate();
+      }
+      if (monitor){
+         amon->Terminate(); HJoinMonitor();
+      }
+   }
+   catch (ATK_Error e){ ReportErrors("ATK",e.i); }
+   catch (HTK_Error e){ ReportErrors("HTK",e.i); }
+   return 0;
+}
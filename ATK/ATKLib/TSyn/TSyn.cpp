@@ -31,6 +31,8 @@ static int seqnum = 0;         // current output message seq number
 static ASource *asrc;          // the source/sink component
 static ASyn *asyn;             // the synthesiser
 static FSynthesiser *synDevice;// flite synthesiser
+static ASynPool *synPool;      // or a pool of them if synWorkers>0
+static int synWorkers = 0;     // synthesiser pool workers
 static ABuffer *adcToMain;     // sampled input data from ADC
 static ABuffer *synToSink;     // sampled output data to DAC
 static ABuffer *sinkToSyn;     // ack channel from sink to syn
@@ -90,6 +92,31 @@ void GetAck(string& ack)
    printf("TSyn: ack rxed - "); cd->Show(); printf("\n");
 }
 
+// EarlyAbort: abort a talk as soon as it is sent, which with a pool
+// is before its first sentence can have started, and check that the
+// replies are still started, aborted then finished
+void EarlyAbort()
+{
+   string ack, acks;
+
+   printf("TSyn: aborting a talk before it starts\n");
+   asyn->SendMessage("talk(This talk is aborted. It should never be heard.)");
+   asyn->SendMessage("abort()");
+   do {
+      GetAck(ack); acks += ack + " ";
+   } while (ack != "finished" && ack != "error");
+   if (acks == "started aborted finished ")
+      printf("TSyn: early abort ok\n");
+   else
+      printf("TSyn: early abort replies were %s\n",acks.c_str());
+}
+
+void ReportUsage(void)
+{
+   printf("\nUSAGE: TSyn [-C cfg] [synWorkers]\n");
+   exit(1);
+}
+
 void RandWait(int n)
 {
    int w = RandomValue()*n;
@@ -112,6 +139,8 @@ int main(int argc, char *argv[])
       // if (NCInitHTK("TSource.cfg",version)<SUCCESS){
          ReportErrors("Main",0); exit(-1);
       }
+      if (NumArgs() > 1) ReportUsage();
+      if (NumArgs() == 1) synWorkers = GetChkedInt(1,16,"synWorkers");
       printf("TSyn: Synthesiser Test\n");
 
        // Create Buffers
@@ -127,8 +156,15 @@ int main(int argc, char *argv[])
       asrc = new ASource("ASource",adcToMain);
 
       // Create Synthesiser
-      synDevice = new FSynthesiser();
-      asyn = new ASyn("ASyn", synToMain, synToSink, sinkToSyn, asrc, synDevice);
+      if (synWorkers>0){
+         vector<ASynthesiser *> syns;
+         for (int i=0; i<synWorkers; i++) syns.push_back(new FSynthesiser());
+         synPool = new ASynPool("asynpool",syns);
+         asyn = new ASyn("ASyn", synToMain, synToSink, sinkToSyn, asrc, synPool);
+      } else {
+         synDevice = new FSynthesiser();
+         asyn = new ASyn("ASyn", synToMain, synToSink, sinkToSyn, asrc, synDevice);
+      }
 
       // Create Monitor and Start it
       AMonitor amon;
@@ -140,7 +176,9 @@ int main(int argc, char *argv[])
       state = prompting; printf("   state->prompting\n");
       printf("Starting Synthesiser Test\n");
       asrc->Start();
+      if (synPool != NULL) synPool->Start();
       asyn->Start();
+      EarlyAbort();
       SendOutput("Please provide input");
       RandWait(1000);
       asrc->SendMessage("start()");
@@ -193,6 +231,7 @@ int main(int argc, char *argv[])
       }
       asrc->Join();
       asyn->Join();
+      if (synPool != NULL) synPool->Terminate();
       // Shutdown
       printf("Waiting for monitor\n");fflush(stdout);
       amon.Terminate();
@@ -0,0 +1,112 @@
+/* ----------------------------------------------------------- */
+/*                                                             */
+/*                        _ ___                                */
+/*                       /_\ | |_/                             */
+/*                       | | | | \                             */
+/*                       =========                             */
+/*                                                             */
+/*        Real-time API for HTK-base Speech Recognition        */
+/*                                                             */
+/*       Machine Intelligence Laboratory (Speech Group)        */
+/*        Cambridge University Engineering Department          */
+/*                  http://mi.eng.cam.ac.uk/                   */
+/*                                                             */
+/*               Copyright CUED 2000-2007                      */
+/*                                                             */
+/*   Use of this software is governed by a License Agreement   */
+/*    ** See the file License for the Conditions of Use  **    */
+/*    **     This banner notice must not be removed      **    */
+/*                                                             */
+/* ----------------------------------------------------------- */
+/*     File: TTimer.cpp -     Test the shared timer wheel      */
+/* ----------------------------------------------------------- */
+
+
+static const char * version="!HVER!TTimer: 1.6.0 [SJY 01/06/07]";
+
+#include "ATimer.h"
+
+void ReportUsage(void)
+{
+   printf("\nUSAGE: TTimer [-C cfg] nTimers maxMsecs nPending\n");
+   exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+   int nTimers,maxMsecs,nPending;
+   int i,id,n,early,wrong,left,badLeft;
+   double t,late,maxLate,sumLate;
+
+   if (InitHTK(argc,argv,version,TRUE)<SUCCESS){
+      ReportErrors("Main",0); exit(-1);
+   }
+   if (NumArgs() != 3) ReportUsage();
+   nTimers = GetChkedInt(2,100000,"nTimers");
+   maxMsecs = GetChkedInt(1,10000000,"maxMsecs");
+   nPending = GetChkedInt(0,10000000,"nPending");
+
+   try {
+      // buf is declared first so that it outlives the wheel's thread
+      ABuffer buf("timeouts");
+      ATimerWheel wheel("ATIMER");
+      vector<double> due(nTimers+1,0.0);
+      vector<int> ids(nTimers);
+      map<int,int> which;
+
+      wheel.Start();
+
+      // 1. Set nTimers timers with random periods, clear every other one
+      // and check the rest expire on time and once only
+      RandInit(1);
+      for (i=0; i<nTimers; i++){
+         int ms = int(RandomValue()*maxMsecs);
+         ids[i] = wheel.SetTimer(ms,&buf,"timeout");
+         due[i] = GetClockNow() + ms/1000.0;
+         which[ids[i]] = i;
+      }
+      badLeft = 0;
+      for (i=0; i<nTimers; i+=2){
+         left = wheel.TimeLeft(ids[i]);
+         if (left > maxMsecs+20) ++badLeft;
+         wheel.ClearTimer(ids[i]);
+      }
+      printf("TTimer: %d timers up to %dms, %d cleared\n",
+             nTimers,maxMsecs,(nTimers+1)/2);
+      fflush(stdout);
+      n = early = wrong = 0; maxLate = sumLate = 0.0;
+      while (n < nTimers/2){
+         APacket p = buf.GetPacket();
+         t = GetClockNow();
+         ACommandData *cd = (ACommandData *)p.GetData();
+         id = cd->GetInt(0);
+         if (which.find(id)==which.end() || which[id]%2==0) { ++wrong; continue; }
+         i = which[id]; which.erase(id);
+         late = t - due[i];
+         if (late < -0.001) ++early;
+         if (late > maxLate) maxLate = late;
+         sumLate += late; ++n;
+      }
+      printf("TTimer: %d expired, %d early, %d wrong, %d bad TimeLeft\n",
+             n,early,wrong,badLeft);
+      printf("TTimer: lateness mean %.1fms max %.1fms\n",
+             sumLate*1000/n,maxLate*1000);
+      if (!buf.IsEmpty() || wheel.NumPending()!=0)
+         printf("TTimer: %d unexpected timeouts, %d pending\n",
+                buf.NumPackets(),wheel.NumPending());
+
+      // 2. Time setting and clearing a timer with nPending others
+      for (i=0; i<nPending; i++)
+         wheel.SetTimer(3600000+i,&buf,"timeout");
+      t = GetClockNow();
+      for (i=0; i<100000; i++)
+         wheel.ClearTimer(wheel.SetTimer(1000+i%100000,&buf,"timeout"));
+      t = GetClockNow() - t;
+      printf("TTimer: %d pending, %.3f usecs per set/clear\n",
+             wheel.NumPending(),t*1e6/100000);
+      wheel.Terminate();
+   }
+   catch (ATK_Error e){ ReportErrors("ATK",e.i); }
+   catch (HTK_Error e){ ReportErrors("HTK",e.i); }
+   return 0;
+}
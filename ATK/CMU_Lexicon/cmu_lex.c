@@ -47,6 +47,9 @@ extern const int cmu_num_entries;
 extern const char * const cmu_phone_table[54];
 extern const cst_lts_rules cmu6_lts_rules;
 
+/* Number of out of vocabulary words whose LTS results are kept */
+#define CMU_LTS_CACHE 1024
+
 static int cmu_is_vowel(const char *p);
 static int cmu_is_silence(const char *p);
 static int cmu_has_vowel_in_list(const cst_val *v);
@@ -236,4 +239,5 @@ void cmu_lex_init()
     cmu_lex.syl_boundary = cmu_syl_boundary;
     cmu_lex.addenda = (char ***) addenda;
     cmu_lex.lts_rule_set = (cst_lts_rules *) &cmu6_lts_rules;
+    lex_build_index(&cmu_lex,CMU_LTS_CACHE);
 }
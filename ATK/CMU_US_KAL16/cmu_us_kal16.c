@@ -40,6 +40,7 @@
 
 #include "flite.h"
 #include "cst_diphone.h"
+#include "cst_voxfile.h"
 #include "usenglish.h"
 #include "cmulex.h"
 
@@ -48,9 +49,36 @@ extern cst_diphone_db cmu_us_kal_db;
 
 cst_voice *cmu_us_kal_diphone = NULL;
 
+/* The voice file, mapped once and kept for the life of the process */
+static cst_voxfile *cmu_us_kal_vox = NULL;
+
+/* The diphone db in voxdir/cmu_us_kal16.vox, else the compiled in one */
+static cst_diphone_db *cmu_us_kal_get_db(const char *voxdir)
+{
+    char *path;
+
+    if (cmu_us_kal_vox == NULL && voxdir != NULL && *voxdir != '\0')
+    {
+	path = cst_alloc(char,strlen(voxdir)+20);
+	sprintf(path,"%s/cmu_us_kal16.vox",voxdir);
+	cmu_us_kal_vox = cst_vox_open(path);
+	if (cmu_us_kal_vox && cst_vox_diphone_db(cmu_us_kal_vox) == NULL)
+	{
+	    cst_errmsg("cmu_us_kal16: %s is not a diphone voice\n",path);
+	    cst_vox_close(cmu_us_kal_vox);
+	    cmu_us_kal_vox = NULL;
+	}
+	cst_free(path);
+    }
+    if (cmu_us_kal_vox)
+	return cst_vox_diphone_db(cmu_us_kal_vox);
+    return &cmu_us_kal_db;
+}
+
 cst_voice *register_cmu_us_kal16(const char *voxdir)
 {
     cst_voice *v = new_voice();
+    cst_diphone_db *db = cmu_us_kal_get_db(voxdir);
 
     usenglish_init(v);
 
@@ -73,11 +101,15 @@ cst_voice *register_cmu_us_kal16(const char *voxdir)
 
     /* Waveform synthesis: diphone_synth */
     feat_set(v->features,"wave_synth_func",uttfunc_val(&diphone_synth));
-    feat_set(v->features,"diphone_db",diphone_db_val(&cmu_us_kal_db));
-    feat_set_int(v->features,"sample_rate",cmu_us_kal_db.sts->sample_rate);
     feat_set_string(v->features,"resynth_type","fixed");
     feat_set_string(v->features,"join_type","modified_lpc");
 
+    /* Parameters saved with the voice file override the above */
+    if (db != &cmu_us_kal_db)
+	feat_copy_into(cst_vox_features(cmu_us_kal_vox),v->features);
+    feat_set(v->features,"diphone_db",diphone_db_val(db));
+    feat_set_int(v->features,"sample_rate",db->sts->sample_rate);
+
     cmu_us_kal_diphone = v;
 
     return cmu_us_kal_diphone;
@@ -91,6 +123,17 @@ void unregister_cmu_us_kal16(cst_voice *v)
     cmu_us_kal_diphone = NULL;
 }
 
+int save_cmu_us_kal16(const char *path)
+{
+    /* Saves the compiled in db with the voice's scalar parameters */
+    cst_voice *v = register_cmu_us_kal16(NULL);
+    int rv;
+
+    rv = cst_vox_save_diphone_db(path,&cmu_us_kal_db,v->features);
+    unregister_cmu_us_kal16(v);
+    return rv;
+}
+
 static void fix_ah(cst_utterance *u)
 {
     /* This should really be done in the index itself */
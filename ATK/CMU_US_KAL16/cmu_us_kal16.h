@@ -14,6 +14,10 @@ extern "C" {
 cst_voice *register_cmu_us_kal16(const char *voxdir);
 cst_voice *unregister_cmu_us_kal16(cst_voice *vox);
 
+/* Write the compiled in voice to a voice file which register    */
+/* loads (as voxdir/cmu_us_kal16.vox) in place of the linked db  */
+int save_cmu_us_kal16(const char *path);
+
 #ifdef __cplusplus
 };
 #endif
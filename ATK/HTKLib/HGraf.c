@@ -43,6 +43,9 @@
 char *hgraf_version = "!HVER!HGraf: 1.6.0 [SJY 01/06/07]";
 
 /* HAUDOUT event added - SJY 23/08/05 */
+/* events for task records passed to their post function 19/10/26 */
+/* event queues are rings woken via eventfd/epoll 19/10/26 */
+/* HGrafActive, MakeHWin returns NULL when headless 19/10/26 */
 
 #if !defined WINGRAFIX && !defined XGRAFIX && !defined NOGRAFIX
 #define NOGRAFIX
@@ -78,6 +81,15 @@ char *hgraf_version = "!HVER!HGraf: 1.6.0 [SJY 01/06/07]";
 
 #include "HThreads.h"
 
+#if defined(UNIX) && defined(__linux__)
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#endif
+
 #define DEF_FONTSIZE 16           /* default font size */
 #define MAX_POINT    64           /* max number of points for polygons */
 
@@ -420,6 +432,18 @@ void InitGraf(Boolean noGraphics)
    }
 }
 
+/* EXPORT->HGrafActive: return TRUE if windows can be made, a macro */
+/* under NOGRAFIX but defined for code built without it */
+#undef HGrafActive
+Boolean HGrafActive(void)
+{
+#ifdef NOGRAFIX
+   return FALSE;
+#else
+   return noGraph?FALSE:TRUE;
+#endif
+}
+
 /* ----------------------------- Event Handling ------------------------------ */
 
 #if defined(XGRAFIX) || (defined(UNIX) && defined(NOGRAFIX))
@@ -428,84 +452,209 @@ HEventRec convertXevToHEventRec(XEvent xev);
 HWin FindWindowRec(Window w);
 #endif
 
+/* Thread event queues: see EventQueue in HThreads.h.  On Linux the
+   reader of an empty queue blocks on its eventfd (or its epoll set if
+   it watches fds) and a poster writes the eventfd only if the reader
+   is blocked.  Wakeup fds are not used above half of the fd limit so
+   that many threads cannot use up the fds of the process. */
+
+#ifdef __linux__
+#define WAKETAG 0xffffffff   /* epoll data of the eventfd */
+#define MAXWATCH 16          /* fds returned per epoll_wait */
+
+static int maxWakeFd = -1;   /* max fd used for wakeups */
+
+/* openWakeup: open q's eventfd, q->mux held */
+static void openWakeup(EventQueue *q)
+{
+   struct rlimit rl;
+
+   if (maxWakeFd < 0)
+      maxWakeFd = (getrlimit(RLIMIT_NOFILE,&rl)==0 && rl.rlim_cur!=RLIM_INFINITY)?
+         (int)(rl.rlim_cur/2) : 512;
+   q->efd = eventfd(0,0);
+   if (q->efd >= maxWakeFd) {
+      close(q->efd); q->efd = -1;
+   }
+}
+
+/* openWatch: give q an epoll set holding its eventfd, q->mux held */
+static void openWatch(EventQueue *q)
+{
+   struct epoll_event ev;
+
+   if (q->efd < 0) openWakeup(q);
+   if (q->efd < 0)
+      HError(9999,"HWatchFd: cannot open eventfd");
+   q->epfd = epoll_create(MAXWATCH);
+   if (q->epfd < 0)
+      HError(9999,"HWatchFd: cannot create epoll set");
+   memset(&ev,0,sizeof(ev));
+   ev.events = EPOLLIN; ev.data.u32 = WAKETAG;
+   if (epoll_ctl(q->epfd,EPOLL_CTL_ADD,q->efd,&ev) < 0)
+      HError(9999,"HWatchFd: cannot watch eventfd");
+}
+#endif
+
+/* pushEvent: add r to the end of q, growing the ring if full, q->mux held */
+static void pushEvent(EventQueue *q, HEventRec *r)
+{
+   HEventRec *ring = (HEventRec *)q->ring, *newring;
+   int i,newsize;
+
+   if (q->count == q->size) {
+      newsize = (q->size==0)?16:2*q->size;
+      newring = (HEventRec *)malloc(newsize*sizeof(HEventRec));
+      if (newring==NULL)
+         HError(9999,"pushEvent: cannot grow event queue");
+      for (i=0; i<q->count; i++)
+         newring[i] = ring[(q->head+i)%q->size];
+      if (ring!=NULL) free(ring);
+      q->ring = ring = newring; q->size = newsize; q->head = 0;
+   }
+   ring[(q->head+q->count)%q->size] = *r;
+   ++q->count;
+}
+
+/* wakeReader: wake the reader of q if it is blocked, q->mux held */
+static void wakeReader(EventQueue *q)
+{
+#ifdef __linux__
+   uint64_t one = 1;
+#endif
+
+   if (!q->waiting) return;
+   q->waiting = 0;
+#ifdef __linux__
+   if (q->efd >= 0) {
+      if (write(q->efd,&one,sizeof(one)) != sizeof(one))
+         HError(9999,"wakeReader: cannot write eventfd");
+      return;
+   }
+#endif
+   pthread_cond_signal(&(q->cond));
+}
+
+#ifdef __linux__
+/* waitOnFds: wait up to timeout ms (-1 for ever) for a wakeup or a
+   watched fd, queueing an event for each readable watched fd */
+static void waitOnFds(EventQueue *q, int timeout)
+{
+   struct epoll_event evs[MAXWATCH];
+   HEventRec r;
+   uint64_t n;
+   int i,nev;
+
+   if (q->epfd < 0) {
+      /* no watched fds, so just the eventfd */
+      if (timeout == 0) return;
+      if (read(q->efd,&n,sizeof(n)) < 0 && errno != EINTR)
+         HError(9999,"waitOnFds: cannot read eventfd");
+      return;
+   }
+   nev = epoll_wait(q->epfd,evs,MAXWATCH,timeout);
+   if (nev < 0 && errno != EINTR)
+      HError(9999,"waitOnFds: epoll_wait failed");
+   for (i=0; i<nev; i++) {
+      if (evs[i].data.u32 == WAKETAG) {
+         if (read(q->efd,&n,sizeof(n)) < 0 && errno != EINTR)
+            HError(9999,"waitOnFds: cannot read eventfd");
+      } else {
+         memset(&r,0,sizeof(r));
+         r.event = HTBUFFER; r.c = (unsigned char)evs[i].data.u32;
+         pthread_mutex_lock(&(q->mux));
+         pushEvent(q,&r);
+         pthread_mutex_unlock(&(q->mux));
+      }
+   }
+}
+#endif
+
 void postEventToQueue(HThread thread, HEventRec r)
 {
-    QEntry qentry;
-    HEventRec *hevent;
+    EventQueue *q;
 
     if(thread==NULL)
       HError(9999,"NULL thread passed to postEventToQueue");
-
-    hevent= malloc(sizeof (HEventRec));
-    qentry = malloc(sizeof (QEntryRec));
-    /* copy the event information */
-    hevent->event=r.event; hevent->x=r.x; hevent->y=r.y;
-    hevent->c=r.c; hevent->ktype=r.ktype; hevent->win=r.win;
-    qentry->next=NULL;
-    pthread_mutex_lock(&(thread->xeq.mux));
-    /* if queue is empty */
-    if (thread->xeq.tail == NULL) {
-      thread->xeq.head = thread->xeq.tail = qentry;
-    }
-    else { /* add event to the tail of the queue */
-      thread->xeq.tail->next = qentry;
-      thread->xeq.tail = qentry;
+    if(thread->post!=NULL) {  /* a task without a thread of its own */
+      thread->post(thread,r.event,r.c);
+      return;
     }
-    qentry->next = NULL;
-    qentry->hev = (void*)hevent;
-
-    pthread_cond_signal(&(thread->xeq.cond));
-    pthread_mutex_unlock(&(thread->xeq.mux));
+    q = &(thread->xeq);
+    pthread_mutex_lock(&(q->mux));
+    pushEvent(q,&r);
+    wakeReader(q);
+    pthread_mutex_unlock(&(q->mux));
 }
 
 /* return the number of events on the queue */
 int eventsOnQueue(HThread thread)
 {
-   QEntry n;
+   EventQueue *q;
    int i;
 
-   i=0;
    if(thread==NULL)
       HError(9999,"NULL thread passed to eventsOnQueue");
-   pthread_mutex_lock(&(thread->xeq.mux));
-   n=thread->xeq.head;
-   while (n!=NULL) {
-      i++; n=n->next;
-   }
-   pthread_mutex_unlock(&(thread->xeq.mux));
+   q = &(thread->xeq);
+#ifdef __linux__
+   /* collect any watched fds which are ready */
+   if (q->epfd >= 0 && q->count == 0 && thread == HThreadSelf())
+      waitOnFds(q,0);
+#endif
+   pthread_mutex_lock(&(q->mux));
+   i = q->count;
+   pthread_mutex_unlock(&(q->mux));
    return i;
 }
 
+/* EXPORT->HWatchFd: wake the calling thread when fd is readable */
+void HWatchFd(int fd, int bufferId)
+{
+#ifdef __linux__
+   EventQueue *q = &(HThreadSelf()->xeq);
+   struct epoll_event ev;
+
+   pthread_mutex_lock(&(q->mux));
+   if (q->epfd < 0) openWatch(q);
+   pthread_mutex_unlock(&(q->mux));
+   memset(&ev,0,sizeof(ev));
+   ev.events = EPOLLIN; ev.data.u32 = (unsigned char)bufferId;
+   if (epoll_ctl(q->epfd,EPOLL_CTL_ADD,fd,&ev) < 0)
+      HError(9999,"HWatchFd: cannot watch fd %d",fd);
+#else
+   HError(9999,"HWatchFd: not supported");
+#endif
+}
 
 /* Pull an event from the thread event queue */
 HEventRec getEventFromQueue()
 {
    HEventRec r;
-   HEventRec *rp;
    HThread t;
-   QEntry qentry;
+   EventQueue *q;
    t=HThreadSelf();
 
    HFlush();
 
-   pthread_mutex_lock(&(t->xeq.mux));
-   while (t->xeq.head == NULL) {
-      pthread_cond_wait(&(t->xeq.cond), &(t->xeq.mux));
+   q = &(t->xeq);
+   pthread_mutex_lock(&(q->mux));
+   while (q->count == 0) {
+      q->waiting = 1;
+#ifdef __linux__
+      if (q->efd < 0) openWakeup(q);
+      if (q->efd >= 0) {
+         pthread_mutex_unlock(&(q->mux));
+         waitOnFds(q,-1);
+         pthread_mutex_lock(&(q->mux));
+         continue;
+      }
+#endif
+      pthread_cond_wait(&(q->cond), &(q->mux));
    }
-   qentry = t->xeq.head;
-   t->xeq.head = t->xeq.head->next;
-   if (t->xeq.tail == qentry)
-      t->xeq.tail = NULL;
-   pthread_mutex_unlock(&(t->xeq.mux));
-
-   rp=(HEventRec *)qentry->hev;
-
-   r.event=rp->event;  r.x=rp->x;r.y=rp->y;
-   r.c=rp->c;  r.ktype=rp->ktype;
-   r.win=rp->win;
-
-   free(qentry->hev);
-   free(qentry);
+   q->waiting = 0;
+   r = ((HEventRec *)q->ring)[q->head];
+   q->head = (q->head+1)%q->size; --q->count;
+   pthread_mutex_unlock(&(q->mux));
    return r;
 }
 
@@ -1921,9 +2070,7 @@ HWin MakeHWin(char *wname, int x, int y, int w, int h, int bw)
    char sbuf[256];
    HDC dc;
 
-   if(noGraph)
-     HError(9999, "Trying to create window when NOGRAPHICS specified in config file\n");
-
+   if(noGraph) return NULL;
    win = (HWin)malloc(sizeof(HWindowRec));
    win->next = wroot; wroot = win;
    strcpy(win->winName, wname);
@@ -1968,8 +2115,9 @@ HWin MakeHWin(char *wname, int x, int y, int w, int h, int bw)
    unsigned long vmask;
    HEventRec report;
    Atom del_atom;
-   display=globDisp;
 
+   if(noGraph) return NULL;
+   display=globDisp;
    win = (HWin)malloc(sizeof(HWindowRec));
 
    win->theDisp=display;
@@ -41,6 +41,7 @@
 /* !HVER!HGraf: 1.6.0 [SJY 01/06/07] */
 
 /* HAUDOUT event added - SJY 23/08/05 */
+/* HGrafActive added for headless operation 19/10/26 */
 
 /*
    This module provides a minimal graphics facility.  It provides
@@ -64,6 +65,12 @@
    connection to the X11 server to match the Thread Message queues in
    WIN32.
 */
+/*
+   HEADLESS: built with NOGRAFIX (make HTKNOGRAFIX=1) there is no X11
+   and no windows, or set HGRAF: NOGRAPHICS = T to run an X11 build
+   without a display.  Either way the thread event queues still work
+   and HGrafActive is FALSE, MakeHWin returns NULL.
+*/
 #ifndef _HGRAF_H_
 #define _HGRAF_H_
 
@@ -135,6 +142,16 @@ void InitGraf(Boolean noGraphics);
    noGraphics true (required for Linux where no Xserver is available).
 */
 
+#ifdef NOGRAFIX
+#define HGrafActive() FALSE
+#else
+Boolean HGrafActive(void);
+#endif
+/*
+   Return TRUE if windows can be made.  Under NOGRAFIX this is a
+   constant so that drawing code guarded by it compiles out.
+*/
+
 HWin MakeHWin(char *wname, int x, int y, int w, int h, int bw);
 /*
    Create a window of width w and height h, with top left corner at
@@ -556,6 +556,19 @@ void PrintAllHeapStats(void)
    printf(  "---------------------------------------------------------------\n");
 }
 
+/* EXPORT->TotalHeapAlloc: total bytes allocated by all memory heaps */
+size_t TotalHeapAlloc(void)
+{
+   MemHeapRec *p;
+   size_t n = 0;
+
+   LOCK
+   for (p = heapList; p != NULL; p = p->next)
+      n += p->heap->totAlloc*p->heap->elemSize;
+   UNLOCK
+   return n;
+}
+
 /* ------------- Vector/Matrix Memory Management -------------- */
 
 /*
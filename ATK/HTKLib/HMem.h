@@ -169,6 +169,11 @@ void PrintAllHeapStats(void);
    Print summary stats for all allocated heaps
 */
 
+size_t TotalHeapAlloc(void);
+/*
+   Return the total number of bytes currently allocated by all heaps
+*/
+
 /* ------------- Vector/Matrix Memory Management -------------- */
 
 /* Basic Numeric Types */
@@ -3858,10 +3858,11 @@ Network *ExpandWordNet(MemHeap *heap,Lattice *lat,Vocab *voc,HMMSet *hset)
    /* Count the initial/final nodes/links */
    net->numLink=net->initial.nlinks;
    net->numNode=2;
+   net->initial.id=0; net->final.id=1;
    /* now reorder links and identify wd0 nodes */
    for (chainNode = net->chain, bi.ncn=0; chainNode != NULL;
    chainNode = chainNode->chain,net->numNode++,bi.ncn++) {
-      chainNode->inst=NULL;
+      chainNode->inst=NULL; chainNode->id=net->numNode;
       chainNode->type=chainNode->type&n_nocontext;
       net->numLink+=chainNode->nlinks;
       /* Make !NULL words really NULL */
@@ -361,6 +361,7 @@ struct _NetNode {
    int nlinks;          /* Number of nodes connected to this one */
    NetLink *links;      /* Array[0..nlinks-1] of links to connected nodes */
    NetInst *inst;       /* Model Instance (if one exists, else NULL) */
+   int id;              /* index of node in network, 0..numNode-1 */
    NetNode *chain;      /* links all net nodes in a single list */
    WordSet wordset;     /* set of word end nodes reachable from this node */
 	ShowRecPtr sptr;     /* pointer to show node for visual display */
@@ -0,0 +1,375 @@
+/* ----------------------------------------------------------- */
+/*           _ ___   	     ___                               */
+/*          |_| | |_/	  |_| | |_/    SPEECH                  */
+/*          | | | | \  +  | | | | \    RECOGNITION             */
+/*          =========	  =========    SOFTWARE                */
+/*                                                             */
+/* ================> ATK COMPATIBLE VERSION <================= */
+/*                                                             */
+/* ----------------------------------------------------------- */
+/* developed at:                                               */
+/*                                                             */
+/*      Machine Intelligence Laboratory (Speech Group)         */
+/*      Cambridge University Engineering Department            */
+/*      http://mi.eng.cam.ac.uk/                               */
+/*                                                             */
+/* ----------------------------------------------------------- */
+/*         Copyright: Cambridge University                     */
+/*          2001-2007 Engineering Department                   */
+/*                                                             */
+/*   Use of this software is governed by a License Agreement   */
+/*    ** See the file License for the Conditions of Use  **    */
+/*    **     This banner notice must not be removed      **    */
+/*                                                             */
+/* ----------------------------------------------------------- */
+/*   File: HParmTest.c - Front-end benchmark and regression    */
+/* ----------------------------------------------------------- */
+
+char *hparmtest_version = "!HVER!HParmTest: 1.6.0 [CUED 19/10/26]";
+
+/*
+   HParmTest codes a set of waves with each of a list of coder
+   channels (see SetCoderChannel) and reports the coding speed of
+   each.  The features can be saved as reference files (-g) or
+   compared against previously saved reference files (-r).
+*/
+
+#include "HShell.h"
+#include "HThreads.h"
+#include "HMem.h"
+#include "HMath.h"
+#include "HSigP.h"
+#include "HWave.h"
+#include "HAudio.h"
+#include "HParm.h"
+#include "HLabel.h"
+
+#define MAXCHANS 50      /* max number of coder channels */
+#define MAXUTTS  200     /* max number of waves */
+#define SYNSEED  4321    /* random seed for synthetic waves */
+
+static int trace = 0;
+#define T_TOP  0001      /* basic progress reporting */
+#define T_UTT  0002      /* per utterance results */
+#define T_DIF  0004      /* print mismatching frames */
+
+typedef struct {         /* an input wave */
+   char *name;           /* base name used for reference files */
+   short *data;          /* samples */
+   long nSamples;        /* number of samples */
+   long next;            /* next sample to return to HParm */
+} TestWave;
+
+static char *chanName[MAXCHANS];  /* coder channels to test */
+static int numChans = 0;
+static TestWave wave[MAXUTTS];    /* waves to code */
+static int numWaves = 0;
+static char *genDir = NULL;       /* dir to write references to */
+static char *refDir = NULL;       /* dir to read references from */
+static float tolerance = 1.0E-4;  /* relative tolerance for compare */
+static int repeats = 1;           /* times to code each wave */
+static HTime srcRate = 625.0;     /* sample period of synthetic waves */
+static MemHeap waveHeap;
+static MemHeap codeHeap;          /* ParmBufs, reset for each wave */
+static MemHeap feaHeap;           /* coded features, reset for each wave */
+
+void ReportUsage(void)
+{
+   printf("\nUSAGE: HParmTest [options] Chan1,Chan2,... WaveFiles...\n\n");
+   printf(" Option                                   Default\n\n");
+   printf(" -e f    relative tolerance for compare      1.0E-4\n");
+   printf(" -g s    write reference features to dir s   off\n");
+   printf(" -r s    compare with references in dir s    off\n");
+   printf(" -s f    add synthetic wave of f secs        none\n");
+   printf(" -x i    code each wave i times              1\n");
+   PrintStdOpts("S");
+   printf("\n\n");
+   exit(0);
+}
+
+/* ------------------------ Wave Sources ------------------------ */
+
+/* MakeSynWave: make a deterministic speech-like wave of secs duration
+   consisting of alternating bursts of harmonic chirps and noise */
+static void MakeSynWave(float secs)
+{
+   TestWave *w = wave+numWaves;
+   char buf[MAXSTRLEN];
+   long i,n,burst;
+   double f0,ph,fs,x;
+   int h;
+
+   if (numWaves==MAXUTTS) HError(3290,"HParmTest: too many waves");
+   sprintf(buf,"syn%d",numWaves+1);
+   fs = 1.0E7/srcRate;
+   n = (long) (secs*fs);
+   w->name = CopyString(&waveHeap,buf);
+   w->data = (short *)New(&waveHeap,n*sizeof(short));
+   w->nSamples = n;
+   burst = (long) (0.4*fs); ph = 0.0;
+   for (i=0; i<n; i++) {
+      x = GaussDeviate(0.0,30.0);
+      if ((i/burst)%3 != 2) {
+         /* voiced: pitch glides between 100 and 200Hz */
+         f0 = 150.0 + 50.0*sin(2*PI*i/(fs*1.3));
+         ph += 2*PI*f0/fs;
+         for (h=1; h<=20; h++)
+            x += 2000.0/h * sin(h*ph) * (1.0+0.5*sin(2*PI*i*h/(fs*0.7)));
+      }
+      if (x>32767.0) x = 32767.0; else if (x<-32767.0) x = -32767.0;
+      w->data[i] = (short) x;
+   }
+   ++numWaves;
+}
+
+/* LoadTestWave: load samples of wave file fn */
+static void LoadTestWave(char *fn)
+{
+   TestWave *w = wave+numWaves;
+   HTime sp = 0.0;
+   Wave hw;
+   char *s,*e;
+
+   if (numWaves==MAXUTTS) HError(3290,"HParmTest: too many waves");
+   if ((hw = OpenWaveInput(&waveHeap,fn,UNDEFF,250000.0,100000.0,&sp)) == NULL)
+      HError(3210,"HParmTest: cannot open wave file %s",fn);
+   w->data = GetWaveDirect(hw,&w->nSamples);
+   if ((s = strrchr(fn,'/')) == NULL) s = fn; else ++s;
+   w->name = CopyString(&waveHeap,s);
+   if ((e = strrchr(w->name,'.')) != NULL) *e = '\0';
+   ++numWaves;
+}
+
+static Ptr xOpen(Ptr xInfo, char *fn, BufferInfo *info) { return xInfo; }
+static void xClose(Ptr xInfo, Ptr bInfo) {}
+static void xStart(Ptr xInfo, Ptr bInfo) {}
+static void xStop(Ptr xInfo, Ptr bInfo) {}
+static int xNumSamp(Ptr xInfo, Ptr bInfo) { return 1<<20; }
+
+/* xGetData: return next n samples of the wave, zero padded at the end */
+static int xGetData(Ptr xInfo, Ptr bInfo, int n, Ptr data)
+{
+   TestWave *w = (TestWave *) xInfo;
+   short *t = (short *) data;
+   int i;
+
+   for (i=0; i<n; i++,w->next++)
+      *t++ = (w->next<w->nSamples)?w->data[w->next]:0;
+   return n;
+}
+
+/* ------------------------ Reference Files ------------------------ */
+
+static void RefName(char *buf, char *dir, char *chan, TestWave *w)
+{
+   sprintf(buf,"%s/%s_%s.fea",dir,chan,w->name);
+}
+
+/* WriteRef: store nFrames x vSize features as an HTK parameter file */
+static void WriteRef(char *chan, TestWave *w, float *fea, int nFrames,
+                     int vSize, BufferInfo *info)
+{
+   char buf[MAXSTRLEN];
+   FILE *f;
+
+   RefName(buf,genDir,chan,w);
+   if ((f = fopen(buf,"wb")) == NULL)
+      HError(3211,"HParmTest: cannot create %s",buf);
+   WriteHTKHeader(f,nFrames,(long)info->tgtSampRate,(short)(vSize*sizeof(float)),
+                  (short)info->tgtPK,NULL);
+   WriteFloat(f,fea,nFrames*vSize,TRUE);
+   fclose(f);
+}
+
+/* CompareRef: compare features against reference, return TRUE if ok */
+static Boolean CompareRef(char *chan, TestWave *w, float *fea, int nFrames,
+                          int vSize, BufferInfo *info, float *maxDiff)
+{
+   char buf[MAXSTRLEN];
+   FILE *f;
+   long n,sp;
+   short ss,kind;
+   Boolean swap;
+   int i,bad = 0;
+   float r,d;
+
+   *maxDiff = 0.0;
+   RefName(buf,refDir,chan,w);
+   if ((f = fopen(buf,"rb")) == NULL) {
+      printf("  %s: no reference file %s\n",chan,buf);
+      return FALSE;
+   }
+   if (!ReadHTKHeader(f,&n,&sp,&ss,&kind,&swap)) {
+      printf("  %s: bad reference file %s\n",chan,buf);
+      fclose(f); return FALSE;
+   }
+   if (n != nFrames || ss != vSize*sizeof(float) || kind != info->tgtPK) {
+      printf("  %s: %s has %ld frames of size %d, kind %d; coded %d of %d, kind %d\n",
+             chan,buf,n,ss/4,kind,nFrames,vSize,info->tgtPK);
+      fclose(f); return FALSE;
+   }
+   for (i=0; i<nFrames*vSize; i++) {
+      if (fread(&r,sizeof(float),1,f) != 1) {
+         printf("  %s: %s is truncated\n",chan,buf);
+         fclose(f); return FALSE;
+      }
+      if (swap) SwapInt32((int32 *)&r);
+      d = fabs(fea[i]-r)/(1.0+fabs(r));
+      if (d > *maxDiff) *maxDiff = d;
+      if (d > tolerance && ++bad <= 10 && (trace&T_DIF))
+         printf("  %s: %s frame %d, comp %d: %f vs %f\n",chan,w->name,
+                i/vSize,i%vSize+1,fea[i],r);
+   }
+   fclose(f);
+   if (bad>0)
+      printf("  %s: %s has %d values differing from reference (max rel diff %g)\n",
+             chan,w->name,bad,*maxDiff);
+   return bad==0;
+}
+
+/* ------------------------ Coding ------------------------ */
+
+/* CodeWave: code w with a fresh copy of channel name, return secs
+   spent in ReadBuffer and the features in *fea.  A new channel is used
+   each time since running CMN state is carried over within a channel */
+static double CodeWave(char *name, HParmSrcDef ext, TestWave *w,
+                       float **fea, int *nFrames, int *vSize, BufferInfo *info)
+{
+   ChannelInfoLink chan = SetCoderChannel(name);
+   ParmBuf pbuf;
+   Observation o;
+   short swidth[SMAX];
+   Boolean eSep;
+   double t0,t;
+   int i,s,k;
+   float *v;
+
+   w->next = 0;
+   if ((pbuf = OpenChanBuffer(&codeHeap,"",ext,chan)) == NULL)
+      HError(3250,"HParmTest: OpenChanBuffer failed");
+   GetBufferInfo(pbuf,info);
+   ZeroStreamWidths(1,swidth);
+   SetStreamWidths(info->tgtPK,info->tgtVecSize,swidth,&eSep);
+   o = MakeObservation(&codeHeap,swidth,info->tgtPK,FALSE,eSep);
+   *nFrames = (w->nSamples<info->frSize)?0:
+      (w->nSamples - info->frSize)/info->frRate + 1;
+   *vSize = info->tgtVecSize;
+   *fea = v = (float *)New(&feaHeap,(*nFrames * *vSize + 1)*sizeof(float));
+   StartBuffer(pbuf);
+   t = 0.0;
+   for (i=0; i<*nFrames; i++) {
+      t0 = GetClockNow();
+      ReadBuffer(pbuf,&o);
+      t += GetClockNow() - t0;
+      for (s=1; s<=swidth[0]; s++)
+         for (k=1; k<=swidth[s]; k++) *v++ = o.fv[s][k];
+   }
+   StopBuffer(pbuf);
+   CloseBuffer(pbuf);
+   return t;
+}
+
+/* TestChannel: code every wave with channel name, return TRUE if all
+   features match the references */
+static Boolean TestChannel(char *name, HParmSrcDef *ext)
+{
+   BufferInfo info;
+   double t = 0.0,tot = 0.0,audio = 0.0;
+   long frames = 0;
+   int i,r,nFrames = 0,vSize = 0;
+   float *fea = NULL,diff,maxDiff = 0.0;
+   Boolean ok = TRUE;
+   char buf[MAXSTRLEN];
+
+   for (i=0; i<numWaves; i++) {
+      for (r=0; r<repeats; r++) {
+         ResetHeap(&codeHeap); ResetHeap(&feaHeap);
+         t = CodeWave(name,ext[i],wave+i,&fea,&nFrames,&vSize,&info);
+         tot += t; frames += nFrames;
+         audio += wave[i].nSamples*info.srcSampRate/1.0E7;
+      }
+      if (trace&T_UTT)
+         printf("  %-10s %-12s %6d frames %8.4fs\n",name,wave[i].name,nFrames,t);
+      if (genDir != NULL)
+         WriteRef(name,wave+i,fea,nFrames,vSize,&info);
+      if (refDir != NULL) {
+         if (!CompareRef(name,wave+i,fea,nFrames,vSize,&info,&diff))
+            ok = FALSE;
+         if (diff > maxDiff) maxDiff = diff;
+      }
+   }
+   printf("%-10s %-16s %4d %8ld %8.3f %10.1f %8.5f",name,
+          ParmKind2Str(info.tgtPK,buf),info.tgtVecSize,frames,tot,
+          (tot>0.0)?frames/tot:0.0,(audio>0.0)?tot/audio:0.0);
+   if (refDir != NULL)
+      printf(" %10.3g %s",maxDiff,ok?"PASS":"FAIL");
+   printf("\n"); fflush(stdout);
+   return ok;
+}
+
+/* ------------------------ Main Program ------------------------ */
+
+int main(int argc, char *argv[])
+{
+   char *s,*p;
+   HParmSrcDef ext[MAXUTTS];
+   int i,fails = 0;
+   ConfParam *cParm[MAXGLOBS];
+   int nParm;
+   double f;
+
+   InitThreads(HT_NOMONITOR);
+   if(InitShell(argc,argv,hparmtest_version)<SUCCESS)
+      HError(3200,"HParmTest: InitShell failed");
+   InitMem();   InitLabel();
+   InitMath();
+   InitSigP(); InitWave();  InitAudio();
+   if(InitParm()<SUCCESS)
+      HError(3200,"HParmTest: InitParm failed");
+   if (NumArgs() == 0) ReportUsage();
+   CreateHeap(&waveHeap,"HParmTestWave",MSTAK,1,1.0,100000,10000000);
+   CreateHeap(&codeHeap,"HParmTestCode",MSTAK,1,1.0,100000,1000000);
+   CreateHeap(&feaHeap,"HParmTestFea",MSTAK,1,1.0,100000,10000000);
+   nParm = GetConfig("HPARMTEST", TRUE, cParm, MAXGLOBS);
+   if (nParm>0 && GetConfFlt(cParm,nParm,"SOURCERATE",&f)) srcRate = f;
+   RandInit(SYNSEED);
+   while (NextArg() == SWITCHARG) {
+      s = GetSwtArg();
+      if (strlen(s)!=1)
+         HError(3219,"HParmTest: Bad switch %s; must be single letter",s);
+      switch(s[0]){
+      case 'e': tolerance = GetChkedFlt(0.0,1.0,s); break;
+      case 'g': genDir = GetStrArg(); break;
+      case 'r': refDir = GetStrArg(); break;
+      case 's': MakeSynWave(GetChkedFlt(0.1,100000.0,s)); break;
+      case 'x': repeats = GetChkedInt(1,1000,s); break;
+      case 'T': trace = GetChkedInt(0,0777,s); break;
+      default:
+         HError(3219,"HParmTest: Unknown switch %s",s);
+      }
+   }
+   if (NextArg()!=STRINGARG)
+      HError(3219,"HParmTest: channel list expected");
+   for (p=strtok(GetStrArg(),","); p!=NULL; p=strtok(NULL,",")) {
+      if (numChans==MAXCHANS) HError(3219,"HParmTest: too many channels");
+      chanName[numChans++] = p;
+   }
+   while (NextArg()==STRINGARG)
+      LoadTestWave(GetStrArg());
+   if (numWaves==0)
+      HError(3219,"HParmTest: no waves to code [use -s or give wave files]");
+   for (i=0; i<numWaves; i++)
+      ext[i] = CreateSrcExt(wave+i, WAVEFORM, 2, 0.0, xOpen, xClose,
+                            xStart, xStop, xNumSamp, xGetData);
+
+   printf("%-10s %-16s %4s %8s %8s %10s %8s","channel","kind","size",
+          "frames","secs","frames/s","xRT");
+   if (refDir != NULL) printf(" %10s %s","maxdiff","result");
+   printf("\n");
+   for (i=0; i<numChans; i++)
+      if (!TestChannel(chanName[i],ext)) ++fails;
+   if (refDir != NULL)
+      printf("%d of %d channels failed\n",fails,numChans);
+   Exit(fails>0?1:0);
+   return 0;
+}
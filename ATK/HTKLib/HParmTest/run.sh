@@ -0,0 +1,27 @@
+#!/bin/sh
+#
+# run.sh       code the test data and compare with the reference features
+# run.sh -g    regenerate the reference features in Ref
+# run.sh -b    benchmark only: long synthetic wave plus all AVite waves
+
+wprog=Debug/HParmTest
+uprog=./HParmTest
+waves=../../ATKApps/avite/Test
+chans=MFCC,MFCCE,MFCCEDA,MFCC0DAZ,MFCCEDAT,FBANK,FBANKED,MELSPEC,PLP,PLP0DA,PLPEDA,LPC,LPCE,LPREFC,LPCEPSTRA
+
+if [ -f $wprog ]; then
+  prog=$wprog
+elif [ -f $uprog ]; then
+  prog=$uprog
+else
+  echo "Cant find HParmTest program"
+  exit 1
+fi
+case "$1" in
+  -g) mkdir -p Ref
+      opts="-s 2 -g Ref"; data=$waves/sjy0200.wav ;;
+  -b) opts="-s 600 -x 3"; data="$waves/*.wav" ;;
+  *)  opts="-s 2 -r Ref"; data=$waves/sjy0200.wav ;;
+esac
+echo $prog -C hparmtest.cfg $opts $chans $data
+$prog -C hparmtest.cfg $opts $chans $data
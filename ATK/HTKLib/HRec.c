@@ -48,6 +48,9 @@ char *hrec_version = "!HVER!HRec: 1.6.0 [SJY 01/06/07]";
    20/08/04 - conf scoring updated and some threading issues resolved - SJY
    17/05/05 - added lattice generation and nbest routines - MNS
    11/08/05 - added support for class-based LMs - SJY
+   19/10/26 - decoder statistics added
+   19/10/26 - tok set merge done in place without hash table
+   19/10/26 - node insts held in pri so networks can be shared
 */
 
 #include "HShell.h"
@@ -102,18 +105,15 @@ const Token null_token={LZERO,0.0,NULL,FALSE};
 #define node_tr0(node) ((node)->type & n_tr0)
 #define node_wd0(node) ((node)->type & n_wd0)
 
+/* Insts are held by the pri, not the node, so that a network can be */
+/* used by several recognisers at once                               */
+#define NodeInst(pri,node) ((pri)->insts[(node)->id])
+
 
 /* Need some null RelTokens */
 static const RelToken rmax={0.0,0.0,NULL};    /* First rtok same as tok */
 static const RelToken rnull={LZERO,0.0,NULL}; /* Rest can be LZERO */
 
-/* Used for sorting reltokens eg in StepInst2 */
-typedef struct {
-   RelToken rtok;
-   short left;
-   short right;
-}RTokBinTreeNode;
-
 /* HMMSet information is some precomputed limits plus the precomps */
 typedef struct precomp
 {
@@ -337,16 +337,16 @@ static void ReOrderList(PRecInfo *pri, NetNode *node)
    NetLink *dest;
    int i;
 
-   if (node->inst == NULL || !node->inst->ooo ) return;
-   node->inst->ooo=FALSE;
+   if (NodeInst(pri,node) == NULL || !NodeInst(pri,node)->ooo ) return;
+   NodeInst(pri,node)->ooo=FALSE;
    for (i=0,dest=node->links;i<node->nlinks;i++,dest++) {
       /* tr0 nodes always come 1st, so break as soon as non-tr0 node found */
       if (!node_tr0(dest->node)) break;
-      if (dest->node->inst!=NULL)  MoveToRecent(pri,dest->node->inst);
+      if (NodeInst(pri,dest->node)!=NULL)  MoveToRecent(pri,NodeInst(pri,dest->node));
    }
    for (i=0,dest=node->links;i<node->nlinks;i++,dest++) {
       if (!node_tr0(dest->node)) break;
-      if (dest->node->inst!=NULL)  ReOrderList(pri,dest->node);
+      if (NodeInst(pri,dest->node)!=NULL)  ReOrderList(pri,dest->node);
    }
 }
 
@@ -393,7 +393,7 @@ static void AttachInst(PRecInfo *pri, NetNode *node)
    pri->nact++;
 
    /* Attach the inst to the node owning it */
-   node->inst=inst;
+   NodeInst(pri,node)=inst;
 
    /* Ensure any currently alive following insts are moved */
    /*  to be more recent than it to ensure tokens propagated in */
@@ -412,7 +412,7 @@ static void DetachInst(PRecInfo *pri, NetNode *node)
    NetInst *inst;
    int i,n;
 
-   inst=node->inst; pri->nact--;
+   inst=NodeInst(pri,node); pri->nact--;
 #ifdef SANITY
    if (inst->node!=node)
       HError(8591,"DetachInst: Node/Inst mismatch");
@@ -429,7 +429,7 @@ static void DetachInst(PRecInfo *pri, NetNode *node)
    Dispose(pri->stHeap+pri->psi->stHeapIdx[n],inst->state);
    Dispose(pri->stHeap+pri->psi->stHeapIdx[1],inst->exit);
    Dispose(&pri->instHeap,inst);
-   node->inst=NULL;
+   NodeInst(pri,node)=NULL;
 }
 
 
@@ -459,8 +459,11 @@ static LogFloat cSOutP(PRecInfo *pri, HMMSet *hset, int s, Observation *x,
 	bx += det;
 	pre->id=pri->obid;
 	pre->outp=bx;
-      } else
+	++pri->stats.mPreMiss;
+      } else {
          bx=pre->outp;
+         ++pri->stats.mPreHits;
+      }
    } else {
       bx=LZERO;                   /* Multi Mixture Case */
       for (m=1; m<=se->nMix; m++,me++) {
@@ -476,8 +479,11 @@ static LogFloat cSOutP(PRecInfo *pri, HMMSet *hset, int s, Observation *x,
 	      px += det;
 	      pre->id=pri->obid;
 	      pre->outp=px;
-            } else
+	      ++pri->stats.mPreMiss;
+            } else {
                px=pre->outp;
+               ++pri->stats.mPreHits;
+            }
             bx=LAdd(bx,wt+px);
          }
       }
@@ -496,6 +502,7 @@ static LogFloat cPOutP(PRecInfo *pri, StateInfo *si)
    StreamElem *se;
    Vector w;
    int s,S;
+   double t0 = 0.0;
 
    if (si->sIdx>0 && si->sIdx<=pri->psi->nsp)
       pre=pri->psi->sPre+si->sIdx;
@@ -507,6 +514,8 @@ static LogFloat cPOutP(PRecInfo *pri, StateInfo *si)
 #endif
 
    if (pre->id != pri->obid) {
+      ++pri->stats.sPreMiss;
+      if (pri->stats.timing) t0 = GetClockNow();
       if (FALSE && (psi->mixShared==FALSE))
       {
          outp=POutP(psi->hset,obs,si);
@@ -532,7 +541,9 @@ static LogFloat cPOutP(PRecInfo *pri, StateInfo *si)
       pri->confinfo.averp = 0.98*pri->confinfo.averp + 0.02*outp;
       pre->outp=outp;
       pre->id=pri->obid;
-   }
+      if (pri->stats.timing) pri->stats.outpTime += GetClockNow() - t0;
+   } else
+      ++pri->stats.sPreHits;
    return(pre->outp);
 }
 
@@ -781,14 +792,18 @@ static void CollectPaths(PRecInfo *pri)
 
 /* TokSetMerge:  used to propagate token from state i (src) -> j (res)
    cmp is copy of src->tok with like updated by a_ij.  Tokens below
-   nThresh (ie outside nBeam) are ignored */
+   nThresh (ie outside nBeam) are ignored.  The two sorted sets are
+   merged directly into res->set keeping only the most likely token
+   for each LM history.  Since the merged set is written from the
+   front, unread res tokens only need to be moved aside when a src
+   token is about to overwrite one of them. */
 
 static void TokSetMerge(PRecInfo *pri, TokenSet *res,Token *cmp,TokenSet *src)
 {
-   RelToken *cur,*stoks,rtoks[MAX_TOKS];
-   int nr,ns,nn,is,ir,k,hash;
-   unsigned int key,nullkey;
-   LogFloat sdiff,rdiff,baselike,bestlike,slike,rlike,limit;
+   RelToken *cur,*stoks,*rtoks,rsave[MAX_TOKS];
+   unsigned int key,keys[MAX_TOKS],nullkey=027777777777;
+   int nr,ns,nn,is,ir,k;
+   LogFloat sdiff,rdiff,bestlike,slike,rlike,limit;
    Boolean sIsBest;
 
 #ifdef DETAILED_TRACING
@@ -805,59 +820,49 @@ static void TokSetMerge(PRecInfo *pri, TokenSet *res,Token *cmp,TokenSet *src)
    if (cmp->like>=res->tok.like) {
       if (cmp->like>pri->nThresh) {
          if (res->tok.like>pri->nThresh) {
-			 /* res is in beam but cmp is better - so make res rel to cmp */
-			 rdiff = res->tok.like - cmp->like;
-			 res->tok = *cmp;
-          sIsBest = TRUE;
-		 }else{
+            /* res is in beam but cmp is better - so make res rel to cmp */
+            rdiff = res->tok.like - cmp->like;
+            res->tok = *cmp;
+            sIsBest = TRUE;
+         }else{
             /* res is below beam so copy src to res & no more to do */
             res->tok=*cmp; res->n=src->n;
             for (k=0;k<src->n;k++) res->set[k]=src->set[k];
             return;
          }
-	  } else {
-		  /* cmp is below beam so do nothing */
-		  return;
-	  }
+      } else {
+         /* cmp is below beam so do nothing */
+         return;
+      }
    } else {
       if (cmp->like < pri->nThresh) return;
-	  /* cmp is in beam but res is better - so make src rel to res */
-	  sdiff = cmp->like - res->tok.like;
+      /* cmp is in beam but res is better - so make src rel to res */
+      sdiff = cmp->like - res->tok.like;
    }
-   /* need to do proper merge so copy res to rtoks */
-   nr = res->n;
-   for (k=0; k<nr; k++) rtoks[k] = res->set[k];
+   nr = res->n; rtoks = res->set;
    ns = src->n; stoks = src->set;
 
    /* Now merge token sets in rtoks and stoks into res->set */
-   baselike = res->tok.like;     /* all reltokens are relative to this */
-   limit=pri->nThresh-baselike;  /* require every rel.like+diff > limit */
+   limit=pri->nThresh-res->tok.like;  /* require every rel.like+diff > limit */
    nn = 0;                       /* num reltoks stored in res */
    is = ir = 0;                  /* next candidate in each source */
-   nullkey = 027777777777;
    if (sIsBest){
+      /* first output would overwrite res->set[0] */
+      for (k=0; k<nr; k++) rsave[k] = rtoks[k];
+      rtoks = rsave;
       cur = stoks; ++is;
    }else{
       cur = rtoks; ++ir;
    }
    while (cur != NULL) {    /* main merge loop */
-
-      key = (cur->path)?cur->path->hist.key:nullkey;    /* look in hash to see if key is new */
-      hash =  key % TSM_HASH;
-
-      while (! (pri->keyhash[hash] == key || pri->keyhash[hash] == 0)) {
-         hash = (hash+1) % TSM_HASH;
-         /*  ++tsmhits;*/
-      }
-      if (pri->keyhash[hash]==0) {  /* new key so keep this reltoken */
-         pri->keyhash[hash] = key;
-         pri->keyused[nn] = hash;
+      /* keep only the first (ie best) token for each history, tokens
+         with a zero key are always kept */
+      key = (cur->path)?cur->path->hist.key:nullkey;
+      for (k=0; k<nn && keys[k]!=key; k++);
+      if (k==nn || key==0) {
+         keys[nn] = key;
          res->set[nn] = *cur;
-         if (sIsBest) {
-            res->set[nn].like += sdiff;
-         }else{
-            res->set[nn].like += rdiff;
-         }
+         res->set[nn].like += sIsBest?sdiff:rdiff;
          ++nn;
       }
       cur = NULL;                   /* find next candidate */
@@ -879,6 +884,11 @@ static void TokSetMerge(PRecInfo *pri, TokenSet *res,Token *cmp,TokenSet *src)
          }
          if (bestlike>limit){
             if (sIsBest){
+               if (rtoks == res->set && nn >= ir) {
+                  /* output has caught up with unread res tokens */
+                  for (k=ir; k<nr; k++) rsave[k] = rtoks[k];
+                  rtoks = rsave;
+               }
                cur = stoks+is; ++is;
             }else{
                cur = rtoks+ir; ++ir;
@@ -890,9 +900,6 @@ static void TokSetMerge(PRecInfo *pri, TokenSet *res,Token *cmp,TokenSet *src)
    /* res tokenset now complete */
    res->n = nn;
 
-   /* finally clean up keyhash for next use */
-   for (k=0; k<nn; k++) pri->keyhash[pri->keyused[k]] = 0;
-
 #ifdef DETAILED_TRACING
    if ((trace&T_TSM) && (pri->frame >= traceDelay)) {
       TraceTokenSet("Final Target",res);
@@ -901,21 +908,6 @@ static void TokSetMerge(PRecInfo *pri, TokenSet *res,Token *cmp,TokenSet *src)
 #endif
 }
 
-/* BTreeToTokSet: copy contents of btree back into tset in sort order */
-static RelToken * BTreeToTokSet(RTokBinTreeNode *btree, int offset, RelToken *set)
-{
-   RelToken *p = set;
-   RTokBinTreeNode *b = btree+offset;
-
-   if (b->right > 0 )
-      p = BTreeToTokSet(btree,b->right,p);
-   *p++ = b->rtok;
-   if (b->left > 0 )
-      p = BTreeToTokSet(btree,b->left,p);
-
-   return p;
-}
-
 /* RebaseTokSet: restore relative likes in given Token Set */
 static void RebaseTokSet(TokenSet *tset)
 {
@@ -957,7 +949,7 @@ static void qcksrtM(float *array,int l,int r,int M)
 /* StepHMM1: first pass internal token propagation in HMMs */
 static void StepHMM1(PRecInfo *pri, NetNode *node)
 {
-   NetInst *inst = node->inst;
+   NetInst *inst = NodeInst(pri,node);
    HMMDef *hmm = node->info.hmm;
    Token max;
    TokenSet *res,cmp,*cur;
@@ -991,6 +983,7 @@ static void StepHMM1(PRecInfo *pri, NetNode *node)
          res->tok.like += outp;
          /* update max like for this instance */
          if (res->tok.like>max.like) max=res->tok;
+         pri->stats.tokSum += (res->n>0)?res->n:1;
          /* record state level alignment if needed */
       } else {
          /* prune this state */
@@ -1042,11 +1035,13 @@ static void StepHMM1(PRecInfo *pri, NetNode *node)
 /* StepWord1: just invalidate the tokens */
 static void StepWord1(PRecInfo *pri, NetNode *node)
 {
-   node->inst->state->tok=null_token;
-   node->inst->state->n=((pri->nToks>1)?1:0);
-   node->inst->exit->tok=null_token;
-   node->inst->exit->n=((pri->nToks>1)?1:0);
-   node->inst->max=LZERO;
+   NetInst *inst = NodeInst(pri,node);
+
+   inst->state->tok=null_token;
+   inst->state->n=((pri->nToks>1)?1:0);
+   inst->exit->tok=null_token;
+   inst->exit->n=((pri->nToks>1)?1:0);
+   inst->max=LZERO;
 }
 
 /* StepInst1: First pass of token propagation (Internal) */
@@ -1057,7 +1052,7 @@ static void StepInst1(PRecInfo *pri, NetNode *node)
    /* Entry tokens valid for t-1, do states 2..N */
    else
       StepWord1(pri,node);
-   node->inst->pxd=FALSE;
+   NodeInst(pri,node)->pxd=FALSE;
 }
 
 /* --------------------- Pass Two Token Propagation --------------- */
@@ -1065,7 +1060,7 @@ static void StepInst1(PRecInfo *pri, NetNode *node)
 /* StepHMM2: propagate entry to exit in Tee models (may be repeated) */
 static void StepHMM2(PRecInfo *pri, NetNode *node)
 {
-   NetInst *inst = node->inst;
+   NetInst *inst = NodeInst(pri,node);
    HMMDef *hmm = node->info.hmm;
    Token cmp;
    TokenSet *res,*cur;
@@ -1085,7 +1080,7 @@ static void StepHMM2(PRecInfo *pri, NetNode *node)
 /* StepWord2: external word propagation/path update - may be repeated */
 static void StepWord2(PRecInfo *pri, NetNode *node)
 {
-   NetInst *inst=node->inst;
+   NetInst *inst=NodeInst(pri,node);
    Ring *r;
    Path *newpth,*oldpth, *p;
    RelToken *src,*tgt;
@@ -1188,8 +1183,8 @@ static void SetEntryState(PRecInfo *pri, NetNode *node,TokenSet *src)
    TokenSet *res;
    NetNode *wmax;
 
-   if (node->inst==NULL) AttachInst(pri,node);
-   inst=node->inst;  res=inst->state;
+   if (NodeInst(pri,node)==NULL) AttachInst(pri,node);
+   inst=NodeInst(pri,node);  res=inst->state;
 #ifdef SANITY
    if ((res->n==0 && src->n!=0) || (res->n!=0 && src->n==0))
       HError(8590,"SetEntryState: TokenSet size mismatch");
@@ -1204,7 +1199,7 @@ static void SetEntryState(PRecInfo *pri, NetNode *node,TokenSet *src)
    wmax = pri->wordMaxNode;
    /* Update the global word max node */
    if (node->type==n_word &&
-        (wmax==NULL || wmax->inst==NULL || res->tok.like > wmax->inst->max))
+        (wmax==NULL || NodeInst(pri,wmax)==NULL || res->tok.like > NodeInst(pri,wmax)->max))
       pri->wordMaxNode = node;
 }
 
@@ -1213,26 +1208,24 @@ static void StepInst2(PRecInfo *pri, NetNode *node)
 /* Must be able to survive doing this twice !! */
 {
    TokenSet xtok, *exit;
-   RelToken *rp,*rq,rtoks[MAX_TOKS];
+   RelToken *rp,*rq,rtok,rtoks[MAX_TOKS];
    NetLink *dest;
-   LogFloat linkLM,ngLM,rngLM,like;
+   LogFloat linkLM,ngLM,rngLM;
    int i,j,k;
    LMHistory h,hmain,hlast;
    LabId nextword,w1,w0;
-   RTokBinTreeNode *binp,*binq,btree[MAX_TOKS];
-   Boolean found;
 
    /* Do the word or HMM token propagation */
    if (node_word(node))
       StepWord2(pri,node);  /* Merge tokens and update traceback */
    else if (node_tr0(node) /* && node_hmm(node) */)
       StepHMM2(pri,node);   /* Advance tokens within HMM instance t => t-1 */
-   exit = node->inst->exit;
+   exit = NodeInst(pri,node)->exit;
 
    /* Apply word beam pruning */
    if (node_word(node)){
       if (exit->tok.like<pri->wordThresh) {
-         node->inst->pxd=TRUE; return;
+         NodeInst(pri,node)->pxd=TRUE; return;
       }
    }
 
@@ -1244,7 +1237,7 @@ static void StepInst2(PRecInfo *pri, NetNode *node)
 
       /* Process all possible continuation nodes for this token */
       for(i=0,dest=node->links;i<node->nlinks;i++,dest++) {
-         xtok.n=node->inst->exit->n;
+         xtok.n=exit->n;
 
          linkLM = dest->linkLM*pri->lmScale;       /* Pickup LMProb from link */
          xtok.tok.like = exit->tok.like+linkLM;    /* update total likelihood */
@@ -1290,8 +1283,9 @@ static void StepInst2(PRecInfo *pri, NetNode *node)
                xtok.tok.lm += ngLM;
 
                /* if multiple tokens, process reltokens */
-               if (pri->nToks>1 > 0){
-                  binp = btree;
+               if (pri->nToks>1){
+                  /* rescore each rel token and re-sort in place, set[0..j-1]
+                     holds the sorted survivors, ties keep their order */
                   for (k=0,j=0,rp=xtok.set; k<xtok.n; k++,rp++){
 
                      h.key=0;
@@ -1311,20 +1305,10 @@ static void StepInst2(PRecInfo *pri, NetNode *node)
                      /* Prune rel tokens which ngram pushes outside the NBeam */
                      if (xtok.tok.like+rp->like < pri->nThresh) continue;
 
-                     binp->rtok = *rp;  binp->left = binp->right = 0;
-                     if (j>0) {
-                        like = rp->like; found = FALSE; binq=btree;
-                        while (!found){
-                           if (binq->left == 0  && like <= binq->rtok.like) {
-                              binq->left = j; found = TRUE;
-                           } else if (binq->right == 0 && like > binq->rtok.like){
-                              binq->right = j; found = TRUE;
-                           } else  {
-                              binq = (like <= binq->rtok.like) ? btree+binq->left : btree+binq->right;
-                           }
-                        }
-                     }
-                     binp++; j++;
+                     rtok = *rp;
+                     for (rq=xtok.set+j; rq>xtok.set && (rq-1)->like < rtok.like; rq--)
+                        *rq = *(rq-1);
+                     *rq = rtok; j++;
 
 #ifdef DETAILED_TRACING
                      if ((trace&T_WLM) && (pri->frame >= traceDelay)){
@@ -1337,10 +1321,7 @@ static void StepInst2(PRecInfo *pri, NetNode *node)
 #endif
                   }
                   xtok.n = j;
-                  if (j>0){
-                     BTreeToTokSet(btree,0,xtok.set);
-                     RebaseTokSet(&xtok);
-                  }
+                  if (j>0) RebaseTokSet(&xtok);
                }
 #ifdef DETAILED_TRACING
                if ((trace&T_WLM) && (pri->frame >= traceDelay)){
@@ -1358,7 +1339,7 @@ static void StepInst2(PRecInfo *pri, NetNode *node)
          }
       }
    }
-   node->inst->pxd=TRUE;
+   NodeInst(pri,node)->pxd=TRUE;
 }
 
 /* ------------------------- HMMSet Initialisation --------------------- */
@@ -1800,9 +1781,9 @@ PartialPath FinalBestPath(PRecInfo *pri)
 
    pp.node = NULL; pp.path = NULL; pp.n = 0;
    pp.startFrame=0; pp.startLike = 0.0;
-   if (pri->net->final.inst!=NULL){
-      if (pri->net->final.inst->exit->tok.path!=NULL){
-         pp.path = pri->net->final.inst->exit->tok.path;
+   if (NodeInst(pri,&pri->net->final)!=NULL){
+      if (NodeInst(pri,&pri->net->final)->exit->tok.path!=NULL){
+         pp.path = NodeInst(pri,&pri->net->final)->exit->tok.path;
          for (p = pp.path; p!=NULL; p=p->prev) ++pp.n;
       }
    }
@@ -1880,6 +1861,7 @@ PRecInfo *InitPRecInfo(PSetInfo *psi,int nToks)
 
    /* Set up private parameters */
    pri->qsn=0;pri->qsa=NULL;
+   pri->insts=NULL;pri->ninsts=0;
    pri->psi=NULL;
    pri->net=NULL;
    pri->lmScale=1.0;
@@ -1889,7 +1871,6 @@ PRecInfo *InitPRecInfo(PSetInfo *psi,int nToks)
    if (nToks<=1) pri->nToks=0;
    else if (nToks<=MAX_TOKS) pri->nToks=nToks;
    else pri->nToks=MAX_TOKS;
-   for (i=0; i<TSM_HASH; i++) pri->keyhash[i] = 0;
 
    /* SetUp heaps for recognition */
 
@@ -1931,6 +1912,7 @@ PRecInfo *InitPRecInfo(PSetInfo *psi,int nToks)
 
    /* initialise background model */
    InitBGConfRec(&pri->confinfo,pri->psi->hset);
+   ResetRecStats(pri,FALSE);
    return(pri);
 }
 
@@ -1947,6 +1929,7 @@ void DeletePRecInfo(PRecInfo *pri)
    DeleteHeap(&pri->pathHeap);
    DeleteHeap(&pri->ringHeap);
    DeleteHeap(&pri->heap);
+   if (pri->insts!=NULL) Dispose(&gcheap,pri->insts);
    Dispose(&gcheap,pri);
 }
 
@@ -1955,7 +1938,6 @@ void StartRecognition(PRecInfo *pri,Network *net, float lmScale,
                       LogFloat wordPen, float pScale, float ngScale, LModel *lm)
 
 {
-   NetNode *node;
    NetInst *inst,*next;
    PreComp *pre;
    int i;
@@ -1974,8 +1956,12 @@ void StartRecognition(PRecInfo *pri,Network *net, float lmScale,
    pri->lm = lm;
 
    /* Initialise the network and instances ready for first frame */
-   for (node=pri->net->chain;node!=NULL;node=node->chain) node->inst=NULL;
-   pri->net->final.inst=pri->net->initial.inst=NULL;
+   if (pri->net->numNode > pri->ninsts){
+      if (pri->insts!=NULL) Dispose(&gcheap,pri->insts);
+      pri->ninsts=pri->net->numNode;
+      pri->insts=(NetInst**) New(&gcheap,pri->ninsts*sizeof(NetInst*));
+   }
+   for (i=0;i<pri->net->numNode;i++) pri->insts[i]=NULL;
 
    /* Invalidate all precomputed state and mixture probs */
    for(i=1,pre=pri->psi->sPre+1;i<=pri->psi->nsp;i++,pre++) pre->id=-1;
@@ -1986,7 +1972,7 @@ void StartRecognition(PRecInfo *pri,Network *net, float lmScale,
 
    /* Attach an inst to initial net node, with like=1.0 and null path */
    AttachInst(pri,&pri->net->initial);
-   inst=pri->net->initial.inst;
+   inst=NodeInst(pri,&pri->net->initial);
    inst->state->tok.like=inst->max=0.0;
    inst->state->tok.lm=0.0;
    inst->state->tok.ngPending=FALSE;
@@ -2024,6 +2010,8 @@ void ProcessObservation(PRecInfo *pri,Observation *obs, int id,AdaptXForm *xform
    float thresh;
    char buf[100];
    PartialPath pp;
+   RecStats *rs = &pri->stats;
+   double t0 = 0.0, t1;
 
    pri->inXForm = xform;
    if (pri==NULL)
@@ -2077,6 +2065,7 @@ void ProcessObservation(PRecInfo *pri,Observation *obs, int id,AdaptXForm *xform
       PrecomputeTMix(pri->psi->hset,obs,pri->tmBeam,0);
 
    /* Pass 1 must calculate top of all beams - inc word end !! */
+   if (rs->timing) t0 = GetClockNow();
    pri->genMaxTok = pri->wordMaxTok = null_token;
    pri->genMaxNode = pri->wordMaxNode = NULL;
    for (inst=pri->head.link,j=0; inst!=NULL; inst=inst->link,j++){
@@ -2093,6 +2082,10 @@ void ProcessObservation(PRecInfo *pri,Observation *obs, int id,AdaptXForm *xform
       if (pri->nThresh<LSMALL/2) pri->nThresh=LSMALL/2;
    }
 
+   if (rs->timing) {
+      t1 = GetClockNow(); rs->step1Time += t1-t0; t0 = t1;
+   }
+
    /* Pass 2 Performs external token propagation and pruning */
    for (inst=pri->head.link,j=0;inst!=NULL && inst->node!=NULL;inst=next,j++) {
       if (inst->max<pri->genThresh) {
@@ -2104,8 +2097,19 @@ void ProcessObservation(PRecInfo *pri,Observation *obs, int id,AdaptXForm *xform
       }
    }
 
-   if ((pri->nusedPaths - pri->nusedLastCollect) > pri->pCollThresh)
+   if (rs->timing) {
+      t1 = GetClockNow(); rs->step2Time += t1-t0; t0 = t1;
+   }
+
+   if ((pri->nusedPaths - pri->nusedLastCollect) > pri->pCollThresh) {
       CollectPaths(pri);
+      if (rs->timing) rs->collTime += GetClockNow()-t0;
+   }
+
+   ++rs->frames;
+   rs->nactSum += pri->nact;
+   if (pri->nact > rs->nactMax) rs->nactMax = pri->nact;
+   if (pri->nusedPaths > rs->pathsMax) rs->pathsMax = pri->nusedPaths;
 
    pri->tact+=pri->nact;
    UpdateBGConfRec(pri);
@@ -2144,9 +2148,9 @@ Lattice *CreateLatticeFromOutput(PRecInfo *pri, PartialPath pp, MemHeap *heap, H
   lat=NULL;
   if (heap!=NULL) {
      pri->noTokenSurvived=TRUE;
-     if (pri->net->final.inst!=NULL)
-       if (pri->net->final.inst->exit->tok.path!=NULL)
-	 lat=CreateLattice(pri,heap,pri->net->final.inst->exit,frameDur),
+     if (NodeInst(pri,&pri->net->final)!=NULL)
+       if (NodeInst(pri,&pri->net->final)->exit->tok.path!=NULL)
+	 lat=CreateLattice(pri,heap,NodeInst(pri,&pri->net->final)->exit,frameDur),
 	   pri->noTokenSurvived=FALSE;
 
      if (lat==NULL && forceOutput) {
@@ -2178,7 +2182,7 @@ void CompleteRecognition(PRecInfo *pri)
 
    /* Now dispose of everything apart from the answer */
    for (inst=pri->head.link;inst!=NULL;inst=inst->link){
-      if (inst->node) inst->node->inst=NULL;
+      if (inst->node) NodeInst(pri,inst->node)=NULL;
    }
 
    /* Remove everything from active lists */
@@ -2200,6 +2204,18 @@ void CompleteRecognition(PRecInfo *pri)
    /* printf("Total key hash hits = %d\n",tsmhits);*/
 }
 
+/* EXPORT->ResetRecStats: clear decoder statistics */
+void ResetRecStats(PRecInfo *pri, Boolean timing)
+{
+   RecStats *rs = &pri->stats;
+
+   rs->timing = timing; rs->frames = 0;
+   rs->outpTime = rs->step1Time = rs->step2Time = rs->collTime = 0.0;
+   rs->sPreHits = rs->sPreMiss = rs->mPreHits = rs->mPreMiss = 0;
+   rs->nactSum = rs->tokSum = 0;
+   rs->nactMax = rs->pathsMax = 0;
+}
+
 /* EXPORT->SetPruningLevels: Set pruning levels for following frames */
 void SetPruningLevels(PRecInfo *pri,int maxBeam,LogFloat genBeam,
                       LogFloat wordBeam,LogFloat nBeam,LogFloat tmBeam)
@@ -43,8 +43,6 @@ extern "C" {
 
 /* max number of tokens that can be used in HRec */
 #define MAX_TOKS 50
-/* size hash table used in tok set merging */
-#define TSM_HASH 513
 
 /* Each HMMSet that is used for recognition needs to be    */
 /* initialised prior to use.  Initialisation routine adds  */
@@ -134,6 +132,23 @@ typedef struct {
    int frame;         /* frame number of next expected - sanity check */
 } BGConfRec;
 
+typedef struct {        /* decoder statistics, cumulative since last reset */
+   Boolean timing;      /* set to record section timings as well as counts */
+   int frames;          /* frames processed */
+   double outpTime;     /* secs computing uncached output probs */
+   double step1Time;    /* secs in pass 1 (StepInst1, includes outpTime) */
+   double step2Time;    /* secs in pass 2 (StepInst2) */
+   double collTime;     /* secs in path collection */
+   long sPreHits;       /* state output prob cache hits ... */
+   long sPreMiss;       /*  ... and misses */
+   long mPreHits;       /* shared mixture output prob cache hits ... */
+   long mPreMiss;       /*  ... and misses */
+   long nactSum;        /* sum over frames of active instances */
+   int nactMax;         /* max active instances in any frame */
+   long tokSum;         /* sum over frames of live state tokens */
+   int pathsMax;        /* max path records in use */
+} RecStats;
+
 /* The instances actually store tokens and links etc */
 /* Instances are stored in creation/token propagation order to allow */
 /* null/word/tee instances to be connected together and still do propagation */
@@ -217,14 +232,15 @@ struct precinfo        /* Private recognition information */
    Ring *actvHead;          /* Head of active ring list */
    Ring *actvTail;          /* Tail of active ring list */
 
+   NetInst **insts;         /* Array[0..ninsts-1] of insts indexed by node id */
+   int ninsts;              /* Size of insts */
+
    NetInst head;            /* Head (oldest) of Inst linked list */
    NetInst tail;            /* Tail (newest) of Inst linked list */
    NetInst *nxtInst;        /* Inst used to select next in step sequence */
    LModel *lm;              /* ngram language model if any */
    BGConfRec confinfo;      /* background likes for confidence calc */
-
-   unsigned int keyhash[TSM_HASH];  /* hash for key checking in tokset merge */
-   int keyused[MAX_TOKS];			/* record which keys need clearing */
+   RecStats stats;          /* decoder statistics */
 
    /* private use by sanity checking */
    NetInst *start_inst;     /* Inst that started a move */
@@ -295,6 +311,7 @@ void StartRecognition(PRecInfo *pri,Network *net, float lmScale,
    Commence recognition using previously initialised recogniser using
    supplied network, language model scales and word insertion penalty.
    If lm not null, then add ngScale*ngProg to all scaled link probs in network.
+   The network is not changed, so several recognisers may use it at once.
 */
 
 void ProcessObservation(PRecInfo *pri,Observation *obs,int id, AdaptXForm *xform);
@@ -316,6 +333,13 @@ float GetConfidence(PRecInfo *pri, int st, int en, LogFloat a, char * word);
 	word is only needed for debug purposes, pass "" otherwise.
 */
 
+void ResetRecStats(PRecInfo *pri, Boolean timing);
+/*
+   Clear the decoder statistics in pri->stats.  If timing is TRUE
+   time spent in each stage of ProcessObservation is also recorded,
+   otherwise only the (cheap) counts are maintained.
+*/
+
 void SetPruningLevels(PRecInfo *pri,int maxBeam,LogFloat genBeam,
 		      LogFloat wordBeam,LogFloat nBeam,LogFloat tmBeam);
 /*
@@ -341,7 +365,7 @@ PartialPath CurrentBestPath(PRecInfo *pri);
 
 PartialPath FinalBestPath(PRecInfo *pri);
 /*
-  traceback of path from pri->net->final.inst->exit
+  traceback of path from the exit of the final node's inst
 */
 
 void PrintPartialPath(PartialPath pp, Boolean inDetail);
@@ -55,6 +55,7 @@ extern char * hthreads_version;
 
 #ifdef UNIX
 #include <sys/ioctl.h>
+#include <time.h>
 #endif
 
 /* ------------------------ Trace Flags --------------------- */
@@ -115,6 +116,20 @@ HTime GetTimeNow()
    return tnow-startTime;
 }
 
+double GetClockNow()
+{
+#ifdef WIN32
+   LARGE_INTEGER f,c;
+   QueryPerformanceFrequency(&f);
+   QueryPerformanceCounter(&c);
+   return (double)c.QuadPart / (double)f.QuadPart;
+#else
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC,&t);
+   return (double)t.tv_sec + (double)t.tv_nsec*1e-9;
+#endif
+}
+
 /* ------------- Extended File Name Handling ---------------- */
 
 /* RegisterExtFileName: record details of fn exts if any in circ buffer */
@@ -482,16 +497,14 @@ static ReturnStatus ReadConfigFile(char *fname)
          if (strcmp(value,"F")==0 || strcmp(value,"FALSE")==0) {
             e->param.kind = BoolCKind; e->param.val.b = FALSE;
          } else
-            if (NumHead(value)){
-               x = strtod(value,&s);
-               if (s==NULL || *s == '\0'){
-                  if (strchr(value,'.') == NULL){
-                     e->param.kind = IntCKind;
-                     e->param.val.i = strtol(value,NULL,0);
-                  }else{
-                     e->param.kind = FltCKind;
-                     e->param.val.f = x;
-                  }
+            if (NumHead(value) && (x = strtod(value,&s), *s == '\0')){
+               /* values such as 0-1,3 which only start as numbers are strings */
+               if (strchr(value,'.') == NULL){
+                  e->param.kind = IntCKind;
+                  e->param.val.i = strtol(value,NULL,0);
+               }else{
+                  e->param.kind = FltCKind;
+                  e->param.val.f = x;
                }
             } else {
                e->param.kind = StrCKind;
@@ -305,6 +305,12 @@ HTime GetTimeNow();
    TimeNow - in HTK units (accuracy/granularity not guaranteed)
 */
 
+double GetClockNow();
+/*
+   Monotonic high resolution clock in seconds for timing code
+   sections.  The origin is arbitrary so only differences are useful.
+*/
+
 /* ----------------- Command Line Argument Handling ------------------ */
 
 typedef enum {SWITCHARG, STRINGARG, INTARG, FLOATARG, NOARG} ArgKind;
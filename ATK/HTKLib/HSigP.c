@@ -35,9 +35,13 @@
 char *hsigp_version = "!HVER!HSigP: 1.6.0 [SJY 01/06/07]";
 
 #include "HShell.h"        /* HTK Libraries */
+#include "HThreads.h"
 #include "HMem.h"
 #include "HMath.h"
 #include "HSigP.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 /*
    This module provides a set of basic speech signal processing
@@ -49,10 +53,12 @@ char *hsigp_version = "!HVER!HSigP: 1.6.0 [SJY 01/06/07]";
 static int trace = 0;
 #define T_MEL  0002     /* Mel filterbank */
 #define T_CMN  0004     /* trace cepstral mean norm */
+#define T_RCV  0010     /* trace rate conversion */
 
 /* -------------------- Config and Memory ----------------------- */
 
 static MemHeap sigpHeap;
+static MemHeap rcHeap;        /* shared rate conversion filter banks */
 static ConfParam *cParm[MAXGLOBS];       /* config parameters */
 static int numParm = 0;
 
@@ -69,6 +75,7 @@ void InitSigP(void)
       if (GetConfInt(cParm,numParm,"TRACE",&i)) trace = i;
    }
    CreateHeap(&sigpHeap,"sigpHeap",MSTAK,1,0.0,5000,5000);
+   CreateHeap(&rcHeap,"rcHeap",MSTAK,1,0.5,10000,100000);
 }
 
 /* --------------- Windowing and PreEmphasis ---------------------*/
@@ -966,4 +973,226 @@ void NormaliseLogEnergy(float *data,int n,int step,float silFloor,float escale)
 }
 
 
+/* -------------------- Sample Rate Conversion --------------------- */
+
+/*
+   Rate conversion is by polyphase FIR filtering with an interpolating
+   function designed as in rateconv.c by Markus Mummert: a sinc
+   function with cutoff fgK windowed by a gaussian with key frequency
+   fgG.  For a reduced ratio up/down, output sample n is the inner
+   product of the input from floor(n*down/up) with row n%up of the
+   filter bank.  Coefficients and samples are 16 bits so that the
+   inner product maps directly onto SSE2 pmaddwd when available.
+*/
+
+#define RC_FIXSHIFT 15        /* coefs are scaled by 2^RC_FIXSHIFT */
+#define RC_ALIGN    8         /* bank rows padded to RC_ALIGN coefs */
+#define RC_BLOCK    1024      /* input frames buffered per pass */
+#define RC_MAXUP    2000      /* max reduced up/down ratio */
+#define RC_GAIN     0.8       /* avoids overflow from filter overshoot */
+
+typedef struct _RCBank {
+   int up,down;               /* reduced conversion ratio */
+   int len;                   /* filter length */
+   int plen;                  /* row length padded to RC_ALIGN */
+   short *coef;               /* up rows of plen coefs */
+   int *step;                 /* input offset of each row */
+   struct _RCBank *next;
+} RCBank;
+
+typedef struct _RateConvRec {
+   RCBank *bank;              /* shared filter bank */
+   int nChans;                /* interleaved channels */
+   short **hist;              /* input history for each channel */
+   int hSize;                 /* size of each history */
+   int nHist;                 /* input frames in history */
+   int base;                  /* history index for row 0 of cycle */
+   int phase;                 /* current bank row */
+} RateConvRec;
+
+static RCBank *rcBanks = NULL;   /* all banks computed so far */
+
+/* RCInterpol: evaluate interpolating function at t */
+static double RCInterpol(double t, double fgk, double fgg)
+{
+   double x = PI*2*fgk*t;
+
+   x = (fabs(x)<1E-50) ? 1.0 : sin(fmod(x,2*PI))/x;
+   return 2*fgk*x*exp(-PI*(2*fgg*t)*(2*fgg*t));
+}
+
+/* RCGetBank: return filter bank for up/down, making it if needed */
+static RCBank *RCGetBank(int up, int down)
+{
+   RCBank *b;
+   double fgk = 0.461, fgg = 0.0116, c;
+   int i,q;
+
+   HGlobalLock();
+   for (b=rcBanks; b!=NULL; b=b->next)
+      if (b->up==up && b->down==down) break;
+   if (b==NULL){
+      b = (RCBank *)New(&rcHeap,sizeof(RCBank));
+      b->up = up; b->down = down; b->len = 162;
+      if (down>up){
+         fgk *= (double)up/down; fgg *= (double)up/down;
+         b->len = b->len*down/up;
+      }
+      b->plen = (b->len+RC_ALIGN-1)/RC_ALIGN*RC_ALIGN;
+      b->coef = (short *)New(&rcHeap,up*b->plen*sizeof(short));
+      b->step = (int *)New(&rcHeap,up*sizeof(int));
+      for (q=0; q<up; q++){
+         b->step[q] = (int)((long)q*down/up);
+         for (i=0; i<b->plen; i++){
+            c = 0.0;
+            if (i<b->len)
+               c = (1<<RC_FIXSHIFT) * RC_GAIN * RCInterpol(
+                  fmod((double)q*down/up,1.0) + (b->len-1)/2.0 - i, fgk, fgg);
+            b->coef[q*b->plen+i] = (short)floor(c+0.5);
+         }
+      }
+      b->next = rcBanks; rcBanks = b;
+      if (trace&T_RCV)
+         printf("HSigP: rate conv bank %d/%d, %d taps\n",up,down,b->len);
+   }
+   HGlobalUnlock();
+   return b;
+}
+
+/* RCDot: inner product of n samples in x with coefs c, n%RC_ALIGN==0 */
+static int RCDot(short *x, short *c, int n)
+{
+   int i;
+#ifdef __SSE2__
+   __m128i sum = _mm_setzero_si128();
+
+   for (i=0; i<n; i+=8)
+      sum = _mm_add_epi32(sum,_mm_madd_epi16(
+         _mm_loadu_si128((__m128i *)(x+i)),_mm_loadu_si128((__m128i *)(c+i))));
+   sum = _mm_add_epi32(sum,_mm_shuffle_epi32(sum,0x4e));
+   sum = _mm_add_epi32(sum,_mm_shuffle_epi32(sum,0xb1));
+   return _mm_cvtsi128_si32(sum);
+#else
+   int sum = 0;
+
+   for (i=0; i<n; i++)
+      sum += x[i]*c[i];
+   return sum;
+#endif
+}
+
+/* RCAppend: append n frames from in (zeros if NULL) to the history */
+static void RCAppend(RateConv rc, short *in, int n)
+{
+   int i,j;
+   short *h;
+
+   for (j=0; j<rc->nChans; j++){
+      h = rc->hist[j] + rc->nHist;
+      if (in==NULL)
+         memset(h,0,n*sizeof(short));
+      else
+         for (i=0; i<n; i++) h[i] = in[i*rc->nChans+j];
+   }
+   rc->nHist += n;
+}
+
+/* RCFilter: output all frames for which history is complete, then
+   discard history which is no longer needed */
+static int RCFilter(RateConv rc, short *out)
+{
+   RCBank *b = rc->bank;
+   int j,k,s,n = 0;
+   short *c;
+
+   while ((s = rc->base + b->step[rc->phase]) + b->len <= rc->nHist){
+      c = b->coef + rc->phase*b->plen;
+      for (j=0; j<rc->nChans; j++){
+         k = RCDot(rc->hist[j]+s,c,b->plen);
+         k = (k + (1<<(RC_FIXSHIFT-1))) >> RC_FIXSHIFT;
+         *out++ = (short)((k>32767) ? 32767 : ((k<-32768) ? -32768 : k));
+      }
+      ++n;
+      if (++rc->phase == b->up){
+         rc->phase = 0; rc->base += b->down;
+      }
+   }
+   k = (rc->base < rc->nHist) ? rc->base : rc->nHist;
+   if (k>0){
+      for (j=0; j<rc->nChans; j++)
+         memmove(rc->hist[j],rc->hist[j]+k,(rc->nHist-k)*sizeof(short));
+      rc->nHist -= k; rc->base -= k;
+   }
+   return n;
+}
+
+/* EXPORT->CreateRateConv: create a converter from inRate to outRate */
+RateConv CreateRateConv(MemHeap *x, int inRate, int outRate, int nChans)
+{
+   RateConv rc;
+   int i,up,down,g;
+
+   if (inRate<=0 || outRate<=0 || nChans<1)
+      HError(5325,"CreateRateConv: bad rates %d/%d or channels %d",
+             inRate,outRate,nChans);
+   for (up=outRate,g=inRate; g!=0; ){
+      i = up%g; up = g; g = i;
+   }
+   g = up; up = outRate/g; down = inRate/g;
+   if (up>RC_MAXUP)
+      HError(5325,"CreateRateConv: ratio %d/%d too complex",up,down);
+   rc = (RateConv)New(x,sizeof(RateConvRec));
+   rc->bank = RCGetBank(up,down);
+   rc->nChans = nChans;
+   rc->hSize = rc->bank->len + down + RC_BLOCK + RC_ALIGN;
+   rc->hist = (short **)New(x,nChans*sizeof(short *));
+   for (i=0; i<nChans; i++)
+      rc->hist[i] = (short *)New(x,rc->hSize*sizeof(short));
+   ResetRateConv(rc);
+   return rc;
+}
+
+/* EXPORT->ResetRateConv: discard held over input */
+void ResetRateConv(RateConv rc)
+{
+   int i;
+
+   /* history starts with len-1 zeros so the filter runs on at
+      the start as it does at the end */
+   for (i=0; i<rc->nChans; i++)
+      memset(rc->hist[i],0,rc->hSize*sizeof(short));
+   rc->nHist = rc->bank->len-1;
+   rc->base = rc->phase = 0;
+}
+
+/* EXPORT->RateConvSize: max frames output for nIn input frames */
+int RateConvSize(RateConv rc, int nIn)
+{
+   RCBank *b = rc->bank;
+
+   return (int)(((long)nIn + b->len + b->down)*b->up/b->down) + 1;
+}
+
+/* EXPORT->RunRateConv: convert nIn frames from in to out */
+int RunRateConv(RateConv rc, short *in, int nIn, short *out)
+{
+   int n,nOut = 0;
+
+   while (nIn>0){
+      n = rc->hSize - RC_ALIGN - rc->nHist;
+      if (n>nIn) n = nIn;
+      RCAppend(rc,in,n);
+      if (in!=NULL) in += n*rc->nChans;
+      nIn -= n;
+      nOut += RCFilter(rc,out+nOut*rc->nChans);
+   }
+   return nOut;
+}
+
+/* EXPORT->FlushRateConv: output remaining frames */
+int FlushRateConv(RateConv rc, short *out)
+{
+   return RunRateConv(rc,NULL,rc->bank->len-1,out);
+}
+
 /* ------------------------ End of HSigP.c ------------------------- */
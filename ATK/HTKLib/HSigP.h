@@ -269,6 +269,43 @@ void NormaliseLogEnergy(float *data, int n, int step, float silFloor, float esca
    in dB.  Escale is used to scale the normalised log energy.
 */
 
+/* -------------------- Sample Rate Conversion --------------------- */
+
+typedef struct _RateConvRec *RateConv;
+
+RateConv CreateRateConv(MemHeap *x, int inRate, int outRate, int nChans);
+/*
+   Create a streaming converter from inRate to outRate (in Hz) for
+   nChans interleaved channels.  The polyphase filter bank for each
+   reduced up/down ratio is computed once and shared by all
+   converters with that ratio.  The output lags the input by half
+   the filter length.
+*/
+
+int RateConvSize(RateConv rc, int nIn);
+/*
+   Return the max number of frames which RunRateConv can output for
+   nIn input frames, or FlushRateConv when nIn is 0.
+*/
+
+int RunRateConv(RateConv rc, short *in, int nIn, short *out);
+/*
+   Convert nIn frames from in and store them in out, returning the
+   number of frames output.  Input not yet used is held over to the
+   next call so a stream can be passed in blocks of any size.
+*/
+
+int FlushRateConv(RateConv rc, short *out);
+/*
+   Output the remaining frames by running the filter off the end of
+   the input and return the number of frames output.
+*/
+
+void ResetRateConv(RateConv rc);
+/*
+   Discard any held over input ready to start a new stream
+*/
+
 #ifdef __cplusplus
 }
 #endif
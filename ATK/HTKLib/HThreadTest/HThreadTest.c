@@ -37,6 +37,7 @@ char *hthreadtest_version = "!HVER!HThreadTest: 1.6.0 [SJY 01/06/07]";
 
 #include <stdio.h>
 #include <math.h>
+#include <time.h>
 #include "HShell.h"
 #include "HThreads.h"
 #include "HMem.h"
@@ -48,6 +49,14 @@ char *hthreadtest_version = "!HVER!HThreadTest: 1.6.0 [SJY 01/06/07]";
 #include "HParm.h"
 #include "HLabel.h"
 #include "HGraf.h"
+#ifdef UNIX
+#include <unistd.h>
+#include <sched.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
 
 static int sMon = HT_NOMONITOR; /* HT_MSGMON */
 
@@ -58,6 +67,10 @@ void ReportUsage(void)
    printf("   2.  SimpleMutex(numThreads,lockon)\n");
    printf("   3.  SimpleSignal()\n");
    printf("   4.  BufferTest(nChars,bSize,pDelay,cDelay,pcPrioStr)\n");
+   printf("   5.  LockCost(numIdle,numWorkers,nIters,spin)\n");
+   printf("   6.  EventWakeup(nEvents,burst,watch)\n");
+   printf("   7.  CaptureJitter(nLoad,periodMs,nTicks,rtPrio,cpu)\n");
+   printf("   8.  SnapshotSwap(numReaders,nSwaps)\n");
    exit(1);
 }
 
@@ -327,6 +340,347 @@ void BufferTest(int nChars,int bSize,int pDelay,int cDelay,char *pcPrioStr)
 }
 
 
+/* ------------- Test 5 -  Lock Cost  ------------- */
+
+static HLock t5_lock, t5_idlelock;
+static HSignal t5_wake;
+static int t5_count = 0;
+static int t5_iters;
+static Boolean t5_done = FALSE;
+
+TASKTYPE TASKMOD idler(void * n)
+{
+   HEnterSection(t5_idlelock);
+   while (!t5_done) HWaitSignal(t5_wake,t5_idlelock);
+   HLeaveSection(t5_idlelock);
+   HExitThread(0);
+   return 0;
+}
+
+TASKTYPE TASKMOD worker(void * n)
+{
+   int i;
+
+   for (i=0; i<t5_iters; i++){
+      HEnterSection(t5_lock);
+      HEnterSection(t5_lock);          /* nested entry */
+      ++t5_count;
+      HLeaveSection(t5_lock);
+      HLeaveSection(t5_lock);
+   }
+   HExitThread(0);
+   return 0;
+}
+
+/* TimeLocks: return cpu usecs per enter/leave pair of t5_lock */
+double TimeLocks(int nIters)
+{
+   clock_t t0;
+   int i;
+
+   t0 = clock();
+   for (i=0; i<nIters; i++){
+      HEnterSection(t5_lock); HLeaveSection(t5_lock);
+   }
+   return (double)(clock()-t0)*1e6/CLOCKS_PER_SEC/nIters;
+}
+
+void LockCost(int numIdle, int numWorkers, int nIters, int spin)
+{
+   HThread t[1000];
+   int i,status;
+   char name[100];
+   double t1,t2;
+
+   if (numIdle<0) numIdle = 0;
+   if (numWorkers<0) numWorkers = 0;
+   if (numIdle+numWorkers>1000) {
+      printf("too many threads\n"); exit(1);
+   }
+   if (nIters<1) nIters = 1;
+   HSetLockSpin(spin);
+   t5_lock = HCreateLock("t5_lock");
+   t5_idlelock = HCreateLock("t5_idlelock");
+   t5_wake = HCreateSignal("t5_wake");
+   t1 = TimeLocks(nIters);
+   printf(" no other threads:   %.3f usecs per enter/leave\n",t1);
+   for (i=0; i<numIdle; i++){
+      sprintf(name,"idle%d",i+1);
+      t[i] = HCreateThread(name,10,HPRIO_NORM,idler,(void *)i);
+   }
+   t2 = TimeLocks(nIters);
+   printf(" %4d idle threads:   %.3f usecs per enter/leave\n",numIdle,t2);
+   HEnterSection(t5_idlelock);
+   t5_done = TRUE;
+   HLeaveSection(t5_idlelock);
+   for (i=0; i<numIdle; i++){
+      HEnterSection(t5_idlelock);
+      HSendSignal(t5_wake);
+      HLeaveSection(t5_idlelock);
+      HJoinThread(t[i],&status);
+   }
+   /* contended, nested use of one lock */
+   t5_iters = nIters;
+   for (i=0; i<numWorkers; i++){
+      sprintf(name,"worker%d",i+1);
+      t[i] = HCreateThread(name,10,HPRIO_NORM,worker,(void *)i);
+   }
+   for (i=0; i<numWorkers; i++)
+      HJoinThread(t[i],&status);
+   printf(" %4d workers:  count = %d (should be %d)\n",
+          numWorkers,t5_count,numWorkers*nIters);
+}
+
+/* ------------- Test 6 -  Event Wakeup  ------------- */
+
+static int t6_events, t6_ticks;     /* expected buffer events and ticks */
+static int t6_fds[2];                /* tick pipe, if watched */
+static int t6_got = 0;               /* events received so far */
+static HLock t6_lock;
+static HSignal t6_caught;            /* sent when reader has caught up */
+
+TASKTYPE TASKMOD eventReader(void * n)
+{
+   HEventRec e;
+   int nEv = 0, nTick = 0;
+   char buf[256];
+
+#ifdef UNIX
+   if (t6_ticks>0) HWatchFd(t6_fds[0],2);
+#endif
+   while (nEv<t6_events || nTick<t6_ticks){
+      e = HGetEvent(0,0);
+      if (e.event != HTBUFFER) continue;
+      if (e.c == 1) {
+         ++nEv;
+         HEnterSection(t6_lock);
+         ++t6_got; HSendSignal(t6_caught);
+         HLeaveSection(t6_lock);
+      }
+#ifdef UNIX
+      else if (e.c == 2) nTick += read(t6_fds[0],buf,256);
+#endif
+   }
+   printf(" reader: %d events and %d ticks received\n",nEv,nTick);
+   HExitThread(0);
+   return 0;
+}
+
+void EventWakeup(int nEvents, int burst, int watch)
+{
+   HThread t;
+   int i,status;
+   double t0;
+
+   if (nEvents<1) nEvents = 1;
+   if (burst<1) burst = 1;
+   t6_events = nEvents; t6_ticks = 0;
+   t6_lock = HCreateLock("t6_lock");
+   t6_caught = HCreateSignal("t6_caught");
+#ifdef UNIX
+   if (watch) {
+      if (pipe(t6_fds) != 0) { printf("cant make pipe\n"); exit(1); }
+      t6_ticks = (nEvents+burst-1)/burst;
+   }
+#endif
+   t = HCreateThread("reader",10,HPRIO_NORM,eventReader,(void *)0);
+   t0 = GetClockNow();
+   for (i=0; i<nEvents; i++){
+      HBufferEvent(t,1);
+      if ((i+1)%burst == 0 || i == nEvents-1) {
+#ifdef UNIX
+         if (watch && write(t6_fds[1],"t",1) != 1) {
+            printf("cant write pipe\n"); exit(1);
+         }
+#endif
+         /* wait for the reader to catch up, so each burst wakes it */
+         HEnterSection(t6_lock);
+         while (t6_got < i+1) HWaitSignal(t6_caught,t6_lock);
+         HLeaveSection(t6_lock);
+      }
+   }
+   HJoinThread(t,&status);
+   printf(" %d events in bursts of %d: %.3f usecs per event\n",
+          nEvents,burst,(GetClockNow()-t0)*1e6/nEvents);
+}
+
+/* ------------- Test 7 -  Capture Jitter  ------------- */
+
+static volatile Boolean t7_done = FALSE;  /* load threads must stop */
+static int t7_period, t7_ticks;           /* capture period (msecs) and ticks */
+static double *t7_late;                   /* lateness of each tick */
+
+/* loader: a decoder which never blocks */
+TASKTYPE TASKMOD loader(void * n)
+{
+   volatile double x = 1.0;
+
+   while (!t7_done) {
+      x = x*1.0000001 + 1e-9;
+      if (x > 1e6) x = 1.0;
+   }
+   HExitThread(0);
+   return 0;
+}
+
+/* capturer: wakes every t7_period msecs as an audio driver would,
+   and records how late each wakeup is */
+TASKTYPE TASKMOD capturer(void * n)
+{
+   double next, now;
+   int k;
+#ifdef UNIX
+   struct timespec ts;
+   struct sched_param param;
+   int policy;
+
+   pthread_getschedparam(pthread_self(),&policy,&param);
+   printf(" capture: %s priority %d",(policy==SCHED_FIFO)?"SCHED_FIFO":
+          (policy==SCHED_RR)?"SCHED_RR":"SCHED_OTHER",param.sched_priority);
+#ifdef __linux__
+   printf(" nice %d",getpriority(PRIO_PROCESS,(id_t)syscall(SYS_gettid)));
+#endif
+   printf("\n"); fflush(stdout);
+#endif
+   next = GetClockNow();
+   for (k=0; k<t7_ticks; k++){
+      next += t7_period/1000.0;
+#ifdef UNIX
+      ts.tv_sec = (time_t)next; ts.tv_nsec = (long)((next-ts.tv_sec)*1e9);
+      while (clock_nanosleep(CLOCK_MONOTONIC,TIMER_ABSTIME,&ts,NULL) == EINTR);
+#else
+      now = next - GetClockNow();
+      if (now > 0) HPauseThread((int)(now*1000+0.5));
+#endif
+      now = GetClockNow();
+      t7_late[k] = (now>next) ? now-next : 0.0;
+   }
+   HExitThread(0);
+   return 0;
+}
+
+static int CmpDouble(const void *a, const void *b)
+{
+   double x = *(const double *)a, y = *(const double *)b;
+   return (x<y) ? -1 : (x>y) ? 1 : 0;
+}
+
+void CaptureJitter(int nLoad, int periodMs, int nTicks, int rtPrio, int cpu)
+{
+   HThread t[1000], cap;
+   int i,status,over;
+   char name[100];
+   double sum;
+
+   if (nLoad<0) nLoad = 0;
+   if (nLoad>1000) { printf("too many threads\n"); exit(1); }
+   if (periodMs<1) periodMs = 1;
+   if (nTicks<1) nTicks = 1;
+   t7_period = periodMs; t7_ticks = nTicks;
+   t7_late = (double *)malloc(nTicks*sizeof(double));
+   HSetPriorityMap(rtPrio,FALSE,-10,0);
+   for (i=0; i<nLoad; i++){
+      sprintf(name,"load%d",i+1);
+      t[i] = HCreateThread(name,10,HPRIO_NORM,loader,(void *)i);
+   }
+   cap = HCreateThread("capture",10,HPRIO_HIGH,capturer,(void *)0);
+   if (cpu>=0) {
+      sprintf(name,"%d",cpu);
+      for (i=0; i<nLoad; i++) HSetThreadAffinity(t[i],name);
+      HSetThreadAffinity(cap,name);
+   }
+   HJoinThread(cap,&status);
+   t7_done = TRUE;
+   for (i=0; i<nLoad; i++)
+      HJoinThread(t[i],&status);
+   for (i=0,sum=0.0,over=0; i<nTicks; i++){
+      sum += t7_late[i];
+      if (t7_late[i] > periodMs/2000.0) ++over;
+   }
+   qsort(t7_late,nTicks,sizeof(double),CmpDouble);
+   printf(" %d load threads, %d ticks of %dms\n",nLoad,nTicks,periodMs);
+   printf(" lateness mean %.1f usecs, 99%% %.1f usecs, max %.1f usecs\n",
+          sum*1e6/nTicks,t7_late[(int)(0.99*(nTicks-1))]*1e6,t7_late[nTicks-1]*1e6);
+   printf(" %d ticks later than half a period\n",over);
+   free(t7_late);
+}
+
+/* ------------- Test 8 -  Snapshot Swap  ------------- */
+
+typedef struct {
+   int magic;              /* T8_MAGIC until freed */
+   volatile int refs;      /* readers holding it, plus 1 while current */
+} T8Snap;
+
+#define T8_MAGIC 0x5eed
+
+static T8Snap * volatile t8_cur;     /* current snapshot */
+static volatile int t8_readers = 0;  /* acquires in progress */
+static volatile Boolean t8_done = FALSE;
+static int t8_reads = 0, t8_bad = 0, t8_freed = 0;
+
+static void T8Release(T8Snap *s)
+{
+   if (HAtomicAdd(&s->refs,-1) == 0){
+      s->magic = 0; free(s); HAtomicAdd(&t8_freed,1);
+   }
+}
+
+/* snapReader: acquire the current snapshot without locking, check it
+   has not been freed and release it */
+TASKTYPE TASKMOD snapReader(void * n)
+{
+   T8Snap *s;
+   int reads = 0, bad = 0;
+
+   while (!t8_done) {
+      HAtomicAdd(&t8_readers,1);
+      s = t8_cur; HAtomicAdd(&s->refs,1);
+      HAtomicAdd(&t8_readers,-1);
+      if (s->magic != T8_MAGIC) ++bad;
+      ++reads;
+      T8Release(s);
+   }
+   HAtomicAdd(&t8_reads,reads); HAtomicAdd(&t8_bad,bad);
+   HExitThread(0);
+   return 0;
+}
+
+void SnapshotSwap(int numReaders, int nSwaps)
+{
+   HThread t[1000];
+   T8Snap *s;
+   int i,status;
+   char name[100];
+   double t0;
+
+   if (numReaders<1) numReaders = 1;
+   if (numReaders>1000) { printf("too many threads\n"); exit(1); }
+   s = (T8Snap *)malloc(sizeof(T8Snap));
+   s->magic = T8_MAGIC; s->refs = 1; t8_cur = s;
+   for (i=0; i<numReaders; i++){
+      sprintf(name,"reader%d",i+1);
+      t[i] = HCreateThread(name,10,HPRIO_NORM,snapReader,(void *)i);
+   }
+   t0 = GetClockNow();
+   for (i=0; i<nSwaps; i++){
+      s = (T8Snap *)malloc(sizeof(T8Snap));
+      s->magic = T8_MAGIC; s->refs = 1;
+      s = (T8Snap *)HAtomicSwap((void * volatile *)&t8_cur,s);
+      /* wait until no reader can still be about to reference s */
+      while (t8_readers > 0) HDeschedule();
+      T8Release(s);
+   }
+   t0 = GetClockNow() - t0;
+   t8_done = TRUE;
+   for (i=0; i<numReaders; i++)
+      HJoinThread(t[i],&status);
+   printf(" %d readers: %d reads, %d reads of freed snapshots\n",numReaders,t8_reads,t8_bad);
+   printf(" %d swaps: %d snapshots freed, %.3f usecs per swap\n",
+          nSwaps,t8_freed,t0*1e6/(nSwaps>0?nSwaps:1));
+   T8Release(t8_cur);
+}
+
 /* ---------------------- End of Tests --------------------------- */
 
 int main(int argc, char *argv[])
@@ -360,6 +714,20 @@ int main(int argc, char *argv[])
 			a1 = GetIntArg(); a2 = GetIntArg();
 			a3 = GetIntArg(); a4 = GetIntArg();
 			BufferTest(a1,a2,a3,a4,GetStrArg()); break;
+		case 5:
+			a1 = GetIntArg(); a2 = GetIntArg();
+			a3 = GetIntArg(); a4 = GetIntArg();
+			LockCost(a1,a2,a3,a4); break;
+		case 6:
+			a1 = GetIntArg(); a2 = GetIntArg(); a3 = GetIntArg();
+			EventWakeup(a1,a2,a3); break;
+		case 7:
+			a1 = GetIntArg(); a2 = GetIntArg();
+			a3 = GetIntArg(); a4 = GetIntArg();
+			CaptureJitter(a1,a2,a3,a4,GetIntArg()); break;
+		case 8:
+			a1 = GetIntArg(); a2 = GetIntArg();
+			SnapshotSwap(a1,a2); break;
 		default:
 			printf("Bad test number %d\n",n); ReportUsage();
 		}
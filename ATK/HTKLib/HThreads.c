@@ -33,6 +33,19 @@
 /* ----------------------------------------------------------- */
 
 /* Linux support by MNS */
+/* Thread records cached in thread local storage, status only
+   recorded when monitored 19/10/26 */
+/* Task records for tasks run on shared worker threads 19/10/26 */
+/* Event queues are rings woken via eventfd/epoll 19/10/26 */
+/* Thread and task record cpu times 19/10/26 */
+/* Real-time and nice priorities, cpu affinity 19/10/26 */
+/* Refused nice values reported 19/10/26 */
+/* Atomic add and swap 19/10/26 */
+/* HLock owner and depth read atomically outside the mutex 19/10/26 */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE        /* for cpu affinity */
+#endif
 
 char *hthreads_version = "!HVER!HThreads: 1.6.0 [SJY 01/06/07]";
 
@@ -43,6 +56,12 @@ char *hthreads_version = "!HVER!HThreads: 1.6.0 [SJY 01/06/07]";
 #include "HGraf.h"
 #ifdef UNIX
 #include <pthread.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/resource.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
 #ifdef XGRAFIX
 #include <X11/Xlib.h>
 #endif
@@ -62,8 +81,51 @@ static int numLockRecords   = 0;
 static HLockT glock;               /* global lightweight lock */
 static HLockT mlock;               /* hmem lock */
 static HLockT tlock;               /* lock protecting this module */
-static Boolean updated=FALSE;      /* true when updated */
+static volatile Boolean updated=FALSE; /* true when updated */
 static HThread monThread=NULL;     /* the monitor thread ... */
+static int lockSpin = 0;           /* tries of a held HLock before blocking */
+static int rtPrio = 0;             /* real-time priority of HPRIO_HIGH, 0 if none */
+static int rtRR = 0;               /* use SCHED_RR rather than SCHED_FIFO */
+static int highNice = 0;           /* nice of HPRIO_HIGH threads if not real-time */
+static int lowNice = 0;            /* nice of HPRIO_LOW threads */
+static int rtWarned = 0;           /* real-time refusal has been reported */
+static volatile int niceWarned = 0;/* nice refusals reported, warn once */
+static unsigned int threadIDCounter = 1; /* ids of unix threads and tasks */
+
+#ifdef UNIX
+/* HEnterSection reads the owner and depth of a lock without holding
+   its mutex, so they are accessed atomically.  depth is stored after
+   owner with release and loaded with acquire, so a thread which sees
+   another's depth also sees its owner, and only ever sees itself as
+   owner while it holds the mutex */
+#define LockDepth(l) __atomic_load_n(&(l)->lock.depth,__ATOMIC_ACQUIRE)
+#define SetLockDepth(l,d) __atomic_store_n(&(l)->lock.depth,(d),__ATOMIC_RELEASE)
+
+/* LockHeld: true if thread self holds l */
+static int LockHeld(HLock l, pthread_t self)
+{
+  pthread_t owner;
+
+  if (LockDepth(l)<=0) return 0;
+  __atomic_load(&l->lock.owner,&owner,__ATOMIC_RELAXED);
+  return pthread_equal(owner,self);
+}
+
+/* SetLockOwner: record that self now holds l at the given depth */
+static void SetLockOwner(HLock l, pthread_t self, int depth)
+{
+  __atomic_store(&l->lock.owner,&self,__ATOMIC_RELAXED);
+  SetLockDepth(l,depth);
+}
+#endif
+
+/* Each thread's HThread is kept in its local storage */
+#ifdef WIN32
+static DWORD selfKey;
+#endif
+#ifdef UNIX
+static pthread_key_t selfKey;
+#endif
 
 static char * tsmap[THREAD_STATUS_SIZE] = {
   "Initial", "Waiting", "Running", "Critcal", "Stopped"
@@ -198,6 +260,31 @@ void HMemoryUnlock()
 #endif
 }
 
+/* HAtomicAdd: add n to *p and return the new value */
+int HAtomicAdd(volatile int *p, int n)
+{
+#ifdef WIN32
+  return InterlockedExchangeAdd((volatile LONG *)p,n) + n;
+#endif
+#ifdef UNIX
+  return __sync_add_and_fetch(p,n);
+#endif
+}
+
+/* HAtomicSwap: set *p to v and return the old value */
+void *HAtomicSwap(void * volatile *p, void *v)
+{
+#ifdef WIN32
+  return InterlockedExchangePointer(p,v);
+#endif
+#ifdef UNIX
+  /* test_and_set is only an acquire barrier, so order the stores
+     made before it too */
+  __sync_synchronize();
+  return __sync_lock_test_and_set(p,v);
+#endif
+}
+
 /* HTCreate: create the internal lock and signal needed for monitoring */
 static void HTCreate()
 {
@@ -257,6 +344,11 @@ static void HTUnlock(void)
 /* Send a buffer update event to given thread */
 void HBufferEvent(HThread thread, int bufferId)
 {
+   if (thread != NULL && thread->post != NULL) {
+      if (thread->status < THREAD_STOPPED)
+         thread->post(thread,HTBUFFER,bufferId);
+      return;
+   }
 #ifdef WIN32
    if (thread == NULL)
       HTError("HBufferEvent: null thread (bufferID=%d",bufferId);
@@ -266,10 +358,8 @@ void HBufferEvent(HThread thread, int bufferId)
    }
 #endif
 #ifdef UNIX
-   /* in Linux the equivalent to the ThreadMessage queue is emulated
-   using the XDisplay queues, with a seperate connection to the
-   display server being made by each thread and a window for thread
-   messages */
+   /* in Unix the equivalent to the ThreadMessage queue is the
+   thread's event queue (see EventQueue in HThreads.h) */
    HEventRec r;
    int rc;
 
@@ -307,21 +397,124 @@ static void HTUpdate(void)
   }
 }
 
-/* GetSelf: return self (internal version) */
-static HThread GetSelf(void){
+#ifdef UNIX
+/* InitEventQueue: empty queue, its fds are opened at the first wait */
+static void InitEventQueue(EventQueue *q)
+{
+  int rc;
+
+  q->ring = NULL; q->size = q->head = q->count = 0;
+  q->waiting = 0; q->efd = q->epfd = -1;
+  rc = pthread_cond_init(&(q->cond),NULL);
+  if (rc!=0)
+    HTError("InitEventQueue: cant create signal",rc);
+  rc = pthread_mutex_init(&(q->mux),NULL);
+  if (rc!=0)
+    HTError("InitEventQueue: cant create mux",rc);
+}
+
+/* CloseEventQueue: release the fds of a thread which has finished */
+static void CloseEventQueue(EventQueue *q)
+{
+  pthread_mutex_lock(&(q->mux));
+  if (q->epfd >= 0) close(q->epfd);
+  if (q->efd >= 0) close(q->efd);
+  q->efd = q->epfd = -1;
+  pthread_mutex_unlock(&(q->mux));
+}
+#endif
+
+/* SetSelf: record t in the calling thread's local storage */
+static void SetSelf(HThread t)
+{
+#ifdef WIN32
+  if (!TlsSetValue(selfKey,t))
+    HTError("SetSelf: cannot set thread local storage",GetLastError());
+#endif
+#ifdef UNIX
+  int rc = pthread_setspecific(selfKey,t);
+  if (rc!=0)
+    HTError("SetSelf: cannot set thread local storage",rc);
+#endif
+}
+
+/* FindSelf: return self or NULL if not found, the thread list is only
+   searched (and must not be locked) if self is not yet recorded */
+static HThread FindSelf(void){
   HThread t;
 #ifdef WIN32
-  unsigned int id = GetCurrentThreadId();
+  unsigned int id;
+
+  if ((t = (HThread)TlsGetValue(selfKey)) != NULL) return t;
+  id = GetCurrentThreadId();
+  HTLock();
   for (t=threadList; t!=NULL; t=t->next)
-    if (t->id == id) return t;
+    if (t->id == id) break;
+  HTUnlock();
 #endif
 #ifdef UNIX
-  HThreadT tt = pthread_self();
+  HThreadT tt;
+
+  if ((t = (HThread)pthread_getspecific(selfKey)) != NULL) return t;
+  tt = pthread_self();
+  HTLock();
   for (t=threadList; t!=NULL; t=t->next)
-    if (t->thread == tt) return t;
+    if (pthread_equal(t->thread,tt)) break;
+  HTUnlock();
 #endif
-  HTError("GetSelf: cannot find self",0);
-  return NULL;
+  if (t!=NULL) SetSelf(t);
+  return t;
+}
+
+/* GetSelf: return self (internal version) */
+static HThread GetSelf(void){
+  HThread t = FindSelf();
+
+  if (t==NULL)
+    HTError("GetSelf: cannot find self",0);
+  return t;
+}
+
+/* SelfCPUTime: cpu secs used by the calling thread */
+static double SelfCPUTime(void)
+{
+#ifdef UNIX
+  struct timespec ts;
+
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID,&ts) != 0) return 0.0;
+  return (double)ts.tv_sec + (double)ts.tv_nsec*1e-9;
+#endif
+#ifdef WIN32
+  FILETIME c,e,k,u;
+
+  if (!GetThreadTimes(GetCurrentThread(),&c,&e,&k,&u)) return 0.0;
+  return ((double)k.dwLowDateTime + (double)u.dwLowDateTime +
+          4294967296.0*((double)k.dwHighDateTime + (double)u.dwHighDateTime))*1e-7;
+#endif
+}
+
+/* ThreadStart: record the new thread as self and run its task */
+static TASKTYPE TASKMOD ThreadStart(void *arg)
+{
+  HThread t = (HThread)arg;
+  TASKTYPE r;
+
+  SetSelf(t);
+#ifdef __linux__
+  /* nice applies to the calling thread only on Linux.  Raising
+     priority (nice<0) needs privilege, so it may be refused */
+  if (t->nice != 0 &&
+      setpriority(PRIO_PROCESS,(id_t)syscall(SYS_gettid),t->nice) != 0 &&
+      HAtomicAdd(&niceWarned,1) == 1)
+    HError(-9999,"ThreadStart: nice %d refused for %s [%d]",
+           t->nice,t->name,errno);
+#endif
+  r = t->task(t->arg);
+  t->cpu = SelfCPUTime(); t->cpuFinal = 1;
+#ifdef UNIX
+  CloseEventQueue(&(t->xeq));
+#endif
+  return r;
 }
 
 void HSendAllThreadsCloseEvent(void)
@@ -329,7 +522,9 @@ void HSendAllThreadsCloseEvent(void)
   HThread t,self;
 #ifdef WIN32
   for (t=threadList; t!=NULL; t=t->next) {
-     if (t!=mainThread && t!=monThread  && t->status < THREAD_STOPPED) {
+     if (t->post!=NULL) {
+        if (t->status < THREAD_STOPPED) t->post(t,HWINCLOSE,0);
+     } else if (t!=mainThread && t!=monThread  && t->status < THREAD_STOPPED) {
         while (!PostThreadMessage(t->id,WM_HREQCLOSE,0,0))
            Sleep(10);
      }
@@ -369,9 +564,20 @@ void InitThreads(HMonMode monMode)
   mode = monMode;
   t = (HThread)malloc(sizeof(HThreadRec));
   t->name = CopyName("main"); t->info = NULL;
+  t->task = NULL; t->arg = NULL; t->post = NULL;
+  t->cpu = t->cpuMark = 0.0; t->cpuFinal = 0; t->nice = 0;
   HTCreate();
   HGLockCreate();
   HMLockCreate();
+#ifdef WIN32
+  if ((selfKey = TlsAlloc()) == TLS_OUT_OF_INDEXES)
+    HTError("InitThreads: cannot create thread local storage",GetLastError());
+#endif
+#ifdef UNIX
+  rc = pthread_key_create(&selfKey,NULL);
+  if (rc!=0)
+    HTError("InitThreads: cannot create thread local storage",rc);
+#endif
   t->status = THREAD_INITIAL;
   if (mode>HT_NOMONITOR) {
     t->info = (HThreadInfo *)malloc(sizeof(HThreadInfo));
@@ -393,21 +599,14 @@ void InitThreads(HMonMode monMode)
 #endif
   t->id = 0;
   t->thread = pthread_self();
-  t->xeq.head=NULL;
-  t->xeq.tail=NULL;
-  rc = pthread_cond_init(&(t->xeq.cond),NULL);
-  if (rc!=0)
-    HTError("InitThreads: cant create signal",rc);
-  rc= pthread_mutex_init(&(t->xeq.mux),NULL);
-  if (rc!=0)
-    HTError("InitThreads: cant create mux",rc);
+  InitEventQueue(&(t->xeq));
 #endif
+  SetSelf(t);
 }
 
 /* HCreateThread: Exec task(arg) as thread with prio p, store thread in *tp */
 HThread HCreateThread(const char *name, int prBufLines, HPriority pr,
 		      TASKTYPE (TASKMOD *task)(void *), void *arg){
-  static unsigned int threadIDCounter = 1;
   HThreadT thread;
   HThread t; int i;
   unsigned int threadID;
@@ -417,6 +616,7 @@ HThread HCreateThread(const char *name, int prBufLines, HPriority pr,
 #ifdef UNIX
   int rc;
   int scope;
+  int rtRefused = 0, created = 0;
   pthread_mutexattr_t mattr;
   pthread_attr_t attr;
   struct sched_param param;
@@ -426,6 +626,14 @@ HThread HCreateThread(const char *name, int prBufLines, HPriority pr,
   t = (HThread)malloc(sizeof(HThreadRec));
   t->name = CopyName(name);
   t->status = THREAD_INITIAL;
+  t->info = NULL;
+  t->task = task; t->arg = arg; t->post = NULL;
+  t->cpu = t->cpuMark = 0.0; t->cpuFinal = 0; t->nice = 0;
+  /* everything the thread may use is set up before it starts */
+  CreateHeap(&(t->gstack), "ThreadStack",  MSTAK, 1, 0.0, 100000, ULONG_MAX );
+#ifdef UNIX
+  InitEventQueue(&(t->xeq));
+#endif
   if (mode>HT_NOMONITOR){
     t->info = (HThreadInfo *)malloc(sizeof(HThreadInfo));
     t->info->inLock = 0;  t->info->inSignal = 0;
@@ -434,7 +642,7 @@ HThread HCreateThread(const char *name, int prBufLines, HPriority pr,
   }
   t->next = threadList; threadList = t; ++numThreadRecords;
 #ifdef WIN32
-  thread = (HANDLE)_beginthreadex(NULL,0,task,arg,0,&threadID);
+  thread = (HANDLE)_beginthreadex(NULL,0,ThreadStart,t,0,&threadID);
   t->thread = thread;
   t->id = threadID;
   if (thread==NULL)
@@ -457,54 +665,152 @@ HThread HCreateThread(const char *name, int prBufLines, HPriority pr,
 #endif
 
 #ifdef UNIX
+  /* SCHED_OTHER has no priorities, so HPRIO_HIGH is real-time
+     scheduling if enabled by HSetPriorityMap, else a nice value
+     applied by the thread itself in ThreadStart */
   pthread_attr_init(&attr);
-  rc =  pthread_attr_setschedpolicy(&attr,SCHED_OTHER);
-  if (rc != 0)
-    HTError("HCreateThread: Cannot set policy",rc);
-  /*  rc=pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
-      if (rc != 0)
-      HTError("HCreateThread: Cannot set schedule",rc); */
-
   switch(pr){
   case HPRIO_HIGH:
-    param.sched_priority = sched_get_priority_max(SCHED_OTHER);
-    pthread_attr_setschedparam(&attr,&param);
+    t->nice = highNice;
     break;
   case HPRIO_LOW:
-    param.sched_priority = sched_get_priority_min(SCHED_OTHER);
-    pthread_attr_setschedparam(&attr,&param);
+    t->nice = lowNice;
     break;
   case HPRIO_NORM:
     break;
   default:
     HTError("HCreateThread: Bad priority" ,pr);
   }
-
-  rc = pthread_create(&thread, &attr, task, arg);
+  if (pr==HPRIO_HIGH && rtPrio>0){
+    pthread_attr_setinheritsched(&attr,PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr,rtRR?SCHED_RR:SCHED_FIFO);
+    param.sched_priority = rtPrio;
+    pthread_attr_setschedparam(&attr,&param);
+    t->nice = 0;
+    rc = pthread_create(&thread, &attr, ThreadStart, t);
+    if (rc == EPERM || rc == EINVAL){
+      if (!rtWarned) rtRefused = rc;
+      rtWarned = 1;
+      t->nice = highNice;
+      pthread_attr_setinheritsched(&attr,PTHREAD_INHERIT_SCHED);
+    } else
+      created = 1;
+  }
+  if (!created)
+    rc = pthread_create(&thread, &attr, ThreadStart, t);
+  pthread_attr_destroy(&attr);
 
   t->thread = thread;
   if (rc != 0)
     HTError("HCreateThread: Cannot create thread",rc);
   threadID = ++threadIDCounter;
   t->id = threadID;
-  t->xeq.head=NULL;
-  t->xeq.tail=NULL;
-  rc = pthread_cond_init(&(t->xeq.cond),NULL);
-  if (rc!=0)
-    HTError("HCreateThread: cant create signal",rc);
-  rc=pthread_mutex_init(&(t->xeq.mux),NULL);
-  if (rc!=0)
-    HTError("HCreateThread: cant create mux",rc);
 #endif
   updated = TRUE;
 
   HTUnlock();
-  CreateHeap(&(t->gstack), "ThreadStack",  MSTAK, 1, 0.0, 100000, ULONG_MAX );
 
+#ifdef UNIX
+  if (rtRefused)
+    HError(-9999,"HCreateThread: real-time priority %d refused [%d], using nice %d",
+           rtPrio,rtRefused,highNice);
+#endif
+  if (mode==HT_MSGMON) HTUpdate();
+  return t;
+}
+
+/* HCreateTaskRecord: create the record of a task without a thread */
+HThread HCreateTaskRecord(const char *name, int prBufLines,
+                          void (*post)(HThread t, int event, int c),
+                          void *arg)
+{
+  HThread t;
+
+  if (post == NULL)
+    HTError("HCreateTaskRecord: no post function",0);
+  HTLock();
+  t = (HThread)malloc(sizeof(HThreadRec));
+  t->name = CopyName(name);
+  t->status = THREAD_INITIAL;
+  t->info = NULL;
+  t->task = NULL; t->arg = arg; t->post = post;
+  t->cpu = t->cpuMark = 0.0; t->cpuFinal = 0; t->nice = 0;
+  CreateHeap(&(t->gstack), "TaskStack",  MSTAK, 1, 0.0, 100000, ULONG_MAX );
+#ifdef UNIX
+  /* the queue is never used but must be valid */
+  InitEventQueue(&(t->xeq));
+#endif
+  if (mode>HT_NOMONITOR){
+    t->info = (HThreadInfo *)malloc(sizeof(HThreadInfo));
+    t->info->inLock = 0;  t->info->inSignal = 0;
+    t->info->returnStatus = 0;
+    InitThreadPrBuf(&(t->info->prBuf),prBufLines);
+  }
+  t->next = threadList; threadList = t; ++numThreadRecords;
+#ifdef WIN32
+  t->id = 0;     /* not a WIN32 thread id */
+#else
+  t->id = ++threadIDCounter;
+#endif
+  updated = TRUE;
+  HTUnlock();
   if (mode==HT_MSGMON) HTUpdate();
   return t;
 }
 
+/* HSetThreadSelf: make calling thread act as t, return previous self.
+   The cpu time used while acting as a task record is charged to it */
+HThread HSetThreadSelf(HThread t)
+{
+  HThread prev = GetSelf();
+  double now;
+
+  if (prev->post != NULL || t->post != NULL){
+    now = SelfCPUTime();
+    if (prev->post != NULL) prev->cpu += now - prev->cpuMark;
+    if (t->post != NULL) t->cpuMark = now;
+  }
+  SetSelf(t);
+  return prev;
+}
+
+/* HStopTaskRecord: mark task record t as stopped */
+void HStopTaskRecord(HThread t, int status)
+{
+  HTLock();
+  t->status = THREAD_STOPPED;
+  if (mode>HT_NOMONITOR){
+    t->info->returnStatus = status;
+    updated = TRUE;
+  }
+  HTUnlock();
+  if (mode==HT_MSGMON) HTUpdate();
+}
+
+/* HThreadCPUTime: cpu secs used so far by t */
+double HThreadCPUTime(HThread t)
+{
+#ifdef UNIX
+  clockid_t cid;
+  struct timespec ts;
+#endif
+#ifdef WIN32
+  FILETIME c,e,k,u;
+#endif
+
+  if (t->post != NULL || t->cpuFinal) return t->cpu;
+#ifdef UNIX
+  if (pthread_getcpuclockid(t->thread,&cid) != 0 ||
+      clock_gettime(cid,&ts) != 0) return t->cpu;
+  return (double)ts.tv_sec + (double)ts.tv_nsec*1e-9;
+#endif
+#ifdef WIN32
+  if (!GetThreadTimes(t->thread,&c,&e,&k,&u)) return t->cpu;
+  return ((double)k.dwLowDateTime + (double)u.dwLowDateTime +
+          4294967296.0*((double)k.dwHighDateTime + (double)u.dwHighDateTime))*1e-7;
+#endif
+}
+
 /* HCreateMonitor: create the monitor thread with max priority */
 void HCreateMonitor(TASKTYPE (TASKMOD *task)(void *), void *arg)
 {
@@ -541,8 +847,9 @@ void HExitThread(int status){
   HThread t;
   int *statusp;
 
-  HTLock();
   t = GetSelf();
+  t->cpu = SelfCPUTime(); t->cpuFinal = 1;
+  HTLock();
   t->status = THREAD_STOPPED;
   if (mode>HT_NOMONITOR){
     t->info->returnStatus = status;
@@ -556,6 +863,7 @@ void HExitThread(int status){
 #endif
 
 #ifdef UNIX
+  CloseEventQueue(&(t->xeq));
   statusp = malloc(sizeof(int));
   *statusp = status;
   pthread_exit((void *)statusp);
@@ -614,27 +922,12 @@ void HJoinMonitor(void)
 
 /* HThreadSelf: Return identity of calling thread */
 HThread HThreadSelf(void){
-  HThread t;
-
-#ifdef WIN32
-  unsigned int id = GetCurrentThreadId();
-
-  HTLock();
-  for (t=threadList; t!=NULL; t=t->next)
-    if (t->id == id) {HTUnlock(); return t;}
-  HTError("HThreadSelf: cannot find self",id);
-#endif
-#ifdef UNIX
-
-  HThreadT tt = pthread_self();
-
-  HTLock();
-  for (t=threadList; t!=NULL; t=t->next)
-    if (t->thread == tt) {HTUnlock(); return t;}
-  HTError("HThreadSelf: cannot find self",0);
+  return GetSelf();
+}
 
-#endif
-  return NULL;
+/* HFindThreadSelf: as HThreadSelf but NULL if caller is unknown */
+HThread HFindThreadSelf(void){
+  return FindSelf();
 }
 
 /* HDeschedule: Calling thread offers to deschedule */
@@ -744,13 +1037,13 @@ HLock HCreateLock(const char *name){
     HTError("HCreateLock: cannot create mutex",GetLastError());
 #endif
 #ifdef UNIX
-  pthread_mutexattr_t attr;
-
-  pthread_mutexattr_init(&attr);
-  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+  int rc;
 
-  pthread_mutex_init(&(lock.mutex),&attr);
-  lock.owner = 0;
+  /* nesting is counted in the lock itself so a plain mutex will do */
+  rc = pthread_mutex_init(&(lock.mutex),NULL);
+  if (rc!=0)
+    HTError("HCreateLock: cannot create mutex",rc);
+  lock.owner = pthread_self();
   lock.depth = 0;
 #endif
   l = (HLock)malloc(sizeof(HLockRec));
@@ -762,20 +1055,105 @@ HLock HCreateLock(const char *name){
   return l;
 }
 
+/* HSetPriorityMap: set how thread priorities are applied */
+void HSetPriorityMap(int rtp, int roundRobin, int hNice, int lNice)
+{
+  HTLock();
+  rtPrio = rtp; rtRR = roundRobin;
+  highNice = hNice; lowNice = lNice;
+  rtWarned = 0; niceWarned = 0;
+  HTUnlock();
+}
+
+/* HSetThreadAffinity: restrict t to the cpus listed in cpus */
+int HSetThreadAffinity(HThread t, const char *cpus)
+{
+  const char *s = cpus;
+  char *e;
+  long lo,hi,i;
+  Boolean ok = TRUE;
+#ifdef __linux__
+  cpu_set_t set;
+  int rc;
+
+  CPU_ZERO(&set);
+#endif
+#ifdef WIN32
+  DWORD_PTR mask = 0;
+#endif
+
+  if (t->post != NULL){
+    HError(-9999,"HSetThreadAffinity: %s is a task record",t->name);
+    return FALSE;
+  }
+  /* parse a list of cpus and ranges, eg 0-1,3 */
+  for (;;){
+    lo = hi = strtol(s,&e,10);
+    if (e==s || lo<0) { ok = FALSE; break; }
+    s = e;
+    if (*s == '-'){
+      hi = strtol(s+1,&e,10);
+      if (e==s+1 || hi<lo) { ok = FALSE; break; }
+      s = e;
+    }
+    for (i=lo; i<=hi; i++){
+#ifdef __linux__
+      if (i<CPU_SETSIZE) CPU_SET(i,&set);
+#endif
+#ifdef WIN32
+      if (i<8*(long)sizeof(DWORD_PTR)) mask |= (DWORD_PTR)1<<i;
+#endif
+    }
+    if (*s == '\0') break;
+    if (*s++ != ',') { ok = FALSE; break; }
+  }
+  if (!ok){
+    HError(-9999,"HSetThreadAffinity: bad cpu list %s",cpus);
+    return FALSE;
+  }
+#ifdef __linux__
+  if ((rc = pthread_setaffinity_np(t->thread,sizeof(set),&set)) != 0){
+    HError(-9999,"HSetThreadAffinity: cannot set %s to cpus %s [%d]",t->name,cpus,rc);
+    return FALSE;
+  }
+  return TRUE;
+#else
+#ifdef WIN32
+  if (SetThreadAffinityMask(t->thread,mask) == 0){
+    HError(-9999,"HSetThreadAffinity: cannot set %s to cpus %s",t->name,cpus);
+    return FALSE;
+  }
+  return TRUE;
+#else
+  HError(-9999,"HSetThreadAffinity: not supported");
+  return FALSE;
+#endif
+#endif
+}
+
+/* HSetLockSpin: set number of tries of a held lock before blocking */
+void HSetLockSpin(int n)
+{
+   lockSpin = (n>0) ? n : 0;
+}
+
+/* SetStatus: record status of self t for the monitor */
+static void SetStatus(HThread t, HThreadStatus status)
+{
+   t->status = status;
+   updated = TRUE;
+}
+
 /* HEnterSection: enter a critical sections */
 void HEnterSection(HLock lock){
-   HThread t;
+   HThread t = NULL;
    int rc;
 
-   HTLock();
-   t = GetSelf();
-   t->status = THREAD_WAITING;
    if (mode>HT_NOMONITOR){
+      t = GetSelf();
       t->info->inLock = 1; t->info->lock = lock;
-      updated = TRUE;
+      SetStatus(t,THREAD_WAITING);
    }
-   HTUnlock();
-   /* if (mode==HT_MSGMON) HTUpdate();*/
 #ifdef WIN32
    rc = WaitForSingleObject(lock->lock,INFINITE);
    if (rc != WAIT_OBJECT_0)
@@ -790,18 +1168,26 @@ void HEnterSection(HLock lock){
 #endif
 
 #ifdef UNIX
-  rc = pthread_mutex_lock(&lock->lock.mutex);
-  if (rc!=0)
-    HTError("HEnterSection: wait failed",rc);
-  lock->lock.owner=pthread_self();
-#endif
-  HTLock();
-  t->status = THREAD_CRITICAL;
-  if (mode>HT_NOMONITOR){
-     updated = TRUE;
+  {
+    pthread_t self = pthread_self();
+    int n;
+
+    /* only this thread can have set owner to self */
+    if (LockHeld(lock,self))
+      SetLockDepth(lock,LockDepth(lock)+1);
+    else {
+      for (n=0,rc=EBUSY; n<lockSpin && rc==EBUSY; n++)
+        rc = pthread_mutex_trylock(&lock->lock.mutex);
+      if (rc!=0)
+        rc = pthread_mutex_lock(&lock->lock.mutex);
+      if (rc!=0)
+        HTError("HEnterSection: wait failed",rc);
+      SetLockOwner(lock,self,1);
+    }
   }
-  HTUnlock();
-  /* if (mode==HT_MSGMON) HTUpdate();*/
+#endif
+  if (mode>HT_NOMONITOR)
+     SetStatus(t,THREAD_CRITICAL);
 }
 
 /* HLeaveSection: leave a critical sections */
@@ -813,21 +1199,22 @@ void HLeaveSection(HLock lock){
 #endif
 
 #ifdef UNIX
-  /*  if (pthread_self()!=lock->lock.owner)
-    HTError("HLeaveSection: invalid thread owner",0);
-   if (--lock->lock.depth == 0) */
-  pthread_mutex_unlock(&lock->lock.mutex);
+  {
+    int depth = LockDepth(lock);
+
+    if (!LockHeld(lock,pthread_self()))
+      HTError("HLeaveSection: invalid thread owner",0);
+    SetLockDepth(lock,depth-1);
+    if (depth == 1)
+      pthread_mutex_unlock(&lock->lock.mutex);
+  }
 #endif
 
-  HTLock();
-  t = GetSelf();
-  t->status = THREAD_RUNNING;
   if (mode>HT_NOMONITOR){
+     t = GetSelf();
      t->info->inLock = 0;
-     updated = TRUE;
+     SetStatus(t,THREAD_RUNNING);
   }
-  HTUnlock();
-  /* if (mode==HT_MSGMON) HTUpdate();*/
 }
 
 /* HCreateSignal: create and return a signal */
@@ -859,21 +1246,17 @@ HSignal HCreateSignal(const char *name)
 
 /* HWaitSignal: wait for signal inside lock-ed section */
 void HWaitSignal(HSignal signal, HLock lock){
-  HThread t;
+  HThread t = NULL;
   int rc;
 
-
-  HTLock();
-  t = GetSelf();
-  t->status = THREAD_WAITING;
   if (mode>HT_NOMONITOR){
+     t = GetSelf();
      t->info->inSignal = 1; t->info->signal = signal;
      if (!t->info->inLock || lock != t->info->lock)
         HTError("HWaitSignal: lock conflict",0);
-     updated = TRUE;
+     SetStatus(t,THREAD_WAITING);
+     if (mode==HT_MSGMON) HTUpdate();
   }
-  HTUnlock();
-  if (mode==HT_MSGMON) HTUpdate();
 
 #ifdef WIN32
   ReleaseMutex(lock->lock);
@@ -900,23 +1283,26 @@ void HWaitSignal(HSignal signal, HLock lock){
 #endif
 
 #ifdef UNIX
-  /* cond_wait unlocks the mutex,
-     then reaquires it once the condition is passed */
-  rc = pthread_cond_wait(&signal->signal,&lock->lock.mutex);
-  if (rc !=0)
-    HTError("HWaitSignal: cant execute wait on signal",rc);
+  {
+    /* cond_wait unlocks the mutex, then reaquires it once the
+       condition is passed, whatever the nesting depth */
+    pthread_t self = pthread_self();
+    int depth = LockDepth(lock);
+
+    if (!LockHeld(lock,self))
+      HTError("HWaitSignal: lock not held",0);
+    SetLockDepth(lock,0);
+    rc = pthread_cond_wait(&signal->signal,&lock->lock.mutex);
+    if (rc !=0)
+      HTError("HWaitSignal: cant execute wait on signal",rc);
+    SetLockOwner(lock,self,depth);
+  }
 #endif
 
-
-  HTLock();
-  t->status = THREAD_CRITICAL;
   if (mode>HT_NOMONITOR){
-
      t->info->inSignal = 0;
-     updated = TRUE;
+     SetStatus(t,THREAD_CRITICAL);
   }
-  HTUnlock();
-  /* if (mode==HT_MSGMON) HTUpdate();*/
 }
 
 /* HSendSignal: send signal */
@@ -970,13 +1356,14 @@ void AccessStatus(void)
 {
   CheckMode("AccessStatusImmediate", mode>HT_NOMONITOR);
   HTLock();
+  /* cleared on entry since threads record their status without tlock */
+  updated = FALSE;
 }
 
 /* ReleaseStatusAccess: release the tlock */
 void ReleaseStatusAccess(void)
 {
   CheckMode("ReleaseStatusAccess", mode>HT_NOMONITOR);
-  updated = FALSE;
   HTUnlock();
 }
 
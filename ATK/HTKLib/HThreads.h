@@ -80,23 +80,29 @@ typedef HANDLE HSignalT;
 #ifdef UNIX
 typedef pthread_t HThreadT;
 typedef struct {                 /* tracks nested calls */
-  pthread_mutex_t mutex;             /* basic mutex */
-  pthread_t       owner;             /* owner of the lock */
+  pthread_mutex_t mutex;             /* basic (non-recursive) mutex */
+  pthread_t       owner;             /* owner of the lock, valid if depth>0, */
+                                     /* both accessed atomically */
   int             depth;             /* number of nested "EnterSection" calls */
 } HLockT;
 typedef pthread_cond_t HSignalT;
 #define TASKTYPE void *
 #define TASKMOD
 
-typedef struct _QEntryRec *QEntry;
-typedef struct _QEntryRec{
-  QEntry next;
-  void *hev;
-} QEntryRec;
-
+/* The event queue of a thread is a ring of HEventRecs which grows
+   when full, so posting an event does not allocate.  On Linux a
+   thread blocked on an empty queue waits on an eventfd, or an epoll
+   set holding the eventfd and any fds given to HWatchFd, which is
+   written once per wakeup however many events are posted meanwhile.
+   Elsewhere, or if no fd is available, it waits on cond. */
 typedef struct {
-  QEntry head;
-  QEntry tail;
+  void *ring;            /* HEventRec[size] */
+  int size;              /* slots in ring */
+  int head;              /* index of oldest event */
+  int count;             /* events in ring */
+  int waiting;           /* reader is blocked and needs a wakeup */
+  int efd;               /* eventfd of the reader, -1 if none yet */
+  int epfd;              /* epoll set, -1 unless fds are watched */
   pthread_mutex_t mux;
   pthread_cond_t cond;
 } EventQueue;
@@ -154,6 +160,13 @@ typedef struct _HThreadRec{
 #ifdef UNIX
   EventQueue xeq;
 #endif
+  TASKTYPE (TASKMOD *task)(void *);  /* task run by the thread */
+  void *arg;                         /* and its argument */
+  void (*post)(HThread t, int event, int c); /* set if t is a task record */
+  double cpu;              /* cpu secs of a task record, or of a finished thread */
+  double cpuMark;          /* thread cpu clock when a task record took over */
+  int cpuFinal;            /* thread has finished, cpu is its total */
+  int nice;                /* nice value applied when the thread starts */
 } HThreadRec;
 
 typedef struct _HSignalRec{
@@ -191,6 +204,36 @@ HThread HCreateThread(const char *name, int prBufLines, HPriority pr,
   prBufLines sets the size of the tasks printf buffer
 */
 
+HThread HCreateTaskRecord(const char *name, int prBufLines,
+                          void (*post)(HThread t, int event, int c),
+                          void *arg);
+/*
+  Create a thread record for a task which has no thread of its own
+  but is run in turn by other threads (see HSetThreadSelf).  Events
+  sent to it (HBufferEvent, audio and close events) are passed to
+  post(t,event,c) instead of being queued, arg is kept in t->arg.
+  It has its own gstack and printf buffer.
+*/
+
+HThread HSetThreadSelf(HThread t);
+/*
+  Make the calling thread act as t, which must be a task record or
+  the thread itself, until the next call.  Returns the previous self
+*/
+
+void HStopTaskRecord(HThread t, int status);
+/*
+  Mark task record t as stopped with the given exit status
+*/
+
+double HThreadCPUTime(HThread t);
+/*
+  Return the cpu time in secs used so far by thread t.  For a task
+  record this is the time charged to it while threads were acting as
+  it (see HSetThreadSelf), and the time of a thread includes that of
+  the task records it has run.  Returns 0 if it cannot be measured.
+*/
+
 void HCreateMonitor(TASKTYPE (TASKMOD *task)(void *), void *arg);
 /*
   Create the monitor thread, this thread, is not recorded in the
@@ -228,6 +271,12 @@ HThread HThreadSelf(void);
   Return identity of calling thread
 */
 
+HThread HFindThreadSelf(void);
+/*
+  As HThreadSelf but returns NULL instead of failing if the calling
+  thread was not created by HThreads (eg an audio driver thread)
+*/
+
 void HDeschedule(void);
 /*
   Calling thread offers to deschedule
@@ -267,11 +316,45 @@ void HMemoryUnlock();
   Lightweight lock (not registered or monitored). Used by HMem.
 */
 
+int HAtomicAdd(volatile int *p, int n);
+void *HAtomicSwap(void * volatile *p, void *v);
+/*
+  Lock free updates of a shared variable.  HAtomicAdd adds n to *p
+  and returns the new value, HAtomicSwap sets *p to v and returns the
+  old value.  Both are full memory barriers.
+*/
+
 HLock HCreateLock(const char *name);
 void HEnterSection(HLock lock);
 void HLeaveSection(HLock lock);
 /*
-   Critical section mutual exclusion
+   Critical section mutual exclusion.  The cost does not depend on
+   the number of threads, and with HT_NOMONITOR no thread status is
+   recorded so it is just that of the underlying mutex.
+*/
+
+void HSetPriorityMap(int rtPrio, int roundRobin, int highNice, int lowNice);
+/*
+   Set how the priority of a new thread is applied on UNIX.  If rtPrio
+   > 0, HPRIO_HIGH threads run with real-time scheduling at priority
+   rtPrio (SCHED_RR if roundRobin else SCHED_FIFO).  This needs
+   privilege, without it or if rtPrio is 0 they are given nice value
+   highNice instead.  HPRIO_LOW threads are given lowNice.  The
+   default is 0,0,0,0 ie all threads have the priority of the process.
+*/
+
+int HSetThreadAffinity(HThread t, const char *cpus);
+/*
+   Restrict thread t to the cpus listed in cpus, eg "0-1,3".  Returns
+   FALSE (with a warning) if cpus is not a valid list or the affinity
+   cannot be set, eg t is a task record or affinity is not supported.
+*/
+
+void HSetLockSpin(int n);
+/*
+   Make HEnterSection try a held lock up to n times before it blocks
+   (default 0).  This can help on multi-processors when locks are
+   only held briefly.
 */
 
 HSignal HCreateSignal(const char *name);
@@ -291,6 +374,16 @@ void HBufferEvent(HThread thread, int bufferId);
   in receiving this event.
 */
 
+#ifdef UNIX
+void HWatchFd(int fd, int bufferId);
+/*
+  Add fd to the fds which the calling thread waits on with its event
+  queue.  Whenever fd is readable and the thread looks for an event
+  it is given a buffer event with bufferId.  This is level triggered
+  so the thread must read fd when it handles the event.
+*/
+#endif
+
 void  HSendAllThreadsCloseEvent();
 /* send the close signal to all threads currently active */
 
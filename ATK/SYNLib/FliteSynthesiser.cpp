@@ -27,14 +27,37 @@ char * flitesynthesiser_version="!HVER!FliteSynthesiser: 1.5.1 [SJY 02/03/07]";
 #include "FliteSynthesiser.h"
 #include "cmu_us_kal16.h"
 
+// Registering a voice sets up process-wide flite state (regexes,
+// lexicon, the kal voice pointer) so it is serialised.  Each
+// FSynthesiser still gets its own voice so that several can
+// synthesise at once, sharing the static diphone db, lexicon
+// and trees.
+static HLock regLock = NULL;
 
-// Constructor for FSynthesiser
+// Constructor for FSynthesiser.  The voice database is mapped from
+// FSYNTH: VOXDIR if set, else the linked in one is used.
 FSynthesiser::FSynthesiser()
 {
+   ConfParam *cParm[MAXGLOBS];
+   int numParm;
+   char buf[MAXSTRLEN],voxdir[MAXSTRLEN];
+
+   voxdir[0] = '\0';
+   strcpy(buf,"FSYNTH");
+   numParm = GetConfig(buf, TRUE, cParm, MAXGLOBS);
+   if (numParm>0){
+      strcpy(buf,"VOXDIR");
+      GetConfStr(cParm,numParm,buf,voxdir);
+   }
+   HGlobalLock();
+   if (regLock == NULL) regLock = HCreateLock("FSynthesiser");
+   HGlobalUnlock();
+   HEnterSection(regLock);
    // initialise Edinburgh cst lib
    cst_regex_init();
    // setup the voice
-   voice = register_cmu_us_kal16(NULL);
+   voice = register_cmu_us_kal16(voxdir);
+   HLeaveSection(regLock);
    // clear the current utterance
    utt = NULL; cstwave = NULL;
 }
@@ -115,4 +138,69 @@ void FSynthesiser::EndUtterance()
    ctext.clear();
 }
 
+// Voice name and settings which affect the waveform
+string FSynthesiser::GetVoiceKey()
+{
+   char buf[256];
+   const cst_features *f = voice->features;
+
+   sprintf(buf,"%.100s:%d:%.3f:%.2f:%.2f",
+           get_param_string(f,"name",""),
+           get_param_int(f,"sample_rate",0),
+           get_param_float(f,"duration_stretch",1.0),
+           get_param_float(f,"int_f0_target_mean",0.0),
+           get_param_float(f,"int_f0_target_stddev",0.0));
+   return string(buf);
+}
+
+int FSynthesiser::GetSampRate()
+{
+   return get_param_int(voice->features,"sample_rate",16000);
+}
+
+// IsBreak: true if token starts a new sentence, where last is the
+// previous token and punc its post punctuation.  These are flite's
+// utterance break rules with ';' added as a phrase break.
+static Boolean IsBreak(cst_tokenstream *ts, const char *token,
+                       const string& last, const string& punc)
+{
+   const char *caps = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+   Boolean cap = (token[0]!='\0' && strchr(caps,token[0])!=NULL)?TRUE:FALSE;
+
+   if (strchr(ts->whitespace,'\n') != strrchr(ts->whitespace,'\n'))
+      return TRUE;    // blank line
+   if (punc.find_first_of(":;?!") != string::npos)
+      return TRUE;
+   if (punc.find('.') == string::npos || !cap)
+      return FALSE;
+   if (strlen(ts->whitespace) > 1)
+      return TRUE;
+   // single space after a full stop, unless last looks like an abbreviation
+   if (last.size()==0 || strchr(caps,last[last.size()-1]) != NULL ||
+       (last.size()<4 && strchr(caps,last[0]) != NULL))
+      return FALSE;
+   return TRUE;
+}
+
+// Split: split text into sentences and phrases
+void FSynthesiser::Split(const string& text, vector<string>& segs)
+{
+   cst_tokenstream *ts = ts_open_string(text.c_str());
+   string last,punc;
+   const char *token;
+   int start = 0;
+
+   while (!ts_eof(ts)){
+      token = ts_get(ts);
+      if (*token == '\0') continue;
+      if (last != "" && IsBreak(ts,token,last,punc)){
+         segs.push_back(text.substr(start,ts->token_pos-start));
+         start = ts->token_pos;
+      }
+      last = token; punc = ts->postpunctuation;
+   }
+   ts_close(ts);
+   segs.push_back(text.substr(start));
+}
+
 // ----------------------End of FliteSynthesiser.cpp ---------------------
@@ -32,6 +32,7 @@
 class FSynthesiser : public ASynthesiser {
 public:
    FSynthesiser();
+   // voice database is mapped from FSYNTH: VOXDIR if set
    void StartUtterance(const string& text);
    // start new utterance with given text
    short *GetWave();
@@ -46,6 +47,12 @@ public:
    // get sample number of end of i'th word
    void EndUtterance();
    // release any storage allocated for current utterance
+   string GetVoiceKey();
+   // voice name and settings which affect the waveform
+   int GetSampRate();
+   // sample rate of the voice
+   void Split(const string& text, vector<string>& segs);
+   // split text at sentence and phrase breaks
 private:
   string ctext;         // current output text
   cst_voice *voice;     // synthesis voice
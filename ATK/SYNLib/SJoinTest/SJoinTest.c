@@ -0,0 +1,205 @@
+/* ----------------------------------------------------------- */
+/*                                                             */
+/*                        _ ___                                */
+/*                       /_\ | |_/                             */
+/*                       | | | | \                             */
+/*                       =========                             */
+/*                                                             */
+/*        Real-time API for HTK-base Speech Recognition        */
+/*                                                             */
+/*       Machine Intelligence Laboratory (Speech Group)        */
+/*        Cambridge University Engineering Department          */
+/*                  http://mi.eng.cam.ac.uk/                   */
+/*                                                             */
+/*               Copyright CUED 2000-2007                      */
+/*                                                             */
+/*   Use of this software is governed by a License Agreement   */
+/*    ** See the file License for the Conditions of Use  **    */
+/*    **     This banner notice must not be removed      **    */
+/*                                                             */
+/* ----------------------------------------------------------- */
+/*   File: SJoinTest.c - clunits join cost test                */
+/* ----------------------------------------------------------- */
+
+char *sjointest_version = "!HVER!SJoinTest: 1.6.0 [CUED 19/10/26]";
+
+/*
+   SJoinTest checks the memoised join costs of unit selection.  A
+   clunits database with more units than a 16 bit index can hold is
+   built in memory, and the costs and moves for many pairs of units
+   taken from one join cost engine, which memoises them, must equal
+   those from a fresh engine for each pair.  Pairs whose indices
+   only differ above bit 16 are costed together.
+*/
+
+#include "HShell.h"
+#include "HThreads.h"
+#include "HMem.h"
+#include "HMath.h"
+#include "flite.h"
+#include "cst_clunits.h"
+
+#define JOINSEED 1234      /* random seed for the database */
+#define NCHANS 16          /* lpc and mel cep channels */
+#define FRAMES 5           /* frames per unit */
+
+static int nUnits = 70000;      /* units in clunits db */
+static int nPairs = 20000;      /* pairs of units costed */
+static int trace = 0;           /* trace flags */
+
+void ReportUsage(void)
+{
+   printf("\nUSAGE: SJoinTest [options]\n\n");
+   printf(" Option                                   Default\n\n");
+   printf(" -p i    pairs of units costed               20000\n");
+   printf(" -u i    units in clunits db                 70000\n");
+   PrintStdOpts("");
+   printf("\n\n");
+}
+
+/* ---------------- Test database ------------------ */
+
+/* MakeSts: n random frames of NCHANS, sizes from 60 to 200 */
+static cst_sts_list *MakeSts(int n)
+{
+   cst_sts_list *l;
+   cst_sts *sts;
+   unsigned short *f;
+   int i,j;
+
+   l = new_sts_list();
+   sts = cst_alloc(cst_sts,n);
+   for (i=0; i<n; i++) {
+      f = cst_alloc(unsigned short,NCHANS);
+      for (j=0; j<NCHANS; j++) f[j] = (unsigned short)(RandomValue()*65535);
+      sts[i].frame = f;
+      *(int *)&sts[i].size = 60 + (int)(RandomValue()*140);
+   }
+   l->sts = sts;
+   l->num_sts = n; l->num_channels = NCHANS;
+   l->coeff_min = -2.5; l->coeff_range = 5.25;
+   return l;
+}
+
+/* MakeClunits: chains of 50 units, each of FRAMES frames.  Units */
+/* beyond CLUNIT_NONE cannot be linked so are left unchained      */
+static cst_clunit_db *MakeClunits(void)
+{
+   cst_clunit_db *db;
+   cst_clunit *u;
+   int i;
+
+   db = cst_alloc(cst_clunit_db,1);
+   u = cst_alloc(cst_clunit,nUnits);
+   for (i=0; i<nUnits; i++) {
+      u[i].type = 0; u[i].phone = i%41;
+      u[i].start = i*FRAMES; u[i].end = i*FRAMES+FRAMES;
+      u[i].prev = (i%50==0 || i>CLUNIT_NONE) ? CLUNIT_NONE : i-1;
+      u[i].next = (i%50==49 || i+1>=CLUNIT_NONE || i==nUnits-1)
+         ? CLUNIT_NONE : i+1;
+   }
+   db->name = "sjoin_clunits";
+   db->units = u;
+   db->num_units = (nUnits > CLUNIT_NONE) ? CLUNIT_NONE : nUnits;
+   db->sts = MakeSts(nUnits*FRAMES);
+   db->mcep = MakeSts(nUnits*FRAMES);
+   db->join_weights = cst_alloc(int,NCHANS);
+   for (i=0; i<NCHANS; i++) db->join_weights[i] = 65536/(i+1);
+   db->f0_weight = 1;
+   return db;
+}
+
+/* MakePairs: random pairs, each with u1 >= 65536 followed by the */
+/* pair (u0+1,u1-65536) which packs to the same 32 bit u0<<16|u1, */
+/* and every tenth pair consecutive */
+static void MakePairs(int *u0, int *u1)
+{
+   int i,n;
+
+   n = (nUnits > CLUNIT_NONE) ? CLUNIT_NONE : nUnits;
+   for (i=0; i<nPairs; i++) {
+      if (i%2 == 1 && u1[i-1] >= 65536) {
+         u0[i] = u0[i-1]+1; u1[i] = u1[i-1]-65536;
+      } else if (i%10 == 0) {
+         u1[i] = 1 + (int)(RandomValue()*(n-1));
+         u0[i] = u1[i]-1;
+      } else if (nUnits > 65536) {
+         u0[i] = (int)(RandomValue()*(nUnits-1));
+         u1[i] = 65536 + (int)(RandomValue()*(nUnits-65536));
+      } else {
+         u0[i] = (int)(RandomValue()*nUnits);
+         u1[i] = (int)(RandomValue()*nUnits);
+      }
+   }
+}
+
+/* ---------------- Test ------------------ */
+
+/* TestCoupling: costs from one memoised engine against a fresh */
+/* engine for every pair, each pair costed twice by the former  */
+static Boolean TestCoupling(cst_clunit_db *db, int oc, int *u0, int *u1)
+{
+   cst_clunit_jc *jc,*ref;
+   int i,pass,cost,m0,m1,rcost,r0,r1,nDiffs = 0;
+
+   db->optimal_coupling = oc;
+   jc = new_clunit_jc(db);
+   for (pass=0; pass<2; pass++)
+      for (i=0; i<nPairs; i++) {
+         m0 = m1 = r0 = r1 = -1;  /* consecutive units leave these */
+         cost = clunit_join_cost(jc,u0[i],u1[i],&m0,&m1);
+         ref = new_clunit_jc(db);
+         rcost = clunit_join_cost(ref,u0[i],u1[i],&r0,&r1);
+         delete_clunit_jc(ref);
+         if (cost != rcost || (oc == 1 && (m0 != r0 || m1 != r1))) {
+            if (nDiffs == 0 && trace&1)
+               printf("  pass %d pair %d (%d,%d) cost %d not %d\n",
+                      pass,i,u0[i],u1[i],cost,rcost);
+            ++nDiffs;
+         }
+      }
+   delete_clunit_jc(jc);
+   printf("coupling %d %8d %8d %s\n",oc,nPairs,nDiffs,
+          nDiffs==0?"PASS":"FAIL");
+   fflush(stdout);
+   return nDiffs==0;
+}
+
+/* ------------------------ Main Program ------------------------ */
+
+int main(int argc, char *argv[])
+{
+   cst_clunit_db *db;
+   int *u0,*u1;
+   char *s;
+   int fails = 0;
+
+   InitThreads(HT_NOMONITOR);
+   if(InitShell(argc,argv,sjointest_version)<SUCCESS)
+      HError(3200,"SJoinTest: InitShell failed");
+   InitMem(); InitMath();
+   while (NextArg() == SWITCHARG) {
+      s = GetSwtArg();
+      if (strlen(s)!=1)
+         HError(3219,"SJoinTest: Bad switch %s; must be single letter",s);
+      switch(s[0]){
+      case 'p': nPairs = GetChkedInt(1,1000000,s); break;
+      case 'u': nUnits = GetChkedInt(2,1000000,s); break;
+      case 'T': trace = GetChkedInt(0,0777,s); break;
+      default:
+         HError(3219,"SJoinTest: Unknown switch %s",s);
+      }
+   }
+   if (NextArg()!=NOARG)
+      HError(3219,"SJoinTest: unexpected extra args");
+   RandInit(JOINSEED);
+   db = MakeClunits();
+   u0 = cst_alloc(int,nPairs); u1 = cst_alloc(int,nPairs);
+   MakePairs(u0,u1);
+   printf("%d units, %d pairs\n",nUnits,nPairs);
+   printf("%-10s %8s %8s %s\n","test","pairs","diffs","result");
+   if (!TestCoupling(db,1,u0,u1)) ++fails;
+   if (!TestCoupling(db,2,u0,u1)) ++fails;
+   Exit(fails>0?1:0);
+   return 0;
+}
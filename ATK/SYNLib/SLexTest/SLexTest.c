@@ -0,0 +1,361 @@
+/* ----------------------------------------------------------- */
+/*                                                             */
+/*                        _ ___                                */
+/*                       /_\ | |_/                             */
+/*                       | | | | \                             */
+/*                       =========                             */
+/*                                                             */
+/*        Real-time API for HTK-base Speech Recognition        */
+/*                                                             */
+/*       Machine Intelligence Laboratory (Speech Group)        */
+/*        Cambridge University Engineering Department          */
+/*                  http://mi.eng.cam.ac.uk/                   */
+/*                                                             */
+/*               Copyright CUED 2000-2007                      */
+/*                                                             */
+/*   Use of this software is governed by a License Agreement   */
+/*    ** See the file License for the Conditions of Use  **    */
+/*    **     This banner notice must not be removed      **    */
+/*                                                             */
+/* ----------------------------------------------------------- */
+/*   File: SLexTest.c - lexicon lookup benchmark               */
+/* ----------------------------------------------------------- */
+
+char *slextest_version = "!HVER!SLexTest: 1.6.0 [CUED 19/10/26]";
+
+/*
+   SLexTest looks up a long list of words in the CMU lexicon with
+   lex_lookup and with a copy of the original binary search and
+   uncached letter to sound lookup kept below for reference.  It
+   reports the throughput of each and checks that every word gets
+   the same phones from both.
+*/
+
+#include "HShell.h"
+#include "HThreads.h"
+#include "HMem.h"
+#include "HMath.h"
+#include "flite.h"
+#include "cmulex.h"
+#include <time.h>
+#include <ctype.h>
+
+#define LEXSEED 1234     /* random seed for word list */
+#define MAXWORD 64       /* max chars in a word */
+
+static int nTokens = 200000;    /* words looked up in each test */
+static int nOOV = 2000;         /* distinct out of vocabulary words */
+static float oovRate = 0.05;    /* fraction of tokens out of vocabulary */
+static int repeats = 1;         /* times to run each test */
+static char *wordFile = NULL;   /* word list, else made up */
+static int trace = 0;           /* trace flags */
+
+void ReportUsage(void)
+{
+   printf("\nUSAGE: SLexTest [options]\n\n");
+   printf(" Option                                   Default\n\n");
+   printf(" -n i    words looked up in each test        200000\n");
+   printf(" -o f    fraction of words not in lexicon    0.05\n");
+   printf(" -v i    distinct words not in lexicon       2000\n");
+   printf(" -w s    take words from file s              none\n");
+   printf(" -x i    run each test i times               1\n");
+   PrintStdOpts("");
+   printf("\n\n");
+}
+
+/* ---------------- Reference lookup ------------------ */
+
+/* The original lex_lookup, binary search then letter to sound */
+
+static int ref_find_full_match(const lexicon_entry *entries, int i,
+                               const char *word)
+{
+   int w, match;
+
+   if (word[0] == '0')
+      return i;
+   for (w=i; w >=0; w--) {
+      if (!cst_streq(word+1,entries[w].word_pos+1))
+         break;
+      else if ((cst_streq(word,entries[w].word_pos)) ||
+               (entries[w].word_pos[0] == '0'))
+         return w;
+   }
+   match = w+1;
+   for (w=i; entries[w].word_pos; w++) {
+      if (!cst_streq(word+1,entries[w].word_pos+1))
+         break;
+      else if ((cst_streq(word,entries[w].word_pos)) ||
+               (entries[w].word_pos[0] == '0'))
+         return w;
+   }
+   return match;
+}
+
+static int ref_bsearch(const lexicon_entry *entries, int start, int end,
+                       const char *word)
+{
+   int mid,c;
+
+   while (start < end) {
+      mid = (start + end)/2;
+      c = strcmp(entries[mid].word_pos+1,word+1);
+      if (c == 0)
+         return ref_find_full_match(entries,mid,word);
+      else if (c > 0)
+         end = mid;
+      else
+         start = mid + 1;
+   }
+   return -1;
+}
+
+static cst_val *ref_lex_lookup(const cst_lexicon *l, const char *word,
+                               const char *pos)
+{
+   int index,p,i,j;
+   char *wp;
+   cst_val *phones = 0;
+   int found = FALSE;
+
+   wp = cst_alloc(char,strlen(word)+2);
+   sprintf(wp,"%c%s",(pos ? pos[0] : '0'),word);
+   if (l->addenda)
+      for (i=0; l->addenda[i]; i++)
+         if (((wp[0] == '0') || (wp[0] == l->addenda[i][0][0])) &&
+             (cst_streq(wp+1,l->addenda[i][0]+1))) {
+            for (j=1; l->addenda[i][j]; j++)
+               phones = cons_val(string_val(l->addenda[i][j]),phones);
+            phones = val_reverse(phones);
+            found = TRUE;
+            break;
+         }
+   if (!found) {
+      index = ref_bsearch(l->entry_index,0,l->num_entries,wp);
+      if (index >= 0) {
+         for (p=l->entry_index[index].phone_index; l->phones[p]; p++)
+            phones = cons_val(string_val(l->phone_table[l->phones[p]]),
+                              phones);
+         phones = val_reverse(phones);
+      }
+      else if (l->lts_rule_set)
+         phones = lts_apply(word,"",l->lts_rule_set);
+      else if (l->lts_function)
+         phones = (l->lts_function)(l,word,"");
+   }
+   cst_free(wp);
+   return phones;
+}
+
+/* ------------------ Word lists ------------------- */
+
+typedef struct {
+   int n;             /* number of words */
+   char **words;
+   double *cum;       /* cumulative zipf weights */
+} WordList;
+
+static void SetZipf(WordList *w)
+{
+   int i;
+
+   w->cum = (double *)New(&gstack,w->n*sizeof(double));
+   for (i=0; i<w->n; i++)
+      w->cum[i] = (i>0?w->cum[i-1]:0.0) + 1.0/(i+1);
+}
+
+/* Shuffle: random order so the frequent words are spread over the lexicon */
+static void Shuffle(WordList *w)
+{
+   int i,j;
+   char *t;
+
+   for (i=w->n-1; i>0; i--) {
+      j = (int)(RandomValue()*(i+1)); if (j>i) j = i;
+      t = w->words[i]; w->words[i] = w->words[j]; w->words[j] = t;
+   }
+}
+
+/* LexWords: the distinct words of the lexicon */
+static void LexWords(WordList *w)
+{
+   const lexicon_entry *e = cmu_lex.entry_index;
+   int i;
+
+   w->words = (char **)New(&gstack,cmu_lex.num_entries*sizeof(char *));
+   for (i=0,w->n=0; i<cmu_lex.num_entries; i++)
+      if (i==0 || strcmp(e[i].word_pos+1,e[i-1].word_pos+1)!=0)
+         w->words[w->n++] = e[i].word_pos+1;
+   Shuffle(w); SetZipf(w);
+}
+
+/* OOVWords: letter strings which are not in the lexicon */
+static void OOVWords(WordList *w)
+{
+   static char *cons = "bcdfghjklmnprstvwz", *vows = "aeiouy";
+   char buf[MAXWORD];
+   int i,j,len;
+
+   w->words = (char **)New(&gstack,nOOV*sizeof(char *));
+   for (w->n=0; w->n<nOOV; ) {
+      len = 4 + (int)(RandomValue()*8);
+      for (j=0; j<len; j++)
+         buf[j] = (j&1) ? vows[(int)(RandomValue()*6)%6] :
+            cons[(int)(RandomValue()*18)%18];
+      buf[len] = '\0';
+      if (in_lex(&cmu_lex,buf,NULL)) continue;
+      for (i=0; i<w->n && strcmp(w->words[i],buf)!=0; i++);
+      if (i<w->n) continue;
+      w->words[w->n++] = CopyString(&gstack,buf);
+   }
+   SetZipf(w);
+}
+
+/* FileWords: words from a file, one per line, in their given order */
+static void FileWords(WordList *w, char *fn)
+{
+   FILE *f;
+   char buf[MAXWORD], *s;
+   int max = 1024;
+
+   if ((f = fopen(fn,"r")) == NULL)
+      HError(3210,"SLexTest: cannot open word list %s",fn);
+   w->words = (char **)malloc(max*sizeof(char *)); w->n = 0;
+   while (fgets(buf,MAXWORD,f) != NULL) {
+      for (s=buf; *s && !isspace((int)*s); s++) *s = tolower((int)*s);
+      *s = '\0';
+      if (buf[0] == '\0') continue;
+      if (w->n == max) {
+         max *= 2; w->words = (char **)realloc(w->words,max*sizeof(char *));
+      }
+      w->words[w->n++] = CopyString(&gstack,buf);
+   }
+   fclose(f);
+   if (w->n == 0)
+      HError(3210,"SLexTest: no words in %s",fn);
+}
+
+/* Pick: a word from w with zipf distribution */
+static char *Pick(WordList *w)
+{
+   double x = RandomValue()*w->cum[w->n-1];
+   int lo = 0, hi = w->n-1, mid;
+
+   while (lo < hi) {
+      mid = (lo+hi)/2;
+      if (w->cum[mid] < x) lo = mid+1; else hi = mid;
+   }
+   return w->words[lo];
+}
+
+/* MakeTokens: n tokens, fraction oov from oov and the rest from iv */
+static char **MakeTokens(WordList *iv, WordList *oov, float oovFrac)
+{
+   char **t;
+   int i;
+
+   t = (char **)New(&gstack,nTokens*sizeof(char *));
+   for (i=0; i<nTokens; i++)
+      t[i] = (RandomValue()<oovFrac) ? Pick(oov) : Pick(iv);
+   return t;
+}
+
+/* ------------------ Benchmark ------------------- */
+
+typedef cst_val *(*Lookup)(const cst_lexicon *l, const char *word,
+                           const char *pos);
+
+/* RunLookup: look up all tokens repeats times, return secs */
+static double RunLookup(Lookup look, char **tok, int n)
+{
+   clock_t c;
+   int i,r;
+
+   c = clock();
+   for (r=0; r<repeats; r++)
+      for (i=0; i<n; i++)
+         delete_val(look(&cmu_lex,tok[i],NULL));
+   return (double)(clock()-c)/CLOCKS_PER_SEC;
+}
+
+/* SamePhones: TRUE if two phone lists are equal */
+static Boolean SamePhones(const cst_val *a, const cst_val *b)
+{
+   for (; a && b; a = val_cdr(a), b = val_cdr(b))
+      if (!cst_streq(val_string(val_car(a)),val_string(val_car(b))))
+         return FALSE;
+   return a == NULL && b == NULL;
+}
+
+/* TestLookup: time lex_lookup against the reference and compare */
+static Boolean TestLookup(char *name, char **tok, int n)
+{
+   cst_val *a,*b;
+   double t,rt;
+   int i,nDiff = 0;
+
+   rt = RunLookup(ref_lex_lookup,tok,n);
+   t = RunLookup(lex_lookup,tok,n);
+   for (i=0; i<n; i++) {
+      a = ref_lex_lookup(&cmu_lex,tok[i],NULL);
+      b = lex_lookup(&cmu_lex,tok[i],NULL);
+      if (!SamePhones(a,b)) {
+         if (nDiff == 0 && trace&1)
+            printf("  %s differs\n",tok[i]);
+         ++nDiff;
+      }
+      delete_val(a); delete_val(b);
+   }
+   printf("%-10s %8.3f %8.3f %10.0f %10.0f %7.2f %8d %s\n",name,rt,t,
+          (rt>0.0)?n*repeats/rt:0.0,(t>0.0)?n*repeats/t:0.0,
+          (t>0.0)?rt/t:0.0,nDiff,nDiff==0?"PASS":"FAIL");
+   fflush(stdout);
+   return nDiff==0;
+}
+
+/* ------------------------ Main Program ------------------------ */
+
+int main(int argc, char *argv[])
+{
+   char *s;
+   WordList iv, oov, file;
+   int fails = 0;
+
+   InitThreads(HT_NOMONITOR);
+   if(InitShell(argc,argv,slextest_version)<SUCCESS)
+      HError(3200,"SLexTest: InitShell failed");
+   InitMem(); InitMath();
+   while (NextArg() == SWITCHARG) {
+      s = GetSwtArg();
+      if (strlen(s)!=1)
+         HError(3219,"SLexTest: Bad switch %s; must be single letter",s);
+      switch(s[0]){
+      case 'n': nTokens = GetChkedInt(1,100000000,s); break;
+      case 'o': oovRate = GetChkedFlt(0.0,1.0,s); break;
+      case 'v': nOOV = GetChkedInt(1,1000000,s); break;
+      case 'w': wordFile = GetStrArg(); break;
+      case 'x': repeats = GetChkedInt(1,1000,s); break;
+      case 'T': trace = GetChkedInt(0,0777,s); break;
+      default:
+         HError(3219,"SLexTest: Unknown switch %s",s);
+      }
+   }
+   if (NextArg()!=NOARG)
+      HError(3219,"SLexTest: unexpected extra args");
+   cmu_lex_init();
+   RandInit(LEXSEED);
+   LexWords(&iv); OOVWords(&oov);
+   printf("%d lexicon words, %d oov words, %d lookups, %d repeats\n",
+          iv.n,oov.n,nTokens,repeats);
+   printf("%-10s %8s %8s %10s %10s %7s %8s %s\n","test","refsecs",
+          "secs","refwps","wps","speedup","diffs","result");
+   if (!TestLookup("lexicon",MakeTokens(&iv,&oov,0.0),nTokens)) ++fails;
+   if (!TestLookup("lts",MakeTokens(&iv,&oov,1.0),nTokens)) ++fails;
+   if (!TestLookup("mixed",MakeTokens(&iv,&oov,oovRate),nTokens)) ++fails;
+   if (wordFile != NULL) {
+      FileWords(&file,wordFile);
+      if (!TestLookup("file",file.words,file.n)) ++fails;
+   }
+   Exit(fails>0?1:0);
+   return 0;
+}
@@ -0,0 +1,307 @@
+/* ----------------------------------------------------------- */
+/*                                                             */
+/*                        _ ___                                */
+/*                       /_\ | |_/                             */
+/*                       | | | | \                             */
+/*                       =========                             */
+/*                                                             */
+/*        Real-time API for HTK-base Speech Recognition        */
+/*                                                             */
+/*       Machine Intelligence Laboratory (Speech Group)        */
+/*        Cambridge University Engineering Department          */
+/*                  http://mi.eng.cam.ac.uk/                   */
+/*                                                             */
+/*               Copyright CUED 2000-2007                      */
+/*                                                             */
+/*   Use of this software is governed by a License Agreement   */
+/*    ** See the file License for the Conditions of Use  **    */
+/*    **     This banner notice must not be removed      **    */
+/*                                                             */
+/* ----------------------------------------------------------- */
+/*   File: SLpcTest.c - LPC resynthesis benchmark              */
+/* ----------------------------------------------------------- */
+
+char *slpctest_version = "!HVER!SLpcTest: 1.6.0 [CUED 19/10/26]";
+
+/*
+   SLpcTest builds a synthetic residual excited LPC track (random
+   stable filters and pitch periods) and resynthesises it with the
+   SYNLib kernels and with the original sample by sample kernels
+   kept below for reference.  It reports the throughput of each and
+   checks that the waveforms are identical.
+*/
+
+#include "HShell.h"
+#include "HThreads.h"
+#include "HMem.h"
+#include "HMath.h"
+#include "cst_wave.h"
+#include "cst_sigpr.h"
+#include "cst_sts.h"
+#include <time.h>
+
+#define SYNSEED 1234     /* random seed for synthetic track */
+
+static int order = 16;          /* lpc order */
+static int fold = 1;            /* residual fold */
+static float secs = 60.0;       /* secs of speech */
+static int repeats = 1;         /* times to run each kernel */
+static int sampRate = 16000;    /* sample rate */
+static int trace = 0;           /* trace flags */
+
+cst_wave *lpc_resynth_windows(cst_lpcres *lpcres);
+
+void ReportUsage(void)
+{
+   printf("\nUSAGE: SLpcTest [options]\n\n");
+   printf(" Option                                   Default\n\n");
+   printf(" -f i    residual fold                       1\n");
+   printf(" -o i    lpc order                           16\n");
+   printf(" -s f    secs of synthetic speech            60\n");
+   printf(" -x i    run each kernel i times             1\n");
+   PrintStdOpts("");
+   printf("\n\n");
+}
+
+/* ------------------ Reference Kernels ------------------- */
+
+/* The sample by sample kernels as originally in cst_sigpr.c and
+   cst_sigprFP.c, with a circular history buffer */
+
+static cst_wave *ref_resynth(cst_lpcres *lpcres, int reset)
+{
+   cst_wave *w;
+   int i,j,r,o,k;
+   int ci,cr;
+   float *outbuf, *lpccoefs;
+   int pm_size_samps;
+   float pp = 0;
+
+   w = new_wave();
+   cst_wave_resize(w,lpcres->num_samples * lpcres->residual_fold,1);
+   w->sample_rate = lpcres->sample_rate;
+   outbuf = cst_alloc(float,1+lpcres->num_channels);
+   lpccoefs = cst_alloc(float,lpcres->num_channels);
+   for (r=0,o=lpcres->num_channels,i=0; i < lpcres->num_frames; i++) {
+      pm_size_samps = lpcres->sizes[i] * lpcres->residual_fold;
+      for (k=0; k<lpcres->num_channels; k++) {
+         if (reset)
+            lpccoefs[k] = ((float)(((double)lpcres->frames[i][k])/65535.0)*
+                           lpcres->lpc_range) + lpcres->lpc_min;
+         else
+            lpccoefs[k] = (float)((((double)lpcres->frames[i][k])/65535.0)*
+                                  lpcres->lpc_range) + lpcres->lpc_min;
+      }
+      if (reset)
+         memset(outbuf,0,sizeof(float)*(1+lpcres->num_channels));
+      for (j=0; j < pm_size_samps; j++,r++) {
+         outbuf[o] = (float)cst_ulaw_to_short(lpcres->residual[r/lpcres->residual_fold]);
+         cr = (o == 0 ? lpcres->num_channels : o-1);
+         for (ci=0; ci < lpcres->num_channels; ci++) {
+            outbuf[o] += lpccoefs[ci] * outbuf[cr];
+            cr = (cr == 0 ? lpcres->num_channels : cr-1);
+         }
+         w->samples[r] = (short)(outbuf[o] + pp*lpcres->post_emphasis);
+         pp = outbuf[o];
+         o = (o == lpcres->num_channels ? 0 : o+1);
+      }
+   }
+   cst_free(outbuf);
+   cst_free(lpccoefs);
+   return w;
+}
+
+static cst_wave *ref_resynth_float(cst_lpcres *lpcres)
+{
+   return ref_resynth(lpcres,FALSE);
+}
+
+static cst_wave *ref_resynth_windows(cst_lpcres *lpcres)
+{
+   return ref_resynth(lpcres,TRUE);
+}
+
+static cst_wave *ref_resynth_fixedpoint(cst_lpcres *lpcres)
+{
+   cst_wave *w;
+   int i,j,r,o,k;
+   int ci,cr;
+   int *outbuf, *lpccoefs;
+   int pm_size_samps, ilpc_min, ilpc_range;
+
+   w = new_wave();
+   cst_wave_resize(w,lpcres->num_samples * lpcres->residual_fold,1);
+   w->sample_rate = lpcres->sample_rate;
+   outbuf = cst_alloc(int,1+lpcres->num_channels);
+   lpccoefs = cst_alloc(int,lpcres->num_channels);
+   ilpc_min = (int)(lpcres->lpc_min*32768.0);
+   ilpc_range = (int)(lpcres->lpc_range*2048.0);
+   for (r=0,o=lpcres->num_channels,i=0; i < lpcres->num_frames; i++) {
+      pm_size_samps = lpcres->sizes[i] * lpcres->residual_fold;
+      for (k=0; k<lpcres->num_channels; k++)
+         lpccoefs[k]=((lpcres->frames[i][k]/2*ilpc_range)/2048+ilpc_min)/2;
+      for (j=0; j < pm_size_samps; j++,r++) {
+         outbuf[o] = (int)cst_ulaw_to_short(lpcres->residual[r / lpcres->residual_fold]);
+         outbuf[o] *= 16384;
+         cr = (o == 0 ? lpcres->num_channels : o-1);
+         for (ci=0; ci < lpcres->num_channels; ci++) {
+            outbuf[o] += lpccoefs[ci]*outbuf[cr];
+            cr = (cr == 0 ? lpcres->num_channels : cr-1);
+         }
+         outbuf[o] /= 16384;
+         w->samples[r] = (short)outbuf[o];
+         o = (o == lpcres->num_channels ? 0 : o+1);
+      }
+   }
+   cst_free(outbuf);
+   cst_free(lpccoefs);
+   return w;
+}
+
+/* ------------------ Synthetic Track ------------------- */
+
+/* MakeTrack: random stable filters from reflection coefs, pitch
+   periods of 5 to 10ms and a low level residual */
+static cst_lpcres *MakeTrack(void)
+{
+   cst_lpcres *l;
+   unsigned short **frames;
+   float **coefs,*k,*a,*b,cmin,cmax;
+   int i,j,m,n,nFrames,nSamps;
+
+   RandInit(SYNSEED);
+   /* sizes are in residual samples, each is output fold times */
+   nSamps = (int)(secs*sampRate/fold);
+   nFrames = nSamps/(sampRate/200/fold) + 1;
+   l = new_lpcres();
+   l->sizes = cst_alloc(int,nFrames);
+   coefs = (float **)New(&gstack,nFrames*sizeof(float *));
+   k = (float *)New(&gstack,(order+1)*sizeof(float));
+   b = (float *)New(&gstack,(order+1)*sizeof(float));
+   cmin = 1.0E10; cmax = -1.0E10;
+   for (n=0,i=0; n<nSamps; i++) {
+      l->sizes[i] = (sampRate/200 + (int)(RandomValue()*sampRate/200))/fold;
+      n += l->sizes[i];
+      /* step up from reflection coefs to predictor coefs */
+      a = coefs[i] = (float *)New(&gstack,(order+1)*sizeof(float));
+      for (m=1; m<=order; m++) {
+         k[m] = 0.7*(2.0*RandomValue()-1.0);
+         for (j=1; j<m; j++) b[j] = a[j] - k[m]*a[m-j];
+         for (j=1; j<m; j++) a[j] = b[j];
+         a[m] = k[m];
+      }
+      for (j=1; j<=order; j++) {
+         if (a[j]<cmin) cmin = a[j];
+         if (a[j]>cmax) cmax = a[j];
+      }
+   }
+   nFrames = i;
+   frames = cst_alloc(unsigned short *,nFrames);
+   for (i=0; i<nFrames; i++) {
+      frames[i] = cst_alloc(unsigned short,order);
+      for (j=0; j<order; j++)
+         frames[i][j] = (unsigned short)((coefs[i][j+1]-cmin)/(cmax-cmin)*65535.0+0.5);
+   }
+   l->frames = (const unsigned short **)frames;
+   l->num_frames = nFrames; l->num_channels = order;
+   l->lpc_min = cmin; l->lpc_range = cmax-cmin;
+   l->post_emphasis = 0.0; l->sample_rate = sampRate;
+   l->residual_fold = fold;
+   l->num_samples = n;
+   l->residual = cst_alloc(unsigned char,l->num_samples);
+   /* ulaw bytes with exponent <= 3, ie magnitudes below 1000 */
+   for (i=0; i<l->num_samples; i++)
+      l->residual[i] = 0xff - (unsigned char)(RandomValue()*64) -
+         ((RandomValue()<0.5)?0x80:0);
+   return l;
+}
+
+/* ------------------ Benchmark ------------------- */
+
+typedef cst_wave *(*Kernel)(cst_lpcres *l);
+
+/* RunKernel: run kernel repeats times, return last wave and secs */
+static cst_wave *RunKernel(Kernel kern, cst_lpcres *l, double *t)
+{
+   cst_wave *w = NULL;
+   clock_t c;
+   int i;
+
+   c = clock();
+   for (i=0; i<repeats; i++) {
+      if (w != NULL) delete_wave(w);
+      w = kern(l);
+   }
+   *t = (double)(clock()-c)/CLOCKS_PER_SEC;
+   return w;
+}
+
+/* TestKernel: time new against ref and compare, return TRUE if same */
+static Boolean TestKernel(char *name, Kernel kern, Kernel ref, cst_lpcres *l)
+{
+   cst_wave *w,*rw;
+   double t,rt,audio;
+   int i,nDiff = 0,maxDiff = 0;
+
+   /* one untimed pass each so neither pays for first touch */
+   delete_wave(ref(l)); delete_wave(kern(l));
+   rw = RunKernel(ref,l,&rt);
+   w = RunKernel(kern,l,&t);
+   audio = (double)w->num_samples*repeats/sampRate;
+   if (w->num_samples != rw->num_samples) nDiff = -1;
+   else
+      for (i=0; i<w->num_samples; i++)
+         if (w->samples[i] != rw->samples[i]) {
+            ++nDiff;
+            if (abs(w->samples[i]-rw->samples[i])>maxDiff)
+               maxDiff = abs(w->samples[i]-rw->samples[i]);
+         }
+   printf("%-10s %8.3f %8.3f %10.1f %10.1f %7.2f %8d %s\n",name,rt,t,
+          (rt>0.0)?audio/rt:0.0,(t>0.0)?audio/t:0.0,(t>0.0)?rt/t:0.0,
+          nDiff,nDiff==0?"PASS":"FAIL");
+   if (nDiff != 0 && trace&1)
+      printf("  %d samples differ, max diff %d\n",nDiff,maxDiff);
+   fflush(stdout);
+   delete_wave(w); delete_wave(rw);
+   return nDiff==0;
+}
+
+/* ------------------------ Main Program ------------------------ */
+
+int main(int argc, char *argv[])
+{
+   char *s;
+   cst_lpcres *l;
+   int fails = 0;
+
+   InitThreads(HT_NOMONITOR);
+   if(InitShell(argc,argv,slpctest_version)<SUCCESS)
+      HError(3200,"SLpcTest: InitShell failed");
+   InitMem(); InitMath();
+   while (NextArg() == SWITCHARG) {
+      s = GetSwtArg();
+      if (strlen(s)!=1)
+         HError(3219,"SLpcTest: Bad switch %s; must be single letter",s);
+      switch(s[0]){
+      case 'f': fold = GetChkedInt(1,8,s); break;
+      case 'o': order = GetChkedInt(1,64,s); break;
+      case 's': secs = GetChkedFlt(0.1,100000.0,s); break;
+      case 'x': repeats = GetChkedInt(1,1000,s); break;
+      case 'T': trace = GetChkedInt(0,0777,s); break;
+      default:
+         HError(3219,"SLpcTest: Unknown switch %s",s);
+      }
+   }
+   if (NextArg()!=NOARG)
+      HError(3219,"SLpcTest: unexpected extra args");
+   l = MakeTrack();
+   printf("%d frames, order %d, %.1f secs, %d repeats\n",l->num_frames,
+          order,(float)l->num_samples*fold/sampRate,repeats);
+   printf("%-10s %8s %8s %10s %10s %7s %8s %s\n","kernel","refsecs",
+          "secs","refxRT","xRT","speedup","diffs","result");
+   if (!TestKernel("float",lpc_resynth,ref_resynth_float,l)) ++fails;
+   if (!TestKernel("windows",lpc_resynth_windows,ref_resynth_windows,l)) ++fails;
+   if (!TestKernel("fixed",lpc_resynth_fixedpoint,ref_resynth_fixedpoint,l)) ++fails;
+   Exit(fails>0?1:0);
+   return 0;
+}
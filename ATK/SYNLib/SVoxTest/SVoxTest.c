@@ -0,0 +1,514 @@
+/* ----------------------------------------------------------- */
+/*                                                             */
+/*                        _ ___                                */
+/*                       /_\ | |_/                             */
+/*                       | | | | \                             */
+/*                       =========                             */
+/*                                                             */
+/*        Real-time API for HTK-base Speech Recognition        */
+/*                                                             */
+/*       Machine Intelligence Laboratory (Speech Group)        */
+/*        Cambridge University Engineering Department          */
+/*                  http://mi.eng.cam.ac.uk/                   */
+/*                                                             */
+/*               Copyright CUED 2000-2007                      */
+/*                                                             */
+/*   Use of this software is governed by a License Agreement   */
+/*    ** See the file License for the Conditions of Use  **    */
+/*    **     This banner notice must not be removed      **    */
+/*                                                             */
+/* ----------------------------------------------------------- */
+/*   File: SVoxTest.c - voice file test                        */
+/* ----------------------------------------------------------- */
+
+char *svoxtest_version = "!HVER!SVoxTest: 1.6.0 [CUED 19/10/26]";
+
+/*
+   SVoxTest builds a diphone and a clunits unit database in memory,
+   as a voice compiler would, saves each to a voice file and maps
+   it back.  Every diphone, unit type, unit, tree, sts frame and
+   residual of the mapped database must equal the original.  The
+   time to map a voice file is compared with reading it into memory,
+   and files with the wrong byte order or version must be refused.
+*/
+
+#include "HShell.h"
+#include "HThreads.h"
+#include "HMem.h"
+#include "HMath.h"
+#include "flite.h"
+#include "cst_voxfile.h"
+#include <time.h>
+
+#define VOXSEED 4321       /* random seed for the databases */
+#define NCHANS 16          /* lpc and mel cep channels */
+
+static int nDiphones = 2000;    /* diphones in diphone db */
+static int nUnits = 20000;      /* units in clunits db */
+static int repeats = 100;       /* times to map each file */
+static char *voxDir = ".";      /* where voice files are written */
+static int trace = 0;           /* trace flags */
+
+void ReportUsage(void)
+{
+   printf("\nUSAGE: SVoxTest [options]\n\n");
+   printf(" Option                                   Default\n\n");
+   printf(" -d i    diphones in diphone db              2000\n");
+   printf(" -o s    write voice files in dir s          .\n");
+   printf(" -u i    units in clunits db                 20000\n");
+   printf(" -x i    map each file i times               100\n");
+   PrintStdOpts("");
+   printf("\n\n");
+}
+
+/* ---------------- Test databases ------------------ */
+
+/* MakeSts: n frames as compiled in, residual sizes from 60 to 200 */
+static cst_sts_list *MakeSts(int n, int fixed)
+{
+   cst_sts_list *l;
+   cst_sts *sts;
+   unsigned short *f;
+   unsigned char *r;
+   int i,j,size;
+
+   l = new_sts_list();
+   sts = cst_alloc(cst_sts,n);
+   for (i=0; i<n; i++) {
+      size = fixed ? NCHANS : 60 + (int)(RandomValue()*140);
+      f = cst_alloc(unsigned short,NCHANS);
+      r = cst_alloc(unsigned char,size);
+      for (j=0; j<NCHANS; j++) f[j] = (unsigned short)(RandomValue()*65535);
+      for (j=0; j<size; j++) r[j] = (unsigned char)(RandomValue()*255);
+      sts[i].frame = f; sts[i].residual = r;
+      *(int *)&sts[i].size = fixed ? 80 : size;
+   }
+   l->sts = sts;
+   l->num_sts = n; l->num_channels = NCHANS;
+   l->sample_rate = 16000;
+   l->coeff_min = -2.5; l->coeff_range = 5.25;
+   l->post_emphasis = 0.0; l->residual_fold = 1;
+   return l;
+}
+
+/* MakeDiphones: a diphone db with names in sorted order */
+static cst_diphone_db *MakeDiphones(void)
+{
+   cst_diphone_db *db;
+   cst_diphone_entry *e;
+   char buf[32];
+   int i,pm;
+
+   db = cst_alloc(cst_diphone_db,1);
+   e = cst_alloc(cst_diphone_entry,nDiphones);
+   for (i=0,pm=0; i<nDiphones; i++) {
+      sprintf(buf,"p%04d-p%04d",i/50,i%50);
+      e[i].name = cst_strdup(buf);
+      e[i].start_pm = pm; e[i].pb_pm = pm+3+i%4; pm = e[i].end_pm = pm+8;
+   }
+   db->name = "svox_diphone";
+   db->num_entries = nDiphones; db->diphones = e;
+   db->sts = MakeSts(pm,0);
+   return db;
+}
+
+/* MakeLeaf: a clunits leaf, a list of (unit score) pairs */
+static cst_val *MakeLeaf(int start, int count)
+{
+   cst_val *v = NULL;
+   int i;
+
+   for (i=count-1; i>=0; i--)
+      v = cons_val(cons_val(int_val(i),cons_val(int_val(start+i),NULL)),v);
+   return v;
+}
+
+/* MakeTree: asks name IS "a" then num < 3.5 */
+static cst_cart *MakeTree(int start, int count)
+{
+   static const char *feats[] = { "name", "num", NULL };
+   cst_cart_node *n;
+   cst_cart *c;
+
+   n = cst_alloc(cst_cart_node,6);
+   n[0].feat = 0; n[0].op = CST_CART_OP_IS; n[0].no_node = 2;
+   n[0].val = string_val("a");
+   n[1].feat = 255; n[1].op = CST_CART_OP_LEAF;
+   n[1].val = MakeLeaf(start,count);
+   n[2].feat = 1; n[2].op = CST_CART_OP_LESS; n[2].no_node = 4;
+   n[2].val = float_val(3.5);
+   n[3].feat = 255; n[3].op = CST_CART_OP_LEAF;
+   n[3].val = MakeLeaf(start,count/2+1);
+   n[4].feat = 255; n[4].op = CST_CART_OP_LEAF;
+   n[4].val = string_val("none");
+   n[5].feat = 255; n[5].op = CST_CART_OP_NONE;
+   c = cst_alloc(cst_cart,1);
+   c->rule_table = n; c->feat_table = feats;
+   return c;
+}
+
+/* MakeClunits: types of 50 units each, each unit of 5 frames */
+static cst_clunit_db *MakeClunits(void)
+{
+   cst_clunit_db *db;
+   cst_clunit_type *t;
+   cst_clunit *u;
+   const cst_cart **trees;
+   char buf[32];
+   int i,nt;
+
+   nt = (nUnits+49)/50;
+   db = cst_alloc(cst_clunit_db,1);
+   t = cst_alloc(cst_clunit_type,nt);
+   trees = cst_alloc(const cst_cart *,nt);
+   u = cst_alloc(cst_clunit,nUnits);
+   for (i=0; i<nt; i++) {
+      sprintf(buf,"t%04d_%d",i,i%7);
+      t[i].name = cst_strdup(buf);
+      t[i].start = i*50;
+      t[i].count = (i==nt-1) ? nUnits-i*50 : 50;
+      trees[i] = MakeTree(t[i].start,t[i].count);
+   }
+   for (i=0; i<nUnits; i++) {
+      u[i].type = i/50; u[i].phone = i%41;
+      u[i].start = i*5; u[i].end = i*5+5;
+      u[i].prev = (i%50==0) ? CLUNIT_NONE : i-1;
+      u[i].next = (i%50==49 || i==nUnits-1) ? CLUNIT_NONE : i+1;
+   }
+   db->name = "svox_clunits";
+   db->types = t; db->trees = trees; db->units = u;
+   db->num_types = nt; db->num_units = nUnits;
+   db->sts = MakeSts(nUnits*5,0);
+   db->mcep = MakeSts(nUnits*5,1);
+   db->join_weights = cst_alloc(int,NCHANS);
+   for (i=0; i<NCHANS; i++) db->join_weights[i] = 65536/(i+1);
+   db->optimal_coupling = 1; db->extend_selections = 2; db->f0_weight = 0;
+   return db;
+}
+
+static cst_features *MakeParams(void)
+{
+   cst_features *f = new_features();
+
+   feat_set_string(f,"name","svox");
+   feat_set_float(f,"int_f0_target_mean",105.0);
+   feat_set_int(f,"sample_rate",16000);
+   return f;
+}
+
+/* ---------------- Comparison ------------------ */
+
+static int nDiffs;
+
+static void Differs(char *what, int i)
+{
+   if (nDiffs == 0 && trace&1)
+      printf("  %s %d differs\n",what,i);
+   ++nDiffs;
+}
+
+/* SameVal: deep equality of tree values */
+static Boolean SameVal(const cst_val *a, const cst_val *b)
+{
+   if (a == NULL || b == NULL)
+      return a == b;
+   if (cst_val_consp(a) || cst_val_consp(b))
+      return cst_val_consp(a) && cst_val_consp(b)
+         && SameVal(val_car(a),val_car(b)) && SameVal(val_cdr(a),val_cdr(b));
+   if (CST_VAL_TYPE(a) != CST_VAL_TYPE(b))
+      return FALSE;
+   if (CST_VAL_TYPE(a) == CST_VAL_TYPE_STRING)
+      return cst_streq(val_string(a),val_string(b));
+   if (CST_VAL_TYPE(a) == CST_VAL_TYPE_FLOAT)
+      return val_float(a) == val_float(b);
+   return val_int(a) == val_int(b);
+}
+
+static void CompareSts(const cst_sts_list *a, const cst_sts_list *b,
+                       int fixed)
+{
+   const unsigned short *fa,*fb;
+   const unsigned char *ra,*rb;
+   int i,size;
+
+   if (b == NULL || a->num_sts != b->num_sts
+       || a->num_channels != b->num_channels
+       || a->sample_rate != b->sample_rate || a->coeff_min != b->coeff_min
+       || a->coeff_range != b->coeff_range
+       || a->residual_fold != b->residual_fold) {
+      Differs("sts header",0); return;
+   }
+   for (i=0; i<a->num_sts; i++) {
+      fa = get_sts_frame(a,i); fb = get_sts_frame(b,i);
+      if (memcmp(fa,fb,a->num_channels*sizeof(unsigned short)) != 0)
+         Differs("frame",i);
+      if (fixed) {
+         ra = get_sts_residual_fixed(a,i); rb = get_sts_residual_fixed(b,i);
+         size = a->num_channels;
+      } else {
+         size = get_frame_size(a,i);
+         if (size != get_frame_size(b,i)) { Differs("frame size",i); continue; }
+         ra = get_sts_residual(a,i); rb = get_sts_residual(b,i);
+      }
+      if (memcmp(ra,rb,size) != 0)
+         Differs("residual",i);
+   }
+}
+
+static void CompareParams(cst_features *f)
+{
+   if (!cst_streq(get_param_string(f,"name",""),"svox")
+       || get_param_float(f,"int_f0_target_mean",0.0) != 105.0
+       || get_param_int(f,"sample_rate",0) != 16000)
+      Differs("params",0);
+}
+
+static void CompareDiphones(const cst_diphone_db *a, cst_voxfile *vf)
+{
+   const cst_diphone_db *b = cst_vox_diphone_db(vf);
+   int i;
+
+   if (b == NULL || a->num_entries != b->num_entries
+       || !cst_streq(a->name,b->name)) {
+      Differs("diphone db",0); return;
+   }
+   for (i=0; i<a->num_entries; i++)
+      if (!cst_streq(a->diphones[i].name,b->diphones[i].name)
+          || a->diphones[i].start_pm != b->diphones[i].start_pm
+          || a->diphones[i].pb_pm != b->diphones[i].pb_pm
+          || a->diphones[i].end_pm != b->diphones[i].end_pm)
+         Differs("diphone",i);
+   CompareSts(a->sts,b->sts,0);
+   CompareParams(cst_vox_features(vf));
+}
+
+/* CompareTree: node by node, then by interpreting both */
+static void CompareTree(const cst_cart *a, const cst_cart *b, int t,
+                        cst_item *item)
+{
+   static const char *names[] = { "a", "b" };
+   int i;
+
+   for (i=0; a->feat_table[i]; i++)
+      if (b->feat_table[i] == NULL
+          || !cst_streq(a->feat_table[i],b->feat_table[i]))
+         Differs("tree feats",t);
+   if (b->feat_table[i] != NULL)
+      Differs("tree feats",t);
+   for (i=0; a->rule_table[i].op != CST_CART_OP_NONE
+           || a->rule_table[i].val != NULL; i++)
+      if (a->rule_table[i].feat != b->rule_table[i].feat
+          || a->rule_table[i].op != b->rule_table[i].op
+          || a->rule_table[i].no_node != b->rule_table[i].no_node
+          || !SameVal(a->rule_table[i].val,b->rule_table[i].val))
+         Differs("tree node",t);
+   for (i=0; i<4; i++) {
+      item_set_string(item,"name",names[i%2]);
+      item_set_float(item,"num",(i<2)?1.0:5.0);
+      if (!SameVal(cart_interpret(item,a),cart_interpret(item,b)))
+         Differs("tree answer",t);
+   }
+}
+
+static void CompareClunits(const cst_clunit_db *a, cst_voxfile *vf)
+{
+   const cst_clunit_db *b = cst_vox_clunit_db(vf);
+   cst_utterance *utt;
+   cst_item *item;
+   int i;
+
+   if (b == NULL || a->num_types != b->num_types
+       || a->num_units != b->num_units || !cst_streq(a->name,b->name)
+       || a->optimal_coupling != b->optimal_coupling
+       || a->extend_selections != b->extend_selections
+       || a->f0_weight != b->f0_weight) {
+      Differs("clunit db",0); return;
+   }
+   for (i=0; i<a->mcep->num_channels; i++)
+      if (a->join_weights[i] != b->join_weights[i])
+         Differs("join weight",i);
+   for (i=0; i<a->num_units; i++)
+      if (a->units[i].type != b->units[i].type
+          || a->units[i].phone != b->units[i].phone
+          || a->units[i].start != b->units[i].start
+          || a->units[i].end != b->units[i].end
+          || a->units[i].prev != b->units[i].prev
+          || a->units[i].next != b->units[i].next)
+         Differs("unit",i);
+   utt = new_utterance();
+   item = relation_append(utt_relation_create(utt,"Segment"),NULL);
+   for (i=0; i<a->num_types; i++) {
+      if (!cst_streq(a->types[i].name,b->types[i].name)
+          || a->types[i].start != b->types[i].start
+          || a->types[i].count != b->types[i].count)
+         Differs("unit type",i);
+      CompareTree(a->trees[i],b->trees[i],i,item);
+   }
+   delete_utterance(utt);
+   CompareSts(a->sts,b->sts,0);
+   CompareSts(a->mcep,b->mcep,1);
+   CompareParams(cst_vox_features(vf));
+}
+
+/* ---------------- Tests ------------------ */
+
+/* TimeOpen: map and close fn repeats times, return secs per map */
+static double TimeOpen(char *fn)
+{
+   cst_voxfile *vf;
+   clock_t c;
+   int r;
+
+   c = clock();
+   for (r=0; r<repeats; r++) {
+      if ((vf = cst_vox_open(fn)) == NULL)
+         HError(3250,"SVoxTest: cannot map %s",fn);
+      cst_vox_close(vf);
+   }
+   return (double)(clock()-c)/CLOCKS_PER_SEC/repeats;
+}
+
+/* TimeRead: read fn into memory repeats times, return secs per read */
+static double TimeRead(char *fn)
+{
+   cst_filemap *fm;
+   clock_t c;
+   int r;
+
+   c = clock();
+   for (r=0; r<repeats; r++) {
+      if ((fm = cst_read_whole_file(fn)) == NULL)
+         HError(3250,"SVoxTest: cannot read %s",fn);
+      cst_free_whole_file(fm);
+   }
+   return (double)(clock()-c)/CLOCKS_PER_SEC/repeats;
+}
+
+static Boolean Report(char *name, char *fn, double mb)
+{
+   double t,rt;
+
+   t = TimeOpen(fn); rt = TimeRead(fn);
+   printf("%-10s %8.2f %10.3f %10.3f %8d %s\n",name,mb,t*1000.0,rt*1000.0,
+          nDiffs,nDiffs==0?"PASS":"FAIL");
+   fflush(stdout);
+   return nDiffs==0;
+}
+
+static double FileMB(char *fn)
+{
+   FILE *f;
+   long n = 0;
+
+   if ((f = fopen(fn,"rb")) != NULL) {
+      fseek(f,0,SEEK_END); n = ftell(f); fclose(f);
+   }
+   return n/1048576.0;
+}
+
+static Boolean TestDiphones(void)
+{
+   cst_diphone_db *db = MakeDiphones();
+   cst_features *params = MakeParams();
+   cst_voxfile *vf;
+   char fn[MAXFNAMELEN];
+
+   MakeFN("svox_diphone.vox",voxDir,NULL,fn);
+   if (cst_vox_save_diphone_db(fn,db,params) != 0)
+      HError(3211,"SVoxTest: cannot write %s",fn);
+   nDiffs = 0;
+   if ((vf = cst_vox_open(fn)) == NULL)
+      Differs("open",0);
+   else {
+      CompareDiphones(db,vf); cst_vox_close(vf);
+   }
+   return Report("diphone",fn,FileMB(fn));
+}
+
+static Boolean TestClunits(void)
+{
+   cst_clunit_db *db = MakeClunits();
+   cst_features *params = MakeParams();
+   cst_voxfile *vf;
+   char fn[MAXFNAMELEN];
+
+   MakeFN("svox_clunits.vox",voxDir,NULL,fn);
+   if (cst_vox_save_clunit_db(fn,db,params) != 0)
+      HError(3211,"SVoxTest: cannot write %s",fn);
+   nDiffs = 0;
+   if ((vf = cst_vox_open(fn)) == NULL)
+      Differs("open",0);
+   else {
+      CompareClunits(db,vf); cst_vox_close(vf);
+   }
+   return Report("clunits",fn,FileMB(fn));
+}
+
+/* TestRefused: a copy of src with header word w changed must not map */
+static Boolean TestRefused(char *name, char *src, int w)
+{
+   cst_filemap *fm;
+   cst_voxfile *vf;
+   cst_vox_header *h;
+   char fn[MAXFNAMELEN];
+   FILE *f;
+
+   if ((fm = cst_read_whole_file(src)) == NULL)
+      HError(3250,"SVoxTest: cannot read %s",src);
+   h = (cst_vox_header *)fm->mem;
+   if (w == 0) h->byteorder = 0x04030201; else ++h->version;
+   MakeFN("svox_bad.vox",voxDir,NULL,fn);
+   if ((f = fopen(fn,"wb")) == NULL)
+      HError(3211,"SVoxTest: cannot write %s",fn);
+   fwrite(fm->mem,1,fm->mapsize,f); fclose(f);
+   cst_free_whole_file(fm);
+   nDiffs = 0;
+   if ((vf = cst_vox_open(fn)) != NULL) {
+      Differs("refused",0); cst_vox_close(vf);
+   }
+   remove(fn);
+   printf("%-10s %8s %10s %10s %8d %s\n",name,"-","-","-",
+          nDiffs,nDiffs==0?"PASS":"FAIL");
+   return nDiffs==0;
+}
+
+/* ------------------------ Main Program ------------------------ */
+
+int main(int argc, char *argv[])
+{
+   char *s, fn[MAXFNAMELEN];
+   int fails = 0;
+
+   InitThreads(HT_NOMONITOR);
+   if(InitShell(argc,argv,svoxtest_version)<SUCCESS)
+      HError(3200,"SVoxTest: InitShell failed");
+   InitMem(); InitMath();
+   while (NextArg() == SWITCHARG) {
+      s = GetSwtArg();
+      if (strlen(s)!=1)
+         HError(3219,"SVoxTest: Bad switch %s; must be single letter",s);
+      switch(s[0]){
+      case 'd': nDiphones = GetChkedInt(1,100000,s); break;
+      case 'o': voxDir = GetStrArg(); break;
+      case 'u': nUnits = GetChkedInt(1,60000,s); break;
+      case 'x': repeats = GetChkedInt(1,100000,s); break;
+      case 'T': trace = GetChkedInt(0,0777,s); break;
+      default:
+         HError(3219,"SVoxTest: Unknown switch %s",s);
+      }
+   }
+   if (NextArg()!=NOARG)
+      HError(3219,"SVoxTest: unexpected extra args");
+   RandInit(VOXSEED);
+   printf("%d diphones, %d units, %d maps of each file\n",
+          nDiphones,nUnits,repeats);
+   printf("%-10s %8s %10s %10s %8s %s\n","test","MB","mapms","readms",
+          "diffs","result");
+   if (!TestDiphones()) ++fails;
+   if (!TestClunits()) ++fails;
+   MakeFN("svox_diphone.vox",voxDir,NULL,fn);
+   if (!TestRefused("byteorder",fn,0)) ++fails;
+   if (!TestRefused("version",fn,1)) ++fails;
+   Exit(fails>0?1:0);
+   return 0;
+}
@@ -131,17 +131,13 @@ int audio_bps(cst_audiofmt fmt)
 cst_audiodev *audio_open(int sps, int channels, cst_audiofmt fmt)
 {
    cst_audiodev *ad;
-   int up, down;
 
    ad = audio_open_atk(sps, channels, fmt);
    if (ad == NULL)
       return NULL;
 
-   down = sps / 1000;
-   up = ad->real_sps / 1000;
-
-   if (up != down)
-      ad->rateconv = new_rateconv(up, down, channels);
+   if (ad->real_sps != sps)
+      ad->rateconv = new_rateconv(ad->real_sps, sps, channels);
 
    return ad;
 }
@@ -161,27 +157,12 @@ int audio_write(cst_audiodev *ad,void *buff,int num_bytes)
 
    if (ad->rateconv)
    {
-      short *in, *out;
-      int insize, outsize, n;
-
-      insize = real_num_bytes / 2;
-      in = buff;
+      int n;
 
-      outsize = ad->rateconv->outsize;
-      nbuf = out = cst_alloc(short, outsize);
-      real_num_bytes = outsize * 2;
-
-      while ((n = cst_rateconv_in(ad->rateconv, in, insize)) > 0)
-      {
-         in += n;
-         insize -= n;
-         while ((n = cst_rateconv_out(ad->rateconv, out, outsize)) > 0)
-         {
-            out += n;
-            outsize -= n;
-         }
-      }
-      real_num_bytes -= outsize * 2;
+      n = real_num_bytes / (2 * ad->channels);
+      nbuf = cst_alloc(short, cst_rateconv_size(ad->rateconv, n) * ad->channels);
+      n = cst_rateconv_run(ad->rateconv, buff, n, nbuf);
+      real_num_bytes = n * 2 * ad->channels;
       if (abuf != buff)
          cst_free(abuf);
       abuf = nbuf;
@@ -233,6 +233,109 @@ void cst_local_free(cst_alloc_context ctx, void *p)
     else
 	LocalFree(p);
 }
-#endif
 
+int cst_arena_owns(cst_alloc_context ctx, const void *p)
+{
+    return FALSE;
+}
+#else /* ! UNDER_CE */
+
+/* Arena blocks, allocations are carved off the front of each block */
+typedef struct cst_arena_block_struct {
+    struct cst_arena_block_struct *next;
+    int size;                   /* bytes of data in the block */
+    int used;
+} cst_arena_block;
+
+struct cst_arena_struct {
+    cst_arena_block *head;      /* current block is first */
+    int block_size;
+};
+
+/* Allocations and the block header are kept double aligned */
+#define CST_ARENA_ALIGN 16
+#define CST_ARENA_ROUND(n) (((n)+CST_ARENA_ALIGN-1) & ~(CST_ARENA_ALIGN-1))
+#define CST_ARENA_HDR CST_ARENA_ROUND((int)sizeof(cst_arena_block))
+
+cst_alloc_context new_alloc_context(int size)
+{
+    cst_alloc_context ctx;
+
+    ctx = cst_alloc(struct cst_arena_struct,1);
+    ctx->head = NULL;
+    ctx->block_size = (size > 0) ? size : 4096;
+    return ctx;
+}
+
+void delete_alloc_context(cst_alloc_context ctx)
+{
+    cst_arena_block *b, *nb;
+
+    if (ctx)
+    {
+	for (b=ctx->head; b; b=nb)
+	{
+	    nb = b->next;
+	    cst_free(b);
+	}
+	cst_free(ctx);
+    }
+}
+
+void *cst_local_alloc(cst_alloc_context ctx, int size)
+{
+    cst_arena_block *b;
+    void *p;
+    int bsize;
+
+    if (ctx == NULL)
+	return cst_safe_alloc(size);
+    if (size <= 0)
+	size = 1;
+    size = CST_ARENA_ROUND(size);
+    b = ctx->head;
+    if ((b == NULL) || (b->used+size > b->size))
+    {
+	/* blocks come from calloc so the arena hands out zeroed memory */
+	bsize = (size > ctx->block_size) ? size : ctx->block_size;
+	b = (cst_arena_block *)cst_safe_alloc(CST_ARENA_HDR+bsize);
+	b->size = bsize;
+	b->used = 0;
+	if (ctx->head && (bsize > ctx->block_size))
+	{
+	    /* keep the current block in front for small requests */
+	    b->next = ctx->head->next;
+	    ctx->head->next = b;
+	}
+	else
+	{
+	    b->next = ctx->head;
+	    ctx->head = b;
+	}
+    }
+    p = (char *)b + CST_ARENA_HDR + b->used;
+    b->used += size;
+    return p;
+}
 
+void cst_local_free(cst_alloc_context ctx, void *p)
+{
+    if (ctx == NULL)
+	cst_free(p);
+}
+
+int cst_arena_owns(cst_alloc_context ctx, const void *p)
+{
+    cst_arena_block *b;
+    const char *d;
+
+    if (ctx)
+	for (b=ctx->head; b; b=b->next)
+	{
+	    d = (const char *)b + CST_ARENA_HDR;
+	    if (((const char *)p >= d) && ((const char *)p < d + b->used))
+		return TRUE;
+	}
+    return FALSE;
+}
+#endif
@@ -63,13 +63,21 @@ void delete_alloc_context(cst_alloc_context ctx);
 void *cst_local_alloc(cst_alloc_context ctx, int size);
 void cst_local_free(cst_alloc_context ctx, void *p);
 #else /* ! UNDER_CE */
-typedef void * cst_alloc_context;
-#define new_alloc_context(size)   (NULL)
-#define delete_alloc_context(ctx)
-#define cst_local_alloc(ctx,size) cst_safe_alloc(size)
-#define cst_local_free(cst,p)     cst_free(p)
+/* A context is an arena, local frees are ignored and everything is */
+/* released at once by delete_alloc_context.  A NULL context means  */
+/* the global heap.                                                 */
+typedef struct cst_arena_struct *cst_alloc_context;
+
+cst_alloc_context new_alloc_context(int size);
+void delete_alloc_context(cst_alloc_context ctx);
+
+void *cst_local_alloc(cst_alloc_context ctx, int size);
+void cst_local_free(cst_alloc_context ctx, void *p);
 #endif /* ! UNDER_CE */
 
+/* TRUE if p was allocated from the arena ctx */
+int cst_arena_owns(cst_alloc_context ctx, const void *p);
+
 /* The public interface to the alloc functions */
 
 /* Note we actually underying call calloc so everything is zero'd */
@@ -40,18 +40,48 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "cst_regex.h"
 #include "cst_cart.h"
 
-CST_VAL_REGISTER_TYPE_NODEL(cart,cst_cart)
+CST_VAL_REGISTER_TYPE(cart,cst_cart)
 
 #define cst_cart_node_n(P,TREE) ((TREE)->rule_table[P])
 
 void delete_cart(cst_cart *cart)
 {
-#ifndef UNDER_CE
-    printf("delete_cart function missing\n");
-#endif
+    /* Only compiled trees are owned, static ones are left alone */
+    int i;
+
+    if (cart && cart->feat_paths)
+    {
+	for (i=0; i<cart->num_feats; i++)
+	    delete_featpath(cart->feat_paths[i]);
+	cst_free(cart->feat_paths);
+	cst_free(cart);
+    }
+}
+
+cst_cart *cart_compile(const cst_cart *tree,const cst_features *ffunctions)
+{
+    cst_cart *cart;
+    int i;
+
+    cart = cst_alloc(cst_cart,1);
+    cart->rule_table = tree->rule_table;
+    cart->feat_table = tree->feat_table;
+    for (i=0; tree->feat_table[i]; i++);
+    if (i > CST_CART_MAX_FEATS)
+    {
+	cst_errmsg("cart_compile: too many features %d\n",i);
+	cst_error();
+    }
+    cart->num_feats = i;
+    cart->feat_paths = cst_alloc(cst_featpath *,i+1);
+    for (i=0; i<cart->num_feats; i++)
+	cart->feat_paths[i] = new_featpath(tree->feat_table[i],ffunctions);
+
+    return cart;
 }
 
 static const cst_val *cart_interpret_questions(cst_item *item,
@@ -101,21 +131,30 @@ static const cst_val *cart_interpret_questions(cst_item *item,
 {
     const cst_val *v=0;
     const cst_val *tree_val;
-    const char *tree_feat = "";
-    cst_features *fcache;
-    int r=0;
+    const cst_val *fcache[CST_CART_MAX_FEATS];
+    unsigned char cached[CST_CART_MAX_FEATS];
+    unsigned char used[CST_CART_MAX_FEATS];
+    int feat, nused=0, r=0;
 
-    fcache = new_features_local(item_utt(item)->ctx);
+    /* feature values are cached by feat index for this interpretation */
+    memset(cached,0,sizeof(cached));
 
     while (cst_cart_node_op(node,tree) != CST_CART_OP_LEAF)
     {
 /* 	cart_print_node(node,tree); */
-	tree_feat = cst_cart_node_feat(node,tree);
-	v = get_param_val(fcache,tree_feat,0);
-	if (v == 0)
+	feat = cst_cart_node_n(node,tree).feat;
+	if (cached[feat])
+	    v = fcache[feat];
+	else
 	{
-	    v = ffeature(item,tree_feat);
-	    feat_set(fcache,tree_feat,v);
+	    if (tree->feat_paths)
+		v = ffeature_fp(item,tree->feat_paths[feat]);
+	    else
+		v = ffeature(item,cst_cart_node_feat(node,tree));
+	    /* held until the end as ffunctions may return new vals */
+	    fcache[feat] = val_inc_refcount(v);
+	    cached[feat] = 1;
+	    used[nused++] = feat;
 	}
 /*	val_print(stdout,v); printf("\n"); */
 	tree_val = cst_cart_node_val(node,tree);
@@ -148,7 +187,8 @@ static const cst_val *cart_interpret_questions(cst_item *item,
 	    node = cst_cart_node_no(node,tree);
 	}
     }
-    delete_features(fcache);
+    while (nused > 0)
+	delete_val((cst_val *)(void *)fcache[used[--nused]]);
     return cst_cart_node_val(node,tree);
 
 }
@@ -66,10 +66,20 @@ typedef struct cst_cart_node_struct {
 typedef struct cst_cart_struct {
     const cst_cart_node *rule_table;
     const char * const *feat_table;
+    /* Set by cart_compile, NULL for static trees */
+    cst_featpath **feat_paths;   /* compiled feat_table entries */
+    int num_feats;
 } cst_cart;
 
+/* Largest feat index a node can hold */
+#define CST_CART_MAX_FEATS 256
+
 void delete_cart(cst_cart *c);
 
+/* Returns a copy of tree sharing its nodes but with its feature */
+/* paths compiled, ffunctions are resolved in the given set      */
+cst_cart *cart_compile(const cst_cart *tree,const cst_features *ffunctions);
+
 CST_VAL_USER_TYPE_DCLS(cart,cst_cart)
 
 const cst_val *cart_interpret(cst_item *item, const cst_cart *tree);
@@ -52,6 +52,9 @@
 #include "cst_track.h"
 #include "cst_sigpr.h"
 #include "HShell.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define CLUNITS_DEBUG 0
 
@@ -80,22 +83,35 @@ static cst_vit_path *cl_path(cst_vit_path *p,
 static const cst_cart *clunit_get_tree(cst_clunit_db *cludb, const char *name);
 static void clunit_set_unit_name(cst_item *s,cst_clunit_db *clunit_db);
 
-typedef int (*cst_distfunc)(const cst_clunit_db *, int, int, const int *, int);
-static int optimal_couple_frame(cst_clunit_db *cludb, int u0, int u1,
-				cst_distfunc dfunc);
-static int optimal_couple(cst_clunit_db *cludb,
+static int optimal_couple_frame(cst_clunit_jc *jc, int u0, int u1);
+static int optimal_couple(cst_clunit_jc *jc,
 			  int u0, int u1,
-			  int *u0_move, int *u1_move,
-			  cst_distfunc dfunc);
-static int frame_distance(const cst_clunit_db *cludb,
-			  int a, int b,
-			  const int *join_weights,
-			  int order);
-static int frame_distanceb(const cst_clunit_db *cludb,
-			   int a, int b,
-			   const int *join_weights,
-			   int order);
+			  int *u0_move, int *u1_move);
+static void frame_join_costs(cst_clunit_jc *jc, int a, int b, int n,
+			     int *dist);
+static int frame_distance(const cst_clunit_jc *jc, int a, int b);
+static int frame_distanceb(const cst_clunit_jc *jc, int a, int b);
+
+/* Join costs for one utterance.  The same unit pairs turn up many  */
+/* times in the lattice so each is costed once and memoised in an   */
+/* open hash table.  Frame distances along an optimal coupling      */
+/* window are found together, with SSE2 when the weights fit 16 bits */
+
+typedef struct cst_clunit_join_struct {
+    int u0, u1;                /* the pair, u0 is -1 if the slot is unused */
+    int cost;
+    int u0_move, u1_move;
+} cst_clunit_join;
 
+struct cst_clunit_jc_struct {
+    cst_clunit_db *cludb;
+    int bytes;                 /* mcep held as bytes not shorts */
+    unsigned short *w16;       /* join_weights, NULL if any >= 65536 */
+    int *dist;                 /* frame costs along a window */
+    int dist_size;
+    cst_clunit_join *memo;
+    int memo_size, memo_used;
+};
 
 cst_utterance *clunits_synth(cst_utterance *utt)
 {
@@ -135,6 +151,7 @@ static cst_utterance *clunits_select(cst_utterance *utt)
     cst_relation *units,*segs;
     cst_item *s,*u;
     cst_clunit_db *clunit_db;
+    cst_clunit_jc *jc;
     int unit_entry;
 
     segs = utt_relation(utt,"Segment");
@@ -143,6 +160,8 @@ static cst_utterance *clunits_select(cst_utterance *utt)
     vd->big_is_good = FALSE;
     feat_set(vd->f,"clunit_db",feat_val(utt->features,"clunit_db"));
     clunit_db = val_clunit_db(feat_val(vd->f,"clunit_db"));
+    jc = new_clunit_jc(clunit_db);
+    feat_set(vd->f,"clunit_jc",userdata_val(jc));
     utt_set_feat(utt,"sts_list",sts_list_val(clunit_db->sts));
 
     for (s=relation_head(segs); s; s=item_next(s))
@@ -158,6 +177,7 @@ static cst_utterance *clunits_select(cst_utterance *utt)
     viterbi_copy_feature(vd, "unit_prev_move");
     viterbi_copy_feature(vd, "unit_this_move");
     delete_viterbi(vd);
+    delete_clunit_jc(jc);
 
     /* Construct unit stream with selected units */
     units = utt_relation_create(utt,"Unit");
@@ -267,21 +287,11 @@ static cst_vit_path *cl_path(cst_vit_path *p,
 {
     int cost;
     cst_vit_path *np;
-    cst_clunit_db *cludb;
-    cst_distfunc dfunc;
-    int u0,u1;
+    cst_clunit_jc *jc;
     int u0_move = -1, u1_move = -1;
 
     np = new_vit_path(vd);
-    cludb = val_clunit_db(feat_val(vd->f,"clunit_db"));
-    if ((cludb->mcep->sts == NULL
-	 && cludb->mcep->frames == NULL)
-	|| (cludb->mcep->sts
-	    && cludb->mcep->sts[0].frame == NULL))
-	dfunc = frame_distanceb;
-    else
-	dfunc = frame_distance;
-
+    jc = (cst_clunit_jc *)val_userdata(feat_val(vd->f,"clunit_jc"));
 
     np->cand = c;
     np->from = p;
@@ -290,20 +300,16 @@ static cst_vit_path *cl_path(cst_vit_path *p,
 	cost = 0;
     else
     {
-	u0 = p->cand->ival;
-	u1 = c->ival;
-	if (cludb->optimal_coupling == 1) {
+	cost = clunit_join_cost(jc, p->cand->ival, c->ival,
+				&u0_move, &u1_move);
+	if (jc->cludb->optimal_coupling == 1) {
 	    if (np->f == NULL)
 		np->f = new_features();
-	    cost = optimal_couple(cludb, u0, u1, &u0_move, &u1_move, dfunc);
 	    if (u0_move != -1)
 		    feat_set(np->f, "unit_prev_move", int_val(u0_move));
 	    if (u1_move != -1)
 		    feat_set(np->f, "unit_this_move", int_val(u1_move));
-	} else if (cludb->optimal_coupling == 2)
-	    cost = optimal_couple_frame(cludb, u0, u1, dfunc);
-	else
-	    cost = 0;
+	}
     }
 
     cost *= 5; /* magic number ("continuity weight") */
@@ -316,10 +322,105 @@ static cst_vit_path *cl_path(cst_vit_path *p,
     return np;
 }
 
-static int optimal_couple_frame(cst_clunit_db *cludb, int u0, int u1,
-				cst_distfunc dfunc)
+#define CLUNIT_JC_MEMO 1024    /* initial memo size, a power of 2 */
+
+cst_clunit_jc *new_clunit_jc(cst_clunit_db *cludb)
+{
+    cst_clunit_jc *jc;
+    int i;
+
+    jc = cst_alloc(cst_clunit_jc,1);
+    jc->cludb = cludb;
+    if ((cludb->mcep->sts == NULL
+	 && cludb->mcep->frames == NULL)
+	|| (cludb->mcep->sts
+	    && cludb->mcep->sts[0].frame == NULL))
+	jc->bytes = TRUE;
+    jc->w16 = cst_alloc(unsigned short,cludb->mcep->num_channels);
+    for (i=0; i < cludb->mcep->num_channels; i++)
+    {
+	if (cludb->join_weights[i] < 0 || cludb->join_weights[i] > 65535)
+	{
+	    cst_free(jc->w16);
+	    jc->w16 = NULL;
+	    break;
+	}
+	jc->w16[i] = (unsigned short)cludb->join_weights[i];
+    }
+    jc->memo_size = CLUNIT_JC_MEMO;
+    jc->memo = cst_alloc(cst_clunit_join,jc->memo_size);
+    for (i=0; i < jc->memo_size; i++)
+	jc->memo[i].u0 = -1;
+    return jc;
+}
+
+void delete_clunit_jc(cst_clunit_jc *jc)
+{
+    cst_free(jc->w16);
+    cst_free(jc->dist);
+    cst_free(jc->memo);
+    cst_free(jc);
+}
+
+static cst_clunit_join *clunit_memo_slot(cst_clunit_join *memo, int size,
+					 int u0, int u1)
+{
+    unsigned int h;
+
+    /* both indices go into the hash and the match, so databases */
+    /* of any size cost each pair of units once */
+    h = ((unsigned int)u0 * 2654435761U) ^ ((unsigned int)u1 * 2246822519U);
+    for (h = (h ^ (h >> 16)) & (size-1);
+	 memo[h].u0 != -1 && (memo[h].u0 != u0 || memo[h].u1 != u1);
+	 h = (h+1) & (size-1));
+    return &memo[h];
+}
+
+int clunit_join_cost(cst_clunit_jc *jc, int u0, int u1,
+			    int *u0_move, int *u1_move)
+{
+    cst_clunit_join *j, *old;
+    int i, old_size;
+
+    if (jc->cludb->optimal_coupling != 1 && jc->cludb->optimal_coupling != 2)
+	return 0;
+    if (jc->cludb->units[u1].prev == u0)
+	return 0; /* Consecutive units win */
+    j = clunit_memo_slot(jc->memo,jc->memo_size,u0,u1);
+    if (j->u0 == -1)
+    {
+	j->u0 = u0;
+	j->u1 = u1;
+	j->u0_move = j->u1_move = -1;
+	if (jc->cludb->optimal_coupling == 1)
+	    j->cost = optimal_couple(jc, u0, u1, &j->u0_move, &j->u1_move);
+	else
+	    j->cost = optimal_couple_frame(jc, u0, u1);
+	if (++jc->memo_used * 2 > jc->memo_size)
+	{   /* keep the table at most half full */
+	    old = jc->memo;
+	    old_size = jc->memo_size;
+	    jc->memo_size *= 2;
+	    jc->memo = cst_alloc(cst_clunit_join,jc->memo_size);
+	    for (i=0; i < jc->memo_size; i++)
+		jc->memo[i].u0 = -1;
+	    for (i=0; i < old_size; i++)
+		if (old[i].u0 != -1)
+		    *clunit_memo_slot(jc->memo,jc->memo_size,
+				      old[i].u0,old[i].u1) = old[i];
+	    cst_free(old);
+	    j = clunit_memo_slot(jc->memo,jc->memo_size,u0,u1);
+	}
+    }
+    *u0_move = j->u0_move;
+    *u1_move = j->u1_move;
+    return j->cost;
+}
+
+static int optimal_couple_frame(cst_clunit_jc *jc, int u0, int u1)
 {
-    int a,b;
+    cst_clunit_db *cludb = jc->cludb;
+    int a,b,dist;
 
     if (cludb->units[u1].prev == u0)
 	return 0; /* Consecutive units win */
@@ -330,31 +431,27 @@ static int optimal_couple_frame(cst_clunit_db *cludb, int u0, int u1,
 	a = cludb->units[u0].end-1;  /* if num frames < 1 this is bad */
     b = cludb->units[u1].start;
 
-    return (*dfunc)(cludb, a, b,
-		    cludb->join_weights,
-		    cludb->mcep->num_channels)
-	    + abs(get_frame_size(cludb->sts, a)
-		  - get_frame_size(cludb->sts,b)) * cludb->f0_weight;
+    frame_join_costs(jc, a, b, 1, &dist);
+    return dist;
 }
 
-static int optimal_couple(cst_clunit_db *cludb,
+static int optimal_couple(cst_clunit_jc *jc,
 			  int u0, int u1,
-			  int *u0_move, int *u1_move,
-			  cst_distfunc dfunc)
+			  int *u0_move, int *u1_move)
 {
-    int a,b;
+    cst_clunit_db *cludb = jc->cludb;
     int u1_p;
     int i, fcount;
     int u0_st, u1_p_st, u0_end, u1_p_end;
     int best_u0, best_u1_p;
-    int dist, best_val;
+    int best_val;
 
     u1_p = cludb->units[u1].prev;
 
     if (u1_p == u0)
 	return 0;
     if (u1_p == CLUNIT_NONE || cludb->units[u0].phone != cludb->units[u1_p].phone)
-	return 10 * optimal_couple_frame(cludb, u0, u1, dfunc); /* laziness */
+	return 10 * optimal_couple_frame(jc, u0, u1); /* laziness */
 
     DPRINTF(1,("optimal_coupling %s_%d (%d,%d) %s_%d (%d,%d)\n",
 	       UNIT_TYPE(cludb,u0),
@@ -390,19 +487,21 @@ static int optimal_couple(cst_clunit_db *cludb,
     best_u1_p = u1_p_end;
     best_val = INT_MAX;
 
+    if (fcount > jc->dist_size)
+    {
+	cst_free(jc->dist);
+	jc->dist_size = fcount;
+	jc->dist = cst_alloc(int,jc->dist_size);
+    }
+    if (fcount > 0)
+	frame_join_costs(jc,
+			 cludb->units[u0].start + u0_st,
+			 cludb->units[u1_p].start + u1_p_st,
+			 fcount, jc->dist);
+
     for (i = 0; i < fcount; ++i) {
-	a = cludb->units[u0].start + u0_st + i;
-	b = cludb->units[u1_p].start + u1_p_st + i;
-
-	dist =
-	    (*dfunc)(cludb, a, b,
-		     cludb->join_weights,
-		     cludb->mcep->num_channels)
-	    + abs(get_frame_size(cludb->sts, a)
-		  - get_frame_size(cludb->sts,b)) * cludb->f0_weight;
-
-	if (dist < best_val) {
-	    best_val = dist;
+	if (jc->dist[i] < best_val) {
+	    best_val = jc->dist[i];
 	    best_u0 = u0_st + i;
 	    best_u1_p = u1_p_st + i;
 	}
@@ -426,11 +525,83 @@ static int optimal_couple(cst_clunit_db *cludb,
     return 30000 + best_val;
 }
 
-static int frame_distance(const cst_clunit_db *cludb,
-			  int a, int b,
-			  const int *join_weights,
-			  int order)
+/* Costs of joining frames a+i to b+i for i = 0..n-1 */
+static void frame_join_costs(cst_clunit_jc *jc, int a, int b, int n,
+			     int *dist)
+{
+    const cst_clunit_db *cludb = jc->cludb;
+    int i;
+
+    for (i = 0; i < n; i++)
+	dist[i] = (jc->bytes ? frame_distanceb(jc, a+i, b+i)
+		   : frame_distance(jc, a+i, b+i))
+	    + abs(get_frame_size(cludb->sts, a+i)
+		  - get_frame_size(cludb->sts, b+i)) * cludb->f0_weight;
+}
+
+/* Weighted Manhattan distance with weights below 65536, each term */
+/* |a-b|*w/65536 is the high half of a 16x16 bit product           */
+static int mcep_distance(const unsigned short *av, const unsigned short *bv,
+			 const unsigned short *w, int order)
+{
+    int r = 0, i = 0;
+#ifdef __SSE2__
+    __m128i a, b, d, z, sum;
+
+    z = _mm_setzero_si128();
+    sum = z;
+    for (; i+8 <= order; i += 8)
+    {
+	a = _mm_loadu_si128((const __m128i *)(av+i));
+	b = _mm_loadu_si128((const __m128i *)(bv+i));
+	d = _mm_or_si128(_mm_subs_epu16(a,b),_mm_subs_epu16(b,a));
+	d = _mm_mulhi_epu16(d,_mm_loadu_si128((const __m128i *)(w+i)));
+	sum = _mm_add_epi32(sum,_mm_unpacklo_epi16(d,z));
+	sum = _mm_add_epi32(sum,_mm_unpackhi_epi16(d,z));
+    }
+    sum = _mm_add_epi32(sum,_mm_shuffle_epi32(sum,0x4e));
+    sum = _mm_add_epi32(sum,_mm_shuffle_epi32(sum,0xb1));
+    r = _mm_cvtsi128_si32(sum);
+#endif
+    for (; i < order; i++)
+	r += ((unsigned int)abs(av[i]-bv[i]) * w[i]) >> 16;
+    return r;
+}
+
+/* As mcep_distance for byte coefficients, scaled by 256 */
+static int mcep_distanceb(const unsigned char *av, const unsigned char *bv,
+			  const unsigned short *w, int order)
+{
+    int r = 0, i = 0;
+#ifdef __SSE2__
+    __m128i a, b, d, z, sum;
+
+    z = _mm_setzero_si128();
+    sum = z;
+    for (; i+8 <= order; i += 8)
+    {
+	a = _mm_loadl_epi64((const __m128i *)(av+i));
+	b = _mm_loadl_epi64((const __m128i *)(bv+i));
+	d = _mm_or_si128(_mm_subs_epu8(a,b),_mm_subs_epu8(b,a));
+	d = _mm_unpacklo_epi8(z,d);   /* |a-b|*256 */
+	d = _mm_mulhi_epu16(d,_mm_loadu_si128((const __m128i *)(w+i)));
+	sum = _mm_add_epi32(sum,_mm_unpacklo_epi16(d,z));
+	sum = _mm_add_epi32(sum,_mm_unpackhi_epi16(d,z));
+    }
+    sum = _mm_add_epi32(sum,_mm_shuffle_epi32(sum,0x4e));
+    sum = _mm_add_epi32(sum,_mm_shuffle_epi32(sum,0xb1));
+    r = _mm_cvtsi128_si32(sum);
+#endif
+    for (; i < order; i++)
+	r += ((unsigned int)abs(av[i]-bv[i]) * 256 * w[i]) >> 16;
+    return r;
+}
+
+static int frame_distance(const cst_clunit_jc *jc, int a, int b)
 {
+    const cst_clunit_db *cludb = jc->cludb;
+    const int *join_weights = cludb->join_weights;
+    int order = cludb->mcep->num_channels;
     int r,diff;
     int i;
     const unsigned short *av, *bv;
@@ -454,11 +625,14 @@ static int frame_distance(const cst_clunit_db *cludb,
 #endif
 
     /* Weighted Manhattan distance */
-    for (r = 0, i = 0; i < order; i++)
-    {
-	diff = av[i]-bv[i];
-	r += abs(diff) * join_weights[i] / 65536;
-    }
+    if (jc->w16)
+	r = mcep_distance(av, bv, jc->w16, order);
+    else
+	for (r = 0, i = 0; i < order; i++)
+	{
+	    diff = av[i]-bv[i];
+	    r += abs(diff) * join_weights[i] / 65536;
+	}
 
     release_sts_frame(cludb->mcep, a, av);
     release_sts_frame(cludb->mcep, b, bv);
@@ -466,11 +640,11 @@ static int frame_distance(const cst_clunit_db *cludb,
     return r;
 }
 
-static int frame_distanceb(const cst_clunit_db *cludb,
-			   int a, int b,
-			   const int *join_weights,
-			   int order)
+static int frame_distanceb(const cst_clunit_jc *jc, int a, int b)
 {
+    const cst_clunit_db *cludb = jc->cludb;
+    const int *join_weights = cludb->join_weights;
+    int order = cludb->mcep->num_channels;
     int r,diff;
     int i;
     const unsigned char *av, *bv;
@@ -494,11 +668,14 @@ static int frame_distanceb(const cst_clunit_db *cludb,
 #endif
 
     /* Weighted Manhattan distance */
-    for (r = 0, i = 0; i < order; i++)
-    {
-	diff = (av[i]-bv[i]) * 256;
-	r += abs(diff) * join_weights[i] / 65536;
-    }
+    if (jc->w16)
+	r = mcep_distanceb(av, bv, jc->w16, order);
+    else
+	for (r = 0, i = 0; i < order; i++)
+	{
+	    diff = (av[i]-bv[i]) * 256;
+	    r += abs(diff) * join_weights[i] / 65536;
+	}
 
     release_sts_residual(cludb->mcep, a, av);
     release_sts_residual(cludb->mcep, b, bv);
@@ -92,6 +92,13 @@ int clunit_get_unit_index(cst_clunit_db *cludb,
 int clunit_get_unit_index_name(cst_clunit_db *cludb,
 			       const char *name);
 
+/* Join costs for unit selection, memoised per pair of unit indices */
+typedef struct cst_clunit_jc_struct cst_clunit_jc;
+cst_clunit_jc *new_clunit_jc(cst_clunit_db *cludb);
+void delete_clunit_jc(cst_clunit_jc *jc);
+int clunit_join_cost(cst_clunit_jc *jc, int u0, int u1,
+		     int *u0_move, int *u1_move);
+
 #define UNIT_TYPE(db,u) ((db)->types[(db)->units[(u)].type].name)
 #define UNIT_INDEX(db,u) ((u) - (db)->types[(db)->units[(u)].type].start)
 
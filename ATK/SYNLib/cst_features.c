@@ -210,22 +210,38 @@ const cst_val *get_param_val(const cst_features *f, const char *name, cst_val *d
 	return def;
 }
 
+static void feat_set_local(cst_features *f, const char* name,
+			   const cst_val *val);
+
+/* Atoms set here come from f's context, an utterance's arena */
 void feat_set_int(cst_features *f, const char *name, int v)
 {
-    feat_set(f,name,int_val(v));
+    feat_set_local(f,name,int_val_local(f->ctx,v));
 }
 
 void feat_set_float(cst_features *f, const char *name, float v)
 {
-    feat_set(f,name,float_val(v));
+    feat_set_local(f,name,float_val_local(f->ctx,v));
 }
 
 void feat_set_string(cst_features *f, const char *name, const char *v)
 {
-    feat_set(f,name,string_val(v));
+    feat_set_local(f,name,string_val_local(f->ctx,v));
 }
 
 void feat_set(cst_features *f, const char* name, const cst_val *val)
+{
+    /* An atom in an arena other than f's, eg an utterance's val set */
+    /* in a voice's or caller's features, is copied so it can outlive */
+    /* its utterance */
+    if (val && CST_VAL_IN_ARENA(val) && !cst_arena_owns(f->ctx,val))
+	val = val_copy_atom_local(f->ctx,val);
+    feat_set_local(f,name,val);
+}
+
+/* Set val which is already in f's context (or not in any arena) */
+static void feat_set_local(cst_features *f, const char* name,
+			   const cst_val *val)
 {
     cst_featvalpair *n;
     n = feat_find_featpair(f,name);
@@ -44,12 +44,22 @@
 #include "cst_item.h"
 #include "cst_relation.h"
 #include "cst_utterance.h"
-#include "cst_tokenstream.h"
 
 CST_VAL_REGISTER_FUNCPTR(ffunc,cst_ffunction)
 
 DEF_STATIC_CONST_VAL_STRING(ffeature_default_val,"0");
 
+/* Moves along a feature path */
+#define FP_NEXT      1
+#define FP_PREV      2
+#define FP_PREVPREV  3
+#define FP_NEXTNEXT  4
+#define FP_PARENT    5
+#define FP_DAUGHTER  6
+#define FP_DAUGHTERN 7
+#define FP_RELATION  8
+#define FP_UNKNOWN   9
+
 static const void *internal_ff(const cst_item *item,
 			       const char *featpath,int type);
 
@@ -76,89 +86,217 @@ const cst_val *ffeature(const cst_item *item,const char *featpath)
     return (cst_val *)internal_ff(item,featpath,0);
 }
 
-static const void *internal_ff(const cst_item *item,
-			       const char *featpath,int type)
+static char *fp_token(char **p)
 {
-    const char *tk, *relation;
-    cst_tokenstream *ts;
-    cst_utterance *utt;
-    const cst_item *pitem;
-    void *void_v;
-    const cst_val *ff;
-    cst_ffunction ffunc;
-
-    ts = ts_open_string(featpath);
-    ts->whitespacesymbols = ":.";
-    ts->singlecharsymbols = "";
-    ts->prepunctuationsymbols = "";
-    ts->postpunctuationsymbols = "";
-
-    for (tk = ts_get(ts), pitem=item;
-	 pitem &&
-	     (((type == 0) && !ts_eof(ts)) ||
-	      ((type == 1) && !cst_streq(tk,"")));
-	 tk = ts_get(ts))
+    /* Return next token in *p, splitting it in place */
+    char *s, *tk;
+
+    for (s = *p; (*s == ':') || (*s == '.'); s++);
+    for (tk = s; *s && (*s != ':') && (*s != '.'); s++);
+    if (*s)
+	*s++ = '\0';
+    *p = s;
+
+    return tk;
+}
+
+static int fp_more(const char *p)
+{
+    for (; (*p == ':') || (*p == '.'); p++);
+    return (*p != '\0');
+}
+
+static void featpath_parse(cst_featpath *fp, char *p, int type)
+{
+    /* Split the path in p into moves, for type 0 the last token is */
+    /* the feature name, for type 1 (an item path) all are moves    */
+    char *tk;
+    int m;
+
+    fp->nmoves = 0;
+    for (tk = fp_token(&p);
+	 ((type == 0) && fp_more(p)) ||
+	     ((type == 1) && !cst_streq(tk,""));
+	 tk = fp_token(&p))
     {
+	if (fp->nmoves == CST_FP_MAXMOVES)
+	{
+	    cst_errmsg("ffeature: path has more than %d moves\n",
+		       CST_FP_MAXMOVES);
+	    cst_error();
+	}
+	m = fp->nmoves++;
+	fp->arg[m] = NULL;
 	if (cst_streq(tk,"n"))
-	    pitem = item_next(pitem);
+	    fp->move[m] = FP_NEXT;
 	else if (cst_streq(tk,"p"))
-	    pitem = item_prev(pitem);
+	    fp->move[m] = FP_PREV;
 	else if (cst_streq(tk,"pp"))
-	{
-	    if (item_prev(pitem))
-		pitem = item_prev(item_prev(pitem));
-	    else
-		pitem = NULL;
-	}
+	    fp->move[m] = FP_PREVPREV;
 	else if (cst_streq(tk,"nn"))
-	{
-	    if (item_next(pitem))
-		pitem = item_next(item_next(pitem));
-	    else
-		pitem = NULL;
-	}
+	    fp->move[m] = FP_NEXTNEXT;
 	else if (cst_streq(tk,"parent"))
-	    pitem = item_parent(pitem);
+	    fp->move[m] = FP_PARENT;
 	else if ((cst_streq(tk,"daughter")) ||
 		 (cst_streq(tk,"daughter1")))
-	    pitem = item_daughter(pitem);
+	    fp->move[m] = FP_DAUGHTER;
 	else if (cst_streq(tk,"daughtern"))
-	    pitem = item_last_daughter(pitem);
+	    fp->move[m] = FP_DAUGHTERN;
 	else if (cst_streq(tk,"R"))
 	{
 	    /* A relation move */
-	    relation = ts_get(ts);
-	    pitem = item_as(pitem,relation);
+	    fp->move[m] = FP_RELATION;
+	    fp->arg[m] = fp_token(&p);
 	}
 	else
-	    cst_errmsg("ffeature: unknown directive \"%s\" ignored\n",tk);
+	{
+	    fp->move[m] = FP_UNKNOWN;
+	    fp->arg[m] = tk;
+	}
     }
+    fp->name = tk;
+}
 
-    if (type == 0)
+static const cst_item *featpath_walk(const cst_item *item,
+				     const cst_featpath *fp)
+{
+    const cst_item *pitem;
+    int m;
+
+    for (m=0, pitem=item; pitem && (m < fp->nmoves); m++)
     {
-	if (pitem && (utt = item_utt(pitem)))
-	    ff = feat_val(utt->ffunctions,tk);
-	else
-	    ff = NULL;
-	void_v = NULL;
-	if (!ff)
-	    void_v = (void *)item_feat(pitem,tk);
-	else if (pitem)
+	switch (fp->move[m])
 	{
-	    ffunc = val_ffunc(ff);
-	    void_v = (void *)(*ffunc)(pitem);
+	case FP_NEXT:
+	    pitem = item_next(pitem); break;
+	case FP_PREV:
+	    pitem = item_prev(pitem); break;
+	case FP_PREVPREV:
+	    if (item_prev(pitem))
+		pitem = item_prev(item_prev(pitem));
+	    else
+		pitem = NULL;
+	    break;
+	case FP_NEXTNEXT:
+	    if (item_next(pitem))
+		pitem = item_next(item_next(pitem));
+	    else
+		pitem = NULL;
+	    break;
+	case FP_PARENT:
+	    pitem = item_parent(pitem); break;
+	case FP_DAUGHTER:
+	    pitem = item_daughter(pitem); break;
+	case FP_DAUGHTERN:
+	    pitem = item_last_daughter(pitem); break;
+	case FP_RELATION:
+	    pitem = item_as(pitem,fp->arg[m]); break;
+	default:
+	    cst_errmsg("ffeature: unknown directive \"%s\" ignored\n",
+		       fp->arg[m]);
 	}
-	if (void_v == NULL)
-	    void_v = (void *)&ffeature_default_val;
     }
+
+    return pitem;
+}
+
+static const cst_val *featpath_val(const cst_item *pitem,
+				   const cst_featpath *fp)
+{
+    cst_utterance *utt;
+    const cst_val *ff, *v;
+    cst_ffunction ffunc = NULL;
+
+    if (pitem == NULL)
+	return (const cst_val *)&ffeature_default_val;
+    if (fp->resolved)
+    {
+	if (fp->ffunc && item_utt(pitem))
+	    ffunc = fp->ffunc;
+    }
+    else if ((utt = item_utt(pitem)) &&
+	     (ff = feat_val(utt->ffunctions,fp->name)))
+	ffunc = val_ffunc(ff);
+
+    if (ffunc)
+	v = (*ffunc)(pitem);
+    else
+	v = item_feat(pitem,fp->name);
+    if (v == NULL)
+	v = (const cst_val *)&ffeature_default_val;
+
+    return v;
+}
+
+static const void *internal_ff(const cst_item *item,
+			       const char *featpath,int type)
+{
+    /* Paths given as strings are parsed on the stack, use */
+    /* new_featpath() for paths which are used repeatedly  */
+    cst_featpath fp;
+    char sbuf[256], *buf;
+    const cst_item *pitem;
+    const void *void_v;
+    size_t len;
+
+    len = strlen(featpath);
+    if (len < sizeof(sbuf))
+	buf = (char *)memcpy(sbuf,featpath,len+1);
+    else
+	buf = cst_strdup(featpath);
+    featpath_parse(&fp,buf,type);
+    fp.resolved = FALSE;
+    fp.ffunc = NULL;
+
+    pitem = featpath_walk(item,&fp);
+    if (type == 0)
+	void_v = (const void *)featpath_val(pitem,&fp);
     else
-	void_v = (void *)pitem;
+	void_v = (const void *)pitem;
 
-    ts_close(ts);
+    if (buf != sbuf)
+	cst_free(buf);
 
     return void_v;
 }
 
+cst_featpath *new_featpath(const char *featpath,
+			   const cst_features *ffunctions)
+{
+    cst_featpath *fp = cst_alloc(cst_featpath,1);
+    const cst_val *ff;
+
+    fp->buf = cst_strdup(featpath);
+    featpath_parse(fp,fp->buf,0);
+    if (ffunctions)
+    {
+	fp->resolved = TRUE;
+	ff = feat_val(ffunctions,fp->name);
+	fp->ffunc = (ff ? val_ffunc(ff) : NULL);
+    }
+    else
+    {
+	fp->resolved = FALSE;
+	fp->ffunc = NULL;
+    }
+
+    return fp;
+}
+
+void delete_featpath(cst_featpath *fp)
+{
+    if (fp)
+    {
+	cst_free(fp->buf);
+	cst_free(fp);
+    }
+}
+
+const cst_val *ffeature_fp(const cst_item *item,const cst_featpath *fp)
+{
+    return featpath_val(featpath_walk(item,fp),fp);
+}
+
 void ff_register(cst_features *ffunctions, const char *name, cst_ffunction f)
 {
     /* Register features functions */
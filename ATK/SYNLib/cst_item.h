@@ -128,6 +128,26 @@ void ff_register(cst_features *ffeatures, const char *name,
 			   cst_ffunction f);
 void ff_unregister(cst_features *ffeatures, const char *name);
 
+/* Feature paths compiled once into a sequence of item moves, the */
+/* final feature's ffunction is resolved at compile time when the */
+/* ffunctions are given, otherwise it is looked up in the item's  */
+/* utterance as ffeature() does                                   */
+#define CST_FP_MAXMOVES 32
+typedef struct cst_featpath_struct {
+    int nmoves;
+    unsigned char move[CST_FP_MAXMOVES];
+    const char *arg[CST_FP_MAXMOVES];  /* relation name for R moves */
+    const char *name;                  /* feature or ffunction name */
+    int resolved;                      /* ffunc looked up at compile time */
+    cst_ffunction ffunc;               /* ffunction or NULL if item feature */
+    char *buf;                         /* holds the path tokens */
+} cst_featpath;
+
+cst_featpath *new_featpath(const char *featpath,
+			   const cst_features *ffunctions);
+void delete_featpath(cst_featpath *fp);
+const cst_val *ffeature_fp(const cst_item *item,const cst_featpath *fp);
+
 /* Generalized item hook function, like cst_uttfunc. */
 typedef cst_val *(*cst_itemfunc)(cst_item *i);
 CST_VAL_USER_FUNCPTR_DCLS(itemfunc,cst_itemfunc)
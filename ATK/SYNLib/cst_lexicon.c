@@ -42,6 +42,8 @@
 #include <string.h>
 #include "cst_features.h"
 #include "cst_lexicon.h"
+#include "HShell.h"
+#include "HThreads.h"
 
 CST_VAL_REGISTER_TYPE_NODEL(lexicon,cst_lexicon)
 
@@ -53,7 +55,51 @@ static int lex_match_entry(const char *a, const char *b);
 static int lex_lookup_bsearch(const lexicon_entry *entries,
 			      int start, int end,
 			      const char *word);
+static int lex_bsearch_word(const lexicon_entry *entries,
+			    int start, int end,
+			    const char *word);
 static int find_full_match(const lexicon_entry *entries, int i,const char *word);
+static int lex_find_entry(const cst_lexicon *l, const char *wp);
+static int lex_find_addenda(const cst_lexicon *l, const char *wp);
+static void lex_index_entries(cst_lexicon *l);
+static void delete_lex_index(cst_lexicon *l);
+static cst_val *lts_cache_lookup(const cst_lexicon *l, const char *word,
+				 int *found);
+static void lts_cache_add(const cst_lexicon *l, const char *word,
+			  const cst_val *phones);
+static void delete_lts_cache(cst_lexicon *l);
+
+/* The index is an open hash table on the word (without its pos) */
+/* giving the entry the binary search would have reached, so     */
+/* find_full_match resolves the pos exactly as before, and a      */
+/* second one giving the first addenda entry for the word         */
+typedef struct cst_lex_slot_struct {
+    unsigned int hash;
+    int entry;             /* -1 if empty */
+} cst_lex_slot;
+
+typedef struct cst_lex_index_struct {
+    int size;              /* a power of 2, at least twice num_entries */
+    cst_lex_slot *slots;
+    int addenda_size;      /* likewise for the addenda */
+    cst_lex_slot *addenda_slots;
+} cst_lex_index;
+
+/* The LTS cache is 2-way set associative, a miss replaces the less */
+/* recently used way.  It is shared by all users of the lexicon so  */
+/* it is accessed under the global lock.                            */
+typedef struct cst_lts_cache_entry_struct {
+    unsigned int hash;
+    unsigned int used;     /* cache clock at last use */
+    char *word;            /* NULL if empty */
+    cst_val *phones;
+} cst_lts_cache_entry;
+
+typedef struct cst_lts_cache_struct {
+    int num_sets;          /* a power of 2 */
+    unsigned int clock;
+    cst_lts_cache_entry *entries;  /* num_sets*2 */
+} cst_lts_cache;
 
 cst_lexicon *new_lexicon()
 {
@@ -66,6 +112,8 @@ void delete_lexicon(cst_lexicon *lex)
 {
 	if (lex)
 	{
+		delete_lex_index(lex);
+		delete_lts_cache(lex);
 		cst_free(lex->entry_index);
 		cst_free(lex->phones);
 		cst_free(lex);
@@ -125,6 +173,8 @@ lexicon_entry * lex_add_entry(cst_lexicon *l,
     l->entry_index[i].phone_index = nextphone - l->phones;
 
     ++l->num_entries;
+    if (l->index)
+	lex_index_entries(l);
     return l->entry_index + i;
 }
 
@@ -142,7 +192,7 @@ lex_delete_entry(cst_lexicon *l, const char *word, const char *pos)
     sprintf(wp,"%c%s",(pos ? pos[0] : '0'),word);
 
     /* Find the entry */
-    if ((i = lex_lookup_bsearch(l->entry_index,0,l->num_entries,wp)) < 0) {
+    if ((i = lex_find_entry(l,wp)) < 0) {
 	cst_free(wp);
 	return -1;
     }
@@ -169,6 +219,8 @@ lex_delete_entry(cst_lexicon *l, const char *word, const char *pos)
     l->entry_index = cst_realloc(l->entry_index, lexicon_entry,
 				 l->num_entries - 1);
     --l->num_entries;
+    if (l->index)
+	lex_index_entries(l);
 
     cst_free(wp);
     return 0;
@@ -213,23 +265,16 @@ static int no_syl_boundaries(const cst_item *i, const cst_val *p)
 int in_lex(const cst_lexicon *l, const char *word, const char *pos)
 {
     /* return TRUE is its in the lexicon */
-    int r = FALSE, i;
+    int r = FALSE;
     char *wp;
 
     wp = cst_alloc(char,strlen(word)+2);
     sprintf(wp,"%c%s",(pos ? pos[0] : '0'),word);
 
-    for (i=0; l->addenda[i]; i++)
-    {
-	if (((wp[0] == '0') || (wp[0] == l->addenda[i][0][0])) &&
-	    (cst_streq(wp+1,l->addenda[i][0]+1)))
-	{
-	    r = TRUE;
-	    break;
-	}
-    }
+    if (lex_find_addenda(l,wp) >= 0)
+	r = TRUE;
 
-    if (!r && (lex_lookup_bsearch(l->entry_index,0,l->num_entries,wp) >= 0))
+    if (!r && (lex_find_entry(l,wp) >= 0))
 	r = TRUE;
 
     cst_free(wp);
@@ -239,11 +284,14 @@ int in_lex(const cst_lexicon *l, const char *word, const char *pos)
 cst_val *lex_lookup(const cst_lexicon *l, const char *word, const char *pos)
 {
     int index,p;
-    char *wp;
+    char *wp, wpbuf[64];
     cst_val *phones = 0;
     int found = FALSE;
 
-    wp = cst_alloc(char,strlen(word)+2);
+    if (strlen(word)+2 <= sizeof(wpbuf))
+	wp = wpbuf;  /* most words, saves an alloc */
+    else
+	wp = cst_alloc(char,strlen(word)+2);
     sprintf(wp,"%c%s",(pos ? pos[0] : '0'),word);
 
     if (l->addenda)
@@ -251,7 +299,7 @@ cst_val *lex_lookup(const cst_lexicon *l, const char *word, const char *pos)
 
     if (!found)
     {
-	index = lex_lookup_bsearch(l->entry_index,0,l->num_entries,wp);
+	index = lex_find_entry(l,wp);
 
 	if (index >= 0)
 	{
@@ -260,15 +308,26 @@ cst_val *lex_lookup(const cst_lexicon *l, const char *word, const char *pos)
 				  phones);
 	    phones = val_reverse(phones);
 	}
-	else if (l->lts_rule_set)
-	    phones = lts_apply(word,
-			       "",  /* more features if we had them */
-			       l->lts_rule_set);
-	else if (l->lts_function)
-	    phones = (l->lts_function)(l,word,"");
+	else
+	{
+	    if (l->lts_cache)
+		phones = lts_cache_lookup(l,word,&found);
+	    if (!found)
+	    {
+		if (l->lts_rule_set)
+		    phones = lts_apply(word,
+				       "",  /* more features if we had them */
+				       l->lts_rule_set);
+		else if (l->lts_function)
+		    phones = (l->lts_function)(l,word,"");
+		if (l->lts_cache)
+		    lts_cache_add(l,word,phones);
+	    }
+	}
     }
 
-    cst_free(wp);
+    if (wp != wpbuf)
+	cst_free(wp);
     return phones;
 }
 
@@ -281,16 +340,12 @@ static cst_val *lex_lookup_addenda(const char *wp,const cst_lexicon *l,
 
     phones = NULL;
 
-    for (i=0; l->addenda[i]; i++)
+    if ((i = lex_find_addenda(l,wp)) >= 0)
     {
-	if (((wp[0] == '0') || (wp[0] == l->addenda[i][0][0])) &&
-	    (cst_streq(wp+1,l->addenda[i][0]+1)))
-	{
-	    for (j=1; l->addenda[i][j]; j++)
-		phones = cons_val(string_val(l->addenda[i][j]),phones);
-	    *found = TRUE;
-	    return val_reverse(phones);
-	}
+	for (j=1; l->addenda[i][j]; j++)
+	    phones = cons_val(string_val(l->addenda[i][j]),phones);
+	*found = TRUE;
+	return val_reverse(phones);
     }
 
     return NULL;
@@ -300,6 +355,18 @@ static int lex_lookup_bsearch(const lexicon_entry *entries,
 			      int start, int end,
 			      const char *word)
 {
+    int mid;
+
+    if ((mid = lex_bsearch_word(entries,start,end,word)) < 0)
+	return -1;
+    return find_full_match(entries,mid,word);
+}
+
+static int lex_bsearch_word(const lexicon_entry *entries,
+			    int start, int end,
+			    const char *word)
+{
+    /* first entry found for word, ignoring pos */
     int mid,c;
 
     while (start < end) {
@@ -307,7 +374,7 @@ static int lex_lookup_bsearch(const lexicon_entry *entries,
 	    c = lex_match_entry(entries[mid].word_pos,word);
 
 	    if (c == 0)
-		    return find_full_match(entries,mid,word);
+		    return mid;
 	    else if (c > 0)
 		    end = mid;
 	    else
@@ -355,3 +422,225 @@ static int lex_match_entry(const char *a, const char *b)
 }
 
 
+
+static unsigned int lex_hash(const char *s)
+{
+    /* FNV-1a */
+    unsigned int h = 2166136261U;
+
+    for ( ; *s; s++)
+	h = (h ^ (unsigned char)*s) * 16777619U;
+    return h;
+}
+
+static int lex_find_entry(const cst_lexicon *l, const char *wp)
+{
+    const cst_lex_index *x = l->index;
+    unsigned int h;
+    int i, e;
+
+    if (x == NULL)
+	return lex_lookup_bsearch(l->entry_index,0,l->num_entries,wp);
+
+    h = lex_hash(wp+1);
+    for (i = h & (x->size-1); (e = x->slots[i].entry) >= 0;
+	 i = (i+1) & (x->size-1))
+	if (x->slots[i].hash == h
+	    && lex_match_entry(l->entry_index[e].word_pos,wp) == 0)
+	    return find_full_match(l->entry_index,e,wp);
+    return -1;
+}
+
+static int lex_find_addenda(const cst_lexicon *l, const char *wp)
+{
+    /* first addenda entry for word and pos, or -1 */
+    const cst_lex_index *x = l->index;
+    unsigned int h;
+    int i = 0, a;
+
+    if (l->addenda == NULL)
+	return -1;
+    if (x)
+    {   /* skip to the first entry for the word */
+	h = lex_hash(wp+1);
+	for (i = h & (x->addenda_size-1);
+	     (a = x->addenda_slots[i].entry) >= 0;
+	     i = (i+1) & (x->addenda_size-1))
+	    if (x->addenda_slots[i].hash == h
+		&& cst_streq(wp+1,l->addenda[a][0]+1))
+		break;
+	if ((i = a) < 0)
+	    return -1;
+    }
+
+    for ( ; l->addenda[i]; i++)
+    {
+	if (((wp[0] == '0') || (wp[0] == l->addenda[i][0][0])) &&
+	    (cst_streq(wp+1,l->addenda[i][0]+1)))
+	    return i;
+    }
+    return -1;
+}
+
+static void lex_index_entries(cst_lexicon *l)
+{
+    cst_lex_index *x;
+    const char *w;
+    unsigned int h;
+    int i, j, e, n;
+
+    delete_lex_index(l);
+    x = cst_alloc(cst_lex_index,1);
+    for (x->size = 16; x->size < 2*l->num_entries; x->size *= 2);
+    x->slots = cst_alloc(cst_lex_slot,x->size);
+    for (i=0; i < x->size; i++)
+	x->slots[i].entry = -1;
+
+    for (i=0; i < l->num_entries; i++)
+    {
+	w = l->entry_index[i].word_pos;
+	if (i > 0 && lex_match_entry(l->entry_index[i-1].word_pos,w) == 0)
+	    continue;  /* pos variants of the same word are adjacent */
+	e = lex_bsearch_word(l->entry_index,0,l->num_entries,w);
+	h = lex_hash(w+1);
+	for (j = h & (x->size-1); x->slots[j].entry >= 0;
+	     j = (j+1) & (x->size-1));
+	x->slots[j].hash = h;
+	x->slots[j].entry = e;
+    }
+
+    for (n=0; l->addenda && l->addenda[n]; n++);
+    for (x->addenda_size = 16; x->addenda_size < 2*n; x->addenda_size *= 2);
+    x->addenda_slots = cst_alloc(cst_lex_slot,x->addenda_size);
+    for (i=0; i < x->addenda_size; i++)
+	x->addenda_slots[i].entry = -1;
+    for (i=0; i < n; i++)
+    {
+	w = l->addenda[i][0];
+	h = lex_hash(w+1);
+	for (j = h & (x->addenda_size-1); (e = x->addenda_slots[j].entry) >= 0;
+	     j = (j+1) & (x->addenda_size-1))
+	    if (x->addenda_slots[j].hash == h && cst_streq(w+1,l->addenda[e][0]+1))
+		break;
+	if (e < 0)
+	{   /* only the first entry for each word */
+	    x->addenda_slots[j].hash = h;
+	    x->addenda_slots[j].entry = i;
+	}
+    }
+    l->index = x;
+}
+
+static void delete_lex_index(cst_lexicon *l)
+{
+    if (l->index)
+    {
+	cst_free(l->index->slots);
+	cst_free(l->index->addenda_slots);
+	cst_free(l->index);
+	l->index = NULL;
+    }
+}
+
+void lex_build_index(cst_lexicon *l, int lts_cache_size)
+{
+    cst_lts_cache *c;
+    int i;
+
+    HGlobalLock();
+    if (l->index == NULL)
+	lex_index_entries(l);
+    if (l->lts_cache == NULL && lts_cache_size > 0)
+    {
+	c = cst_alloc(cst_lts_cache,1);
+	for (c->num_sets = 1; c->num_sets*2 < lts_cache_size; c->num_sets *= 2);
+	c->entries = cst_alloc(cst_lts_cache_entry,c->num_sets*2);
+	for (i=0; i < c->num_sets*2; i++)
+	    c->entries[i].word = NULL;
+	l->lts_cache = c;
+    }
+    HGlobalUnlock();
+}
+
+static void delete_lts_cache(cst_lexicon *l)
+{
+    cst_lts_cache *c = l->lts_cache;
+    int i;
+
+    if (c)
+    {
+	for (i=0; i < c->num_sets*2; i++)
+	    if (c->entries[i].word)
+	    {
+		cst_free(c->entries[i].word);
+		delete_val(c->entries[i].phones);
+	    }
+	cst_free(c->entries);
+	cst_free(c);
+	l->lts_cache = NULL;
+    }
+}
+
+static cst_val *copy_phones(const cst_val *phones)
+{
+    cst_val *r = NULL;
+    const cst_val *v;
+
+    for (v=phones; v; v=val_cdr(v))
+	r = cons_val(string_val(val_string(val_car(v))),r);
+    return val_reverse(r);
+}
+
+static cst_val *lts_cache_lookup(const cst_lexicon *l, const char *word,
+				 int *found)
+{
+    cst_lts_cache *c = l->lts_cache;
+    cst_lts_cache_entry *e;
+    cst_val *phones = NULL;
+    unsigned int h;
+    int i;
+
+    h = lex_hash(word);
+    HGlobalLock();
+    e = c->entries + 2*(h & (c->num_sets-1));
+    for (i=0; i < 2; i++, e++)
+	if (e->word && e->hash == h && cst_streq(e->word,word))
+	{
+	    e->used = ++c->clock;
+	    phones = copy_phones(e->phones);
+	    *found = TRUE;
+	    break;
+	}
+    HGlobalUnlock();
+    return phones;
+}
+
+static void lts_cache_add(const cst_lexicon *l, const char *word,
+			  const cst_val *phones)
+{
+    cst_lts_cache *c = l->lts_cache;
+    cst_lts_cache_entry *e;
+    cst_val *copy;
+    char *w;
+    unsigned int h;
+
+    /* copy outside the lock, another thread may have added it already */
+    /* in which case it is simply replaced                             */
+    h = lex_hash(word);
+    w = cst_strdup(word);
+    copy = copy_phones(phones);
+    HGlobalLock();
+    e = c->entries + 2*(h & (c->num_sets-1));
+    if (e[1].word == NULL || (e[0].word && e[1].used < e[0].used))
+	e++;
+    if (e->word)
+    {
+	cst_free(e->word);
+	delete_val(e->phones);
+    }
+    e->hash = h;
+    e->used = ++c->clock;
+    e->word = w;
+    e->phones = copy;
+    HGlobalUnlock();
+}
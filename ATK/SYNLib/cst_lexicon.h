@@ -64,6 +64,10 @@ typedef struct lexicon_struct {
     cst_val *(*lts_function)(const struct lexicon_struct *l, const char *word, const char *pos);
 
     char ***addenda;
+
+    /* Optional, set up by lex_build_index */
+    struct cst_lex_index_struct *index;    /* hash index over entry_index */
+    struct cst_lts_cache_struct *lts_cache; /* recent LTS results */
 } cst_lexicon;
 
 cst_lexicon *new_lexicon();
@@ -76,6 +80,12 @@ int lex_delete_entry(cst_lexicon *l, const char *word, const char *pos);
 cst_val *lex_lookup(const cst_lexicon *l, const char *word, const char *pos);
 int in_lex(const cst_lexicon *l, const char *word, const char *pos);
 
+/* Build a hash index over the entries so lookups avoid the binary */
+/* search, and a cache holding the LTS results of the last         */
+/* lts_cache_size or so unknown words (none if 0).  Safe to call   */
+/* more than once, later calls do nothing.                         */
+void lex_build_index(cst_lexicon *l, int lts_cache_size);
+
 CST_VAL_USER_TYPE_DCLS(lexicon,cst_lexicon)
 
 #endif
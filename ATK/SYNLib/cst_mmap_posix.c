@@ -0,0 +1,144 @@
+/* ----------------------------------------------------------- */
+/*                                                             */
+/*                        _ ___                                */
+/*                       /_\ | |_/                             */
+/*                       | | | | \                             */
+/*                       =========                             */
+/*                                                             */
+/*        Real-time API for HTK-base Speech Recognition        */
+/*                                                             */
+/*       Machine Intelligence Laboratory (Speech Group)        */
+/*        Cambridge University Engineering Department          */
+/*                  http://mi.eng.cam.ac.uk/                   */
+/*                                                             */
+/*               Copyright CUED 2000-2007                      */
+/*                                                             */
+/*   Use of this software is governed by a License Agreement   */
+/*    ** See the file License for the Conditions of Use  **    */
+/*    **     This banner notice must not be removed      **    */
+/*                                                             */
+/* ----------------------------------------------------------- */
+/*   File: cst_mmap_posix.c - file mapping for unix            */
+/* ----------------------------------------------------------- */
+
+/*
+   The unix counterpart of cst_mmap_win32.c.  Files are mapped
+   read-only and shared so that every process using the same voice
+   file shares its pages in the page cache.
+*/
+
+#ifndef _WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "cst_file.h"
+#include "cst_error.h"
+#include "cst_alloc.h"
+
+cst_filemap *cst_mmap_file(const char *path)
+{
+    cst_filemap *fmap = NULL;
+    struct stat buf;
+    void *mem;
+    int fd;
+
+    if ((fd = open(path,O_RDONLY)) < 0)
+	return NULL;
+    if (fstat(fd,&buf) < 0 || buf.st_size == 0)
+    {
+	close(fd);
+	return NULL;
+    }
+    mem = mmap(NULL,buf.st_size,PROT_READ,MAP_SHARED,fd,0);
+    if (mem == MAP_FAILED)
+    {
+	close(fd);
+	return NULL;
+    }
+    fmap = cst_alloc(cst_filemap,1);
+    fmap->fd = fd;
+    fmap->mapsize = buf.st_size;
+    fmap->mem = mem;
+
+    return fmap;
+}
+
+int cst_munmap_file(cst_filemap *fmap)
+{
+    if (munmap(fmap->mem,fmap->mapsize) < 0)
+    {
+	cst_errmsg("cst_munmap_file: munmap() failed\n");
+	return -1;
+    }
+    if (close(fmap->fd) < 0)
+    {
+	cst_errmsg("cst_munmap_file: close() failed\n");
+	return -1;
+    }
+    cst_free(fmap);
+    return 0;
+}
+
+cst_filemap *cst_read_whole_file(const char *path)
+{
+    cst_filemap *fmap;
+    cst_file fh;
+
+    if ((fh = cst_fopen(path, CST_OPEN_READ | CST_OPEN_BINARY)) == NULL) {
+	cst_errmsg("cst_read_whole_file: Failed to open file\n");
+	return NULL;
+    }
+
+    fmap = cst_alloc(cst_filemap, 1);
+    fmap->fh = fh;
+    fmap->fd = -1;
+    cst_fseek(fmap->fh, 0, CST_SEEK_ENDREL);
+    fmap->mapsize = cst_ftell(fmap->fh);
+    fmap->mem = cst_alloc(char, fmap->mapsize);
+    cst_fseek(fmap->fh, 0, CST_SEEK_ABSOLUTE);
+    cst_fread(fmap->fh, fmap->mem, 1, fmap->mapsize);
+
+    return fmap;
+}
+
+int cst_free_whole_file(cst_filemap *fmap)
+{
+    if (cst_fclose(fmap->fh) < 0) {
+	cst_errmsg("cst_read_whole_file: cst_fclose() failed\n");
+	return -1;
+    }
+    cst_free(fmap->mem);
+    cst_free(fmap);
+    return 0;
+}
+
+cst_filemap *cst_read_part_file(const char *path)
+{
+    cst_filemap *fmap;
+    cst_file fh;
+
+    if ((fh = cst_fopen(path, CST_OPEN_READ | CST_OPEN_BINARY)) == NULL) {
+	cst_errmsg("cst_read_part_file: Failed to open file\n");
+	return NULL;
+    }
+
+    fmap = cst_alloc(cst_filemap, 1);
+    fmap->fh = fh;
+    fmap->fd = -1;
+
+    return fmap;
+}
+
+int cst_free_part_file(cst_filemap *fmap)
+{
+    if (cst_fclose(fmap->fh) < 0) {
+	cst_errmsg("cst_read_part_file: cst_fclose() failed\n");
+	return -1;
+    }
+    cst_free(fmap);
+    return 0;
+}
+#endif
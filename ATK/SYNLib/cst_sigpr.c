@@ -46,112 +46,110 @@
 #include "cst_sigpr.h"
 #include "cst_sts.h"
 
-cst_wave *lpc_resynth(cst_lpcres *lpcres)
+/* The all-pole filter is run one pitch period at a time over a */
+/* linear buffer: x[0..order-1] holds the last outputs of the    */
+/* previous period (oldest first) and the excitation is decoded  */
+/* into x[order..] before filtering in place.  Keeping history   */
+/* contiguous removes the circular index arithmetic from the     */
+/* inner loop, the summation order is as before so the output is */
+/* unchanged.                                                    */
+
+static int lpcres_max_period(const cst_lpcres *lpcres)
 {
-    cst_wave *w;
-    int i,j,r,o,k;
-    int ci,cr;
-    float *outbuf, *lpccoefs;
-    int pm_size_samps;
-    float pp = 0;
+    int i, m;
 
-    /* Get a new wave to build the signal into */
-    w = new_wave();
-    cst_wave_resize(w,lpcres->num_samples * lpcres->residual_fold,1);
-    w->sample_rate = lpcres->sample_rate;
-    /* outbuf is a circular buffer with past relevant samples in it */
-    outbuf = cst_alloc(float,1+lpcres->num_channels);
-    /* unpacked lpc coefficients */
-    lpccoefs = cst_alloc(float,lpcres->num_channels);
+    for (m=0,i=0; i < lpcres->num_frames; i++)
+	if (lpcres->sizes[i] > m)
+	    m = lpcres->sizes[i];
+    return m * lpcres->residual_fold;
+}
 
-    for (r=0,o=lpcres->num_channels,i=0; i < lpcres->num_frames; i++)
-    {
-	pm_size_samps = lpcres->sizes[i] * lpcres->residual_fold;
+static void lpc_excitation(const cst_lpcres *lpcres, int r, int n, float *e)
+{
+    int j;
+
+    if (lpcres->residual_fold == 1)
+	for (j=0; j < n; j++)
+	    e[j] = (float)cst_ulaw_to_short(lpcres->residual[r+j]);
+    else
+	for (j=0; j < n; j++,r++)
+	    e[j] = (float)cst_ulaw_to_short(lpcres->residual[r/lpcres->residual_fold]);
+}
 
-	/* Unpack the LPC coefficients */
-	for (k=0; k<lpcres->num_channels; k++)
-	{
-	    lpccoefs[k] = (float)((((double)lpcres->frames[i][k])/65535.0)*
-			   lpcres->lpc_range) + lpcres->lpc_min;
-	}
-	/* Note we don't zero the lead in from the previous part */
-	/* seems like you should but it makes it worse if you do */
-/*	memset(outbuf,0,sizeof(float)*(1+lpcres->num_channels)); */
+static void lpc_filter_block(float *x, int n, const float *a, int order)
+{
+    float *y, s;
+    int j, ci;
 
-	/* resynthesis the signal */
-	for (j=0; j < pm_size_samps; j++,r++)
-	{
-	    outbuf[o] = (float)cst_ulaw_to_short(lpcres->residual[r/lpcres->residual_fold]);
-	    cr = (o == 0 ? lpcres->num_channels : o-1);
-	    for (ci=0; ci < lpcres->num_channels; ci++)
-	    {
-		outbuf[o] += lpccoefs[ci] * outbuf[cr];
-		cr = (cr == 0 ? lpcres->num_channels : cr-1);
-	    }
-	    w->samples[r] = (short)(outbuf[o] + pp*lpcres->post_emphasis);
-	    pp = outbuf[o];
-	    o = (o == lpcres->num_channels ? 0 : o+1);
-	}
+    for (j=0,y=x+order; j < n; j++,y++)
+    {
+	s = *y;
+	for (ci=0; ci < order; ci++)
+	    s += a[ci] * y[-1-ci];
+	*y = s;
     }
-
-    cst_free(outbuf);
-    cst_free(lpccoefs);
-
-    return w;
-
 }
 
-cst_wave *lpc_resynth_windows(cst_lpcres *lpcres)
+static cst_wave *lpc_resynth_float(cst_lpcres *lpcres, int reset)
 {
     cst_wave *w;
-    int i,j,r,o,k;
-    int ci,cr;
-    float *outbuf, *lpccoefs;
-    int pm_size_samps;
+    int i,j,r,k,order,n;
+    float *x, *y, *lpccoefs;
     float pp = 0;
 
     /* Get a new wave to build the signal into */
     w = new_wave();
     cst_wave_resize(w,lpcres->num_samples * lpcres->residual_fold,1);
     w->sample_rate = lpcres->sample_rate;
-    /* outbuf is a circular buffer with past relevant samples in it */
-    outbuf = cst_alloc(float,1+lpcres->num_channels);
+    order = lpcres->num_channels;
+    /* filter history followed by the current pitch period */
+    x = cst_alloc(float,order+lpcres_max_period(lpcres));
+    y = x+order;
     /* unpacked lpc coefficients */
-    lpccoefs = cst_alloc(float,lpcres->num_channels);
+    lpccoefs = cst_alloc(float,order);
 
-    for (r=0,o=lpcres->num_channels,i=0; i < lpcres->num_frames; i++)
+    for (r=0,i=0; i < lpcres->num_frames; i++)
     {
-	pm_size_samps = lpcres->sizes[i] * lpcres->residual_fold;
+	n = lpcres->sizes[i] * lpcres->residual_fold;
 
 	/* Unpack the LPC coefficients */
-	for (k=0; k<lpcres->num_channels; k++)
-	{
-	    lpccoefs[k] = ((float)(((double)lpcres->frames[i][k])/65535.0)*
-			   lpcres->lpc_range) + lpcres->lpc_min;
-	}
-	memset(outbuf,0,sizeof(float)*(1+lpcres->num_channels));
+	if (reset)
+	    for (k=0; k<order; k++)
+		lpccoefs[k] = ((float)(((double)lpcres->frames[i][k])/65535.0)*
+			       lpcres->lpc_range) + lpcres->lpc_min;
+	else
+	    for (k=0; k<order; k++)
+		lpccoefs[k] = (float)((((double)lpcres->frames[i][k])/65535.0)*
+				      lpcres->lpc_range) + lpcres->lpc_min;
+	/* Note we don't zero the lead in from the previous part */
+	/* seems like you should but it makes it worse if you do */
+	if (reset)
+	    memset(x,0,sizeof(float)*order);
 
 	/* resynthesis the signal */
-	for (j=0; j < pm_size_samps; j++,r++)
+	lpc_excitation(lpcres,r,n,y);
+	lpc_filter_block(x,n,lpccoefs,order);
+	for (j=0; j < n; j++,r++)
 	{
-	    outbuf[o] = (float)cst_ulaw_to_short(lpcres->residual[r / lpcres->residual_fold]);
-	    cr = (o == 0 ? lpcres->num_channels : o-1);
-	    for (ci=0; ci < lpcres->num_channels; ci++)
-	    {
-		outbuf[o] += lpccoefs[ci] * outbuf[cr];
-		cr = (cr == 0 ? lpcres->num_channels : cr-1);
-	    }
-	    w->samples[r] = (short)(outbuf[o] + pp*lpcres->post_emphasis);
-/*	    w->samples[r] = (short)outbuf[o] - pp*0.95; */
-	    pp = outbuf[o];
-	    o = (o == lpcres->num_channels ? 0 : o+1);
+	    w->samples[r] = (short)(y[j] + pp*lpcres->post_emphasis);
+	    pp = y[j];
 	}
+	memmove(x,x+n,sizeof(float)*order);
     }
 
-    cst_free(outbuf);
+    cst_free(x);
     cst_free(lpccoefs);
 
     return w;
+}
 
+cst_wave *lpc_resynth(cst_lpcres *lpcres)
+{
+    return lpc_resynth_float(lpcres,FALSE);
 }
 
+cst_wave *lpc_resynth_windows(cst_lpcres *lpcres)
+{
+    /* As lpc_resynth but the filter history is cleared every period */
+    return lpc_resynth_float(lpcres,TRUE);
+}
@@ -45,61 +45,75 @@
 #include "cst_sigpr.h"
 #include "cst_sts.h"
 
+/* As lpc_resynth, the filter runs over a linear buffer one pitch */
+/* period at a time, x[0..order-1] holding the previous outputs   */
+
+static void lpc_filter_block_fixedpoint(int *x, int n, const int *a, int order)
+{
+    int *y, s;
+    int j, ci;
+
+    for (j=0,y=x+order; j < n; j++,y++)
+    {
+	s = *y * 16384;
+	for (ci=0; ci < order; ci++)
+	    s += a[ci] * y[-1-ci];
+	*y = s / 16384;
+    }
+}
+
 cst_wave *lpc_resynth_fixedpoint(cst_lpcres *lpcres)
 {
     /* The fixed point version, without floats */
     cst_wave *w;
-    int i,j,r,o,k;
-    int ci,cr;
-    int *outbuf, *lpccoefs;
-    int pm_size_samps, ilpc_min, ilpc_range;
-    int pp = 0;
+    int i,j,r,k,order,n,maxn;
+    int *x, *y, *lpccoefs;
+    int ilpc_min, ilpc_range;
 
     /* Get a new wave to build the signal into */
     w = new_wave();
     cst_wave_resize(w,lpcres->num_samples * lpcres->residual_fold,1);
     w->sample_rate = lpcres->sample_rate;
-    /* outbuf is a circular buffer with past relevant samples in it */
-    outbuf = cst_alloc(int,1+lpcres->num_channels);
+    order = lpcres->num_channels;
+    for (maxn=0,i=0; i < lpcres->num_frames; i++)
+	if (lpcres->sizes[i] > maxn)
+	    maxn = lpcres->sizes[i];
+    /* filter history followed by the current pitch period */
+    x = cst_alloc(int,order+maxn*lpcres->residual_fold);
+    y = x+order;
     /* unpacked lpc coefficients */
-    lpccoefs = cst_alloc(int,lpcres->num_channels);
+    lpccoefs = cst_alloc(int,order);
     ilpc_min = (int)(lpcres->lpc_min*32768.0);
     /* assume range is never > abs(16) */
     ilpc_range = (int)(lpcres->lpc_range*2048.0);
 
-    for (r=0,o=lpcres->num_channels,i=0; i < lpcres->num_frames; i++)
+    for (r=0,i=0; i < lpcres->num_frames; i++)
     {
-	pm_size_samps = lpcres->sizes[i] * lpcres->residual_fold;
+	n = lpcres->sizes[i] * lpcres->residual_fold;
 
 	/* Unpack the LPC coefficients */
-	for (k=0; k<lpcres->num_channels; k++)
+	for (k=0; k<order; k++)
 	    lpccoefs[k]=((lpcres->frames[i][k]/2*ilpc_range)/2048+ilpc_min)/2;
 
 	/* resynthesis the signal */
-	for (j=0; j < pm_size_samps; j++,r++)
-	{
-	    outbuf[o] = (int)cst_ulaw_to_short(lpcres->residual[r / lpcres->residual_fold]);
-	    outbuf[o] *= 16384;
-	    cr = (o == 0 ? lpcres->num_channels : o-1);
-	    for (ci=0; ci < lpcres->num_channels; ci++)
-	    {
-		outbuf[o] += lpccoefs[ci]*outbuf[cr];
-		cr = (cr == 0 ? lpcres->num_channels : cr-1);
-	    }
-	    outbuf[o] /= 16384;
-	    w->samples[r] = (short)outbuf[o]
+	if (lpcres->residual_fold == 1)
+	    for (j=0; j < n; j++)
+		y[j] = (int)cst_ulaw_to_short(lpcres->residual[r+j]);
+	else
+	    for (j=0; j < n; j++)
+		y[j] = (int)cst_ulaw_to_short(lpcres->residual[(r+j) / lpcres->residual_fold]);
+	lpc_filter_block_fixedpoint(x,n,lpccoefs,order);
+	for (j=0; j < n; j++,r++)
+	    w->samples[r] = (short)y[j]
 		/* I'll have to re-think this for FP case */
 		/* + (pp*lpcres->post_emphasis)/32768 */
 		;
-	    pp = outbuf[o];
-	    o = (o == lpcres->num_channels ? 0 : o+1);
-	}
+	memmove(x,x+n,sizeof(int)*order);
     }
 
-    cst_free(outbuf);
+    cst_free(x);
     cst_free(lpccoefs);
 
     return w;
 
 }
-
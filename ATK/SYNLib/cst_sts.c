@@ -98,20 +98,22 @@ const unsigned char * get_sts_residual_fixed(const cst_sts_list *sts_list, int f
 	return sts_list->sts[frame].residual;
 }
 
-static unsigned long mapped_frame_offset(const cst_sts_list *sts_list, int frame)
+/* Residual offsets are 32 bit in voice files, whatever the size of */
+/* a long on the machine reading them                                */
+static unsigned int mapped_frame_offset(const cst_sts_list *sts_list, int frame)
 {
     /* This assumes that the voice compiler has generated an extra
            offset at the end of the array. */
     if (sts_list->resoffs->mem == NULL)
     {
-	unsigned long off;
+	unsigned int off;
 
-	cst_fseek(sts_list->resoffs->fh, frame*sizeof(unsigned long), CST_SEEK_ABSOLUTE);
+	cst_fseek(sts_list->resoffs->fh, frame*sizeof(unsigned int), CST_SEEK_ABSOLUTE);
 	cst_fread(sts_list->resoffs->fh, &off, sizeof(off), 1);
 	return off;
     }
     else
-	return ((const unsigned long *)sts_list->resoffs->mem)[frame];
+	return ((const unsigned int *)sts_list->resoffs->mem)[frame];
 }
 
 const unsigned char * get_sts_residual(const cst_sts_list *sts_list, int frame)
@@ -121,8 +123,8 @@ const unsigned char * get_sts_residual(const cst_sts_list *sts_list, int frame)
 	if (sts_list->frames->mem == NULL)
 	{
 	    unsigned char *data;
-	    unsigned long a = mapped_frame_offset(sts_list, frame);
-	    unsigned long b = mapped_frame_offset(sts_list, frame+1);
+	    unsigned int a = mapped_frame_offset(sts_list, frame);
+	    unsigned int b = mapped_frame_offset(sts_list, frame+1);
 
 	    data = cst_alloc(unsigned char, b - a);
 	    cst_fseek(sts_list->residuals->fh, a, CST_SEEK_ABSOLUTE);
@@ -131,7 +133,7 @@ const unsigned char * get_sts_residual(const cst_sts_list *sts_list, int frame)
 	}
 	else
 	    return (const unsigned char *)sts_list->residuals->mem
-		+ ((const unsigned long *)sts_list->resoffs->mem)[frame];
+		+ ((const unsigned int *)sts_list->resoffs->mem)[frame];
     }
     else
 	return sts_list->sts[frame].residual;
@@ -144,15 +146,15 @@ int get_frame_size(const cst_sts_list *sts_list, int frame)
            offset at the end of the array. */
 	if (sts_list->resoffs->mem == NULL)
 	{
-	    unsigned long offs[2];
+	    unsigned int offs[2];
 
-	    cst_fseek(sts_list->resoffs->fh, frame*sizeof(unsigned long), CST_SEEK_ABSOLUTE);
+	    cst_fseek(sts_list->resoffs->fh, frame*sizeof(unsigned int), CST_SEEK_ABSOLUTE);
 	    cst_fread(sts_list->resoffs->fh, offs, sizeof(offs), 1);
 	    return offs[1] - offs[0];
 	}
 	else
-	    return ((const unsigned long *)sts_list->resoffs->mem)[frame+1]
-		- ((const unsigned long *)sts_list->resoffs->mem)[frame];
+	    return ((const unsigned int *)sts_list->resoffs->mem)[frame+1]
+		- ((const unsigned int *)sts_list->resoffs->mem)[frame];
     } else {
 	return sts_list->sts[frame].size;
     }
@@ -89,6 +89,69 @@ cst_val *string_val(const char *s)
    return v;
 }
 
+static cst_val *new_val_local(cst_alloc_context ctx)
+{
+#ifndef UNDER_CE
+   cst_val *v;
+
+   if (ctx)
+   {
+      v = (cst_val *)cst_local_alloc(ctx,sizeof(cst_val));
+      CST_VAL_REFCOUNT(v) = CST_VAL_ARENA;
+      return v;
+   }
+#endif
+   /* WinCE heaps are freed val by val, so vals stay global there */
+   return new_val();
+}
+
+cst_val *int_val_local(cst_alloc_context ctx, int i)
+{
+   cst_val *v = new_val_local(ctx);
+   CST_VAL_TYPE(v) = CST_VAL_TYPE_INT;
+   CST_VAL_INT(v) = i;
+   return v;
+}
+
+cst_val *float_val_local(cst_alloc_context ctx, float f)
+{
+   cst_val *v = new_val_local(ctx);
+   CST_VAL_TYPE(v) = CST_VAL_TYPE_FLOAT;
+   CST_VAL_FLOAT(v) = f;
+   return v;
+}
+
+cst_val *string_val_local(cst_alloc_context ctx, const char *s)
+{
+   cst_val *v = new_val_local(ctx);
+   char *c;
+
+   CST_VAL_TYPE(v) = CST_VAL_TYPE_STRING;
+   if (CST_VAL_REFCOUNT(v) == CST_VAL_ARENA)
+   {  /* the string goes with the val */
+      c = (char *)cst_local_alloc(ctx,strlen(s)+1);
+      strcpy(c,s);
+      CST_VAL_STRING_LVAL(v) = c;
+   }
+   else
+      CST_VAL_STRING_LVAL(v) = cst_strdup(s);
+   return v;
+}
+
+/* Copy of an int, float or string atom in ctx, others are returned */
+/* as they are since they are never in an arena                     */
+cst_val *val_copy_atom_local(cst_alloc_context ctx, const cst_val *v)
+{
+   if (CST_VAL_TYPE(v) == CST_VAL_TYPE_INT)
+      return int_val_local(ctx,CST_VAL_INT(v));
+   else if (CST_VAL_TYPE(v) == CST_VAL_TYPE_FLOAT)
+      return float_val_local(ctx,CST_VAL_FLOAT(v));
+   else if (CST_VAL_TYPE(v) == CST_VAL_TYPE_STRING)
+      return string_val_local(ctx,CST_VAL_STRING(v));
+   else
+      return (cst_val *)(void *)v;
+}
+
 cst_val *cons_val(const cst_val *a, const cst_val *b)
 {
    cst_val *v = new_val();
@@ -425,7 +488,8 @@ cst_val *val_inc_refcount(const cst_val *b)
    if (CST_VAL_REFCOUNT(wb) == -1)
       /* or is a cons cell in the text segment, how do I do that ? */
       return wb;
-   else if (!cst_val_consp(wb)) /* we don't ref count cons cells */
+   else if (!cst_val_consp(wb) /* we don't ref count cons cells */
+            && CST_VAL_REFCOUNT(wb) != CST_VAL_ARENA)
       CST_VAL_REFCOUNT(wb) += 1;
    return wb;
 }
@@ -441,6 +505,8 @@ int val_dec_refcount(const cst_val *b)
       return -1;
    else if (cst_val_consp(wb)) /* we don't ref count cons cells */
       return 0;
+   else if (CST_VAL_REFCOUNT(wb) == CST_VAL_ARENA)
+      return -1; /* goes with its arena */
    else if (CST_VAL_REFCOUNT(wb) == 0)
    {
       /* Otherwise, trying to free a val outside an
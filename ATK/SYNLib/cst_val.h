@@ -110,6 +110,14 @@ cst_val *string_val(const char *s);
 cst_val *val_new_typed(int type, void *vv);
 cst_val *cons_val(const cst_val *a, const cst_val *b);
 
+/* Atoms allocated in a context, as for an utterance's features.  */
+/* Those in an arena are marked CST_VAL_ARENA, are not reference  */
+/* counted and go with the arena.  A NULL context is the heap.    */
+cst_val *int_val_local(cst_alloc_context ctx, int i);
+cst_val *float_val_local(cst_alloc_context ctx, float f);
+cst_val *string_val_local(cst_alloc_context ctx, const char *s);
+cst_val *val_copy_atom_local(cst_alloc_context ctx, const cst_val *v);
+
 /* Derefence and delete val if no other references */
 void delete_val(cst_val *val);
 void delete_val_list(cst_val *val);
@@ -139,6 +147,11 @@ int cst_val_consp(const cst_val *v);
 
 #define CST_VAL_REFCOUNT(X) ((X)->c.a.ref_count)
 
+/* ref_count of atoms in an arena, constants have -1 */
+#define CST_VAL_ARENA -2
+#define CST_VAL_IN_ARENA(X) (!cst_val_consp(X) && \
+			     (CST_VAL_REFCOUNT(X) == CST_VAL_ARENA))
+
 /* Some standard function */
 int val_equal(const cst_val *a, const cst_val *b);
 int val_less(const cst_val *a, const cst_val *b);
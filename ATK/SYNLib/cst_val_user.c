@@ -52,7 +52,7 @@ CST_VAL_REG_TD_FUNCPTR(uttfunc,cst_uttfunc,15)
 CST_VAL_REG_TD_FUNCPTR(ffunc,cst_ffunction,17)
 CST_VAL_REG_TD_TYPE_NODEL(relation,cst_relation,19)
 CST_VAL_REG_TD_TYPE_NODEL(item,cst_item,21)
-CST_VAL_REG_TD_TYPE_NODEL(cart,cst_cart,23)
+CST_VAL_REG_TD_TYPE(cart,cst_cart,23)
 CST_VAL_REG_TD_TYPE_NODEL(phoneset,cst_phoneset,25)
 CST_VAL_REG_TD_TYPE_NODEL(lexicon,cst_lexicon,27)
 CST_VAL_REG_TD_TYPE_NODEL(dur_stats,dur_stats,29)
@@ -0,0 +1,767 @@
+/* ----------------------------------------------------------- */
+/*                                                             */
+/*                        _ ___                                */
+/*                       /_\ | |_/                             */
+/*                       | | | | \                             */
+/*                       =========                             */
+/*                                                             */
+/*        Real-time API for HTK-base Speech Recognition        */
+/*                                                             */
+/*       Machine Intelligence Laboratory (Speech Group)        */
+/*        Cambridge University Engineering Department          */
+/*                  http://mi.eng.cam.ac.uk/                   */
+/*                                                             */
+/*               Copyright CUED 2000-2007                      */
+/*                                                             */
+/*   Use of this software is governed by a License Agreement   */
+/*    ** See the file License for the Conditions of Use  **    */
+/*    **     This banner notice must not be removed      **    */
+/*                                                             */
+/* ----------------------------------------------------------- */
+/*   File: cst_voxfile.c - memory mapped voice databases       */
+/* ----------------------------------------------------------- */
+
+#include <string.h>
+#include "cst_voxfile.h"
+
+#define VOX_MAXSECTS 24
+#define VOX_ALIGN 8
+
+/* ---------------- Writing ------------------ */
+
+typedef struct vox_sect_struct {
+    char tag[4];
+    char *buf;
+    unsigned int size, cap, count;
+} vox_sect;
+
+typedef struct vox_writer_struct {
+    vox_sect sects[VOX_MAXSECTS];
+    int num_sections;
+    vox_sect *strings;
+} vox_writer;
+
+static vox_sect *vox_sect_new(vox_writer *w, const char *tag)
+{
+    vox_sect *s;
+
+    if (w->num_sections == VOX_MAXSECTS)
+    {
+	cst_errmsg("cst_vox_save: too many sections\n");
+	cst_error();
+    }
+    s = &w->sects[w->num_sections++];
+    memmove(s->tag,tag,4);
+    s->buf = NULL;
+    s->size = s->cap = s->count = 0;
+    return s;
+}
+
+/* Append count entries of size bytes each */
+static void vox_put(vox_sect *s, const void *data, int size, int count)
+{
+    unsigned int n = size*count;
+    char *nbuf;
+
+    if (s->size + n > s->cap)
+    {
+	s->cap = (s->cap == 0) ? 1024 : s->cap;
+	while (s->size + n > s->cap)
+	    s->cap *= 2;
+	nbuf = cst_alloc(char,s->cap);
+	if (s->size > 0)
+	    memmove(nbuf,s->buf,s->size);
+	cst_free(s->buf);
+	s->buf = nbuf;
+    }
+    memmove(s->buf+s->size,data,n);
+    s->size += n;
+    s->count += count;
+}
+
+/* Returns the offset of s in the string table, NULL is saved as "" */
+static unsigned int vox_string(vox_writer *w, const char *s)
+{
+    unsigned int off = w->strings->size;
+
+    if (s == NULL)
+	s = "";
+    vox_put(w->strings,s,1,strlen(s)+1);
+    w->strings->count -= strlen(s);
+    return off;
+}
+
+static void vox_writer_init(vox_writer *w)
+{
+    w->num_sections = 0;
+    w->strings = vox_sect_new(w,CST_VOX_STRINGS);
+    vox_string(w,"");
+}
+
+static void vox_put_features(vox_writer *w, const cst_features *params)
+{
+    vox_sect *s = vox_sect_new(w,CST_VOX_FEATURES);
+    const cst_featvalpair *p;
+    cst_vox_feat f;
+
+    for (p=params ? params->head : NULL; p; p=p->next)
+    {
+	if (p->val == NULL || cst_val_consp(p->val))
+	    continue;
+	memset(&f,0,sizeof(f));
+	f.type = CST_VAL_TYPE(p->val);
+	if (f.type == CST_VAL_TYPE_INT)
+	    f.v.ival = CST_VAL_INT(p->val);
+	else if (f.type == CST_VAL_TYPE_FLOAT)
+	    f.v.fval = CST_VAL_FLOAT(p->val);
+	else if (f.type == CST_VAL_TYPE_STRING)
+	    f.v.sval = vox_string(w,CST_VAL_STRING(p->val));
+	else
+	    continue;
+	f.name = vox_string(w,p->name);
+	vox_put(s,&f,sizeof(f),1);
+    }
+}
+
+static int vox_has_frames(const cst_sts_list *sts)
+{
+    if (sts->sts)
+	return sts->num_sts > 0 && sts->sts[0].frame != NULL;
+    return sts->frames != NULL;
+}
+
+static int vox_has_residuals(const cst_sts_list *sts)
+{
+    if (sts->sts)
+	return sts->num_sts > 0 && sts->sts[0].residual != NULL;
+    return sts->residuals != NULL;
+}
+
+/* Save an sts list under tags prefix+H/F/R/O.  Fixed residuals */
+/* (mel cep bytes) are num_channels bytes per frame, others are  */
+/* one byte per sample indexed by the offsets                    */
+static void vox_put_sts(vox_writer *w, const char *prefix,
+			const cst_sts_list *sts, int fixed)
+{
+    char tag[5];
+    vox_sect *s;
+    cst_vox_sts h;
+    const unsigned short *frame;
+    const unsigned char *res;
+    unsigned int off;
+    int i, size;
+
+    memset(&h,0,sizeof(h));
+    h.num_sts = sts->num_sts;
+    h.num_channels = sts->num_channels;
+    h.sample_rate = sts->sample_rate;
+    h.coeff_min = sts->coeff_min;
+    h.coeff_range = sts->coeff_range;
+    h.post_emphasis = sts->post_emphasis;
+    h.residual_fold = sts->residual_fold;
+    strcpy(tag,prefix);
+    tag[3] = CST_VOX_STS_HEAD;
+    vox_put(vox_sect_new(w,tag),&h,sizeof(h),1);
+
+    if (vox_has_frames(sts))
+    {
+	tag[3] = CST_VOX_STS_FRAME;
+	s = vox_sect_new(w,tag);
+	for (i=0; i<sts->num_sts; i++)
+	{
+	    frame = get_sts_frame(sts,i);
+	    vox_put(s,frame,sizeof(unsigned short),sts->num_channels);
+	    release_sts_frame(sts,i,frame);
+	}
+    }
+    if (!vox_has_residuals(sts))
+	return;
+    tag[3] = CST_VOX_STS_RES;
+    s = vox_sect_new(w,tag);
+    if (fixed)
+    {
+	for (i=0; i<sts->num_sts; i++)
+	{
+	    res = get_sts_residual_fixed(sts,i);
+	    vox_put(s,res,1,sts->num_channels);
+	    release_sts_residual(sts,i,res);
+	}
+	return;
+    }
+    for (i=0; i<sts->num_sts; i++)
+    {
+	size = get_frame_size(sts,i);
+	res = get_sts_residual(sts,i);
+	vox_put(s,res,1,size);
+	release_sts_residual(sts,i,res);
+    }
+    tag[3] = CST_VOX_STS_OFFS;
+    s = vox_sect_new(w,tag);
+    for (i=0,off=0; i<sts->num_sts; i++)
+    {
+	vox_put(s,&off,sizeof(off),1);
+	off += get_frame_size(sts,i);
+    }
+    vox_put(s,&off,sizeof(off),1);
+}
+
+/* Flatten a val into the val table, returns its index */
+static unsigned int vox_put_val(vox_writer *w, vox_sect *s, const cst_val *v)
+{
+    cst_vox_val e;
+    unsigned int idx, car, cdr;
+
+    if (v == NULL)
+	return CST_VOX_NOVAL;
+    memset(&e,0,sizeof(e));
+    if (cst_val_consp(v))
+    {
+	car = vox_put_val(w,s,val_car(v));
+	cdr = vox_put_val(w,s,val_cdr(v));
+	e.type = CST_VAL_TYPE_CONS;
+	e.a.car = car;
+	e.cdr = cdr;
+    }
+    else
+    {
+	e.type = CST_VAL_TYPE(v);
+	e.cdr = CST_VOX_NOVAL;
+	if (e.type == CST_VAL_TYPE_INT)
+	    e.a.ival = CST_VAL_INT(v);
+	else if (e.type == CST_VAL_TYPE_FLOAT)
+	    e.a.fval = CST_VAL_FLOAT(v);
+	else if (e.type == CST_VAL_TYPE_STRING)
+	    e.a.sval = vox_string(w,CST_VAL_STRING(v));
+	else
+	{
+	    cst_errmsg("cst_vox_save: can't save val of type %d in a tree\n",
+		       e.type);
+	    cst_error();
+	}
+    }
+    idx = s->count;
+    vox_put(s,&e,sizeof(e),1);
+    return idx;
+}
+
+/* Static trees end with a leaf with no value */
+static int vox_num_nodes(const cst_cart *tree)
+{
+    int n;
+
+    for (n=0; ; n++)
+	if (tree->rule_table[n].op == CST_CART_OP_LEAF
+	    && tree->rule_table[n].feat == 255
+	    && tree->rule_table[n].val == NULL)
+	    return n+1;
+}
+
+static void vox_put_trees(vox_writer *w, const cst_cart * const *trees,
+			  int num_trees)
+{
+    vox_sect *st, *sn, *sf, *sv;
+    const cst_cart *tree;
+    cst_vox_tree t;
+    cst_vox_node n;
+    unsigned int off;
+    int i, j;
+
+    st = vox_sect_new(w,CST_VOX_TREES);
+    sn = vox_sect_new(w,CST_VOX_NODES);
+    sf = vox_sect_new(w,CST_VOX_FEATNAMES);
+    sv = vox_sect_new(w,CST_VOX_VALS);
+    for (i=0; i<num_trees; i++)
+    {
+	tree = trees[i];
+	t.first_node = sn->count;
+	t.num_nodes = vox_num_nodes(tree);
+	t.first_feat = sf->count;
+	for (j=0; tree->feat_table[j]; j++)
+	{
+	    off = vox_string(w,tree->feat_table[j]);
+	    vox_put(sf,&off,sizeof(off),1);
+	}
+	t.num_feats = j;
+	vox_put(st,&t,sizeof(t),1);
+	for (j=0; j<(int)t.num_nodes; j++)
+	{
+	    memset(&n,0,sizeof(n));
+	    n.feat = tree->rule_table[j].feat;
+	    n.op = tree->rule_table[j].op;
+	    n.no_node = tree->rule_table[j].no_node;
+	    n.val = vox_put_val(w,sv,tree->rule_table[j].val);
+	    vox_put(sn,&n,sizeof(n),1);
+	}
+    }
+}
+
+static int vox_write(vox_writer *w, const char *path)
+{
+    cst_vox_header h;
+    cst_vox_section d[VOX_MAXSECTS];
+    static const char pad[VOX_ALIGN] = { 0 };
+    unsigned int off;
+    cst_file fd;
+    int i, rv = 0;
+
+    memset(&h,0,sizeof(h));
+    memmove(h.magic,CST_VOX_MAGIC,8);
+    h.version = CST_VOX_VERSION;
+    h.byteorder = CST_VOX_BYTEORDER;
+    h.num_sections = w->num_sections;
+    off = sizeof(h) + w->num_sections*sizeof(cst_vox_section);
+    for (i=0; i<w->num_sections; i++)
+    {
+	off = (off + VOX_ALIGN-1) & ~(VOX_ALIGN-1);
+	memmove(d[i].tag,w->sects[i].tag,4);
+	d[i].offset = off;
+	d[i].size = w->sects[i].size;
+	d[i].count = w->sects[i].count;
+	off += w->sects[i].size;
+    }
+
+    if ((fd = cst_fopen(path,CST_OPEN_WRITE|CST_OPEN_BINARY)) == NULL)
+    {
+	cst_errmsg("cst_vox_save: can't open file \"%s\"\n",path);
+	rv = -1;
+    }
+    else
+    {
+	off = sizeof(h) + w->num_sections*sizeof(cst_vox_section);
+	cst_fwrite(fd,&h,sizeof(h),1);
+	cst_fwrite(fd,d,sizeof(cst_vox_section),w->num_sections);
+	for (i=0; i<w->num_sections; i++)
+	{
+	    cst_fwrite(fd,pad,1,d[i].offset-off);
+	    if (w->sects[i].size > 0
+		&& cst_fwrite(fd,w->sects[i].buf,1,w->sects[i].size)
+		   != w->sects[i].size)
+		rv = -1;
+	    off = d[i].offset + d[i].size;
+	}
+	if (cst_fclose(fd) != 0 || rv != 0)
+	{
+	    cst_errmsg("cst_vox_save: failed to write \"%s\"\n",path);
+	    rv = -1;
+	}
+    }
+    for (i=0; i<w->num_sections; i++)
+	cst_free(w->sects[i].buf);
+    return rv;
+}
+
+int cst_vox_save_diphone_db(const char *path, const cst_diphone_db *db,
+			    const cst_features *params)
+{
+    vox_writer w;
+    vox_sect *s;
+    cst_vox_unitdb u;
+    cst_vox_diphone d;
+    int i;
+
+    vox_writer_init(&w);
+    vox_put_features(&w,params);
+    memset(&u,0,sizeof(u));
+    u.db_type = CST_VOX_DIPHONE;
+    u.name = vox_string(&w,db->name);
+    u.num_entries = db->num_entries;
+    vox_put(vox_sect_new(&w,CST_VOX_UNITDB),&u,sizeof(u),1);
+    s = vox_sect_new(&w,CST_VOX_DIPHONES);
+    for (i=0; i<db->num_entries; i++)
+    {
+	d.name = vox_string(&w,db->diphones[i].name);
+	d.start_pm = db->diphones[i].start_pm;
+	d.pb_pm = db->diphones[i].pb_pm;
+	d.end_pm = db->diphones[i].end_pm;
+	vox_put(s,&d,sizeof(d),1);
+    }
+    vox_put_sts(&w,"LPC",db->sts,0);
+
+    return vox_write(&w,path);
+}
+
+int cst_vox_save_clunit_db(const char *path, const cst_clunit_db *db,
+			   const cst_features *params)
+{
+    vox_writer w;
+    vox_sect *s;
+    cst_vox_unitdb u;
+    cst_vox_type t;
+    cst_vox_unit n;
+    int i;
+
+    vox_writer_init(&w);
+    vox_put_features(&w,params);
+    memset(&u,0,sizeof(u));
+    u.db_type = CST_VOX_CLUNITS;
+    u.name = vox_string(&w,db->name);
+    u.num_entries = db->num_types;
+    u.num_units = db->num_units;
+    u.optimal_coupling = db->optimal_coupling;
+    u.extend_selections = db->extend_selections;
+    u.f0_weight = db->f0_weight;
+    vox_put(vox_sect_new(&w,CST_VOX_UNITDB),&u,sizeof(u),1);
+    s = vox_sect_new(&w,CST_VOX_TYPES);
+    for (i=0; i<db->num_types; i++)
+    {
+	t.name = vox_string(&w,db->types[i].name);
+	t.start = db->types[i].start;
+	t.count = db->types[i].count;
+	vox_put(s,&t,sizeof(t),1);
+    }
+    s = vox_sect_new(&w,CST_VOX_UNITS);
+    for (i=0; i<db->num_units; i++)
+    {
+	memset(&n,0,sizeof(n));
+	n.type = db->units[i].type;
+	n.phone = db->units[i].phone;
+	n.start = db->units[i].start;
+	n.end = db->units[i].end;
+	n.prev = db->units[i].prev;
+	n.next = db->units[i].next;
+	vox_put(s,&n,sizeof(n),1);
+    }
+    vox_put(vox_sect_new(&w,CST_VOX_WEIGHTS),db->join_weights,
+	    sizeof(int),db->mcep->num_channels);
+    vox_put_trees(&w,db->trees,db->num_types);
+    vox_put_sts(&w,"LPC",db->sts,0);
+    vox_put_sts(&w,"MCP",db->mcep,1);
+
+    return vox_write(&w,path);
+}
+
+/* ---------------- Loading ------------------ */
+
+static const cst_vox_section *vox_find(const cst_voxfile *vf,
+				       const char *tag)
+{
+    const cst_vox_header *h = (const cst_vox_header *)vf->map->mem;
+    const cst_vox_section *d = (const cst_vox_section *)(h+1);
+    unsigned int i;
+
+    for (i=0; i<h->num_sections; i++)
+	if (memcmp(d[i].tag,tag,4) == 0)
+	    return &d[i];
+    return NULL;
+}
+
+/* Start of a section, NULL if absent */
+static const void *vox_data(const cst_voxfile *vf, const char *tag,
+			    int *count)
+{
+    const cst_vox_section *d = vox_find(vf,tag);
+
+    if (count)
+	*count = d ? d->count : 0;
+    if (d == NULL)
+	return NULL;
+    return (const char *)vf->map->mem + d->offset;
+}
+
+static int vox_check(const cst_filemap *map, const char *path)
+{
+    const cst_vox_header *h = (const cst_vox_header *)map->mem;
+    const cst_vox_section *d = (const cst_vox_section *)(h+1);
+    unsigned int i;
+
+    if (map->mapsize < sizeof(*h) || memcmp(h->magic,CST_VOX_MAGIC,8) != 0)
+    {
+	cst_errmsg("cst_vox_open: \"%s\" is not a voice file\n",path);
+	return 0;
+    }
+    if (h->byteorder != CST_VOX_BYTEORDER)
+    {
+	cst_errmsg("cst_vox_open: \"%s\" was written with the other byte order\n",
+		   path);
+	return 0;
+    }
+    if (h->version != CST_VOX_VERSION)
+    {
+	cst_errmsg("cst_vox_open: \"%s\" is version %d, expected %d\n",
+		   path,h->version,CST_VOX_VERSION);
+	return 0;
+    }
+    if (map->mapsize < sizeof(*h) + h->num_sections*sizeof(*d))
+    {
+	cst_errmsg("cst_vox_open: \"%s\" is truncated\n",path);
+	return 0;
+    }
+    for (i=0; i<h->num_sections; i++)
+	if (d[i].offset % VOX_ALIGN != 0
+	    || d[i].offset > map->mapsize
+	    || d[i].size > map->mapsize - d[i].offset)
+	{
+	    cst_errmsg("cst_vox_open: \"%s\" is truncated\n",path);
+	    return 0;
+	}
+    return 1;
+}
+
+static void vox_load_features(cst_voxfile *vf)
+{
+    const cst_vox_feat *f;
+    int i, n;
+
+    vf->features = new_features();
+    f = (const cst_vox_feat *)vox_data(vf,CST_VOX_FEATURES,&n);
+    for (i=n-1; i>=0; i--)
+    {
+	if (f[i].type == CST_VAL_TYPE_INT)
+	    feat_set_int(vf->features,vf->strings+f[i].name,f[i].v.ival);
+	else if (f[i].type == CST_VAL_TYPE_FLOAT)
+	    feat_set_float(vf->features,vf->strings+f[i].name,f[i].v.fval);
+	else if (f[i].type == CST_VAL_TYPE_STRING)
+	    feat_set_string(vf->features,vf->strings+f[i].name,
+			    vf->strings+f[i].v.sval);
+    }
+}
+
+/* The sts list points into the map through filemaps which are */
+/* views of the sections, they are never unmapped themselves   */
+static cst_sts_list *vox_load_sts(cst_voxfile *vf, const char *prefix,
+				  cst_filemap *maps)
+{
+    const cst_vox_section *d;
+    const cst_vox_sts *h;
+    cst_sts_list *sts;
+    static const char kind[3] =
+	{ CST_VOX_STS_FRAME, CST_VOX_STS_RES, CST_VOX_STS_OFFS };
+    cst_filemap **fm[3];
+    char tag[5];
+    int i;
+
+    strcpy(tag,prefix);
+    tag[3] = CST_VOX_STS_HEAD;
+    if ((h = (const cst_vox_sts *)vox_data(vf,tag,NULL)) == NULL)
+	return NULL;
+    sts = new_sts_list();
+    sts->num_sts = h->num_sts;
+    sts->num_channels = h->num_channels;
+    sts->sample_rate = h->sample_rate;
+    sts->coeff_min = h->coeff_min;
+    sts->coeff_range = h->coeff_range;
+    sts->post_emphasis = h->post_emphasis;
+    sts->residual_fold = h->residual_fold;
+
+    fm[0] = &sts->frames; fm[1] = &sts->residuals; fm[2] = &sts->resoffs;
+    for (i=0; i<3; i++)
+    {
+	tag[3] = kind[i];
+	if ((d = vox_find(vf,tag)) == NULL)
+	    continue;
+	maps[i].mem = (char *)vf->map->mem + d->offset;
+	maps[i].mapsize = d->size;
+	maps[i].fh = NULL;
+	*fm[i] = &maps[i];
+    }
+    return sts;
+}
+
+static void vox_load_diphones(cst_voxfile *vf, const cst_vox_unitdb *u)
+{
+    const cst_vox_diphone *d;
+    cst_diphone_db *db;
+    int i, n;
+
+    d = (const cst_vox_diphone *)vox_data(vf,CST_VOX_DIPHONES,&n);
+    vf->diphones = cst_alloc(cst_diphone_entry,n);
+    for (i=0; i<n; i++)
+    {
+	vf->diphones[i].name = (char *)vf->strings + d[i].name;
+	vf->diphones[i].start_pm = d[i].start_pm;
+	vf->diphones[i].pb_pm = d[i].pb_pm;
+	vf->diphones[i].end_pm = d[i].end_pm;
+    }
+    db = cst_alloc(cst_diphone_db,1);
+    db->name = vf->strings + u->name;
+    db->num_entries = n;
+    db->diphones = vf->diphones;
+    db->sts = vf->sts;
+    vf->diphone_db = db;
+}
+
+static void vox_load_trees(cst_voxfile *vf)
+{
+    const cst_vox_tree *t;
+    const cst_vox_node *n;
+    const cst_vox_val *v;
+    const unsigned int *f;
+    cst_val *val;
+    int i, nt, nn, nf, nv;
+
+    t = (const cst_vox_tree *)vox_data(vf,CST_VOX_TREES,&nt);
+    n = (const cst_vox_node *)vox_data(vf,CST_VOX_NODES,&nn);
+    f = (const unsigned int *)vox_data(vf,CST_VOX_FEATNAMES,&nf);
+    v = (const cst_vox_val *)vox_data(vf,CST_VOX_VALS,&nv);
+
+    /* Vals are given a refcount of -1 as static ones are */
+    vf->vals = cst_alloc(cst_val,nv);
+    for (i=0; i<nv; i++)
+    {
+	val = &vf->vals[i];
+	if (v[i].type == CST_VAL_TYPE_CONS)
+	{
+	    CST_VAL_CAR(val) = (v[i].a.car == CST_VOX_NOVAL) ? NULL
+		: &vf->vals[v[i].a.car];
+	    CST_VAL_CDR(val) = (v[i].cdr == CST_VOX_NOVAL) ? NULL
+		: &vf->vals[v[i].cdr];
+	    continue;
+	}
+	CST_VAL_TYPE(val) = v[i].type;
+	CST_VAL_REFCOUNT(val) = -1;
+	if (v[i].type == CST_VAL_TYPE_INT)
+	    CST_VAL_INT(val) = v[i].a.ival;
+	else if (v[i].type == CST_VAL_TYPE_FLOAT)
+	    CST_VAL_FLOAT(val) = v[i].a.fval;
+	else
+	    CST_VAL_STRING_LVAL(val) = (void *)(vf->strings + v[i].a.sval);
+    }
+    vf->nodes = cst_alloc(cst_cart_node,nn);
+    for (i=0; i<nn; i++)
+    {
+	vf->nodes[i].feat = n[i].feat;
+	vf->nodes[i].op = n[i].op;
+	vf->nodes[i].no_node = n[i].no_node;
+	vf->nodes[i].val = (n[i].val == CST_VOX_NOVAL) ? NULL
+	    : &vf->vals[n[i].val];
+    }
+    /* Feature tables are NULL terminated so one more per tree */
+    vf->feat_names = cst_alloc(const char *,nf+nt);
+    vf->carts = cst_alloc(cst_cart,nt);
+    vf->trees = cst_alloc(const cst_cart *,nt);
+    for (i=0; i<nt; i++)
+    {
+	const char **ft = vf->feat_names + t[i].first_feat + i;
+	unsigned int j;
+
+	for (j=0; j<t[i].num_feats; j++)
+	    ft[j] = vf->strings + f[t[i].first_feat+j];
+	ft[j] = NULL;
+	vf->carts[i].rule_table = vf->nodes + t[i].first_node;
+	vf->carts[i].feat_table = ft;
+	vf->trees[i] = &vf->carts[i];
+    }
+}
+
+static void vox_load_clunits(cst_voxfile *vf, const cst_vox_unitdb *u)
+{
+    const cst_vox_type *t;
+    const cst_vox_unit *units;
+    cst_clunit_db *db;
+    int i, n;
+
+    t = (const cst_vox_type *)vox_data(vf,CST_VOX_TYPES,&n);
+    vf->types = cst_alloc(cst_clunit_type,n);
+    for (i=0; i<n; i++)
+    {
+	vf->types[i].name = vf->strings + t[i].name;
+	vf->types[i].start = t[i].start;
+	vf->types[i].count = t[i].count;
+    }
+    vox_load_trees(vf);
+
+    db = cst_alloc(cst_clunit_db,1);
+    units = (const cst_vox_unit *)vox_data(vf,CST_VOX_UNITS,&n);
+    if (sizeof(cst_clunit) == sizeof(cst_vox_unit))
+	db->units = (const cst_clunit *)units;
+    else
+    {
+	vf->units = cst_alloc(cst_clunit,n);
+	for (i=0; i<n; i++)
+	{
+	    vf->units[i].type = units[i].type;
+	    vf->units[i].phone = units[i].phone;
+	    vf->units[i].start = units[i].start;
+	    vf->units[i].end = units[i].end;
+	    vf->units[i].prev = units[i].prev;
+	    vf->units[i].next = units[i].next;
+	}
+	db->units = vf->units;
+    }
+    db->name = vf->strings + u->name;
+    db->types = vf->types;
+    db->trees = vf->trees;
+    db->num_types = u->num_entries;
+    db->num_units = u->num_units;
+    db->sts = vf->sts;
+    db->mcep = vf->mcep;
+    db->join_weights = (int *)vox_data(vf,CST_VOX_WEIGHTS,NULL);
+    db->optimal_coupling = u->optimal_coupling;
+    db->extend_selections = u->extend_selections;
+    db->f0_weight = u->f0_weight;
+    db->unit_name_func = NULL;
+    vf->clunit_db = db;
+}
+
+cst_voxfile *cst_vox_open(const char *path)
+{
+    cst_filemap *map;
+    cst_voxfile *vf;
+    const cst_vox_unitdb *u;
+
+    if ((map = cst_mmap_file(path)) == NULL)
+    {
+	cst_errmsg("cst_vox_open: can't map file \"%s\"\n",path);
+	return NULL;
+    }
+    if (!vox_check(map,path))
+    {
+	cst_munmap_file(map);
+	return NULL;
+    }
+    vf = cst_alloc(cst_voxfile,1);
+    vf->map = map;
+    vf->strings = (const char *)vox_data(vf,CST_VOX_STRINGS,NULL);
+    vox_load_features(vf);
+    vf->sts = vox_load_sts(vf,"LPC",&vf->sts_maps[0]);
+    vf->mcep = vox_load_sts(vf,"MCP",&vf->sts_maps[3]);
+
+    u = (const cst_vox_unitdb *)vox_data(vf,CST_VOX_UNITDB,NULL);
+    if (u && u->db_type == CST_VOX_DIPHONE && vf->sts)
+	vox_load_diphones(vf,u);
+    else if (u && u->db_type == CST_VOX_CLUNITS && vf->sts && vf->mcep)
+	vox_load_clunits(vf,u);
+    else
+    {
+	cst_errmsg("cst_vox_open: \"%s\" has no unit database\n",path);
+	cst_vox_close(vf);
+	return NULL;
+    }
+    return vf;
+}
+
+void cst_vox_close(cst_voxfile *vf)
+{
+    if (vf == NULL)
+	return;
+    delete_features(vf->features);
+    delete_sts_list(vf->sts);
+    delete_sts_list(vf->mcep);
+    cst_free(vf->diphone_db);
+    cst_free(vf->diphones);
+    cst_free(vf->clunit_db);
+    cst_free(vf->types);
+    cst_free(vf->units);
+    cst_free(vf->carts);
+    cst_free(vf->trees);
+    cst_free(vf->nodes);
+    cst_free(vf->feat_names);
+    cst_free(vf->vals);
+    cst_munmap_file(vf->map);
+    cst_free(vf);
+}
+
+cst_diphone_db *cst_vox_diphone_db(cst_voxfile *vf)
+{
+    return vf->diphone_db;
+}
+
+cst_clunit_db *cst_vox_clunit_db(cst_voxfile *vf)
+{
+    return vf->clunit_db;
+}
+
+cst_features *cst_vox_features(cst_voxfile *vf)
+{
+    return vf->features;
+}
@@ -0,0 +1,201 @@
+/* ----------------------------------------------------------- */
+/*                                                             */
+/*                        _ ___                                */
+/*                       /_\ | |_/                             */
+/*                       | | | | \                             */
+/*                       =========                             */
+/*                                                             */
+/*        Real-time API for HTK-base Speech Recognition        */
+/*                                                             */
+/*       Machine Intelligence Laboratory (Speech Group)        */
+/*        Cambridge University Engineering Department          */
+/*                  http://mi.eng.cam.ac.uk/                   */
+/*                                                             */
+/*               Copyright CUED 2000-2007                      */
+/*                                                             */
+/*   Use of this software is governed by a License Agreement   */
+/*    ** See the file License for the Conditions of Use  **    */
+/*    **     This banner notice must not be removed      **    */
+/*                                                             */
+/* ----------------------------------------------------------- */
+/*   File: cst_voxfile.h - memory mapped voice databases       */
+/* ----------------------------------------------------------- */
+
+/*
+   A voice file holds the unit database of a diphone or clunits
+   voice (sts frames and residuals, unit indexes, clunit trees) and
+   the voice parameters in one binary file.  It is mapped read-only
+   and the bulk data is used where it lies in the map, so several
+   processes using the same voice share its pages and a voice can
+   be replaced without relinking.
+
+   The file is a header, a section directory and 8 byte aligned
+   sections in the byte order of the machine that wrote it.  Only
+   the small tables which hold pointers (diphone and unit type
+   names, tree nodes and their values) are built at load time.
+*/
+
+#ifndef _CST_VOXFILE_H__
+#define _CST_VOXFILE_H__
+
+#include "cst_file.h"
+#include "cst_features.h"
+#include "cst_sts.h"
+#include "cst_cart.h"
+#include "cst_diphone.h"
+#include "cst_clunits.h"
+
+#define CST_VOX_MAGIC     "CSTVOXDB"
+#define CST_VOX_VERSION   1
+#define CST_VOX_BYTEORDER 0x01020304
+
+/* Section tags */
+#define CST_VOX_STRINGS   "STRS"   /* nul terminated strings */
+#define CST_VOX_FEATURES  "FEAT"   /* voice parameters */
+#define CST_VOX_UNITDB    "UNDB"   /* cst_vox_unitdb */
+#define CST_VOX_DIPHONES  "DIPH"   /* cst_vox_diphone entries */
+#define CST_VOX_TYPES     "CLTY"   /* cst_vox_type entries */
+#define CST_VOX_UNITS     "CLUN"   /* cst_vox_unit entries */
+#define CST_VOX_WEIGHTS   "CLJW"   /* join weights, one int per channel */
+#define CST_VOX_TREES     "TREE"   /* cst_vox_tree entries */
+#define CST_VOX_NODES     "NODE"   /* cst_vox_node entries */
+#define CST_VOX_FEATNAMES "TFEA"   /* tree feature names, string offsets */
+#define CST_VOX_VALS      "TVAL"   /* cst_vox_val entries */
+/* Each sts list has a header, frames, residuals and residual     */
+/* offsets, the lpc list is "LPC?" and the mel cep list "MCP?"    */
+#define CST_VOX_STS_HEAD  'H'      /* cst_vox_sts */
+#define CST_VOX_STS_FRAME 'F'      /* unsigned shorts, num_channels per frame */
+#define CST_VOX_STS_RES   'R'      /* residual bytes */
+#define CST_VOX_STS_OFFS  'O'      /* num_sts+1 unsigned ints into residuals */
+
+#define CST_VOX_DIPHONE   1
+#define CST_VOX_CLUNITS   2
+
+/* Used to mark a NULL value or cdr in the val table */
+#define CST_VOX_NOVAL     0xffffffff
+
+typedef struct cst_vox_header_struct {
+    char magic[8];
+    unsigned int version;
+    unsigned int byteorder;
+    unsigned int num_sections;
+    unsigned int pad;
+} cst_vox_header;
+
+typedef struct cst_vox_section_struct {
+    char tag[4];
+    unsigned int offset;        /* from start of file */
+    unsigned int size;          /* in bytes */
+    unsigned int count;         /* entries */
+} cst_vox_section;
+
+typedef struct cst_vox_feat_struct {
+    unsigned int name;          /* string offset */
+    int type;                   /* CST_VAL_TYPE_INT, FLOAT or STRING */
+    union { int ival; float fval; unsigned int sval; } v;
+} cst_vox_feat;
+
+typedef struct cst_vox_unitdb_struct {
+    int db_type;                /* CST_VOX_DIPHONE or CST_VOX_CLUNITS */
+    unsigned int name;
+    int num_entries;            /* diphones or clunit types */
+    int num_units;
+    int optimal_coupling;
+    int extend_selections;
+    int f0_weight;
+    int pad;
+} cst_vox_unitdb;
+
+typedef struct cst_vox_sts_struct {
+    int num_sts;
+    int num_channels;
+    int sample_rate;
+    float coeff_min;
+    float coeff_range;
+    float post_emphasis;
+    int residual_fold;
+    int pad;
+} cst_vox_sts;
+
+typedef struct cst_vox_diphone_struct {
+    unsigned int name;
+    int start_pm;
+    int pb_pm;
+    int end_pm;
+} cst_vox_diphone;
+
+typedef struct cst_vox_type_struct {
+    unsigned int name;
+    unsigned short start, count;
+} cst_vox_type;
+
+/* Laid out as cst_clunit so the table is used in place */
+typedef struct cst_vox_unit_struct {
+    unsigned short type, phone;
+    int start, end;
+    unsigned short prev, next;
+} cst_vox_unit;
+
+typedef struct cst_vox_tree_struct {
+    unsigned int first_node;
+    unsigned int num_nodes;
+    unsigned int first_feat;
+    unsigned int num_feats;
+} cst_vox_tree;
+
+typedef struct cst_vox_node_struct {
+    unsigned char feat;
+    unsigned char op;
+    unsigned short no_node;
+    unsigned int val;           /* index in val table or CST_VOX_NOVAL */
+} cst_vox_node;
+
+/* Atoms hold their value in a, cons cells the car and cdr indexes */
+typedef struct cst_vox_val_struct {
+    int type;                   /* CST_VAL_TYPE_CONS, INT, FLOAT or STRING */
+    union { int ival; float fval; unsigned int sval; unsigned int car; } a;
+    unsigned int cdr;
+} cst_vox_val;
+
+typedef struct cst_voxfile_struct {
+    cst_filemap *map;
+    const char *strings;
+    cst_features *features;
+    cst_diphone_db *diphone_db;
+    cst_clunit_db *clunit_db;
+
+    /* Built at load time, the rest is in the map */
+    cst_sts_list *sts, *mcep;
+    cst_filemap sts_maps[6];
+    cst_diphone_entry *diphones;
+    cst_clunit_type *types;
+    cst_clunit *units;          /* copy only if cst_clunit differs */
+    cst_cart *carts;
+    const cst_cart **trees;
+    cst_cart_node *nodes;
+    const char **feat_names;
+    cst_val *vals;
+} cst_voxfile;
+
+/* Map a voice file, NULL if it can't be read or isn't a voice file */
+/* of this version and byte order                                   */
+cst_voxfile *cst_vox_open(const char *path);
+void cst_vox_close(cst_voxfile *vf);
+
+/* The unit database (the one which matches the voice type, else     */
+/* NULL) and the voice parameters, all owned by the voice file.  The */
+/* clunit db unit_name_func is not saved, it is left for the voice   */
+/* to set                                                            */
+cst_diphone_db *cst_vox_diphone_db(cst_voxfile *vf);
+cst_clunit_db *cst_vox_clunit_db(cst_voxfile *vf);
+cst_features *cst_vox_features(cst_voxfile *vf);
+
+/* Write a voice file from a database, compiled in or mapped.  Only */
+/* int, float and string params are saved.  Residuals must be one  */
+/* byte per sample (not "pulse" residuals).  Returns 0 on success   */
+int cst_vox_save_diphone_db(const char *path, const cst_diphone_db *db,
+			    const cst_features *params);
+int cst_vox_save_clunit_db(const char *path, const cst_clunit_db *db,
+			   const cst_features *params);
+
+#endif
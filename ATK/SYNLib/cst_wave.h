@@ -101,32 +101,15 @@ void cst_wave_resize(cst_wave *w,int samples, int num_channels);
 void cst_wave_resample(cst_wave *w, int sample_rate);
 void cst_wave_rescale(cst_wave *w, int factor);
 
-/* Resampling code */
-typedef struct cst_rateconv_struct {
-	int channels;           /* what do you think? */
-	int up, down;           /* up/down sampling ratio */
-
-	double gain;            /* output gain */
-	int lag;                /* lag time (in samples) */
-	int *sin, *sout, *coep; /* filter buffers, coefficients */
-
-	/* n.b. outsize is the minimum buffer size for
-           cst_rateconv_out() when streaming */
-	int insize, outsize;    /* size of filter buffers */
-	int incount;		/* amount of input data */
-	int len;		/* size of filter */
-
-	/* internal foo coefficients */
-	double fsin, fgk, fgg;
-	/* internal counters */
-	int inbaseidx, inoffset, cycctr, outidx;
-} cst_rateconv;
+/* Resampling code, up and down may be the sample rates themselves */
+typedef struct cst_rateconv_struct cst_rateconv;
 
 cst_rateconv * new_rateconv(int up, int down, int channels);
 void delete_rateconv(cst_rateconv *filt);
-int cst_rateconv_in(cst_rateconv *filt, const short *inptr, int max);
-int cst_rateconv_leadout(cst_rateconv *filt);
-int cst_rateconv_out(cst_rateconv *filt, short *outptr, int max);
+int cst_rateconv_size(cst_rateconv *filt, int n);
+int cst_rateconv_run(cst_rateconv *filt, const short *inptr, int n,
+		     short *outptr);
+int cst_rateconv_flush(cst_rateconv *filt, short *outptr);
 
 /* File format cruft. */
 
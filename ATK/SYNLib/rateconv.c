@@ -2,6 +2,13 @@
    Huggins-Daines <dhd@cepstral.com> in December 2001 for use in the
    Flite and Theta speech synthesis systems. */
 
+/* Modified again for ATK in October 2026: the filtering is now done
+   by the polyphase converter in HTKLib/HSigP.c so that it can also be
+   used by ASource and ASyn.  That follows the design described below
+   but with 16 bit coefficients and samples, filter banks shared
+   between converters with the same ratio and the ratio reduced to
+   lowest terms.  This file keeps the cst_rateconv interface. */
+
 /*
  *
  *	RATECONV.C
@@ -149,7 +156,6 @@
  *	    Zwicker, E., Fastl, H.: "Psychoacoustics - Facts and Models",
  * Springer-Verlag, Berlin, Heidelberg, New-York, Tokyo, 1990 */
 
-#include <math.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -158,330 +164,65 @@
 #include "cst_error.h"
 #include "cst_wave.h"
 
-/*
- *	adaptable defines and globals
- */
-
-#define DPRINTF(l, x)
-
-#define FIXSHIFT 16
-#define FIXMUL (1<<FIXSHIFT)
-
-#ifndef M_PI
-#define M_PI 3.1415926535
-#endif
+#include "HShell.h"
+#include "HMem.h"
+#include "HMath.h"
+#include "HSigP.h"
 
-#define sqr(a)	((a)*(a))
-
-/*
- *	FIR-routines, mono and stereo
- *	this is where we need all the MIPS
- */
-static void
-fir_mono(int *inp, int *coep, int firlen, int *outp)
-{
-	register int akku = 0, *endp;
-	int n1 = (firlen / 8) * 8, n0 = firlen % 8;
-
-	endp = coep + n1;
-	while (coep != endp) {
-		akku += *inp++ * *coep++;
-		akku += *inp++ * *coep++;
-		akku += *inp++ * *coep++;
-		akku += *inp++ * *coep++;
-		akku += *inp++ * *coep++;
-		akku += *inp++ * *coep++;
-		akku += *inp++ * *coep++;
-		akku += *inp++ * *coep++;
-	}
+struct cst_rateconv_struct {
+	int channels;
+	MemHeap heap;		/* holds the converter */
+	RateConv rc;
+};
 
-	endp = coep + n0;
-	while (coep != endp) {
-		akku += *inp++ * *coep++;
-	}
-	*outp = akku;
-}
-
-static void
-fir_stereo(int *inp, int *coep,
-	   int firlen, int *out1p, int *out2p)
-{
-	register int akku1 = 0, akku2 = 0, *endp;
-	int n1 = (firlen / 8) * 8, n0 = firlen % 8;
-
-	endp = coep + n1;
-	while (coep != endp) {
-		akku1 += *inp++ * *coep;
-		akku2 += *inp++ * *coep++;
-		akku1 += *inp++ * *coep;
-		akku2 += *inp++ * *coep++;
-		akku1 += *inp++ * *coep;
-		akku2 += *inp++ * *coep++;
-		akku1 += *inp++ * *coep;
-		akku2 += *inp++ * *coep++;
-		akku1 += *inp++ * *coep;
-		akku2 += *inp++ * *coep++;
-		akku1 += *inp++ * *coep;
-		akku2 += *inp++ * *coep++;
-		akku1 += *inp++ * *coep;
-		akku2 += *inp++ * *coep++;
-		akku1 += *inp++ * *coep;
-		akku2 += *inp++ * *coep++;
-	}
-
-	endp = coep + n0;
-	while (coep != endp) {
-		akku1 += *inp++ * *coep;
-		akku2 += *inp++ * *coep++;
-	}
-	*out1p = akku1;
-	*out2p = akku2;
-}
-
-/*
- * 	filtering from input buffer to output buffer;
- *	returns number of processed samples in output buffer:
- *	if it is not equal to output buffer size,
- *	the input buffer is expected to be refilled upon entry, so that
- *	the last firlen numbers of the old input buffer are
- *	the first firlen numbers of the new input buffer;
- *	if it is equal to output buffer size, the output buffer
- *	is full and is expected to be stowed away;
- *
- */
-static int
-filtering_on_buffers(cst_rateconv *filt)
+cst_rateconv *
+new_rateconv(int up, int down, int channels)
 {
-	int insize;
+	cst_rateconv *filt;
 
-	DPRINTF(0, ("filtering_on_buffers(%d)\n", filt->incount));
-	insize = filt->incount + filt->lag;
-	if (filt->channels == 1) {
-		while (1) {
-			filt->inoffset = (filt->cycctr * filt->down)/filt->up;
-			if ((filt->inbaseidx + filt->inoffset + filt->len) > insize) {
-				filt->inbaseidx -= insize - filt->len + 1;
-				memcpy(filt->sin, filt->sin + insize - filt->lag,
-				       filt->lag * sizeof(int));
-				/* Prevent people from re-filtering the same stuff. */
-				filt->incount = 0;
-				return 0;
-			}
-			fir_mono(filt->sin + filt->inoffset + filt->inbaseidx,
-				 filt->coep + filt->cycctr * filt->len,
-				 filt->len, filt->sout + filt->outidx);
-			DPRINTF(1, ("in(%d + %d) = %d cycctr %d out(%d) = %d\n",
-				    filt->inoffset, filt->inbaseidx,
-				    filt->sin[filt->inoffset + filt->inbaseidx],
-				    filt->cycctr, filt->outidx,
-				    filt->sout[filt->outidx] >> FIXSHIFT));
-			++filt->outidx;
-			++filt->cycctr;
-			if (!(filt->cycctr %= filt->up))
-				filt->inbaseidx += filt->down;
-			if (!(filt->outidx %= filt->outsize))
-				return filt->outsize;
-		}
-	} else if (filt->channels == 2) {
-		/*
-		 * rule how to convert mono routine to stereo routine:
-		 * firlen, up, down and cycctr relate to samples in general,
-		 * wether mono or stereo; inbaseidx, inoffset and outidx as
-		 * well as insize and outsize still account for mono samples.
-		 */
-		while (1) {
-			filt->inoffset = 2*((filt->cycctr * filt->down)/filt->up);
-			if ((filt->inbaseidx + filt->inoffset + 2*filt->len) > insize) {
-				filt->inbaseidx -= insize - 2*filt->len + 2;
-				return filt->outidx;
-			}
-			fir_stereo(filt->sin + filt->inoffset + filt->inbaseidx,
-				   filt->coep + filt->cycctr * filt->len,
-				   filt->len,
-				   filt->sout + filt->outidx,
-				   filt->sout + filt->outidx + 1);
-			filt->outidx += 2;
-			++filt->cycctr;
-			if (!(filt->cycctr %= filt->up))
-				filt->inbaseidx += 2*filt->down;
-			if (!(filt->outidx %= filt->outsize))
-				return filt->outsize;
-		}
-	} else {
-		cst_errmsg("filtering_on_buffers: only 1 or 2 channels supported!\n");
+	if (channels < 1) {
+		cst_errmsg("new_rateconv: channels must be 1 or more\n");
 		cst_error();
 	}
-	return 0;
-}
-
-/*
- *	convert buffer of n samples to ints
- */
-static void
-sample_to_int(short *buff, int n)
-{
-	short *s, *e;
-	int *d;
-
-	if (n < 1)
-		return;
-	s = buff + n;
-	d = (int*)buff + n;
-	e = buff;
-	while (s != e) {
-		*--d = (int)(*--s);
-	}
+	filt = cst_alloc(cst_rateconv, 1);
+	filt->channels = channels;
+	CreateHeap(&filt->heap, "rateconv", MSTAK, 1, 0.0, 4096, 16384);
+	filt->rc = CreateRateConv(&filt->heap, down, up, channels);
+	return filt;
 }
 
-/*
- *	convert buffer of n ints to samples
- */
-static void
-int_to_sample(short *buff, int n)
+void
+delete_rateconv(cst_rateconv *filt)
 {
-	int *s;
-	short *e, *d;
-
-	if (n < 1)
-		return;
-	s = (int *)buff;
-	d = buff;
-	e = buff + n;
-	while (d != e)
-		*d++ = (*s++ >> FIXSHIFT);
+	DeleteHeap(&filt->heap);
+	cst_free(filt);
 }
 
 /*
- *	read and convert input sample format to integer
+ *	max number of frames output for n input frames, or by
+ *	cst_rateconv_flush when n is 0
  */
 int
-cst_rateconv_in(cst_rateconv *filt, const short *inptr, int max)
+cst_rateconv_size(cst_rateconv *filt, int n)
 {
-	if (max > filt->insize - filt->lag)
-		max = filt->insize - filt->lag;
-	if (max > 0) {
-		memcpy(filt->sin + filt->lag, inptr, max * sizeof(short));
-		sample_to_int((short *)(filt->sin + filt->lag), max);
-	}
-	filt->incount = max;
-	return max;
+	return RateConvSize(filt->rc, n);
 }
 
 /*
- *	do some conversion jobs and write
+ *	convert n frames from inptr to outptr, return frames output
  */
 int
-cst_rateconv_out(cst_rateconv *filt, short *outptr, int max)
+cst_rateconv_run(cst_rateconv *filt, const short *inptr, int n,
+		 short *outptr)
 {
-	int outsize;
-
-	if ((outsize = filtering_on_buffers(filt)) == 0)
-		return 0;
-	if (max > outsize)
-		max = outsize;
-	int_to_sample((short *)filt->sout, max);
-	memcpy(outptr, filt->sout, max * sizeof(short));
-	return max;
-}
-
-int
-cst_rateconv_leadout(cst_rateconv *filt)
-{
-	memset(filt->sin + filt->lag, 0, filt->lag * sizeof(int));
-	filt->incount = filt->lag;
-	return filt->lag;
-}
-
-/*
- *	evaluate sinc(x) = sin(x)/x safely
- */
-static double
-sinc(double x)
-{
-	return(fabs(x) < 1E-50 ? 1.0 : sin(fmod(x,2*M_PI))/x);
+	return RunRateConv(filt->rc, (short *)inptr, n, outptr);
 }
 
 /*
- *	evaluate interpolation function g(t) at t
- *	integral of g(t) over all times is expected to be one
+ *	output the remaining frames at the end of the input
  */
-static double
-interpol_func(double t, double fgk, double fgg)
-{
-	return (2*fgk*sinc(M_PI*2*fgk*t)*exp(-M_PI*sqr(2*fgg*t)));
-}
-
-/*
- *	evaluate coefficient from i, q=n%u by sampling interpolation function
- *	and scale it for integer multiplication used by FIR-filtering
- */
-static int
-coefficient(int i, int q, cst_rateconv *filt)
-{
-	return (int)(FIXMUL * filt->gain *
-		     interpol_func((fmod(q* filt->down/(double)filt->up,1.0)
-				    + (filt->len-1)/2.0 - i) / filt->fsin,
-				   filt->fgk, filt->fgg) / filt->fsin);
-}
-
-/*
- *	set up coefficient array
- */
-static void
-make_coe(cst_rateconv *filt)
-{
-	int i, q;
-
-	filt->coep = cst_alloc(int, filt->len * filt->up);
-	for (i = 0; i < filt->len; i++) {
-	    for (q = 0; q < filt->up; q++) {
-		filt->coep[q * filt->len + i]
-			= coefficient(i, q, filt);
-	    }
-	}
-}
-
-cst_rateconv *
-new_rateconv(int up, int down, int channels)
-{
-	cst_rateconv *filt;
-
-	if (!(channels == 1 || channels == 2)) {
-		cst_errmsg("new_rateconv: channels must be 1 or 2\n");
-		cst_error();
-	}
-
-	filt = cst_alloc(cst_rateconv, 1);
-	filt->fsin = 1.0;
-	filt->gain = 0.8;
-	filt->fgg = 0.0116;
-	filt->fgk = 0.461;
-	filt->len = 162;
-	filt->down = down;
-	filt->up = up;
-	filt->channels = channels;
-
-	if (down > up) {
-		filt->fgg *= (double) up / down;
-		filt->fgk *= (double) up / down;
-		filt->len = filt->len * down / up;
-	}
-
-	make_coe(filt);
-	filt->lag = (filt->len - 1) * channels;
-	filt->insize = channels*filt->len + filt->lag;
-	filt->outsize = channels*filt->len;
-	filt->sin = cst_alloc(int, filt->insize);
-	filt->sout = cst_alloc(int, filt->outsize);
-
-	return filt;
-}
-
-void
-delete_rateconv(cst_rateconv *filt)
+int
+cst_rateconv_flush(cst_rateconv *filt, short *outptr)
 {
-	cst_free(filt->coep);
-	cst_free(filt->sin);
-	cst_free(filt->sout);
-	cst_free(filt);
+	return FlushRateConv(filt->rc, outptr);
 }
@@ -46,6 +46,10 @@ void usenglish_init(cst_voice *v)
 {
     us_text_init();
 
+    /* Feature functions, registered first so the carts below can */
+    /* be compiled against them */
+    us_ff_register(v->ffunctions);
+
     /* Phoneset */
     feat_set(v->features,"phoneset",phoneset_val(&us_phoneset));
     feat_set_string(v->features,"silence",us_phoneset.silence);
@@ -61,14 +65,18 @@ void usenglish_init(cst_voice *v)
     feat_set(v->features,"tokentowords_func",itemfunc_val(&us_tokentowords));
 
     /* Phrasing */
-    feat_set(v->features,"phrasing_cart",cart_val(&us_phrasing_cart));
+    feat_set(v->features,"phrasing_cart",
+	     cart_val(cart_compile(&us_phrasing_cart,v->ffunctions)));
 
     /* Intonation */
-    feat_set(v->features,"int_cart_accents",cart_val(&us_int_accent_cart));
-    feat_set(v->features,"int_cart_tones",cart_val(&us_int_tone_cart));
+    feat_set(v->features,"int_cart_accents",
+	     cart_val(cart_compile(&us_int_accent_cart,v->ffunctions)));
+    feat_set(v->features,"int_cart_tones",
+	     cart_val(cart_compile(&us_int_tone_cart,v->ffunctions)));
 
     /* Duration */
-    feat_set(v->features,"dur_cart",cart_val(&us_durz_cart));
+    feat_set(v->features,"dur_cart",
+	     cart_val(cart_compile(&us_durz_cart,v->ffunctions)));
     feat_set(v->features,"dur_stats",dur_stats_val((dur_stats *)us_dur_stats));
 
     /* f0 model */
@@ -76,6 +84,4 @@ void usenglish_init(cst_voice *v)
 
     /* Post lexical rules */
     feat_set(v->features,"postlex_func",uttfunc_val(&us_postlex));
-
-    us_ff_register(v->ffunctions);
 }